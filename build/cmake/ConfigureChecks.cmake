@@ -51,9 +51,20 @@ check_include_file(sys/un.h HAVE_SYS_UN_H)
 check_include_file(poll.h HAVE_POLL_H)
 check_include_file(sys/poll.h HAVE_SYS_POLL_H)
 check_include_file(sys/select.h HAVE_SYS_SELECT_H)
+check_include_file(sys/epoll.h HAVE_SYS_EPOLL_H)
+check_include_file(sys/eventfd.h HAVE_SYS_EVENTFD_H)
 check_include_file(sched.h HAVE_SCHED_H)
 check_include_file(string.h HAVE_STRING_H)
 check_include_file(strings.h HAVE_STRINGS_H)
+check_include_file(linux/io_uring.h HAVE_LINUX_IO_URING_H)
+
+# zstd and lz4 are only used by thriftz, which links them if enabled
+if(WITH_ZSTD)
+  set(HAVE_ZSTD_H 1)
+endif()
+if(WITH_LZ4)
+  set(HAVE_LZ4FRAME_H 1)
+endif()
 
 # Check for afunix.h on Windows (since Windows 10 Insider Build 17063):
 check_cxx_source_compiles(
@@ -67,6 +67,13 @@ if(WITH_CPP)
     find_package(ZLIB QUIET)
     CMAKE_DEPENDENT_OPTION(WITH_ZLIB "Build with ZLIB support" ON
                            "ZLIB_FOUND" OFF)
+    # zstd and lz4 are built into the zlib library, along with THeaderTransport
+    find_package(Zstd QUIET)
+    CMAKE_DEPENDENT_OPTION(WITH_ZSTD "Build with zstd support" ON
+                           "WITH_ZLIB;Zstd_FOUND" OFF)
+    find_package(LZ4 QUIET)
+    CMAKE_DEPENDENT_OPTION(WITH_LZ4 "Build with LZ4 support" ON
+                           "WITH_ZLIB;LZ4_FOUND" OFF)
     find_package(Libevent QUIET)
     CMAKE_DEPENDENT_OPTION(WITH_LIBEVENT "Build with libevent support" ON
                            "Libevent_FOUND" OFF)
@@ -185,6 +192,8 @@ if (BUILD_CPP)
     message(STATUS "    Build with libevent support:              ${WITH_LIBEVENT}")
     message(STATUS "    Build with Qt5 support:                   ${WITH_QT5}")
     message(STATUS "    Build with ZLIB support:                  ${WITH_ZLIB}")
+    message(STATUS "    Build with zstd support:                  ${WITH_ZSTD}")
+    message(STATUS "    Build with LZ4 support:                   ${WITH_LZ4}")
 endif ()
 message(STATUS)
 message(STATUS "  Build C (GLib) library:                     ${BUILD_C_GLIB}")
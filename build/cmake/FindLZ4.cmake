@@ -0,0 +1,18 @@
+# find lz4
+# a very fast lossless compression library (https://lz4.org/)
+#
+# Usage:
+# LZ4_INCLUDE_DIRS, where to find lz4 headers
+# LZ4_LIBRARIES, lz4 libraries
+# LZ4_FOUND, If false, do not try to use lz4
+
+find_path(LZ4_INCLUDE_DIRS lz4frame.h)
+find_library(LZ4_LIBRARIES NAMES lz4 liblz4)
+
+include(FindPackageHandleStandardArgs)
+find_package_handle_standard_args(LZ4 DEFAULT_MSG LZ4_LIBRARIES LZ4_INCLUDE_DIRS)
+
+mark_as_advanced(
+    LZ4_LIBRARIES
+    LZ4_INCLUDE_DIRS
+  )
@@ -0,0 +1,18 @@
+# find zstd
+# a fast lossless compression library (https://facebook.github.io/zstd/)
+#
+# Usage:
+# ZSTD_INCLUDE_DIRS, where to find zstd headers
+# ZSTD_LIBRARIES, zstd libraries
+# Zstd_FOUND, If false, do not try to use zstd
+
+find_path(ZSTD_INCLUDE_DIRS zstd.h)
+find_library(ZSTD_LIBRARIES NAMES zstd zstd_static libzstd)
+
+include(FindPackageHandleStandardArgs)
+find_package_handle_standard_args(Zstd DEFAULT_MSG ZSTD_LIBRARIES ZSTD_INCLUDE_DIRS)
+
+mark_as_advanced(
+    ZSTD_LIBRARIES
+    ZSTD_INCLUDE_DIRS
+  )
@@ -27,6 +27,8 @@
 #include <iomanip>
 #include <iostream>
 #include <limits>
+#include <map>
+#include <set>
 #include <sstream>
 #include <string>
 #include <vector>
@@ -66,6 +68,8 @@ public:
     gen_moveable_ = false;
     gen_no_ostream_operators_ = false;
     gen_no_skeleton_ = false;
+    gen_zero_copy_binary_ = false;
+    gen_partial_read_ = false;
     has_members_ = false;
 
     for( iter = parsed_options.begin(); iter != parsed_options.end(); ++iter) {
@@ -88,6 +92,10 @@ public:
         gen_no_ostream_operators_ = true;
       } else if ( iter->first.compare("no_skeleton") == 0) {
         gen_no_skeleton_ = true;
+      } else if ( iter->first.compare("zero_copy_binary") == 0) {
+        gen_zero_copy_binary_ = true;
+      } else if ( iter->first.compare("partial_read") == 0) {
+        gen_partial_read_ = true;
       } else {
         throw "unknown option cpp:" + iter->first;
       }
@@ -154,9 +162,16 @@ public:
   void generate_equality_operator(std::ostream& out, t_struct* tstruct);
   void generate_move_assignment_operator(std::ostream& out, t_struct* tstruct);
   void generate_assignment_helper(std::ostream& out, t_struct* tstruct, bool is_move);
-  void generate_struct_reader(std::ostream& out, t_struct* tstruct, bool pointers = false);
+  void generate_struct_reader(std::ostream& out,
+                              t_struct* tstruct,
+                              bool pointers = false,
+                              bool partial = false);
   void generate_struct_writer(std::ostream& out, t_struct* tstruct, bool pointers = false);
   void generate_struct_result_writer(std::ostream& out, t_struct* tstruct, bool pointers = false);
+  void generate_struct_serialized_size(std::ostream& out,
+                                       t_struct* tstruct,
+                                       bool pointers = false,
+                                       bool result = false);
   void generate_struct_swap(std::ostream& out, t_struct* tstruct);
   void generate_struct_print_method(std::ostream& out, t_struct* tstruct);
   void generate_exception_what_method(std::ostream& out, t_struct* tstruct);
@@ -224,6 +239,16 @@ public:
 
   void generate_serialize_list_element(std::ostream& out, t_list* tlist, std::string iter);
 
+  void generate_serialized_size_field(std::ostream& out,
+                                      t_field* tfield,
+                                      std::string prefix = "",
+                                      std::string suffix = "");
+
+  void generate_serialized_size_container(std::ostream& out,
+                                          t_type* ttype,
+                                          std::string prefix = "");
+  bool may_have_fixed_size(t_type* ttype);
+
   void generate_function_call(ostream& out,
                               t_function* tfunction,
                               string target,
@@ -268,6 +293,76 @@ public:
 
   bool is_reference(t_field* tfield) { return tfield->get_reference(); }
 
+  /**
+   * True if a field is annotated with cpp.lazy and can be declared as a
+   * TLazy, which only holds structs.
+   */
+  bool is_lazy(t_field* tfield) {
+    t_type* type = get_true_type(tfield->get_type());
+    return tfield->annotations_.count("cpp.lazy") && !is_reference(tfield)
+           && (type->is_struct() || type->is_xception());
+  }
+
+  bool has_lazy_fields() {
+    std::vector<t_struct*> structs = program_->get_objects();
+    for (auto tservice : program_->get_services()) {
+      for (auto tfunction : tservice->get_functions()) {
+        structs.push_back(tfunction->get_arglist());
+      }
+    }
+    for (auto tstruct : structs) {
+      for (auto tfield : tstruct->get_members()) {
+        if (is_lazy(tfield)) {
+          return true;
+        }
+      }
+    }
+    return false;
+  }
+
+  /**
+   * Returns the suffix of the bulk TProtocol call, e.g. "I64s" for
+   * readI64s()/writeI64s(), that can move the elements of a list or set in
+   * one go, or an empty string when it must be done element by element.
+   * Only the default std::vector and std::set of plain numbers qualify.
+   */
+  std::string bulk_suffix(t_type* ttype) {
+    t_type* etype;
+    if (ttype->is_list()) {
+      etype = ((t_list*)ttype)->get_elem_type();
+    } else if (ttype->is_set()) {
+      etype = ((t_set*)ttype)->get_elem_type();
+    } else {
+      return "";
+    }
+    if (((t_container*)ttype)->has_cpp_name()) {
+      return "";
+    }
+    etype = get_true_type(etype);
+    if (!etype->is_base_type() || etype->annotations_.count("cpp.type")) {
+      return "";
+    }
+    switch (((t_base_type*)etype)->get_base()) {
+    case t_base_type::TYPE_I16:
+      return "I16s";
+    case t_base_type::TYPE_I32:
+      return "I32s";
+    case t_base_type::TYPE_I64:
+      return "I64s";
+    case t_base_type::TYPE_DOUBLE:
+      return "Doubles";
+    default:
+      return "";
+    }
+  }
+
+  /**
+   * True if a (true) binary type is read and written as a TBinaryView.
+   */
+  bool is_binary_view(t_type* ttype) {
+    return gen_zero_copy_binary_ && ttype->is_binary() && !ttype->annotations_.count("cpp.type");
+  }
+
   bool is_complex_type(t_type* ttype) {
     ttype = get_true_type(ttype);
 
@@ -347,6 +442,18 @@ private:
    */
   bool gen_no_ostream_operators_;
 
+  /**
+   * True if binary fields should be TBinaryViews into the read buffer
+   * rather than std::strings.
+   */
+  bool gen_zero_copy_binary_;
+
+  /**
+   * True if structs should get a readPartial() that reads only the fields
+   * in a TFieldMask.
+   */
+  bool gen_partial_read_;
+
   /**
    * True iff we should use a path prefix in our #include statements for other
    * thrift-generated header files.
@@ -448,8 +555,17 @@ void t_cpp_generator::init_generator() {
            << "#include <thrift/TApplicationException.h>" << '\n'
            << "#include <thrift/TBase.h>" << '\n'
            << "#include <thrift/protocol/TProtocol.h>" << '\n'
-           << "#include <thrift/transport/TTransport.h>" << '\n'
-           << '\n';
+           << "#include <thrift/transport/TTransport.h>" << '\n';
+  if (gen_partial_read_) {
+    f_types_ << "#include <thrift/protocol/TFieldMask.h>" << '\n';
+  }
+  if (gen_zero_copy_binary_) {
+    f_types_ << "#include <thrift/TBinaryView.h>" << '\n';
+  }
+  if (has_lazy_fields()) {
+    f_types_ << "#include <thrift/protocol/TLazy.h>" << '\n';
+  }
+  f_types_ << '\n';
   // Include C++xx compatibility header
   f_types_ << "#include <functional>" << '\n';
   f_types_ << "#include <memory>" << '\n';
@@ -919,6 +1035,9 @@ void t_cpp_generator::generate_cpp_struct(t_struct* tstruct, bool is_exception)
 
   std::ostream& out = (gen_templates_ ? f_types_tcc_ : f_types_impl_);
   generate_struct_reader(out, tstruct);
+  if (gen_partial_read_) {
+    generate_struct_reader(out, tstruct, false, true);
+  }
   generate_struct_writer(out, tstruct);
   generate_struct_swap(f_types_impl_, tstruct);
   if (!gen_no_default_operators_) {
@@ -1061,7 +1180,8 @@ void t_cpp_generator::generate_default_constructor(ostream& out,
     if (!t->is_base_type() && !t->is_enum() && !is_reference(*m_iter)) {
       t_const_value* cv = (*m_iter)->get_value();
       if (cv != nullptr) {
-        print_const_value(out, (*m_iter)->get_name(), t, cv);
+        string name = (*m_iter)->get_name() + (is_lazy(*m_iter) ? ".get()" : "");
+        print_const_value(out, name, t, cv);
       }
     }
   }
@@ -1360,6 +1480,17 @@ void t_cpp_generator::generate_struct_declaration(ostream& out,
         out << " override";
       out << ';' << '\n';
     }
+    if (is_user_struct && gen_partial_read_) {
+      // Reads only the fields in mask and skips the others
+      if (gen_templates_) {
+        out << indent() << "template <class Protocol_>" << '\n' << indent()
+            << "uint32_t readPartial(Protocol_* iprot, "
+            << "const ::apache::thrift::protocol::TFieldMask& mask);" << '\n';
+      } else {
+        out << indent() << "uint32_t readPartial(::apache::thrift::protocol::TProtocol* iprot, "
+            << "const ::apache::thrift::protocol::TFieldMask& mask);" << '\n';
+      }
+    }
   }
   if (write) {
     if (gen_templates_) {
@@ -1372,6 +1503,14 @@ void t_cpp_generator::generate_struct_declaration(ostream& out,
         out << " override";
       out << ';' << '\n';
     }
+    // The number of bytes write() will produce, or an upper bound for it
+    if (gen_templates_) {
+      out << indent() << "template <class Protocol_>" << '\n' << indent()
+          << "uint32_t serializedSize(Protocol_* oprot) const;" << '\n';
+    } else {
+      out << indent() << "uint32_t serializedSize("
+          << "::apache::thrift::protocol::TProtocol* oprot) const;" << '\n';
+    }
   }
   out << '\n';
 
@@ -1474,13 +1613,18 @@ void t_cpp_generator::generate_struct_definition(ostream& out,
  * @param out Stream to write to
  * @param tstruct The struct
  */
-void t_cpp_generator::generate_struct_reader(ostream& out, t_struct* tstruct, bool pointers) {
+void t_cpp_generator::generate_struct_reader(ostream& out,
+                                             t_struct* tstruct,
+                                             bool pointers,
+                                             bool partial) {
+  string method = partial ? "readPartial" : "read";
+  string mask = partial ? ", const ::apache::thrift::protocol::TFieldMask& mask" : "";
   if (gen_templates_) {
     out << indent() << "template <class Protocol_>" << '\n' << indent() << "uint32_t "
-        << tstruct->get_name() << "::read(Protocol_* iprot) {" << '\n';
+        << tstruct->get_name() << "::" << method << "(Protocol_* iprot" << mask << ") {" << '\n';
   } else {
-    indent(out) << "uint32_t " << tstruct->get_name()
-                << "::read(::apache::thrift::protocol::TProtocol* iprot) {" << '\n';
+    indent(out) << "uint32_t " << tstruct->get_name() << "::" << method
+                << "(::apache::thrift::protocol::TProtocol* iprot" << mask << ") {" << '\n';
   }
   indent_up();
 
@@ -1518,6 +1662,15 @@ void t_cpp_generator::generate_struct_reader(ostream& out, t_struct* tstruct, bo
   out << indent() << "if (ftype == ::apache::thrift::protocol::T_STOP) {" << '\n' << indent()
       << "  break;" << '\n' << indent() << "}" << '\n';
 
+  // Skip the fields that were not asked for
+  if (partial) {
+    out << indent() << "if (!mask.contains(fid)) {" << '\n'
+        << indent() << "  xfer += iprot->skip(ftype);" << '\n'
+        << indent() << "  xfer += iprot->readFieldEnd();" << '\n'
+        << indent() << "  continue;" << '\n'
+        << indent() << "}" << '\n';
+  }
+
   if (fields.empty()) {
     out << indent() << "xfer += iprot->skip(ftype);" << '\n';
   } else {
@@ -1546,11 +1699,27 @@ void t_cpp_generator::generate_struct_reader(ostream& out, t_struct* tstruct, bo
             indent() << "  throw TProtocolException(TProtocolException::INVALID_DATA);" << '\n';
 #endif
 
+      t_type* ftype = get_true_type((*f_iter)->get_type());
+      bool nestable = partial && (ftype->is_struct() || ftype->is_xception())
+                      && !is_reference(*f_iter) && !is_lazy(*f_iter);
+      if (nestable) {
+        // A struct may come with a mask of its own
+        out << indent() << "if (const ::apache::thrift::protocol::TFieldMask* nested = "
+            << "mask.nested(fid)) {" << '\n'
+            << indent() << "  xfer += this->" << (*f_iter)->get_name()
+            << ".readPartial(iprot, *nested);" << '\n'
+            << indent() << "} else {" << '\n';
+        indent_up();
+      }
       if (pointers && !(*f_iter)->get_type()->is_xception()) {
         generate_deserialize_field(out, *f_iter, "(*(this->", "))");
       } else {
         generate_deserialize_field(out, *f_iter, "this->");
       }
+      if (nestable) {
+        indent_down();
+        out << indent() << "}" << '\n';
+      }
       out << indent() << isset_prefix << (*f_iter)->get_name() << " = true;" << '\n';
       indent_down();
       out << indent() << "} else {" << '\n' << indent() << "  xfer += iprot->skip(ftype);" << '\n'
@@ -1580,9 +1749,14 @@ void t_cpp_generator::generate_struct_reader(ostream& out, t_struct* tstruct, bo
   // there might possibly be a chance of continuing.
   out << '\n';
   for (f_iter = fields.begin(); f_iter != fields.end(); ++f_iter) {
-    if ((*f_iter)->get_req() == t_field::T_REQUIRED)
-      out << indent() << "if (!isset_" << (*f_iter)->get_name() << ')' << '\n' << indent()
+    if ((*f_iter)->get_req() == t_field::T_REQUIRED) {
+      out << indent() << "if (!isset_" << (*f_iter)->get_name();
+      if (partial) {
+        out << " && mask.contains(" << (*f_iter)->get_key() << ")";
+      }
+      out << ')' << '\n' << indent()
           << "  throw TProtocolException(TProtocolException::INVALID_DATA);" << '\n';
+    }
   }
 
   indent(out) << "return xfer;" << '\n';
@@ -1653,6 +1827,8 @@ void t_cpp_generator::generate_struct_writer(ostream& out, t_struct* tstruct, bo
 
   indent_down();
   indent(out) << "}" << '\n' << '\n';
+
+  generate_struct_serialized_size(out, tstruct, pointers);
 }
 
 /**
@@ -1719,6 +1895,75 @@ void t_cpp_generator::generate_struct_result_writer(ostream& out,
 
   indent_down();
   indent(out) << "}" << '\n' << '\n';
+
+  generate_struct_serialized_size(out, tstruct, pointers, true);
+}
+
+/**
+ * Generates serializedSize(), which adds up the sizes the protocol gives for
+ * what write() puts on the wire.
+ *
+ * @param out Output stream
+ * @param tstruct The struct
+ * @param pointers Whether the fields are pointers, as in the args structs
+ * @param result Whether only the first field set is written, as in results
+ */
+void t_cpp_generator::generate_struct_serialized_size(ostream& out,
+                                                      t_struct* tstruct,
+                                                      bool pointers,
+                                                      bool result) {
+  const vector<t_field*>& fields = tstruct->get_sorted_members();
+  vector<t_field*>::const_iterator f_iter;
+
+  if (gen_templates_) {
+    out << indent() << "template <class Protocol_>" << '\n' << indent() << "uint32_t "
+        << tstruct->get_name() << "::serializedSize(Protocol_* oprot) const {" << '\n';
+  } else {
+    indent(out) << "uint32_t " << tstruct->get_name()
+                << "::serializedSize(::apache::thrift::protocol::TProtocol* oprot) const {" << '\n';
+  }
+  indent_up();
+
+  out << indent() << "uint32_t xfer = 0;" << '\n';
+
+  bool first = true;
+  for (f_iter = fields.begin(); f_iter != fields.end(); ++f_iter) {
+    bool check_if_set = result || (*f_iter)->get_req() == t_field::T_OPTIONAL
+                        || (*f_iter)->get_type()->is_xception();
+    if (check_if_set) {
+      if (result && !first) {
+        out << " else ";
+      } else {
+        out << '\n' << indent();
+      }
+      out << "if (this->__isset." << (*f_iter)->get_name() << ") {" << '\n';
+      indent_up();
+    } else {
+      out << '\n';
+    }
+    first = false;
+
+    out << indent() << "xfer += oprot->serializedSizeFieldBegin("
+        << type_to_enum((*f_iter)->get_type()) << ", " << (*f_iter)->get_key() << ");" << '\n';
+    if (pointers && (result || !(*f_iter)->get_type()->is_xception())) {
+      generate_serialized_size_field(out, *f_iter, "(*(this->", "))");
+    } else {
+      generate_serialized_size_field(out, *f_iter, "this->");
+    }
+    if (check_if_set) {
+      indent_down();
+      indent(out) << '}';
+      if (!result) {
+        out << '\n';
+      }
+    }
+  }
+
+  out << '\n' << indent() << "xfer += oprot->serializedSizeFieldStop();" << '\n' << indent()
+      << "return xfer;" << '\n';
+
+  indent_down();
+  indent(out) << "}" << '\n' << '\n';
 }
 
 /**
@@ -2865,7 +3110,9 @@ void t_cpp_generator::generate_service_client(t_service* tservice, string style)
             << ";" << '\n';
       }
 
-      out << indent() << "args.write(" << _this << "oprot_);" << '\n' << '\n' << indent() << _this
+      out << indent() << "::apache::thrift::protocol::reserveSerializedSize(" << _this
+          << "oprot_, args);" << '\n' << indent() << "args.write(" << _this << "oprot_);" << '\n'
+          << '\n' << indent() << _this
           << "oprot_->writeMessageEnd();" << '\n' << indent() << _this
           << "oprot_->getTransport()->writeEnd();" << '\n' << indent() << _this
           << "oprot_->getTransport()->flush();" << '\n';
@@ -3106,6 +3353,8 @@ public:
 
   void generate_class_definition();
   void generate_dispatch_call(bool template_protocol);
+  void generate_dispatch_switch();
+  void generate_dispatch_compare(const vector<t_function*>& functions);
   void generate_process_functions();
   void generate_factory();
 
@@ -3259,7 +3508,9 @@ void ProcessorGenerator::generate_class_definition() {
     f_header_ << indent() << "typedef std::map<std::string, ProcessFunction> "
               << "ProcessMap;" << '\n';
   }
-  f_header_ << indent() << "ProcessMap processMap_;" << '\n';
+  f_header_ << indent() << "// dispatchCall() calls the functions below without looking them"
+            << '\n' << indent() << "// up, processMap_ is only searched for names it does not know."
+            << '\n' << indent() << "ProcessMap processMap_;" << '\n';
 
   for (f_iter = functions.begin(); f_iter != functions.end(); ++f_iter) {
     indent(f_header_) << "void process_" << (*f_iter)->get_name() << "(" << finish_cob_
@@ -3366,7 +3617,9 @@ void ProcessorGenerator::generate_dispatch_call(bool template_protocol) {
          << "const std::string& fname, int32_t seqid" << call_context_ << ") {" << '\n';
   indent_up();
 
-  // HOT: member function pointer map
+  // HOT: switch on the name, with the map only for names not found there
+  generate_dispatch_switch();
+
   f_out_ << indent() << typename_str_ << "ProcessMap::iterator pfn;" << '\n' << indent()
          << "pfn = processMap_.find(fname);" << '\n' << indent()
          << "if (pfn == processMap_.end()) {" << '\n';
@@ -3415,6 +3668,79 @@ void ProcessorGenerator::generate_dispatch_call(bool template_protocol) {
   f_out_ << "}" << '\n' << '\n';
 }
 
+/**
+ * Generates a switch that calls the process function for fname directly.
+ * Names are told apart by their length first and then by the character
+ * position at which names of that length differ the most, so that usually
+ * a single string comparison is left.  Names not found fall through.
+ *
+ * The switch knows every function the constructor puts in processMap_, so
+ * an entry there for one of those names is never used.  processMap_ is
+ * private and filled only by the constructor, so the two cannot disagree.
+ */
+void ProcessorGenerator::generate_dispatch_switch() {
+  vector<t_function*> functions = service_->get_functions();
+  if (functions.empty()) {
+    return;
+  }
+
+  std::map<size_t, vector<t_function*> > by_length;
+  for (auto function : functions) {
+    by_length[function->get_name().size()].push_back(function);
+  }
+
+  indent(f_out_) << "switch (fname.size()) {" << '\n';
+  for (auto& length : by_length) {
+    const vector<t_function*>& group = length.second;
+    indent(f_out_) << "case " << length.first << ":" << '\n';
+    indent_up();
+    if (group.size() == 1) {
+      generate_dispatch_compare(group);
+    } else {
+      // Pick the position with the most distinct characters
+      size_t best_pos = 0;
+      size_t best_count = 0;
+      for (size_t pos = 0; pos < length.first; ++pos) {
+        std::set<char> chars;
+        for (auto function : group) {
+          chars.insert(function->get_name()[pos]);
+        }
+        if (chars.size() > best_count) {
+          best_pos = pos;
+          best_count = chars.size();
+        }
+      }
+
+      std::map<char, vector<t_function*> > by_char;
+      for (auto function : group) {
+        by_char[function->get_name()[best_pos]].push_back(function);
+      }
+      indent(f_out_) << "switch (fname[" << best_pos << "]) {" << '\n';
+      for (auto& c : by_char) {
+        indent(f_out_) << "case '" << c.first << "':" << '\n';
+        indent_up();
+        generate_dispatch_compare(c.second);
+        indent(f_out_) << "break;" << '\n';
+        indent_down();
+      }
+      indent(f_out_) << "}" << '\n';
+    }
+    indent(f_out_) << "break;" << '\n';
+    indent_down();
+  }
+  indent(f_out_) << "}" << '\n';
+}
+
+void ProcessorGenerator::generate_dispatch_compare(const vector<t_function*>& functions) {
+  for (auto function : functions) {
+    indent(f_out_) << "if (fname == \"" << function->get_name() << "\") {" << '\n';
+    indent(f_out_) << "  process_" << function->get_name() << "(" << cob_arg_
+                   << "seqid, iprot, oprot" << call_context_arg_ << ");" << '\n';
+    indent(f_out_) << "  return" << (style_ == "Cob" ? "" : " true") << ";" << '\n';
+    indent(f_out_) << "}" << '\n';
+  }
+}
+
 void ProcessorGenerator::generate_process_functions() {
   vector<t_function*> functions = service_->get_functions();
   vector<t_function*>::iterator f_iter;
@@ -3685,6 +4011,7 @@ void t_cpp_generator::generate_process_function(t_service* tservice,
         << "  this->eventHandler_->preWrite(ctx, " << service_func_name << ");" << '\n' << indent()
         << "}" << '\n' << '\n' << indent() << "oprot->writeMessageBegin(\"" << tfunction->get_name()
         << "\", ::apache::thrift::protocol::T_REPLY, seqid);" << '\n' << indent()
+        << "::apache::thrift::protocol::reserveSerializedSize(oprot, result);" << '\n' << indent()
         << "result.write(oprot);" << '\n' << indent() << "oprot->writeMessageEnd();" << '\n'
         << indent() << "bytes = oprot->getTransport()->writeEnd();" << '\n' << indent()
         << "oprot->getTransport()->flush();" << '\n' << '\n' << indent()
@@ -3854,6 +4181,7 @@ void t_cpp_generator::generate_process_function(t_service* tservice,
           << "  this->eventHandler_->preWrite(ctx, " << service_func_name << ");" << '\n'
           << indent() << "}" << '\n' << '\n' << indent() << "oprot->writeMessageBegin(\""
           << tfunction->get_name() << "\", ::apache::thrift::protocol::T_REPLY, seqid);" << '\n'
+          << indent() << "::apache::thrift::protocol::reserveSerializedSize(oprot, result);" << '\n'
           << indent() << "result.write(oprot);" << '\n' << indent() << "oprot->writeMessageEnd();"
           << '\n' << indent() << "uint32_t bytes = oprot->getTransport()->writeEnd();" << '\n'
           << indent() << "oprot->getTransport()->flush();" << '\n' << indent()
@@ -3933,6 +4261,7 @@ void t_cpp_generator::generate_process_function(t_service* tservice,
           << "  this->eventHandler_->preWrite(ctx, " << service_func_name << ");" << '\n'
           << indent() << "}" << '\n' << '\n' << indent() << "oprot->writeMessageBegin(\""
           << tfunction->get_name() << "\", ::apache::thrift::protocol::T_REPLY, seqid);" << '\n'
+          << indent() << "::apache::thrift::protocol::reserveSerializedSize(oprot, result);" << '\n'
           << indent() << "result.write(oprot);" << '\n' << indent() << "oprot->writeMessageEnd();"
           << '\n' << indent() << "uint32_t bytes = oprot->getTransport()->writeEnd();" << '\n'
           << indent() << "oprot->getTransport()->flush();" << '\n' << indent()
@@ -4047,7 +4376,9 @@ void t_cpp_generator::generate_deserialize_field(ostream& out,
       out << "readUUID(" << name << ");";
       break;
     case t_base_type::TYPE_STRING:
-      if (type->is_binary()) {
+      if (is_binary_view(type)) {
+        out << "readBinaryView(" << name << ");";
+      } else if (type->is_binary()) {
         out << "readBinary(" << name << ");";
       } else {
         out << "readString(" << name << ");";
@@ -4146,6 +4477,26 @@ void t_cpp_generator::generate_deserialize_container(ostream& out, t_type* ttype
     }
   }
 
+  string bulk = bulk_suffix(ttype);
+  if (ttype->is_list() && !bulk.empty()) {
+    indent(out) << "xfer += iprot->read" << bulk << "(" << prefix << ".data(), " << size << ");"
+                << '\n';
+    indent(out) << "xfer += iprot->readListEnd();" << '\n';
+    scope_down(out);
+    return;
+  }
+  if (ttype->is_set() && !bulk.empty()) {
+    string elems = tmp("_elems");
+    indent(out) << "std::vector<" << type_name(((t_set*)ttype)->get_elem_type()) << "> " << elems
+                << "(" << size << ");" << '\n';
+    indent(out) << "xfer += iprot->read" << bulk << "(" << elems << ".data(), " << size << ");"
+                << '\n';
+    indent(out) << prefix << ".insert(" << elems << ".begin(), " << elems << ".end());" << '\n';
+    indent(out) << "xfer += iprot->readSetEnd();" << '\n';
+    scope_down(out);
+    return;
+  }
+
   // For loop iterates over elements
   string i = tmp("_i");
   out << indent() << "uint32_t " << i << ";" << '\n' << indent() << "for (" << i << " = 0; " << i
@@ -4258,7 +4609,9 @@ void t_cpp_generator::generate_serialize_field(ostream& out,
         out << "writeUUID(" << name << ");";
         break;
       case t_base_type::TYPE_STRING:
-        if (type->is_binary()) {
+        if (is_binary_view(type)) {
+          out << "writeBinaryView(" << name << ");";
+        } else if (type->is_binary()) {
           out << "writeBinary(" << name << ");";
         } else {
           out << "writeString(" << name << ");";
@@ -4335,6 +4688,14 @@ void t_cpp_generator::generate_serialize_container(ostream& out, t_type* ttype,
     indent(out) << "xfer += oprot->writeListBegin("
                 << type_to_enum(((t_list*)ttype)->get_elem_type()) << ", "
                 << "static_cast<uint32_t>(" << prefix << ".size()));" << '\n';
+
+    if (!bulk_suffix(ttype).empty()) {
+      indent(out) << "xfer += oprot->write" << bulk_suffix(ttype) << "(" << prefix
+                  << ".data(), static_cast<uint32_t>(" << prefix << ".size()));" << '\n';
+      indent(out) << "xfer += oprot->writeListEnd();" << '\n';
+      scope_down(out);
+      return;
+    }
   }
 
   string iter = tmp("_iter");
@@ -4390,6 +4751,164 @@ void t_cpp_generator::generate_serialize_list_element(ostream& out, t_list* tlis
   generate_serialize_field(out, &efield, "");
 }
 
+/**
+ * Adds the serialized size of a field to xfer, the sizing counterpart of
+ * generate_serialize_field().
+ */
+void t_cpp_generator::generate_serialized_size_field(ostream& out,
+                                                     t_field* tfield,
+                                                     string prefix,
+                                                     string suffix) {
+  t_type* type = get_true_type(tfield->get_type());
+
+  string name = prefix + tfield->get_name() + suffix;
+
+  if (type->is_struct() || type->is_xception()) {
+    if (is_reference(tfield)) {
+      // write() puts an empty struct in place of a null reference
+      indent(out) << "if (" << name << ") {" << '\n';
+      indent(out) << "  xfer += " << name << "->serializedSize(oprot);" << '\n';
+      indent(out) << "} else {" << '\n';
+      indent(out) << "  xfer += oprot->serializedSizeFieldStop();" << '\n';
+      indent(out) << "}" << '\n';
+    } else {
+      indent(out) << "xfer += " << name << ".serializedSize(oprot);" << '\n';
+    }
+  } else if (type->is_container()) {
+    generate_serialized_size_container(out, type, name);
+  } else if (type->is_base_type() || type->is_enum()) {
+    indent(out) << "xfer += oprot->";
+
+    if (type->is_base_type()) {
+      t_base_type::t_base tbase = ((t_base_type*)type)->get_base();
+      switch (tbase) {
+      case t_base_type::TYPE_UUID:
+        out << "serializedSizeUUID();";
+        break;
+      case t_base_type::TYPE_STRING:
+        out << "serializedSizeString(static_cast<uint32_t>(" << name << ".size()));";
+        break;
+      case t_base_type::TYPE_BOOL:
+        out << "serializedSizeBool(" << name << ");";
+        break;
+      case t_base_type::TYPE_I8:
+        out << "serializedSizeByte(" << name << ");";
+        break;
+      case t_base_type::TYPE_I16:
+        out << "serializedSizeI16(" << name << ");";
+        break;
+      case t_base_type::TYPE_I32:
+        out << "serializedSizeI32(" << name << ");";
+        break;
+      case t_base_type::TYPE_I64:
+        out << "serializedSizeI64(" << name << ");";
+        break;
+      case t_base_type::TYPE_DOUBLE:
+        out << "serializedSizeDouble(" << name << ");";
+        break;
+      default:
+        throw "compiler error: no C++ size for base type " + t_base_type::t_base_name(tbase)
+            + " " + name;
+      }
+    } else if (type->is_enum()) {
+      out << "serializedSizeI32(static_cast<int32_t>(" << name << "));";
+    }
+    out << '\n';
+  }
+}
+
+void t_cpp_generator::generate_serialized_size_container(ostream& out,
+                                                         t_type* ttype,
+                                                         string prefix) {
+  scope_up(out);
+
+  if (ttype->is_map()) {
+    indent(out) << "xfer += oprot->serializedSizeMapBegin("
+                << type_to_enum(((t_map*)ttype)->get_key_type()) << ", "
+                << type_to_enum(((t_map*)ttype)->get_val_type()) << ", "
+                << "static_cast<uint32_t>(" << prefix << ".size()));" << '\n';
+  } else if (ttype->is_set()) {
+    indent(out) << "xfer += oprot->serializedSizeSetBegin("
+                << type_to_enum(((t_set*)ttype)->get_elem_type()) << ", "
+                << "static_cast<uint32_t>(" << prefix << ".size()));" << '\n';
+  } else if (ttype->is_list()) {
+    indent(out) << "xfer += oprot->serializedSizeListBegin("
+                << type_to_enum(((t_list*)ttype)->get_elem_type()) << ", "
+                << "static_cast<uint32_t>(" << prefix << ".size()));" << '\n';
+  }
+
+  // Elements the protocol may write at a fixed width are sized all at once
+  string width;
+  if (ttype->is_map()) {
+    t_type* ktype = get_true_type(((t_map*)ttype)->get_key_type());
+    t_type* vtype = get_true_type(((t_map*)ttype)->get_val_type());
+    if (may_have_fixed_size(ktype) && may_have_fixed_size(vtype)) {
+      string kwidth = tmp("_kwidth");
+      string vwidth = tmp("_vwidth");
+      width = tmp("_width");
+      out << indent() << "uint32_t " << kwidth << " = oprot->serializedSizeFixed("
+          << type_to_enum(ktype) << ");" << '\n' << indent() << "uint32_t " << vwidth
+          << " = oprot->serializedSizeFixed(" << type_to_enum(vtype) << ");" << '\n'
+          << indent() << "uint32_t " << width << " = " << kwidth << " > 0 && " << vwidth
+          << " > 0 ? " << kwidth << " + " << vwidth << " : 0;" << '\n';
+    }
+  } else {
+    t_type* etype = get_true_type(ttype->is_set() ? ((t_set*)ttype)->get_elem_type()
+                                                  : ((t_list*)ttype)->get_elem_type());
+    if (may_have_fixed_size(etype)) {
+      width = tmp("_width");
+      out << indent() << "uint32_t " << width << " = oprot->serializedSizeFixed("
+          << type_to_enum(etype) << ");" << '\n';
+    }
+  }
+  if (!width.empty()) {
+    out << indent() << "if (" << width << " > 0) {" << '\n' << indent() << "  xfer += " << width
+        << " * static_cast<uint32_t>(" << prefix << ".size());" << '\n' << indent()
+        << "} else {" << '\n';
+    indent_up();
+  }
+
+  string iter = tmp("_iter");
+  out << indent() << type_name(ttype) << "::const_iterator " << iter << ";" << '\n' << indent()
+      << "for (" << iter << " = " << prefix << ".begin(); " << iter << " != " << prefix
+      << ".end(); ++" << iter << ")" << '\n';
+  scope_up(out);
+  if (ttype->is_map()) {
+    t_field kfield(((t_map*)ttype)->get_key_type(), iter + "->first");
+    generate_serialized_size_field(out, &kfield, "");
+    t_field vfield(((t_map*)ttype)->get_val_type(), iter + "->second");
+    generate_serialized_size_field(out, &vfield, "");
+  } else if (ttype->is_set()) {
+    t_field efield(((t_set*)ttype)->get_elem_type(), "(*" + iter + ")");
+    generate_serialized_size_field(out, &efield, "");
+  } else if (ttype->is_list()) {
+    t_field efield(((t_list*)ttype)->get_elem_type(), "(*" + iter + ")");
+    generate_serialized_size_field(out, &efield, "");
+  }
+  scope_down(out);
+  if (!width.empty()) {
+    indent_down();
+    indent(out) << "}" << '\n';
+  }
+
+  scope_down(out);
+}
+
+/**
+ * Whether a protocol may write every value of a type at the same width,
+ * which is never the case for strings, structs and containers.
+ */
+bool t_cpp_generator::may_have_fixed_size(t_type* ttype) {
+  if (ttype->is_enum()) {
+    return true;
+  }
+  if (!ttype->is_base_type()) {
+    return false;
+  }
+  t_base_type::t_base tbase = ((t_base_type*)ttype)->get_base();
+  return tbase != t_base_type::TYPE_STRING && tbase != t_base_type::TYPE_VOID;
+}
+
 /**
  * Makes a :: prefix for a namespace
  *
@@ -4476,6 +4995,9 @@ string t_cpp_generator::namespace_close(string ns) {
 string t_cpp_generator::type_name(t_type* ttype, bool in_typedef, bool arg) {
   if (ttype->is_base_type()) {
     string bname = base_type_name(((t_base_type*)ttype)->get_base());
+    if (is_binary_view(ttype)) {
+      bname = "::apache::thrift::TBinaryView";
+    }
     std::map<string, std::vector<string>>::iterator it = ttype->annotations_.find("cpp.type");
     if (it != ttype->annotations_.end() && !it->second.empty()) {
       bname = it->second.back();
@@ -4597,6 +5119,8 @@ string t_cpp_generator::declare_field(t_field* tfield,
   result += type_name(tfield->get_type());
   if (is_reference(tfield)) {
     result = "::std::shared_ptr<" + result + ">";
+  } else if (is_lazy(tfield) && !pointer) {
+    result = "::apache::thrift::protocol::TLazy<" + result + ">";
   }
   if (pointer) {
     result += "*";
@@ -4854,4 +5378,9 @@ THRIFT_REGISTER_GENERATOR(
     "    moveable_types:  Generate move constructors and assignment operators.\n"
     "    no_ostream_operators:\n"
     "                     Omit generation of ostream definitions.\n"
-    "    no_skeleton:     Omits generation of skeleton.\n")
+    "    no_skeleton:     Omits generation of skeleton.\n"
+    "    zero_copy_binary:\n"
+    "                     Read binary fields as TBinaryViews that share the\n"
+    "                     transport's read buffer instead of copying them.\n"
+    "    partial_read:    Generate readPartial() methods that read only the fields\n"
+    "                     in a TFieldMask and skip the others.\n")
@@ -0,0 +1,119 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*
+ * Trains a zstd dictionary for THeaderTransport from messages captured with
+ * TFileTransport, one message per event, as they were before any transform.
+ * Load the result into a TZstdDictionary on both ends.
+ *
+ *   g++ -std=c++11 thrift_dict_train.cpp -o thrift_dict_train \
+ *       -lthrift -lthriftz -lzstd
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <thrift/transport/TFileTransport.h>
+#include <thrift/transport/TZstdTransport.h>
+
+using namespace std;
+using namespace apache::thrift;
+using namespace apache::thrift::transport;
+
+// Larger events make poor samples, they are skipped.
+static const uint32_t MAX_SAMPLE_SIZE = 128 * 1024;
+
+void usage() {
+  fprintf(stderr,
+      "usage: thrift_dict_train [-s size] output capture...\n"
+      "  -s  Largest dictionary size in bytes (default 16384)\n");
+  exit(EXIT_FAILURE);
+}
+
+int main(int argc, char *argv[]) {
+  size_t capacity = TZstdDictionary::DEFAULT_CAPACITY;
+  int arg = 1;
+  if (arg + 1 < argc && argv[arg] == std::string("-s")) {
+    capacity = strtoul(argv[arg + 1], nullptr, 10);
+    arg += 2;
+  }
+  if (argc - arg < 2 || capacity == 0) {
+    usage();
+  }
+  const char* output = argv[arg++];
+
+  try {
+    vector<string> samples;
+    size_t skipped = 0;
+    string buf(MAX_SAMPLE_SIZE, '\0');
+    uint8_t* bytes = reinterpret_cast<uint8_t*>(&buf[0]);
+    uint32_t len = static_cast<uint32_t>(buf.size());
+
+    for (; arg < argc; ++arg) {
+      TFileTransport capture(argv[arg], true);
+      capture.setReadTimeout(TFileTransport::NO_TAIL_READ_TIMEOUT);
+
+      // read() stops at the end of an event, so each one is a sample.
+      uint32_t got;
+      while ((got = capture.read(bytes, len)) > 0) {
+        uint32_t remaining = capture.getCurrentEventRemaining();
+        if (remaining == 0) {
+          samples.push_back(buf.substr(0, got));
+          continue;
+        }
+        ++skipped;
+        while (remaining > 0) {
+          got = capture.read(bytes, (std::min)(remaining, len));
+          if (got == 0) {
+            break;
+          }
+          remaining -= got;
+        }
+      }
+    }
+
+    string dictionary = TZstdDictionary::train(samples, capacity);
+    TZstdDictionary dict(dictionary);
+
+    ofstream out(output, ios::binary);
+    out.write(dictionary.data(), dictionary.size());
+    out.close();
+    if (!out) {
+      cerr << "Could not write " << output << '\n';
+      return EXIT_FAILURE;
+    }
+
+    cout << "Trained a " << dictionary.size() << " byte dictionary with id " << dict.getId()
+         << " on " << samples.size() << " messages";
+    if (skipped > 0) {
+      cout << ", skipped " << skipped << " larger than " << MAX_SAMPLE_SIZE << " bytes";
+    }
+    cout << '\n';
+  } catch (const TException& e) {
+    cerr << e.what() << '\n';
+    return EXIT_FAILURE;
+  }
+
+  return 0;
+}
@@ -0,0 +1,139 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _THRIFT_TBINARYVIEW_H_
+#define _THRIFT_TBINARYVIEW_H_ 1
+
+#include <thrift/Thrift.h>
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <ostream>
+#include <string>
+
+namespace apache {
+namespace thrift {
+
+/**
+ * Read-only view of binary data that shares ownership of the memory it
+ * refers to.
+ *
+ * Protocols hand these out for binary fields when the generator is run with
+ * the zero_copy_binary option.  When the transport can share its read buffer
+ * (see TTransport::shareReadBuffer()), the view points straight into the
+ * frame or memory buffer the value was read from and keeps that buffer alive,
+ * so large payloads are never copied.  Otherwise the view owns a copy.
+ *
+ * Copying a view only copies the reference, never the data.
+ */
+class TBinaryView {
+public:
+  typedef uint8_t value_type;
+  typedef const uint8_t* iterator;
+  typedef const uint8_t* const_iterator;
+  typedef std::size_t size_type;
+  typedef std::ptrdiff_t difference_type;
+
+  TBinaryView() : data_(nullptr), size_(0) {}
+
+  /**
+   * Refer to size bytes at data, which stay valid as long as owner is alive.
+   */
+  TBinaryView(std::shared_ptr<const void> owner, const uint8_t* data, uint32_t size)
+    : owner_(std::move(owner)), data_(data), size_(size) {}
+
+  /**
+   * Construct the view from a copy of str.
+   */
+  TBinaryView(const std::string& str) : data_(nullptr), size_(0) { assign(str); }
+
+  TBinaryView(const char* str) : data_(nullptr), size_(0) { assign(std::string(str)); }
+
+  const uint8_t* data() const { return data_; }
+  size_type size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+
+  const_iterator begin() const { return data_; }
+  const_iterator end() const { return data_ + size_; }
+
+  /**
+   * Copy the data out into a string.
+   */
+  std::string str() const { return std::string(reinterpret_cast<const char*>(data_), size_); }
+
+  /**
+   * Make the view own str.
+   */
+  void assign(std::string str) {
+    if (str.empty()) {
+      clear();
+      return;
+    }
+    std::shared_ptr<std::string> copy = std::make_shared<std::string>(std::move(str));
+    data_ = reinterpret_cast<const uint8_t*>(copy->data());
+    size_ = static_cast<uint32_t>(copy->size());
+    owner_ = std::move(copy);
+  }
+
+  /**
+   * Drop the reference, releasing the buffer if this was the last view of it.
+   */
+  void clear() {
+    owner_.reset();
+    data_ = nullptr;
+    size_ = 0;
+  }
+
+  void swap(TBinaryView& other) noexcept {
+    using std::swap;
+    swap(owner_, other.owner_);
+    swap(data_, other.data_);
+    swap(size_, other.size_);
+  }
+
+  bool operator==(const TBinaryView& other) const {
+    return size_ == other.size_ && (size_ == 0 || std::memcmp(data_, other.data_, size_) == 0);
+  }
+
+  bool operator!=(const TBinaryView& other) const { return !(*this == other); }
+
+  bool operator<(const TBinaryView& other) const {
+    return std::lexicographical_compare(begin(), end(), other.begin(), other.end());
+  }
+
+private:
+  std::shared_ptr<const void> owner_;
+  const uint8_t* data_;
+  uint32_t size_;
+};
+
+inline void swap(TBinaryView& lhs, TBinaryView& rhs) noexcept {
+  lhs.swap(rhs);
+}
+
+inline std::ostream& operator<<(std::ostream& out, const TBinaryView& obj) {
+  out.write(reinterpret_cast<const char*>(obj.data()), static_cast<std::streamsize>(obj.size()));
+  return out;
+}
+
+} // namespace thrift
+} // namespace apache
+
+#endif // #ifndef _THRIFT_TBINARYVIEW_H_
@@ -24,6 +24,28 @@
 namespace apache {
 namespace thrift {
 
+/**
+ * The method name of the call being dispatched.  Its storage is kept per
+ * thread and used again, so a name too long for the string's inline buffer
+ * is not allocated on every call.  A call nested on the same thread, as
+ * through TMultiplexedProcessor, gets a string of its own.
+ */
+class TDispatchName {
+public:
+  TDispatchName() { name.swap(spare()); }
+  ~TDispatchName() { name.swap(spare()); }
+  TDispatchName(const TDispatchName&) = delete;
+  TDispatchName& operator=(const TDispatchName&) = delete;
+
+  std::string name;
+
+private:
+  static std::string& spare() {
+    static thread_local std::string spare;
+    return spare;
+  }
+};
+
 /**
  * TDispatchProcessor is a helper class to parse the message header then call
  * another function to dispatch based on the function name.
@@ -50,10 +72,10 @@ public:
     T_GENERIC_PROTOCOL(this, inRaw, specificIn);
     T_GENERIC_PROTOCOL(this, outRaw, specificOut);
 
-    std::string fname;
+    TDispatchName fname;
     protocol::TMessageType mtype;
     int32_t seqid;
-    inRaw->readMessageBegin(fname, mtype, seqid);
+    inRaw->readMessageBegin(fname.name, mtype, seqid);
 
     // If this doesn't look like a valid call, log an error and return false so
     // that the server will close the connection.
@@ -65,22 +87,22 @@ public:
       return false;
     }
 
-    return this->dispatchCall(inRaw, outRaw, fname, seqid, connectionContext);
+    return this->dispatchCall(inRaw, outRaw, fname.name, seqid, connectionContext);
   }
 
 protected:
   bool processFast(Protocol_* in, Protocol_* out, void* connectionContext) {
-    std::string fname;
+    TDispatchName fname;
     protocol::TMessageType mtype;
     int32_t seqid;
-    in->readMessageBegin(fname, mtype, seqid);
+    in->readMessageBegin(fname.name, mtype, seqid);
 
     if (mtype != protocol::T_CALL && mtype != protocol::T_ONEWAY) {
       GlobalOutput.printf("received invalid message type %d from client", mtype);
       return false;
     }
 
-    return this->dispatchCallTemplated(in, out, fname, seqid, connectionContext);
+    return this->dispatchCallTemplated(in, out, fname.name, seqid, connectionContext);
   }
 
   /**
@@ -108,17 +130,17 @@ public:
   bool process(std::shared_ptr<protocol::TProtocol> in,
                        std::shared_ptr<protocol::TProtocol> out,
                        void* connectionContext) override {
-    std::string fname;
+    TDispatchName fname;
     protocol::TMessageType mtype;
     int32_t seqid;
-    in->readMessageBegin(fname, mtype, seqid);
+    in->readMessageBegin(fname.name, mtype, seqid);
 
     if (mtype != protocol::T_CALL && mtype != protocol::T_ONEWAY) {
       GlobalOutput.printf("received invalid message type %d from client", mtype);
       return false;
     }
 
-    return dispatchCall(in.get(), out.get(), fname, seqid, connectionContext);
+    return dispatchCall(in.get(), out.get(), fname.name, seqid, connectionContext);
   }
 
 protected:
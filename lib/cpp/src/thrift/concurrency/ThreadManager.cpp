@@ -23,11 +23,15 @@
 #include <thrift/concurrency/Exception.h>
 #include <thrift/concurrency/Monitor.h>
 
+#include <algorithm>
+#include <atomic>
 #include <memory>
 
 #include <stdexcept>
 #include <deque>
+#include <map>
 #include <set>
+#include <vector>
 
 namespace apache {
 namespace thrift {
@@ -59,6 +63,9 @@ public:
       idleCount_(0),
       pendingTaskCountMax_(0),
       expiredCount_(0),
+      scheduling_(ThreadManager::FIFO),
+      fallbackDeadline_(DEFAULT_FALLBACK_DEADLINE),
+      sequence_(0),
       state_(ThreadManager::UNINITIALIZED),
       monitor_(&mutex_),
       maxMonitor_(&mutex_),
@@ -97,12 +104,12 @@ public:
 
   size_t pendingTaskCount() const override {
     Guard g(mutex_);
-    return tasks_.size();
+    return pendingCount();
   }
 
   size_t totalTaskCount() const override {
     Guard g(mutex_);
-    return tasks_.size() + workerCount_ - idleCount_;
+    return pendingCount() + workerCount_ - idleCount_;
   }
 
   size_t pendingTaskCountMax() const override {
@@ -132,7 +139,45 @@ public:
 
   void setExpireCallback(ExpireCallback expireCallback) override;
 
+  void setExpireInfoCallback(ExpireInfoCallback expireCallback) override;
+
+  ThreadManager::SCHEDULING scheduling() const override {
+    Guard g(mutex_);
+    return scheduling_;
+  }
+
+  void scheduling(ThreadManager::SCHEDULING value) override;
+
+  int64_t fallbackDeadline() const override {
+    Guard g(mutex_);
+    return fallbackDeadline_;
+  }
+
+  void fallbackDeadline(int64_t value) override {
+    Guard g(mutex_);
+    fallbackDeadline_ = value;
+  }
+
 private:
+  /**
+   * \returns the number of pending tasks.  The caller is responsible for
+   * acquiring a lock on the class mutex_.
+   */
+  size_t pendingCount() const { return tasks_.size() + deadlines_.size(); }
+
+  /**
+   * Queues a task, or takes the next one to run off the queue.  The caller
+   * is responsible for acquiring a lock on the class mutex_.
+   */
+  void push(shared_ptr<Task> task);
+  shared_ptr<Task> pop();
+
+  /**
+   * Calls the expire callback, if any, for a task that will not be run.
+   * \returns whether there was a callback to call
+   */
+  bool expire(const shared_ptr<Task>& task, ThreadManager::EXPIRE_REASON reason);
+
   /**
    * Remove one or more expired tasks.
    * \param[in]  justOne  if true, try to remove just one task and return
@@ -157,13 +202,18 @@ private:
   size_t pendingTaskCountMax_;
   size_t expiredCount_;
   ExpireCallback expireCallback_;
+  ExpireInfoCallback expireInfoCallback_;
+  ThreadManager::SCHEDULING scheduling_;
+  int64_t fallbackDeadline_;
+  uint64_t sequence_;
 
   ThreadManager::STATE state_;
   shared_ptr<ThreadFactory> threadFactory_;
 
   friend class ThreadManager::Task;
   typedef std::deque<shared_ptr<Task> > TaskQueue;
-  TaskQueue tasks_;
+  TaskQueue tasks_;       // pending tasks with FIFO scheduling
+  std::vector<shared_ptr<Task> > deadlines_; // a heap of pending tasks with EDF scheduling
   Mutex mutex_;
   Monitor monitor_;
   Monitor maxMonitor_;
@@ -180,9 +230,11 @@ class ThreadManager::Task : public Runnable {
 public:
   enum STATE { WAITING, EXECUTING, TIMEDOUT, COMPLETE };
 
-  Task(shared_ptr<Runnable> runnable, uint64_t expiration = 0ULL)
+  Task(shared_ptr<Runnable> runnable, uint64_t expiration = 0ULL, uint64_t sequence = 0ULL)
     : runnable_(runnable),
-      state_(WAITING) {
+      state_(WAITING),
+      expiration_(expiration),
+      sequence_(sequence) {
         if (expiration != 0ULL) {
           expireTime_.reset(new std::chrono::steady_clock::time_point(std::chrono::steady_clock::now() + std::chrono::milliseconds(expiration)));
         }
@@ -201,11 +253,51 @@ public:
 
   const unique_ptr<std::chrono::steady_clock::time_point> & getExpireTime() const { return expireTime_; }
 
+  bool isExpired(const std::chrono::steady_clock::time_point& now) const {
+    return expireTime_ && *expireTime_ < now;
+  }
+
+  ThreadManager::ExpireInfo getExpireInfo(ThreadManager::EXPIRE_REASON reason) const {
+    ThreadManager::ExpireInfo info;
+    info.reason = reason;
+    info.expiration = std::chrono::milliseconds(expiration_);
+    info.overdue = expireTime_ ? std::chrono::steady_clock::now() - *expireTime_
+                               : std::chrono::steady_clock::duration::zero();
+    return info;
+  }
+
+  /**
+   * Sets the deadline the task is ordered by with EARLIEST_DEADLINE_FIRST:
+   * its expire time, or fallback milliseconds from now if it has none.
+   */
+  void schedule(const std::chrono::steady_clock::time_point& now, int64_t fallback) {
+    deadline_ = expireTime_ ? *expireTime_ : now + std::chrono::milliseconds(fallback);
+  }
+
+  const std::chrono::steady_clock::time_point& getDeadline() const { return deadline_; }
+
+  /**
+   * Heap order for EARLIEST_DEADLINE_FIRST: true if a runs after b
+   */
+  static bool runsAfter(const shared_ptr<Task>& a, const shared_ptr<Task>& b) {
+    if (a->deadline_ != b->deadline_) {
+      return a->deadline_ > b->deadline_;
+    }
+    return a->sequence_ > b->sequence_;
+  }
+
+  static bool addedBefore(const shared_ptr<Task>& a, const shared_ptr<Task>& b) {
+    return a->sequence_ < b->sequence_;
+  }
+
 private:
   shared_ptr<Runnable> runnable_;
   friend class ThreadManager::Worker;
   STATE state_;
+  uint64_t expiration_;
+  uint64_t sequence_;
   unique_ptr<std::chrono::steady_clock::time_point> expireTime_;
+  std::chrono::steady_clock::time_point deadline_;
 };
 
 class ThreadManager::Worker : public Runnable {
@@ -219,7 +311,7 @@ public:
 private:
   bool isActive() const {
     return (manager_->workerCount_ <= manager_->workerMaxCount_)
-           || (manager_->state_ == JOINING && !manager_->tasks_.empty());
+           || (manager_->state_ == JOINING && manager_->pendingCount() != 0);
   }
 
 public:
@@ -266,7 +358,7 @@ public:
         */
       active = isActive();
 
-      while (active && manager_->tasks_.empty()) {
+      while (active && manager_->pendingCount() == 0) {
         manager_->idleCount_++;
         manager_->monitor_.wait();
         active = isActive();
@@ -276,23 +368,21 @@ public:
       shared_ptr<ThreadManager::Task> task;
 
       if (active) {
-        if (!manager_->tasks_.empty()) {
-          task = manager_->tasks_.front();
-          manager_->tasks_.pop_front();
+        if (manager_->pendingCount() != 0) {
+          task = manager_->pop();
           if (task->state_ == ThreadManager::Task::WAITING) {
             // If the state is changed to anything other than EXECUTING or TIMEDOUT here
             // then the execution loop needs to be changed below.
-            task->state_ =
-                (task->getExpireTime() && *(task->getExpireTime()) < std::chrono::steady_clock::now()) ?
-                    ThreadManager::Task::TIMEDOUT :
-                    ThreadManager::Task::EXECUTING;
+            task->state_ = task->isExpired(std::chrono::steady_clock::now())
+                               ? ThreadManager::Task::TIMEDOUT
+                               : ThreadManager::Task::EXECUTING;
           }
         }
 
         /* If we have a pending task max and we just dropped below it, wakeup any
             thread that might be blocked on add. */
         if (manager_->pendingTaskCountMax_ != 0
-            && manager_->tasks_.size() <= manager_->pendingTaskCountMax_ - 1) {
+            && manager_->pendingCount() <= manager_->pendingTaskCountMax_ - 1) {
           manager_->maxMonitor_.notify();
         }
       }
@@ -317,10 +407,10 @@ public:
           // Re-acquire the lock to proceed in the thread manager
           manager_->mutex_.lock();
 
-        } else if (manager_->expireCallback_) {
+        } else if (manager_->expireCallback_ || manager_->expireInfoCallback_) {
           // The only other state the task could have been in is TIMEDOUT (see above)
           manager_->mutex_.unlock();
-          manager_->expireCallback_(task->getRunnable());
+          manager_->expire(task, ThreadManager::EXPIRED_AT_DISPATCH);
           manager_->mutex_.lock();
           manager_->expiredCount_++;
         }
@@ -464,13 +554,13 @@ void ThreadManager::Impl::add(shared_ptr<Runnable> value, int64_t timeout, int64
   }
 
   // if we're at a limit, remove an expired task to see if the limit clears
-  if (pendingTaskCountMax_ > 0 && (tasks_.size() >= pendingTaskCountMax_)) {
+  if (pendingTaskCountMax_ > 0 && (pendingCount() >= pendingTaskCountMax_)) {
     removeExpired(true);
   }
 
-  if (pendingTaskCountMax_ > 0 && (tasks_.size() >= pendingTaskCountMax_)) {
+  if (pendingTaskCountMax_ > 0 && (pendingCount() >= pendingTaskCountMax_)) {
     if (canSleep() && timeout >= 0) {
-      while (pendingTaskCountMax_ > 0 && tasks_.size() >= pendingTaskCountMax_) {
+      while (pendingTaskCountMax_ > 0 && pendingCount() >= pendingTaskCountMax_) {
         // This is thread safe because the mutex is shared between monitors.
         maxMonitor_.wait(timeout);
       }
@@ -479,7 +569,7 @@ void ThreadManager::Impl::add(shared_ptr<Runnable> value, int64_t timeout, int64
     }
   }
 
-  tasks_.push_back(std::make_shared<ThreadManager::Task>(value, expiration));
+  push(std::make_shared<ThreadManager::Task>(value, expiration, sequence_++));
 
   // If idle thread is available notify it, otherwise all worker threads are
   // running and will get around to this task in time.
@@ -504,6 +594,14 @@ void ThreadManager::Impl::remove(shared_ptr<Runnable> task) {
       return;
     }
   }
+
+  for (auto it = deadlines_.begin(); it != deadlines_.end(); ++it) {
+    if ((*it)->getRunnable() == task) {
+      deadlines_.erase(it);
+      std::make_heap(deadlines_.begin(), deadlines_.end(), &ThreadManager::Task::runsAfter);
+      return;
+    }
+  }
 }
 
 std::shared_ptr<Runnable> ThreadManager::Impl::removeNextPending() {
@@ -514,29 +612,95 @@ std::shared_ptr<Runnable> ThreadManager::Impl::removeNextPending() {
         "ThreadManager not started");
   }
 
-  if (tasks_.empty()) {
+  if (pendingCount() == 0) {
     return std::shared_ptr<Runnable>();
   }
 
-  shared_ptr<ThreadManager::Task> task = tasks_.front();
-  tasks_.pop_front();
+  return pop()->getRunnable();
+}
+
+void ThreadManager::Impl::push(shared_ptr<ThreadManager::Task> task) {
+  if (scheduling_ == ThreadManager::EARLIEST_DEADLINE_FIRST) {
+    task->schedule(std::chrono::steady_clock::now(), fallbackDeadline_);
+    deadlines_.push_back(std::move(task));
+    std::push_heap(deadlines_.begin(), deadlines_.end(), &ThreadManager::Task::runsAfter);
+  } else {
+    tasks_.push_back(std::move(task));
+  }
+}
+
+shared_ptr<ThreadManager::Task> ThreadManager::Impl::pop() {
+  shared_ptr<ThreadManager::Task> task;
+  if (!deadlines_.empty()) {
+    std::pop_heap(deadlines_.begin(), deadlines_.end(), &ThreadManager::Task::runsAfter);
+    task = std::move(deadlines_.back());
+    deadlines_.pop_back();
+  } else {
+    task = std::move(tasks_.front());
+    tasks_.pop_front();
+  }
+  return task;
+}
 
-  return task->getRunnable();
+bool ThreadManager::Impl::expire(const shared_ptr<ThreadManager::Task>& task,
+                                 ThreadManager::EXPIRE_REASON reason) {
+  if (expireInfoCallback_) {
+    expireInfoCallback_(task->getRunnable(), task->getExpireInfo(reason));
+    return true;
+  }
+  if (expireCallback_) {
+    expireCallback_(task->getRunnable());
+    return true;
+  }
+  return false;
 }
 
 void ThreadManager::Impl::removeExpired(bool justOne) {
   // this is always called under a lock
-  if (tasks_.empty()) {
+  if (pendingCount() == 0) {
     return;
   }
   auto now = std::chrono::steady_clock::now();
+  const ThreadManager::EXPIRE_REASON reason
+      = justOne ? ThreadManager::EXPIRED_AT_LIMIT : ThreadManager::EXPIRED_BY_SWEEP;
+
+  // with EDF scheduling the expired tasks are the ones at the top of the heap
+  while (!deadlines_.empty() && deadlines_.front()->isExpired(now)) {
+    expire(pop(), reason);
+    ++expiredCount_;
+    if (justOne) {
+      return;
+    }
+  }
+
+  // unless a task without an expiration is overdue ahead of them
+  if (!deadlines_.empty() && deadlines_.front()->getDeadline() < now) {
+    bool removed = false;
+    for (auto it = deadlines_.begin(); it != deadlines_.end(); ) {
+      if ((*it)->isExpired(now)) {
+        expire(*it, reason);
+        it = deadlines_.erase(it);
+        ++expiredCount_;
+        removed = true;
+        if (justOne) {
+          break;
+        }
+      } else {
+        ++it;
+      }
+    }
+    if (removed) {
+      std::make_heap(deadlines_.begin(), deadlines_.end(), &ThreadManager::Task::runsAfter);
+      if (justOne) {
+        return;
+      }
+    }
+  }
 
   for (auto it = tasks_.begin(); it != tasks_.end(); )
   {
-    if ((*it)->getExpireTime() && *((*it)->getExpireTime()) < now) {
-      if (expireCallback_) {
-        expireCallback_((*it)->getRunnable());
-      }
+    if ((*it)->isExpired(now)) {
+      expire(*it, reason);
       it = tasks_.erase(it);
       ++expiredCount_;
       if (justOne) {
@@ -555,6 +719,36 @@ void ThreadManager::Impl::setExpireCallback(ExpireCallback expireCallback) {
   expireCallback_ = expireCallback;
 }
 
+void ThreadManager::Impl::setExpireInfoCallback(ExpireInfoCallback expireCallback) {
+  Guard g(mutex_);
+  expireInfoCallback_ = expireCallback;
+}
+
+void ThreadManager::Impl::scheduling(ThreadManager::SCHEDULING value) {
+  Guard g(mutex_);
+  if (value == scheduling_) {
+    return;
+  }
+  scheduling_ = value;
+
+  // move the pending tasks over to the queue of the new order
+  if (value == ThreadManager::EARLIEST_DEADLINE_FIRST) {
+    // the tasks without an expiration are not told apart by when they were
+    // added, they keep their order among themselves
+    auto now = std::chrono::steady_clock::now();
+    for (const auto& task : tasks_) {
+      task->schedule(now, fallbackDeadline_);
+    }
+    deadlines_.insert(deadlines_.end(), tasks_.begin(), tasks_.end());
+    tasks_.clear();
+    std::make_heap(deadlines_.begin(), deadlines_.end(), &ThreadManager::Task::runsAfter);
+  } else {
+    std::sort(deadlines_.begin(), deadlines_.end(), &ThreadManager::Task::addedBefore);
+    tasks_.insert(tasks_.end(), deadlines_.begin(), deadlines_.end());
+    deadlines_.clear();
+  }
+}
+
 class SimpleThreadManager : public ThreadManager::Impl {
 
 public:
@@ -572,6 +766,650 @@ private:
   const size_t pendingTaskCountMax_;
 };
 
+/**
+ * Thread manager with one task queue per worker thread.
+ *
+ * Tasks are handed out round-robin to the queues, and each worker takes
+ * tasks from its own queue first and steals from the others when that is
+ * empty.  Each queue has its own mutex, so adders and workers only contend
+ * when they hit the same queue, instead of all serializing on the single
+ * mutex_ of ThreadManager::Impl.  mutex_ is only taken to park and wake idle
+ * workers, to block adders at pendingTaskCountMax and to add or remove
+ * workers.
+ *
+ * Tasks are taken from the front of every queue, so the order of execution
+ * is approximately, but not strictly, the order in which they were added.
+ */
+class WorkStealingThreadManager : public ThreadManager {
+
+public:
+  /// Upper bound on the number of task queues; further workers share them
+  static const size_t MAX_QUEUES = 64;
+
+  WorkStealingThreadManager(size_t workerCount, size_t pendingTaskCountMax)
+    : initialWorkerCount_(workerCount),
+      pendingTaskCountMax_(pendingTaskCountMax),
+      workerCount_(0),
+      workerMaxCount_(0),
+      idleCount_(0),
+      pendingCount_(0),
+      queuedCount_(0),
+      activeCount_(0),
+      blockedAdders_(0),
+      expiredCount_(0),
+      numQueues_(1),
+      nextQueue_(0),
+      nextSequence_(0),
+      workerSequence_(0),
+      state_(ThreadManager::UNINITIALIZED),
+      monitor_(&mutex_),
+      maxMonitor_(&mutex_),
+      workerMonitor_(&mutex_) {}
+
+  ~WorkStealingThreadManager() override { stop(); }
+
+  void start() override;
+  void stop() override;
+
+  ThreadManager::STATE state() const override { return state_; }
+
+  shared_ptr<ThreadFactory> threadFactory() const override {
+    Guard g(mutex_);
+    return threadFactory_;
+  }
+
+  void threadFactory(shared_ptr<ThreadFactory> value) override {
+    Guard g(mutex_);
+    if (threadFactory_ && threadFactory_->isDetached() != value->isDetached()) {
+      throw InvalidArgumentException();
+    }
+    threadFactory_ = value;
+  }
+
+  void addWorker(size_t value) override;
+
+  void removeWorker(size_t value) override;
+
+  size_t idleWorkerCount() const override { return idleCount_; }
+
+  size_t workerCount() const override { return workerCount_; }
+
+  size_t pendingTaskCount() const override { return pendingCount_; }
+
+  size_t totalTaskCount() const override { return pendingCount_ + activeCount_; }
+
+  size_t pendingTaskCountMax() const override { return pendingTaskCountMax_; }
+
+  size_t expiredTaskCount() const override { return expiredCount_; }
+
+  void add(shared_ptr<Runnable> value, int64_t timeout, int64_t expiration) override;
+
+  void remove(shared_ptr<Runnable> task) override;
+
+  shared_ptr<Runnable> removeNextPending() override;
+
+  void removeExpiredTasks() override { removeExpired(false); }
+
+  void setExpireCallback(ExpireCallback expireCallback) override {
+    Guard g(mutex_);
+    expireCallback_ = expireCallback;
+  }
+
+  void setExpireInfoCallback(ExpireInfoCallback expireCallback) override {
+    Guard g(mutex_);
+    expireInfoCallback_ = expireCallback;
+  }
+
+private:
+  class Worker;
+
+  struct Entry {
+    shared_ptr<Runnable> runnable;
+    int64_t expiration;
+    std::chrono::steady_clock::time_point expireTime;
+    uint64_t sequence;
+
+    bool isExpired(const std::chrono::steady_clock::time_point& now) const {
+      return expiration != 0LL && expireTime < now;
+    }
+  };
+
+  struct Queue {
+    Queue() : size(0) {}
+    Mutex mutex;
+    std::deque<Entry> tasks;
+    std::atomic<size_t> size;
+    // keep the hot members of neighbouring queues on separate cache lines
+    char padding[64];
+  };
+
+  /**
+   * Reserves room for one more pending task.
+   * \returns false if pendingTaskCountMax has been reached
+   */
+  bool reservePending();
+
+  /**
+   * Takes the next task off the queue of the given worker, or failing that,
+   * off the first other queue that has one.
+   */
+  bool take(size_t self, Entry& entry);
+
+  /**
+   * Accounts for a task that left the queues without being run.  Wakes up a
+   * blocked adder if there is one.
+   */
+  void releasePending(size_t count);
+
+  /**
+   * Calls the expire callback, if any, for expired tasks.
+   * \returns whether there was a callback to call
+   */
+  bool expire(const std::vector<Entry>& entries, ThreadManager::EXPIRE_REASON reason);
+
+  /**
+   * Remove one or more expired tasks.
+   * \param[in]  justOne  if true, try to remove just one task and return
+   */
+  void removeExpired(bool justOne);
+
+  /**
+   * \returns whether it is acceptable to block, depending on the current thread id.
+   * The caller is responsible for acquiring a lock on mutex_.
+   */
+  bool canSleep() const;
+
+  /**
+   * Whether a worker should keep running.  Called with mutex_ held.
+   */
+  bool isActive() const {
+    return workerCount_ <= workerMaxCount_ || (state_ == JOINING && pendingCount_ > 0);
+  }
+
+  void removeWorkersUnderLock(size_t value);
+
+  const size_t initialWorkerCount_;
+  const size_t pendingTaskCountMax_;
+
+  // only modified while holding mutex_, read without it
+  std::atomic<size_t> workerCount_;
+  std::atomic<size_t> workerMaxCount_;
+  std::atomic<size_t> idleCount_;
+
+  // pendingCount_ includes the tasks add() has made room for but not queued
+  // yet, queuedCount_ only those in the queues
+  std::atomic<size_t> pendingCount_;
+  std::atomic<size_t> queuedCount_;
+  std::atomic<size_t> activeCount_;
+  std::atomic<size_t> blockedAdders_;
+  std::atomic<size_t> expiredCount_;
+
+  Queue queues_[MAX_QUEUES];
+  std::atomic<size_t> numQueues_;
+  std::atomic<size_t> nextQueue_;
+  std::atomic<uint64_t> nextSequence_;
+  size_t workerSequence_;
+
+  ExpireCallback expireCallback_;
+  ExpireInfoCallback expireInfoCallback_;
+  std::atomic<ThreadManager::STATE> state_;
+  shared_ptr<ThreadFactory> threadFactory_;
+
+  Mutex mutex_;
+  Monitor monitor_;       // idle workers wait here
+  Monitor maxMonitor_;    // adders blocked at pendingTaskCountMax wait here
+  Monitor workerMonitor_; // used to synchronize changes in worker count
+
+  std::set<shared_ptr<Thread> > workers_;
+  std::set<shared_ptr<Thread> > deadWorkers_;
+  std::map<const Thread::id_t, shared_ptr<Thread> > idMap_;
+};
+
+class WorkStealingThreadManager::Worker : public Runnable {
+
+public:
+  Worker(WorkStealingThreadManager* manager) : manager_(manager) {}
+
+  ~Worker() override = default;
+
+  /**
+   * Worker entry point
+   *
+   * Registration, parking while there is nothing to do and retirement happen
+   * under the manager mutex; taking and running tasks does not.
+   */
+  void run() override {
+    WorkStealingThreadManager* m = manager_;
+    Guard g(m->mutex_);
+
+    bool active = m->workerCount_ < m->workerMaxCount_;
+    size_t self = 0;
+    if (active) {
+      self = m->workerSequence_++ % MAX_QUEUES;
+      if (self >= m->numQueues_) {
+        m->numQueues_.store(self + 1);
+      }
+      if (++m->workerCount_ == m->workerMaxCount_) {
+        m->workerMonitor_.notify();
+      }
+    }
+
+    while (active) {
+      active = m->isActive();
+
+      while (active) {
+        // add() counts its task once it is queued and before it looks for
+        // idle workers, and this worker counts itself idle before it looks
+        // for tasks, so one of them sees the other.  The notify then comes
+        // under mutex_, after the wait below has released it.
+        m->idleCount_++;
+        if (m->queuedCount_ > 0) {
+          m->idleCount_--;
+          break;
+        }
+        m->monitor_.wait();
+        active = m->isActive();
+        m->idleCount_--;
+      }
+
+      if (active) {
+        m->mutex_.unlock();
+        runTasks(self);
+        m->mutex_.lock();
+      }
+    }
+
+    m->deadWorkers_.insert(this->thread());
+    if (--m->workerCount_ == m->workerMaxCount_) {
+      m->workerMonitor_.notify();
+    }
+  }
+
+private:
+  /**
+   * Runs tasks until there are none left or this worker may have to retire.
+   */
+  void runTasks(size_t self) {
+    WorkStealingThreadManager* m = manager_;
+    std::vector<Entry> entries(1);
+    Entry& entry = entries.front();
+
+    while (m->workerCount_ <= m->workerMaxCount_ || m->state_ == JOINING) {
+      if (!m->take(self, entry)) {
+        return;
+      }
+
+      if (entry.isExpired(std::chrono::steady_clock::now())) {
+        if (m->expire(entries, ThreadManager::EXPIRED_AT_DISPATCH)) {
+          m->expiredCount_++;
+        }
+      } else {
+        try {
+          entry.runnable->run();
+        } catch (const std::exception& e) {
+          GlobalOutput.printf("[ERROR] task->run() raised an exception: %s", e.what());
+        } catch (...) {
+          GlobalOutput.printf("[ERROR] task->run() raised an unknown exception");
+        }
+      }
+
+      entry.runnable.reset();
+      m->activeCount_--;
+    }
+  }
+
+  WorkStealingThreadManager* manager_;
+};
+
+bool WorkStealingThreadManager::reservePending() {
+  if (pendingTaskCountMax_ == 0) {
+    pendingCount_++;
+    return true;
+  }
+  size_t pending = pendingCount_.load();
+  while (pending < pendingTaskCountMax_) {
+    if (pendingCount_.compare_exchange_weak(pending, pending + 1)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void WorkStealingThreadManager::releasePending(size_t count) {
+  pendingCount_ -= count;
+  if (blockedAdders_ > 0) {
+    Guard g(mutex_);
+    maxMonitor_.notifyAll();
+  }
+}
+
+bool WorkStealingThreadManager::take(size_t self, Entry& entry) {
+  const size_t numQueues = numQueues_.load();
+  for (size_t ix = 0; ix < numQueues; ix++) {
+    Queue& queue = queues_[(self + ix) % numQueues];
+    if (queue.size.load(std::memory_order_relaxed) == 0) {
+      continue;
+    }
+    {
+      Guard g(queue.mutex);
+      if (queue.tasks.empty()) {
+        continue;
+      }
+      entry = std::move(queue.tasks.front());
+      queue.tasks.pop_front();
+      queue.size.store(queue.tasks.size(), std::memory_order_relaxed);
+      queuedCount_--;
+    }
+    // count the task as active before it stops being pending, so that
+    // totalTaskCount() never drops below the real number of tasks
+    activeCount_++;
+    releasePending(1);
+    return true;
+  }
+  return false;
+}
+
+void WorkStealingThreadManager::addWorker(size_t value) {
+  std::set<shared_ptr<Thread> > newThreads;
+  for (size_t ix = 0; ix < value; ix++) {
+    newThreads.insert(threadFactory_->newThread(std::make_shared<Worker>(this)));
+  }
+
+  Guard g(mutex_);
+  workerMaxCount_ += value;
+  workers_.insert(newThreads.begin(), newThreads.end());
+
+  for (const auto& newThread : newThreads) {
+    newThread->start();
+    idMap_.insert(std::pair<const Thread::id_t, shared_ptr<Thread> >(newThread->getId(), newThread));
+  }
+
+  while (workerCount_ != workerMaxCount_) {
+    workerMonitor_.wait();
+  }
+}
+
+void WorkStealingThreadManager::start() {
+  {
+    Guard g(mutex_);
+    if (state_ != ThreadManager::UNINITIALIZED) {
+      return;
+    }
+    if (!threadFactory_) {
+      throw InvalidArgumentException();
+    }
+    state_ = ThreadManager::STARTED;
+  }
+  addWorker(initialWorkerCount_);
+}
+
+void WorkStealingThreadManager::stop() {
+  Guard g(mutex_);
+  bool doStop = false;
+
+  if (state_ != ThreadManager::STOPPING && state_ != ThreadManager::JOINING
+      && state_ != ThreadManager::STOPPED) {
+    doStop = true;
+    state_ = ThreadManager::JOINING;
+  }
+
+  if (doStop) {
+    removeWorkersUnderLock(workerCount_);
+  }
+
+  state_ = ThreadManager::STOPPED;
+}
+
+void WorkStealingThreadManager::removeWorker(size_t value) {
+  Guard g(mutex_);
+  removeWorkersUnderLock(value);
+}
+
+void WorkStealingThreadManager::removeWorkersUnderLock(size_t value) {
+  if (value > workerMaxCount_) {
+    throw InvalidArgumentException();
+  }
+
+  workerMaxCount_ -= value;
+  monitor_.notifyAll();
+
+  while (workerCount_ != workerMaxCount_) {
+    workerMonitor_.wait();
+  }
+
+  for (const auto& deadWorker : deadWorkers_) {
+    if (!threadFactory_->isDetached()) {
+      deadWorker->join();
+    }
+    idMap_.erase(deadWorker->getId());
+    workers_.erase(deadWorker);
+  }
+
+  deadWorkers_.clear();
+}
+
+bool WorkStealingThreadManager::canSleep() const {
+  const Thread::id_t id = threadFactory_->getCurrentThreadId();
+  return idMap_.find(id) == idMap_.end();
+}
+
+void WorkStealingThreadManager::add(shared_ptr<Runnable> value,
+                                    int64_t timeout,
+                                    int64_t expiration) {
+  if (state_ != ThreadManager::STARTED) {
+    throw IllegalStateException(
+        "WorkStealingThreadManager::add ThreadManager "
+        "not started");
+  }
+
+  if (!reservePending()) {
+    // if we're at a limit, remove an expired task to see if the limit clears
+    removeExpired(true);
+
+    Guard g(mutex_, timeout);
+    if (!g) {
+      throw TimedOutException();
+    }
+    if (!reservePending()) {
+      if (!canSleep() || timeout < 0) {
+        throw TooManyPendingTasksException();
+      }
+      blockedAdders_++;
+      try {
+        while (!reservePending()) {
+          maxMonitor_.wait(timeout);
+        }
+      } catch (...) {
+        blockedAdders_--;
+        throw;
+      }
+      blockedAdders_--;
+    }
+  }
+
+  Entry entry;
+  entry.runnable = std::move(value);
+  entry.expiration = expiration;
+  if (expiration != 0LL) {
+    entry.expireTime = std::chrono::steady_clock::now() + std::chrono::milliseconds(expiration);
+  }
+
+  Queue& queue = queues_[nextQueue_.fetch_add(1, std::memory_order_relaxed) % numQueues_.load()];
+  {
+    Guard g(queue.mutex);
+    entry.sequence = nextSequence_++;
+    queue.tasks.push_back(std::move(entry));
+    queue.size.store(queue.tasks.size(), std::memory_order_relaxed);
+    queuedCount_++;
+  }
+
+  // If idle thread is available notify it, otherwise all worker threads are
+  // running and will get around to this task in time.  queuedCount_ went up
+  // above, before idleCount_ is read here, see Worker::run().
+  if (idleCount_ > 0) {
+    Guard g(mutex_);
+    monitor_.notify();
+  }
+}
+
+void WorkStealingThreadManager::remove(shared_ptr<Runnable> task) {
+  if (state_ != ThreadManager::STARTED) {
+    throw IllegalStateException(
+        "WorkStealingThreadManager::remove ThreadManager not "
+        "started");
+  }
+
+  const size_t numQueues = numQueues_.load();
+  for (size_t ix = 0; ix < numQueues; ix++) {
+    Queue& queue = queues_[ix];
+    bool found = false;
+    {
+      Guard g(queue.mutex);
+      for (auto it = queue.tasks.begin(); it != queue.tasks.end(); ++it) {
+        if (it->runnable == task) {
+          queue.tasks.erase(it);
+          queue.size.store(queue.tasks.size(), std::memory_order_relaxed);
+          queuedCount_--;
+          found = true;
+          break;
+        }
+      }
+    }
+    if (found) {
+      releasePending(1);
+      return;
+    }
+  }
+}
+
+shared_ptr<Runnable> WorkStealingThreadManager::removeNextPending() {
+  if (state_ != ThreadManager::STARTED) {
+    throw IllegalStateException(
+        "WorkStealingThreadManager::removeNextPending "
+        "ThreadManager not started");
+  }
+
+  // lock every queue, always in the same order, to find the oldest task
+  const size_t numQueues = numQueues_.load();
+  for (size_t ix = 0; ix < numQueues; ix++) {
+    queues_[ix].mutex.lock();
+  }
+
+  Queue* oldest = nullptr;
+  for (size_t ix = 0; ix < numQueues; ix++) {
+    Queue& queue = queues_[ix];
+    if (!queue.tasks.empty()
+        && (!oldest || queue.tasks.front().sequence < oldest->tasks.front().sequence)) {
+      oldest = &queue;
+    }
+  }
+
+  shared_ptr<Runnable> task;
+  if (oldest) {
+    task = std::move(oldest->tasks.front().runnable);
+    oldest->tasks.pop_front();
+    oldest->size.store(oldest->tasks.size(), std::memory_order_relaxed);
+    queuedCount_--;
+  }
+
+  for (size_t ix = 0; ix < numQueues; ix++) {
+    queues_[ix].mutex.unlock();
+  }
+
+  if (task) {
+    releasePending(1);
+  }
+  return task;
+}
+
+bool WorkStealingThreadManager::expire(const std::vector<Entry>& entries,
+                                       ThreadManager::EXPIRE_REASON reason) {
+  ExpireCallback expireCallback;
+  ExpireInfoCallback expireInfoCallback;
+  {
+    Guard g(mutex_);
+    expireCallback = expireCallback_;
+    expireInfoCallback = expireInfoCallback_;
+  }
+
+  const auto now = std::chrono::steady_clock::now();
+  for (const auto& entry : entries) {
+    if (expireInfoCallback) {
+      ThreadManager::ExpireInfo info;
+      info.reason = reason;
+      info.expiration = std::chrono::milliseconds(entry.expiration);
+      info.overdue = now - entry.expireTime;
+      expireInfoCallback(entry.runnable, info);
+    } else if (expireCallback) {
+      expireCallback(entry.runnable);
+    }
+  }
+  return expireInfoCallback || expireCallback;
+}
+
+void WorkStealingThreadManager::removeExpired(bool justOne) {
+  auto now = std::chrono::steady_clock::now();
+  const size_t numQueues = numQueues_.load();
+  for (size_t ix = 0; ix < numQueues; ix++) {
+    Queue& queue = queues_[ix];
+    if (queue.size.load(std::memory_order_relaxed) == 0) {
+      continue;
+    }
+
+    std::vector<Entry> expired;
+    {
+      Guard g(queue.mutex);
+      for (auto it = queue.tasks.begin(); it != queue.tasks.end();) {
+        if (it->isExpired(now)) {
+          expired.push_back(std::move(*it));
+          it = queue.tasks.erase(it);
+          if (justOne) {
+            break;
+          }
+        } else {
+          ++it;
+        }
+      }
+      queue.size.store(queue.tasks.size(), std::memory_order_relaxed);
+      queuedCount_ -= expired.size();
+    }
+
+    if (expired.empty()) {
+      continue;
+    }
+    expire(expired, justOne ? ThreadManager::EXPIRED_AT_LIMIT : ThreadManager::EXPIRED_BY_SWEEP);
+    expiredCount_ += expired.size();
+    releasePending(expired.size());
+    if (justOne) {
+      return;
+    }
+  }
+}
+
+void ThreadManager::setExpireInfoCallback(ExpireInfoCallback expireCallback) {
+  if (!expireCallback) {
+    setExpireCallback(ExpireCallback());
+    return;
+  }
+  setExpireCallback([expireCallback](shared_ptr<Runnable> task) {
+    ExpireInfo info;
+    info.reason = EXPIRED_AT_DISPATCH;
+    info.expiration = std::chrono::milliseconds::zero();
+    info.overdue = std::chrono::steady_clock::duration::zero();
+    expireCallback(task, info);
+  });
+}
+
+ThreadManager::SCHEDULING ThreadManager::scheduling() const {
+  return FIFO;
+}
+
+void ThreadManager::scheduling(SCHEDULING value) {
+  if (value != FIFO) {
+    throw InvalidArgumentException();
+  }
+}
+
 shared_ptr<ThreadManager> ThreadManager::newThreadManager() {
   return shared_ptr<ThreadManager>(new ThreadManager::Impl());
 }
@@ -580,6 +1418,19 @@ shared_ptr<ThreadManager> ThreadManager::newSimpleThreadManager(size_t count,
                                                                 size_t pendingTaskCountMax) {
   return shared_ptr<ThreadManager>(new SimpleThreadManager(count, pendingTaskCountMax));
 }
+
+shared_ptr<ThreadManager> ThreadManager::newSimpleThreadManager(size_t count,
+                                                                size_t pendingTaskCountMax,
+                                                                SCHEDULING scheduling) {
+  shared_ptr<ThreadManager> threadManager(new SimpleThreadManager(count, pendingTaskCountMax));
+  threadManager->scheduling(scheduling);
+  return threadManager;
+}
+
+shared_ptr<ThreadManager> ThreadManager::newWorkStealingThreadManager(size_t count,
+                                                                      size_t pendingTaskCountMax) {
+  return shared_ptr<ThreadManager>(new WorkStealingThreadManager(count, pendingTaskCountMax));
+}
 }
 }
 } // apache::thrift::concurrency
@@ -20,6 +20,7 @@
 #ifndef _THRIFT_CONCURRENCY_THREADMANAGER_H_
 #define _THRIFT_CONCURRENCY_THREADMANAGER_H_ 1
 
+#include <chrono>
 #include <functional>
 #include <memory>
 #include <thrift/concurrency/ThreadFactory.h>
@@ -60,6 +61,48 @@ protected:
 public:
   typedef std::function<void(std::shared_ptr<Runnable>)> ExpireCallback;
 
+  /**
+   * Order in which pending tasks are handed to worker threads
+   */
+  enum SCHEDULING {
+    /** in the order in which they were added */
+    FIFO,
+    /**
+     * by expiration time, earliest first; tasks added without an expiration
+     * are ordered as if they expired fallbackDeadline() milliseconds after
+     * being added, so that tasks with deadlines cannot hold them back forever
+     */
+    EARLIEST_DEADLINE_FIRST
+  };
+
+  /// Default for fallbackDeadline(), in milliseconds
+  static const int64_t DEFAULT_FALLBACK_DEADLINE = 1000;
+
+  /**
+   * Why a task was expired instead of being run
+   */
+  enum EXPIRE_REASON {
+    /** a worker thread took the task off the queue after it had expired */
+    EXPIRED_AT_DISPATCH,
+    /** the task was found by removeExpiredTasks() */
+    EXPIRED_BY_SWEEP,
+    /** add() dropped the task to make room at pendingTaskCountMax() */
+    EXPIRED_AT_LIMIT
+  };
+
+  /**
+   * Details on an expired task, passed to an ExpireInfoCallback
+   */
+  struct ExpireInfo {
+    EXPIRE_REASON reason;
+    /** the expiration the task was added with */
+    std::chrono::milliseconds expiration;
+    /** how long the task had been expired when it was removed */
+    std::chrono::steady_clock::duration overdue;
+  };
+
+  typedef std::function<void(std::shared_ptr<Runnable>, const ExpireInfo&)> ExpireInfoCallback;
+
   virtual ~ThreadManager() = default;
 
   /**
@@ -190,6 +233,54 @@ public:
    */
   virtual void setExpireCallback(ExpireCallback expireCallback) = 0;
 
+  /**
+   * Set a callback to be called when a task is expired and not run, which is
+   * also told why and how late.  When set, it is called instead of the
+   * callback set with setExpireCallback().
+   *
+   * @param expireCallback a function called with the shared_ptr<Runnable> for
+   * the expired task and the details of its expiration.
+   *
+   * The default implementation registers it with setExpireCallback(), which
+   * has no details to pass on: the reason reads EXPIRED_AT_DISPATCH and the
+   * times zero.
+   */
+  virtual void setExpireInfoCallback(ExpireInfoCallback expireCallback);
+
+  /**
+   * \returns the order in which pending tasks are run; FIFO unless overridden
+   */
+  virtual SCHEDULING scheduling() const;
+
+  /**
+   * Sets the order in which pending tasks are run.  Tasks that are already
+   * pending are reordered.
+   *
+   * With EARLIEST_DEADLINE_FIRST, expired tasks are at the front of the queue,
+   * so a worker thread or add() at pendingTaskCountMax() finds and drops them
+   * in logarithmic time instead of running them or scanning the queue.  The
+   * queue is only scanned when a task without an expiration is overdue.
+   *
+   * \throws InvalidArgumentException if the implementation does not support
+   *                                  the given order; the default
+   *                                  implementation only supports FIFO
+   */
+  virtual void scheduling(SCHEDULING value);
+
+  /**
+   * \returns the deadline, in milliseconds after being added, by which
+   * EARLIEST_DEADLINE_FIRST orders tasks added without an expiration
+   */
+  virtual int64_t fallbackDeadline() const { return DEFAULT_FALLBACK_DEADLINE; }
+
+  /**
+   * Sets the deadline by which EARLIEST_DEADLINE_FIRST orders tasks added
+   * without an expiration.  They are not expired when it passes.  Applies to
+   * tasks added from now on.  Ignored by implementations that only support
+   * FIFO.
+   */
+  virtual void fallbackDeadline(int64_t value) { (void)value; }
+
   static std::shared_ptr<ThreadManager> newThreadManager();
 
   /**
@@ -200,6 +291,24 @@ public:
   static std::shared_ptr<ThreadManager> newSimpleThreadManager(size_t count = 4,
                                                                  size_t pendingTaskCountMax = 0);
 
+  /**
+   * Creates a simple thread manager that runs its pending tasks in the given
+   * scheduling order, see scheduling(SCHEDULING).
+   */
+  static std::shared_ptr<ThreadManager> newSimpleThreadManager(size_t count,
+                                                                 size_t pendingTaskCountMax,
+                                                                 SCHEDULING scheduling);
+
+  /**
+   * Creates a thread manager like newSimpleThreadManager, but with a task queue
+   * per worker thread.  Idle workers steal tasks from the queues of busy ones.
+   * This scales better than the single shared queue when many short tasks are
+   * added from several threads, at the cost of only approximately FIFO ordering.
+   * Only FIFO scheduling is supported.
+   */
+  static std::shared_ptr<ThreadManager> newWorkStealingThreadManager(size_t count = 4,
+                                                                       size_t pendingTaskCountMax = 0);
+
   class Task;
 
   class Worker;
@@ -21,9 +21,11 @@
 #include <thrift/concurrency/Exception.h>
 
 #include <assert.h>
+#include <algorithm>
 #include <iostream>
 #include <memory>
 #include <set>
+#include <stdint.h>
 
 namespace apache {
 namespace thrift {
@@ -60,6 +62,7 @@ public:
 private:
   shared_ptr<Runnable> runnable_;
   friend class TimerManager::Dispatcher;
+  friend class TimingWheelTimerManager;
   STATE state_;
 };
 
@@ -316,6 +319,376 @@ void TimerManager::remove(Timer handle) {
 TimerManager::STATE TimerManager::state() const {
   return state_;
 }
+
+/**
+ * A timer in a TimingWheelTimerManager.  While it is in the wheel, it is
+ * linked into the list of its slot and keeps itself alive through self_.
+ */
+class TimingWheelTimerManager::Entry : public TimerManager::Task {
+
+public:
+  Entry(shared_ptr<Runnable> runnable, uint64_t tick)
+    : TimerManager::Task(runnable), tick_(tick), slot_(nullptr), prev_(nullptr), next_(nullptr) {}
+
+  uint64_t tick_;
+  Entry** slot_;
+  Entry* prev_;
+  Entry* next_;
+  shared_ptr<Entry> self_;
+};
+
+class TimingWheelTimerManager::Dispatcher : public Runnable {
+
+public:
+  Dispatcher(TimingWheelTimerManager* manager) : manager_(manager) {}
+
+  /**
+   * Dispatcher entry point
+   *
+   * Sleeps until the next tick that has work, moves the timers that are due
+   * out of the wheel and runs them without holding the monitor.
+   */
+  void run() override {
+    {
+      Synchronized s(manager_->monitor_);
+      if (manager_->state_ == TimerManager::STARTING) {
+        manager_->state_ = TimerManager::STARTED;
+        manager_->monitor_.notifyAll();
+      }
+    }
+
+    std::vector<shared_ptr<Entry> > due;
+    for (;;) {
+      {
+        Synchronized s(manager_->monitor_);
+        uint64_t now = 0;
+        while (manager_->state_ == TimerManager::STARTED
+               && (now = manager_->toTick(std::chrono::steady_clock::now()))
+                  <= manager_->processedTick_) {
+          if (manager_->taskCount_ == 0) {
+            manager_->wakeTick_ = UINT64_MAX;
+            manager_->monitor_.waitForever();
+          } else {
+            manager_->wakeTick_ = manager_->nextTick();
+            manager_->monitor_.waitForTime(manager_->toTime(manager_->wakeTick_));
+          }
+        }
+        if (manager_->state_ != TimerManager::STARTED) {
+          break;
+        }
+        manager_->advance(now, due);
+      }
+
+      for (const auto& entry : due) {
+        entry->run();
+      }
+      due.clear();
+    }
+
+    {
+      Synchronized s(manager_->monitor_);
+      if (manager_->state_ == TimerManager::STOPPING) {
+        manager_->state_ = TimerManager::STOPPED;
+        manager_->monitor_.notifyAll();
+      }
+    }
+  }
+
+private:
+  TimingWheelTimerManager* manager_;
+};
+
+TimingWheelTimerManager::TimingWheelTimerManager(const std::chrono::milliseconds& tick)
+  : tick_(std::max(std::chrono::steady_clock::duration(tick),
+                   std::chrono::steady_clock::duration(std::chrono::milliseconds(1)))),
+    epoch_(std::chrono::steady_clock::now()),
+    processedTick_(0),
+    wakeTick_(UINT64_MAX),
+    taskCount_(0),
+    state_(TimerManager::UNINITIALIZED) {
+  for (auto& level : slots_) {
+    for (auto& slot : level) {
+      slot = nullptr;
+    }
+  }
+}
+
+TimingWheelTimerManager::~TimingWheelTimerManager() {
+  if (state_ != STOPPED) {
+    try {
+      stop();
+    } catch (...) {
+      // We're really hosed.
+    }
+  }
+}
+
+void TimingWheelTimerManager::start() {
+  bool doStart = false;
+  {
+    Synchronized s(monitor_);
+    if (!threadFactory_) {
+      throw InvalidArgumentException();
+    }
+    if (state_ == TimerManager::UNINITIALIZED) {
+      state_ = TimerManager::STARTING;
+      doStart = true;
+    }
+  }
+
+  if (doStart) {
+    dispatcher_ = std::make_shared<Dispatcher>(this);
+    dispatcherThread_ = threadFactory_->newThread(dispatcher_);
+    dispatcherThread_->start();
+  }
+
+  {
+    Synchronized s(monitor_);
+    while (state_ == TimerManager::STARTING) {
+      monitor_.wait();
+    }
+  }
+}
+
+void TimingWheelTimerManager::stop() {
+  Synchronized s(monitor_);
+  if (state_ == TimerManager::UNINITIALIZED) {
+    state_ = TimerManager::STOPPED;
+  } else if (state_ != STOPPING && state_ != STOPPED) {
+    state_ = STOPPING;
+    monitor_.notifyAll();
+  }
+  while (state_ != STOPPED) {
+    monitor_.wait();
+  }
+
+  // Clean up any outstanding tasks
+  clear();
+}
+
+shared_ptr<const ThreadFactory> TimingWheelTimerManager::threadFactory() const {
+  Synchronized s(monitor_);
+  return threadFactory_;
+}
+
+void TimingWheelTimerManager::threadFactory(shared_ptr<const ThreadFactory> value) {
+  Synchronized s(monitor_);
+  threadFactory_ = value;
+}
+
+size_t TimingWheelTimerManager::taskCount() const {
+  return taskCount_;
+}
+
+TimerManager::STATE TimingWheelTimerManager::state() const {
+  return state_;
+}
+
+TimerManager::Timer TimingWheelTimerManager::add(shared_ptr<Runnable> task,
+                                                 const std::chrono::milliseconds& timeout) {
+  return add(task, std::chrono::steady_clock::now() + timeout);
+}
+
+TimerManager::Timer TimingWheelTimerManager::add(
+    shared_ptr<Runnable> task,
+    const std::chrono::time_point<std::chrono::steady_clock>& abstime) {
+  if (abstime < std::chrono::steady_clock::now()) {
+    throw InvalidArgumentException();
+  }
+
+  // round up, so that the timer never runs early
+  uint64_t tick = toTick(abstime);
+  if (toTime(tick) < abstime) {
+    tick++;
+  }
+
+  shared_ptr<Entry> entry = std::make_shared<Entry>(task, tick);
+
+  Synchronized s(monitor_);
+  if (state_ != TimerManager::STARTED) {
+    throw IllegalStateException();
+  }
+
+  if (entry->tick_ <= processedTick_) {
+    entry->tick_ = processedTick_ + 1;
+  }
+  entry->self_ = entry;
+  insert(entry.get(), processedTick_ + 1);
+  taskCount_++;
+
+  // kick the dispatcher if it sleeps past the new timer
+  if (entry->tick_ < wakeTick_) {
+    monitor_.notify();
+  }
+
+  return entry;
+}
+
+void TimingWheelTimerManager::remove(shared_ptr<Runnable> task) {
+  Synchronized s(monitor_);
+  if (state_ != TimerManager::STARTED) {
+    throw IllegalStateException();
+  }
+
+  std::vector<shared_ptr<Entry> > removed;
+  for (auto& level : slots_) {
+    for (auto& slot : level) {
+      for (Entry* entry = slot; entry != nullptr;) {
+        Entry* next = entry->next_;
+        if (*entry == task) {
+          removed.push_back(std::move(entry->self_));
+          unlink(entry);
+          taskCount_--;
+        }
+        entry = next;
+      }
+    }
+  }
+  if (removed.empty()) {
+    throw NoSuchTaskException();
+  }
+}
+
+void TimingWheelTimerManager::remove(Timer handle) {
+  Synchronized s(monitor_);
+  if (state_ != TimerManager::STARTED) {
+    throw IllegalStateException();
+  }
+
+  shared_ptr<Task> task = handle.lock();
+  if (!task) {
+    throw NoSuchTaskException();
+  }
+
+  Entry* entry = static_cast<Entry*>(task.get());
+  if (entry->slot_ == nullptr) {
+    // Task is being executed
+    throw UncancellableTaskException();
+  }
+
+  unlink(entry);
+  entry->self_.reset();
+  taskCount_--;
+}
+
+uint64_t TimingWheelTimerManager::toTick(const std::chrono::steady_clock::time_point& time) const {
+  return time <= epoch_ ? 0 : static_cast<uint64_t>((time - epoch_) / tick_);
+}
+
+std::chrono::steady_clock::time_point TimingWheelTimerManager::toTime(uint64_t tick) const {
+  return epoch_ + tick_ * static_cast<std::chrono::steady_clock::rep>(tick);
+}
+
+void TimingWheelTimerManager::insert(Entry* entry, uint64_t base) {
+  // the outermost wheel takes everything beyond the range of the inner ones
+  const uint64_t last = base + (uint64_t(1) << (LEVELS * SLOT_BITS)) - 1;
+  const uint64_t tick = std::min(entry->tick_, last);
+
+  int level = 0;
+  while (level < LEVELS - 1 && tick - base >= (uint64_t(1) << ((level + 1) * SLOT_BITS))) {
+    level++;
+  }
+
+  Entry** slot = &slots_[level][(tick >> (level * SLOT_BITS)) & (SLOTS - 1)];
+  entry->slot_ = slot;
+  entry->prev_ = nullptr;
+  entry->next_ = *slot;
+  if (*slot != nullptr) {
+    (*slot)->prev_ = entry;
+  }
+  *slot = entry;
+}
+
+void TimingWheelTimerManager::unlink(Entry* entry) {
+  if (entry->prev_ != nullptr) {
+    entry->prev_->next_ = entry->next_;
+  } else {
+    *entry->slot_ = entry->next_;
+  }
+  if (entry->next_ != nullptr) {
+    entry->next_->prev_ = entry->prev_;
+  }
+  entry->slot_ = nullptr;
+  entry->prev_ = nullptr;
+  entry->next_ = nullptr;
+}
+
+void TimingWheelTimerManager::cascade(int level, uint64_t tick) {
+  Entry** slot = &slots_[level][(tick >> (level * SLOT_BITS)) & (SLOTS - 1)];
+  Entry* entry = *slot;
+  *slot = nullptr;
+  while (entry != nullptr) {
+    Entry* next = entry->next_;
+    insert(entry, tick);
+    entry = next;
+  }
+}
+
+uint64_t TimingWheelTimerManager::nextTick() const {
+  // the first busy slot of the innermost wheel, or the next time the outer
+  // wheels have to be cascaded into it
+  const uint64_t first = processedTick_ + 1;
+  const uint64_t boundary = (first | (SLOTS - 1)) + 1;
+  for (uint64_t tick = first; tick < boundary; tick++) {
+    if (slots_[0][tick & (SLOTS - 1)] != nullptr) {
+      return tick;
+    }
+  }
+  return boundary;
+}
+
+void TimingWheelTimerManager::advance(uint64_t until,
+                                      std::vector<shared_ptr<Entry> >& due) {
+  while (processedTick_ < until) {
+    if (taskCount_ == 0) {
+      // nothing left to run or cascade, skip ahead
+      processedTick_ = until;
+      break;
+    }
+
+    const uint64_t tick = processedTick_ + 1;
+
+    // move the timers of the outer wheels inwards whenever the wheel inside
+    // them completes a turn
+    int level = 1;
+    while (level < LEVELS && (tick & ((uint64_t(1) << (level * SLOT_BITS)) - 1)) == 0) {
+      level++;
+    }
+    while (--level > 0) {
+      cascade(level, tick);
+    }
+
+    Entry** slot = &slots_[0][tick & (SLOTS - 1)];
+    for (Entry* entry = *slot; entry != nullptr;) {
+      Entry* next = entry->next_;
+      entry->slot_ = nullptr;
+      entry->prev_ = nullptr;
+      entry->next_ = nullptr;
+      if (entry->state_ == TimerManager::Task::WAITING) {
+        entry->state_ = TimerManager::Task::EXECUTING;
+      }
+      due.push_back(std::move(entry->self_));
+      taskCount_--;
+      entry = next;
+    }
+    *slot = nullptr;
+
+    processedTick_ = tick;
+  }
+}
+
+void TimingWheelTimerManager::clear() {
+  for (auto& level : slots_) {
+    for (auto& slot : level) {
+      while (slot != nullptr) {
+        Entry* entry = slot;
+        unlink(entry);
+        entry->self_.reset();
+      }
+    }
+  }
+  taskCount_ = 0;
+}
 }
 }
 } // apache::thrift::concurrency
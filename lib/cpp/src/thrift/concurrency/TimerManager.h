@@ -23,8 +23,10 @@
 #include <thrift/concurrency/Monitor.h>
 #include <thrift/concurrency/ThreadFactory.h>
 
+#include <chrono>
 #include <memory>
 #include <map>
+#include <vector>
 
 namespace apache {
 namespace thrift {
@@ -130,6 +132,87 @@ private:
   using task_iterator = decltype(taskMap_)::iterator;
   typedef std::pair<task_iterator, task_iterator> task_range;
 };
+
+/**
+ * Timer manager backed by a hierarchical timing wheel
+ *
+ * Timers are kept in four wheels of 256 slots each, the first one holding
+ * the timers due within the next 256 ticks, each further one covering 256
+ * times the range of the previous one.  Adding and removing a Timer is O(1)
+ * and does not allocate beyond the task handle itself.  The dispatcher
+ * wakes up at most once per tick and runs all timers due in that tick
+ * together; timers of the outer wheels are moved inwards once per turn of
+ * the wheel inside them.
+ *
+ * Timers never run early, but up to one tick late, so the tick should be
+ * chosen as coarse as the timeouts being managed allow.  This suits large
+ * numbers of timers that are mostly removed before they fall due, such as
+ * request timeouts.
+ */
+class TimingWheelTimerManager : public TimerManager {
+
+public:
+  /**
+   * @param tick The resolution of the wheel
+   */
+  explicit TimingWheelTimerManager(const std::chrono::milliseconds& tick
+                                   = std::chrono::milliseconds(10));
+
+  ~TimingWheelTimerManager() override;
+
+  std::shared_ptr<const ThreadFactory> threadFactory() const override;
+
+  void threadFactory(std::shared_ptr<const ThreadFactory> value) override;
+
+  void start() override;
+
+  void stop() override;
+
+  size_t taskCount() const override;
+
+  using TimerManager::add;
+
+  Timer add(std::shared_ptr<Runnable> task, const std::chrono::milliseconds& timeout) override;
+
+  Timer add(std::shared_ptr<Runnable> task,
+            const std::chrono::time_point<std::chrono::steady_clock>& abstime) override;
+
+  void remove(std::shared_ptr<Runnable> task) override;
+
+  void remove(Timer timer) override;
+
+  STATE state() const override;
+
+  static const int LEVELS = 4;
+  static const int SLOT_BITS = 8;
+  static const int SLOTS = 1 << SLOT_BITS;
+
+private:
+  class Entry;
+  class Dispatcher;
+  friend class Dispatcher;
+
+  uint64_t toTick(const std::chrono::steady_clock::time_point& time) const;
+  std::chrono::steady_clock::time_point toTime(uint64_t tick) const;
+  void insert(Entry* entry, uint64_t base);
+  void unlink(Entry* entry);
+  void cascade(int level, uint64_t tick);
+  uint64_t nextTick() const;
+  void advance(uint64_t until, std::vector<std::shared_ptr<Entry> >& due);
+  void clear();
+
+  const std::chrono::steady_clock::duration tick_;
+  const std::chrono::steady_clock::time_point epoch_;
+  std::shared_ptr<const ThreadFactory> threadFactory_;
+  Entry* slots_[LEVELS][SLOTS];
+  uint64_t processedTick_; // all slots up to this tick have been run
+  uint64_t wakeTick_;      // the tick the dispatcher is waiting for
+  size_t taskCount_;
+  Monitor monitor_;
+  STATE state_;
+  std::shared_ptr<Dispatcher> dispatcher_;
+  std::shared_ptr<Thread> dispatcherThread_;
+};
 }
 }
 } // apache::thrift::concurrency
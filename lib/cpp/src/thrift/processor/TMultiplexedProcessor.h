@@ -23,7 +23,9 @@
 #include <thrift/protocol/TProtocolDecorator.h>
 #include <thrift/TApplicationException.h>
 #include <thrift/TProcessor.h>
-#include <boost/tokenizer.hpp>
+#include <boost/functional/hash.hpp>
+#include <boost/utility/string_ref.hpp>
+#include <unordered_map>
 
 namespace apache {
 namespace thrift {
@@ -42,6 +44,21 @@ public:
                         const int32_t _seqid)
     : TProtocolDecorator(_protocol), name(_name), type(_type), seqid(_seqid) {}
 
+  /**
+   * Make this decorator stand for another message, so that one instance can
+   * serve request after request.  Pass a null protocol to let go of the last
+   * one.
+   */
+  void reset(std::shared_ptr<protocol::TProtocol> _protocol,
+             boost::string_ref _name,
+             const TMessageType _type,
+             const int32_t _seqid) {
+    setProtocol(std::move(_protocol));
+    name.assign(_name.data(), _name.size());
+    type = _type;
+    seqid = _seqid;
+  }
+
   uint32_t readMessageBegin_virt(std::string& _name, TMessageType& _type, int32_t& _seqid) override {
 
     _name = name;
@@ -87,6 +104,24 @@ class TMultiplexedProcessor : public TProcessor {
 public:
   typedef std::map<std::string, std::shared_ptr<TProcessor> > services_t;
 
+  TMultiplexedProcessor() = default;
+
+  // index refers to the names held in services, so copies build their own
+  TMultiplexedProcessor(const TMultiplexedProcessor& other)
+    : TProcessor(other), services(other.services), defaultProcessor(other.defaultProcessor) {
+    rebuildIndex();
+  }
+
+  TMultiplexedProcessor& operator=(const TMultiplexedProcessor& other) {
+    if (this != &other) {
+      TProcessor::operator=(other);
+      services = other.services;
+      defaultProcessor = other.defaultProcessor;
+      rebuildIndex();
+    }
+    return *this;
+  }
+
   /**
     * 'Register' a service with this <code>TMultiplexedProcessor</code>.  This
     * allows us to broker requests to individual services by using the service
@@ -99,7 +134,9 @@ public:
     *                         implementing WeatherReportIf interface.
     */
   void registerProcessor(const std::string& serviceName, std::shared_ptr<TProcessor> processor) {
-    services[serviceName] = processor;
+    auto it = services.insert(services_t::value_type(serviceName, processor)).first;
+    it->second = processor;
+    index[it->first] = processor;
   }
 
   /**
@@ -165,40 +202,29 @@ public:
     }
 
     // Extract the service name
-    boost::tokenizer<boost::char_separator<char> > tok(name, boost::char_separator<char>(":"));
-
-    std::vector<std::string> tokens;
-    std::copy(tok.begin(), tok.end(), std::back_inserter(tokens));
+    boost::string_ref tokens[2];
+    size_t count = split(name, tokens);
 
     // A valid message should consist of two tokens: the service
     // name and the name of the method to call.
-    if (tokens.size() == 2) {
+    if (count == 2) {
       // Search for a processor associated with this service name.
-      auto it = services.find(tokens[0]);
+      auto it = index.find(tokens[0]);
 
-      if (it != services.end()) {
-        std::shared_ptr<TProcessor> processor = it->second;
+      if (it != index.end()) {
         // Let the processor registered for this service name
         // process the message.
-        return processor
-            ->process(std::shared_ptr<protocol::TProtocol>(
-                          new protocol::StoredMessageProtocol(in, tokens[1], type, seqid)),
-                      out,
-                      connectionContext);
+        return dispatch(it->second, in, tokens[1], type, seqid, out, connectionContext);
       } else {
         // Unknown service.
         throw protocol_error(in, out, name, seqid, 
-            "Unknown service: " + tokens[0] +
+            "Unknown service: " + tokens[0].to_string() +
 				". Did you forget to call registerProcessor()?");
       }
-    } else if (tokens.size() == 1) {
+    } else if (count == 1) {
 	  if (defaultProcessor) {
         // non-multiplexed client forwards to default processor
-        return defaultProcessor            
-            ->process(std::shared_ptr<protocol::TProtocol>(
-                          new protocol::StoredMessageProtocol(in, tokens[0], type, seqid)),
-                      out,
-                      connectionContext);
+        return dispatch(defaultProcessor, in, tokens[0], type, seqid, out, connectionContext);
 	  } else {
 		throw protocol_error(in, out, name, seqid,
 			"Non-multiplexed client request dropped. "
@@ -210,9 +236,84 @@ public:
     }
   }
 
+private:
+  struct NameHash {
+    size_t operator()(boost::string_ref name) const {
+      return boost::hash_range(name.begin(), name.end());
+    }
+  };
+
+  void rebuildIndex() {
+    index.clear();
+    for (const auto& service : services) {
+      index[service.first] = service.second;
+    }
+  }
+
+  /**
+   * Split name at each ':', leaving out empty tokens.  Returns the number of
+   * tokens, up to 3, and the first two of them.
+   */
+  static size_t split(const std::string& name, boost::string_ref tokens[2]) {
+    size_t count = 0;
+    size_t start = 0;
+    while (start <= name.size() && count < 3) {
+      size_t end = name.find(':', start);
+      if (end == std::string::npos) {
+        end = name.size();
+      }
+      if (end > start) {
+        if (count < 2) {
+          tokens[count] = boost::string_ref(name.data() + start, end - start);
+        }
+        ++count;
+      }
+      start = end + 1;
+    }
+    return count;
+  }
+
+  /**
+   * Let processor handle the call, reading it through a StoredMessageProtocol
+   * that returns the method name without the service name.  The decorator is
+   * kept per thread and used again unless someone still holds on to it.
+   */
+  static bool dispatch(const std::shared_ptr<TProcessor>& processor,
+                       const std::shared_ptr<protocol::TProtocol>& in,
+                       boost::string_ref name,
+                       protocol::TMessageType type,
+                       int32_t seqid,
+                       const std::shared_ptr<protocol::TProtocol>& out,
+                       void* connectionContext) {
+    static thread_local std::shared_ptr<protocol::StoredMessageProtocol> spare;
+    std::shared_ptr<protocol::StoredMessageProtocol> stored;
+    if (spare && spare.use_count() == 1) {
+      stored = spare;
+      stored->reset(in, name, type, seqid);
+    } else {
+      stored = std::make_shared<protocol::StoredMessageProtocol>(in, name.to_string(), type, seqid);
+      spare = stored;
+    }
+
+    // Let go of the connection's protocol afterwards, unless still in use
+    struct Release {
+      std::shared_ptr<protocol::StoredMessageProtocol>& stored;
+      ~Release() {
+        if (stored.use_count() == 2) {
+          stored->reset(nullptr, boost::string_ref(), protocol::T_CALL, 0);
+        }
+      }
+    } release = {stored};
+
+    return processor->process(stored, out, connectionContext);
+  }
+
 private:
   /** Map of service processor objects, indexed by service names. */
   services_t services;
+
+  /** The same processors, for lookup by the names held in services. */
+  std::unordered_map<boost::string_ref, std::shared_ptr<TProcessor>, NameHash> index;
   
   //! If a non-multi client requests something, it goes to the
   //! default processor (if one is defined) for backwards compatibility.
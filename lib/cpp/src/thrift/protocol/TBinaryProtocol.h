@@ -170,8 +170,76 @@ public:
 
   inline uint32_t readUUID(TUuid& uuid);
 
+  /**
+   * Bulk list element reads and writes.  The elements are fixed width, so
+   * reads byte swap the whole array straight out of the transport's buffer
+   * when it can be borrowed, and writes swap into a local chunk that is
+   * handed to the transport in one call.
+   */
+  inline uint32_t readI16s(int16_t* values, uint32_t count);
+
+  inline uint32_t readI32s(int32_t* values, uint32_t count);
+
+  inline uint32_t readI64s(int64_t* values, uint32_t count);
+
+  inline uint32_t readDoubles(double* values, uint32_t count);
+
+  inline uint32_t writeI16s(const int16_t* values, uint32_t count);
+
+  inline uint32_t writeI32s(const int32_t* values, uint32_t count);
+
+  inline uint32_t writeI64s(const int64_t* values, uint32_t count);
+
+  inline uint32_t writeDoubles(const double* values, uint32_t count);
+
+  /**
+   * Binary values that point into the transport's read buffer when it can
+   * be borrowed from and shared, and are copied otherwise.
+   */
+  inline uint32_t readBinaryView(TBinaryView& view);
+
+  inline uint32_t writeBinaryView(const TBinaryView& view);
+
+  /**
+   * Skips a value using its length prefixes and the sizes of fixed width
+   * types, so nothing is decoded or allocated.  Containers of fixed width
+   * elements are passed over in one step.
+   */
+  uint32_t skip(TType type);
+
   int getMinSerializedSize(TType type) override;
 
+  std::shared_ptr<TProtocolFactory> getProtocolFactory() override;
+
+  /**
+   * Serialized sizes, which are exact.
+   */
+  bool hasSerializedSizes() override { return true; }
+  uint32_t serializedSizeFixed(TType type) override { return getFixedSize(type); }
+  uint32_t serializedSizeFieldBegin(TType /* fieldType */, int16_t /* fieldId */) override {
+    return 3;
+  }
+  uint32_t serializedSizeFieldStop() override { return 1; }
+  uint32_t serializedSizeMapBegin(TType /* keyType */,
+                                  TType /* valType */,
+                                  uint32_t /* size */) override {
+    return 6;
+  }
+  uint32_t serializedSizeListBegin(TType /* elemType */, uint32_t /* size */) override {
+    return 5;
+  }
+  uint32_t serializedSizeSetBegin(TType /* elemType */, uint32_t /* size */) override {
+    return 5;
+  }
+  uint32_t serializedSizeBool(bool /* value */) override { return 1; }
+  uint32_t serializedSizeByte(int8_t /* byte */) override { return 1; }
+  uint32_t serializedSizeI16(int16_t /* i16 */) override { return 2; }
+  uint32_t serializedSizeI32(int32_t /* i32 */) override { return 4; }
+  uint32_t serializedSizeI64(int64_t /* i64 */) override { return 8; }
+  uint32_t serializedSizeDouble(double /* dub */) override { return 8; }
+  uint32_t serializedSizeString(uint32_t size) override { return 4 + size; }
+  uint32_t serializedSizeUUID() override { return 16; }
+
   void checkReadBytesAvailable(TSet& set) override
   {
       trans_->checkReadBytesAvailable(set.size_ * getMinSerializedSize(set.elemType_));
@@ -192,6 +260,26 @@ protected:
   template <typename StrType>
   uint32_t readStringBody(StrType& str, int32_t sz);
 
+  uint32_t writeCollectionBegin(const TType elemType, const uint32_t size);
+
+  uint32_t readBinaryViewBody(TBinaryView& view, int32_t sz);
+
+  // The size of type on the wire if it is fixed, otherwise 0
+  static uint32_t getFixedSize(TType type);
+
+  template <typename Wire_, typename T>
+  uint32_t readArray(T* values, uint32_t count);
+
+  template <typename Wire_, typename T>
+  uint32_t writeArray(const T* values, uint32_t count);
+
+  static uint16_t fromWire(uint16_t x) { return ByteOrder_::fromWire16(x); }
+  static uint32_t fromWire(uint32_t x) { return ByteOrder_::fromWire32(x); }
+  static uint64_t fromWire(uint64_t x) { return ByteOrder_::fromWire64(x); }
+  static uint16_t toWire(uint16_t x) { return ByteOrder_::toWire16(x); }
+  static uint32_t toWire(uint32_t x) { return ByteOrder_::toWire32(x); }
+  static uint64_t toWire(uint64_t x) { return ByteOrder_::toWire64(x); }
+
   Transport_* trans_;
 
   int32_t string_limit_;
@@ -200,6 +288,9 @@ protected:
   // Enforce presence of version identifier
   bool strict_read_;
   bool strict_write_;
+
+  // Made on first use by getProtocolFactory()
+  std::shared_ptr<TProtocolFactory> factory_;
 };
 
 typedef TBinaryProtocolT<TTransport> TBinaryProtocol;
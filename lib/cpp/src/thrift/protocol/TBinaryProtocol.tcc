@@ -23,6 +23,8 @@
 #include <thrift/protocol/TBinaryProtocol.h>
 #include <thrift/transport/TTransportException.h>
 
+#include <algorithm>
+#include <cstring>
 #include <limits>
 
 namespace apache {
@@ -70,10 +72,13 @@ uint32_t TBinaryProtocolT<Transport_, ByteOrder_>::writeFieldBegin(const char* n
                                                                    const TType fieldType,
                                                                    const int16_t fieldId) {
   (void)name;
-  uint32_t wsize = 0;
-  wsize += writeByte((int8_t)fieldType);
-  wsize += writeI16(fieldId);
-  return wsize;
+  uint8_t buf[3];
+  uint8_t* out = transport::reserveOr(*this->trans_, buf, sizeof(buf));
+  auto net = (int16_t)ByteOrder_::toWire16(fieldId);
+  out[0] = (uint8_t)fieldType;
+  std::memcpy(out + 1, &net, 2);
+  transport::commitOrWrite(*this->trans_, buf, out, 3);
+  return 3;
 }
 
 template <class Transport_, class ByteOrder_>
@@ -90,11 +95,14 @@ template <class Transport_, class ByteOrder_>
 uint32_t TBinaryProtocolT<Transport_, ByteOrder_>::writeMapBegin(const TType keyType,
                                                                  const TType valType,
                                                                  const uint32_t size) {
-  uint32_t wsize = 0;
-  wsize += writeByte((int8_t)keyType);
-  wsize += writeByte((int8_t)valType);
-  wsize += writeI32((int32_t)size);
-  return wsize;
+  uint8_t buf[6];
+  uint8_t* out = transport::reserveOr(*this->trans_, buf, sizeof(buf));
+  auto net = (int32_t)ByteOrder_::toWire32(size);
+  out[0] = (uint8_t)keyType;
+  out[1] = (uint8_t)valType;
+  std::memcpy(out + 2, &net, 4);
+  transport::commitOrWrite(*this->trans_, buf, out, 6);
+  return 6;
 }
 
 template <class Transport_, class ByteOrder_>
@@ -105,10 +113,7 @@ uint32_t TBinaryProtocolT<Transport_, ByteOrder_>::writeMapEnd() {
 template <class Transport_, class ByteOrder_>
 uint32_t TBinaryProtocolT<Transport_, ByteOrder_>::writeListBegin(const TType elemType,
                                                                   const uint32_t size) {
-  uint32_t wsize = 0;
-  wsize += writeByte((int8_t)elemType);
-  wsize += writeI32((int32_t)size);
-  return wsize;
+  return writeCollectionBegin(elemType, size);
 }
 
 template <class Transport_, class ByteOrder_>
@@ -119,10 +124,7 @@ uint32_t TBinaryProtocolT<Transport_, ByteOrder_>::writeListEnd() {
 template <class Transport_, class ByteOrder_>
 uint32_t TBinaryProtocolT<Transport_, ByteOrder_>::writeSetBegin(const TType elemType,
                                                                  const uint32_t size) {
-  uint32_t wsize = 0;
-  wsize += writeByte((int8_t)elemType);
-  wsize += writeI32((int32_t)size);
-  return wsize;
+  return writeCollectionBegin(elemType, size);
 }
 
 template <class Transport_, class ByteOrder_>
@@ -193,6 +195,11 @@ uint32_t TBinaryProtocolT<Transport_, ByteOrder_>::writeBinary(const std::string
   return TBinaryProtocolT<Transport_, ByteOrder_>::writeString(str);
 }
 
+template <class Transport_, class ByteOrder_>
+uint32_t TBinaryProtocolT<Transport_, ByteOrder_>::writeBinaryView(const TBinaryView& view) {
+  return TBinaryProtocolT<Transport_, ByteOrder_>::writeString(view);
+}
+
 template <class Transport_, class ByteOrder_>
 uint32_t TBinaryProtocolT<Transport_, ByteOrder_>::writeUUID(const TUuid& uuid) {
   // TODO: Consider endian swapping, see lib/delphi/src/Thrift.Utils.pas:377
@@ -435,12 +442,141 @@ uint32_t TBinaryProtocolT<Transport_, ByteOrder_>::readBinary(std::string& str)
   return TBinaryProtocolT<Transport_, ByteOrder_>::readString(str);
 }
 
+template <class Transport_, class ByteOrder_>
+uint32_t TBinaryProtocolT<Transport_, ByteOrder_>::readBinaryView(TBinaryView& view) {
+  int32_t size;
+  uint32_t result = readI32(size);
+  return result + readBinaryViewBody(view, size);
+}
+
 template <class Transport_, class ByteOrder_>
 uint32_t TBinaryProtocolT<Transport_, ByteOrder_>::readUUID(TUuid& uuid) {
   this->trans_->readAll(uuid.begin(), uuid.size());
   return 16;
 }
 
+template <class Transport_, class ByteOrder_>
+uint32_t TBinaryProtocolT<Transport_, ByteOrder_>::readI16s(int16_t* values, uint32_t count) {
+  return readArray<uint16_t>(values, count);
+}
+
+template <class Transport_, class ByteOrder_>
+uint32_t TBinaryProtocolT<Transport_, ByteOrder_>::readI32s(int32_t* values, uint32_t count) {
+  return readArray<uint32_t>(values, count);
+}
+
+template <class Transport_, class ByteOrder_>
+uint32_t TBinaryProtocolT<Transport_, ByteOrder_>::readI64s(int64_t* values, uint32_t count) {
+  return readArray<uint64_t>(values, count);
+}
+
+template <class Transport_, class ByteOrder_>
+uint32_t TBinaryProtocolT<Transport_, ByteOrder_>::readDoubles(double* values, uint32_t count) {
+  return readArray<uint64_t>(values, count);
+}
+
+template <class Transport_, class ByteOrder_>
+uint32_t TBinaryProtocolT<Transport_, ByteOrder_>::writeI16s(const int16_t* values, uint32_t count) {
+  return writeArray<uint16_t>(values, count);
+}
+
+template <class Transport_, class ByteOrder_>
+uint32_t TBinaryProtocolT<Transport_, ByteOrder_>::writeI32s(const int32_t* values, uint32_t count) {
+  return writeArray<uint32_t>(values, count);
+}
+
+template <class Transport_, class ByteOrder_>
+uint32_t TBinaryProtocolT<Transport_, ByteOrder_>::writeI64s(const int64_t* values, uint32_t count) {
+  return writeArray<uint64_t>(values, count);
+}
+
+template <class Transport_, class ByteOrder_>
+uint32_t TBinaryProtocolT<Transport_, ByteOrder_>::writeDoubles(const double* values, uint32_t count) {
+  return writeArray<uint64_t>(values, count);
+}
+
+/**
+ * List and set headers are the same on the wire.
+ */
+template <class Transport_, class ByteOrder_>
+uint32_t TBinaryProtocolT<Transport_, ByteOrder_>::writeCollectionBegin(const TType elemType,
+                                                                        const uint32_t size) {
+  uint8_t buf[5];
+  uint8_t* out = transport::reserveOr(*this->trans_, buf, sizeof(buf));
+  auto net = (int32_t)ByteOrder_::toWire32(size);
+  out[0] = (uint8_t)elemType;
+  std::memcpy(out + 1, &net, 4);
+  transport::commitOrWrite(*this->trans_, buf, out, 5);
+  return 5;
+}
+
+template <class Transport_, class ByteOrder_>
+template <typename Wire_, typename T>
+uint32_t TBinaryProtocolT<Transport_, ByteOrder_>::readArray(T* values, uint32_t count) {
+  static_assert(sizeof(Wire_) == sizeof(T), "sizeof(Wire_) == sizeof(T)");
+
+  // count comes off the wire, check it before it is scaled to bytes
+  if ((this->container_limit_ && count > static_cast<uint32_t>(this->container_limit_))
+      || count > (std::numeric_limits<uint32_t>::max)() / sizeof(T)) {
+    throw TProtocolException(TProtocolException::SIZE_LIMIT);
+  }
+  const auto size = static_cast<uint32_t>(count * sizeof(T));
+  if (size == 0) {
+    return 0;
+  }
+
+  // Swap straight out of the transport's buffer if it holds the whole array,
+  // otherwise read the wire bytes in place and swap them there.
+  uint32_t got = size;
+  const uint8_t* src = this->trans_->borrow(nullptr, &got);
+  auto* dst = reinterpret_cast<uint8_t*>(values);
+  if (src == nullptr) {
+    this->trans_->readAll(dst, size);
+    src = dst;
+  }
+
+  // memcpy keeps this free of alignment and aliasing problems, and compiles
+  // down to plain loads and stores that the optimizer can vectorize
+  for (uint32_t i = 0; i < size; i += sizeof(Wire_)) {
+    Wire_ wire;
+    std::memcpy(&wire, src + i, sizeof(Wire_));
+    wire = fromWire(wire);
+    std::memcpy(dst + i, &wire, sizeof(Wire_));
+  }
+
+  if (src != dst) {
+    this->trans_->consume(size);
+  }
+  return size;
+}
+
+template <class Transport_, class ByteOrder_>
+template <typename Wire_, typename T>
+uint32_t TBinaryProtocolT<Transport_, ByteOrder_>::writeArray(const T* values, uint32_t count) {
+  static_assert(sizeof(Wire_) == sizeof(T), "sizeof(Wire_) == sizeof(T)");
+
+  if (count > (std::numeric_limits<uint32_t>::max)() / sizeof(T)) {
+    throw TProtocolException(TProtocolException::SIZE_LIMIT);
+  }
+
+  uint8_t chunk[1024];
+  const auto* src = reinterpret_cast<const uint8_t*>(values);
+  const auto size = static_cast<uint32_t>(count * sizeof(T));
+  for (uint32_t done = 0; done < size;) {
+    const uint32_t len = (std::min)(size - done, static_cast<uint32_t>(sizeof(chunk)));
+    uint8_t* out = transport::reserveOr(*this->trans_, chunk, len);
+    for (uint32_t i = 0; i < len; i += sizeof(Wire_)) {
+      Wire_ wire;
+      std::memcpy(&wire, src + done + i, sizeof(Wire_));
+      wire = toWire(wire);
+      std::memcpy(out + i, &wire, sizeof(Wire_));
+    }
+    transport::commitOrWrite(*this->trans_, chunk, out, len);
+    done += len;
+  }
+  return size;
+}
+
 template <class Transport_, class ByteOrder_>
 template <typename StrType>
 uint32_t TBinaryProtocolT<Transport_, ByteOrder_>::readStringBody(StrType& str, int32_t size) {
@@ -474,6 +610,152 @@ uint32_t TBinaryProtocolT<Transport_, ByteOrder_>::readStringBody(StrType& str,
   return (uint32_t)size;
 }
 
+template <class Transport_, class ByteOrder_>
+uint32_t TBinaryProtocolT<Transport_, ByteOrder_>::readBinaryViewBody(TBinaryView& view,
+                                                                      int32_t size) {
+  // Catch error cases
+  if (size < 0) {
+    throw TProtocolException(TProtocolException::NEGATIVE_SIZE);
+  }
+  if (this->string_limit_ > 0 && size > this->string_limit_) {
+    throw TProtocolException(TProtocolException::SIZE_LIMIT);
+  }
+
+  // Catch empty string case
+  if (size == 0) {
+    view.clear();
+    return 0;
+  }
+
+  // Point into the transport's buffer if it lets us keep it
+  uint32_t got = size;
+  const uint8_t* borrow_buf = this->trans_->borrow(nullptr, &got);
+  if (borrow_buf) {
+    std::shared_ptr<const void> owner = this->trans_->shareReadBuffer();
+    if (owner) {
+      view = TBinaryView(std::move(owner), borrow_buf, size);
+    } else {
+      view.assign(std::string((const char*)borrow_buf, size));
+    }
+    this->trans_->consume(size);
+    return size;
+  }
+
+  std::string str;
+  readStringBody(str, size);
+  view.assign(std::move(str));
+  return (uint32_t)size;
+}
+
+template <class Transport_, class ByteOrder_>
+uint32_t TBinaryProtocolT<Transport_, ByteOrder_>::skip(TType type) {
+  TInputRecursionTracker tracker(*this);
+
+  uint32_t result = getFixedSize(type);
+  if (result > 0) {
+    transport::skipAll(*this->trans_, result);
+    return result;
+  }
+
+  switch (type) {
+  case T_STRING: {
+    int32_t size;
+    result += readI32(size);
+    if (size < 0) {
+      throw TProtocolException(TProtocolException::NEGATIVE_SIZE);
+    }
+    if (this->string_limit_ > 0 && size > this->string_limit_) {
+      throw TProtocolException(TProtocolException::SIZE_LIMIT);
+    }
+    transport::skipAll(*this->trans_, size);
+    return result + size;
+  }
+  case T_STRUCT: {
+    while (true) {
+      int8_t fieldType;
+      result += readByte(fieldType);
+      if (fieldType == T_STOP) {
+        return result;
+      }
+      // the field id
+      transport::skipAll(*this->trans_, 2);
+      result += 2 + skip((TType)fieldType);
+    }
+  }
+  case T_MAP: {
+    TType keyType;
+    TType valType;
+    uint32_t size;
+    result += readMapBegin(keyType, valType, size);
+    uint32_t keySize = getFixedSize(keyType);
+    uint32_t valSize = getFixedSize(valType);
+    if (keySize > 0 && valSize > 0) {
+      uint64_t bytes = (uint64_t)size * (keySize + valSize);
+      transport::skipAll(*this->trans_, bytes);
+      return result + (uint32_t)bytes;
+    }
+    for (uint32_t i = 0; i < size; i++) {
+      result += skip(keyType);
+      result += skip(valType);
+    }
+    return result;
+  }
+  case T_SET:
+  case T_LIST: {
+    TType elemType;
+    uint32_t size;
+    result += type == T_SET ? readSetBegin(elemType, size) : readListBegin(elemType, size);
+    uint32_t elemSize = getFixedSize(elemType);
+    if (elemSize > 0) {
+      uint64_t bytes = (uint64_t)size * elemSize;
+      transport::skipAll(*this->trans_, bytes);
+      return result + (uint32_t)bytes;
+    }
+    for (uint32_t i = 0; i < size; i++) {
+      result += skip(elemType);
+    }
+    return result;
+  }
+  default:
+    break;
+  }
+
+  throw TProtocolException(TProtocolException::INVALID_DATA, "invalid TType");
+}
+
+template <class Transport_, class ByteOrder_>
+uint32_t TBinaryProtocolT<Transport_, ByteOrder_>::getFixedSize(TType type) {
+  switch (type) {
+  case T_BOOL:
+  case T_BYTE:
+    return 1;
+  case T_I16:
+    return 2;
+  case T_I32:
+    return 4;
+  case T_I64:
+  case T_DOUBLE:
+    return 8;
+  case T_UUID:
+    return 16;
+  default:
+    return 0;
+  }
+}
+
+// The factory makes protocols on plain TTransports, so that it is of the
+// same type for every transport this protocol is instantiated with
+template <class Transport_, class ByteOrder_>
+std::shared_ptr<TProtocolFactory> TBinaryProtocolT<Transport_, ByteOrder_>::getProtocolFactory() {
+  if (!factory_) {
+    factory_ = std::make_shared<TBinaryProtocolFactoryT<TTransport, ByteOrder_> >(string_limit_,
+                                                                                 container_limit_,
+                                                                                 strict_read_,
+                                                                                 strict_write_);
+  }
+  return factory_;
+}
+
 // Return the minimum number of bytes a type will consume on the wire
 template <class Transport_, class ByteOrder_>
 int TBinaryProtocolT<Transport_, ByteOrder_>::getMinSerializedSize(TType type)
@@ -136,12 +136,43 @@ public:
 
   uint32_t writeDouble(const double dub);
 
+  uint32_t writeI16s(const int16_t* values, uint32_t count);
+
+  uint32_t writeI32s(const int32_t* values, uint32_t count);
+
+  uint32_t writeI64s(const int64_t* values, uint32_t count);
+
   uint32_t writeString(const std::string& str);
 
   uint32_t writeBinary(const std::string& str);
 
+  uint32_t writeBinaryView(const TBinaryView& view);
+
   int getMinSerializedSize(TType type) override;
 
+  std::shared_ptr<TProtocolFactory> getProtocolFactory() override;
+
+  /**
+   * Serialized sizes.  Field headers are sized as if their ids were written
+   * in full, and bool fields as if their values were not in the header, so
+   * a struct's size is an upper bound.  Everything else is exact.
+   */
+  bool hasSerializedSizes() override { return true; }
+  uint32_t serializedSizeFixed(TType type) override { return getFixedSize(type); }
+  uint32_t serializedSizeFieldBegin(TType fieldType, int16_t fieldId) override;
+  uint32_t serializedSizeFieldStop() override { return 1; }
+  uint32_t serializedSizeMapBegin(TType keyType, TType valType, uint32_t size) override;
+  uint32_t serializedSizeListBegin(TType elemType, uint32_t size) override;
+  uint32_t serializedSizeSetBegin(TType elemType, uint32_t size) override;
+  uint32_t serializedSizeBool(bool /* value */) override { return 1; }
+  uint32_t serializedSizeByte(int8_t /* byte */) override { return 1; }
+  uint32_t serializedSizeI16(int16_t i16) override;
+  uint32_t serializedSizeI32(int32_t i32) override;
+  uint32_t serializedSizeI64(int64_t i64) override;
+  uint32_t serializedSizeDouble(double /* dub */) override { return 8; }
+  uint32_t serializedSizeString(uint32_t size) override;
+  uint32_t serializedSizeUUID() override { return 16; }
+
   void checkReadBytesAvailable(TSet& set) override
   {
       trans_->checkReadBytesAvailable(set.size_ * getMinSerializedSize(set.elemType_));
@@ -176,8 +207,14 @@ protected:
   uint32_t writeCollectionBegin(const TType elemType, int32_t size);
   uint32_t writeVarint32(uint32_t n);
   uint32_t writeVarint64(uint64_t n);
+  static uint32_t varintSize(uint64_t n);
   uint64_t i64ToZigzag(const int64_t l);
   uint32_t i32ToZigzag(const int32_t n);
+  uint64_t toZigzag(const int16_t n) { return i32ToZigzag(n); }
+  uint64_t toZigzag(const int32_t n) { return i32ToZigzag(n); }
+  uint64_t toZigzag(const int64_t n) { return i64ToZigzag(n); }
+  template <typename T>
+  uint32_t writeVarints(const T* values, uint32_t count);
   inline int8_t getCompactType(const TType ttype);
 
 public:
@@ -209,10 +246,26 @@ public:
 
   uint32_t readDouble(double& dub);
 
+  uint32_t readI16s(int16_t* values, uint32_t count);
+
+  uint32_t readI32s(int32_t* values, uint32_t count);
+
+  uint32_t readI64s(int64_t* values, uint32_t count);
+
   uint32_t readString(std::string& str);
 
   uint32_t readBinary(std::string& str);
 
+  uint32_t readBinaryView(TBinaryView& view);
+
+  /**
+   * Skips a value using its length prefixes and the sizes of fixed width
+   * types, so nothing is decoded or allocated.  Varints are only scanned for
+   * their last byte, and containers of fixed width elements are passed over
+   * in one step.
+   */
+  uint32_t skip(TType type);
+
   /*
    *These methods are here for the struct to call, but don't have any wire
    * encoding.
@@ -228,7 +281,16 @@ protected:
   uint32_t readVarint64(int64_t& i64);
   int32_t zigzagToI32(uint32_t n);
   int64_t zigzagToI64(uint64_t n);
+  void fromZigzag(uint64_t n, int16_t& i16) { i16 = (int16_t)zigzagToI32((uint32_t)n); }
+  void fromZigzag(uint64_t n, int32_t& i32) { i32 = zigzagToI32((uint32_t)n); }
+  void fromZigzag(uint64_t n, int64_t& i64) { i64 = zigzagToI64(n); }
+  template <typename T>
+  uint32_t readVarints(T* values, uint32_t count);
   TType getTType(int8_t type);
+  uint32_t skipVarints(uint32_t count);
+  // The size of type as a container element if it is fixed, otherwise 0
+  static uint32_t getFixedSize(TType type);
+  static bool isVarint(TType type) { return type == T_I16 || type == T_I32 || type == T_I64; }
 
   // Buffer for reading strings, save for the lifetime of the protocol to
   // avoid memory churn allocating memory on every string read
@@ -236,6 +298,9 @@ protected:
   uint8_t* string_buf_;
   int32_t string_buf_size_;
   int32_t container_limit_;
+
+  // Made on first use by getProtocolFactory()
+  std::shared_ptr<TProtocolFactory> factory_;
 };
 
 typedef TCompactProtocolT<TTransport> TCompactProtocol;
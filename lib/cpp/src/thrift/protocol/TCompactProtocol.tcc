@@ -21,6 +21,11 @@
 
 #include <limits>
 #include <cstdlib>
+#include <cstring>
+
+#if defined(__BMI2__)
+#include <immintrin.h>
+#endif
 
 #include "thrift/config.h"
 
@@ -83,6 +88,102 @@ const int8_t TTypeToCType[16] = {
   CT_LIST, // T_LIST
 };
 
+/*
+ * Word at a time varint coding for the bulk list calls.  A varint of up to
+ * eight bytes is moved with a single 64 bit load or store, its 7 bit groups
+ * being gathered or scattered with BMI2 pext/pdep where the compiler targets
+ * them and with shifts and masks otherwise.  Longer varints, only seen for
+ * i64 values of 2^56 and up, are handled a byte at a time.
+ */
+
+inline int countLeadingZeros(uint64_t x) {
+#if defined(__GNUC__)
+  return __builtin_clzll(x);
+#else
+  int n = 0;
+  for (uint64_t bit = 1ULL << 63; !(x & bit); bit >>= 1) {
+    n++;
+  }
+  return n;
+#endif
+}
+
+inline int countTrailingZeros(uint64_t x) {
+#if defined(__GNUC__)
+  return __builtin_ctzll(x);
+#else
+  int n = 0;
+  for (uint64_t bit = 1; !(x & bit); bit <<= 1) {
+    n++;
+  }
+  return n;
+#endif
+}
+
+/**
+ * Decodes the varint at the start of the eight readable bytes at buf.
+ * Returns its length, or 0 if it is longer than eight bytes.
+ */
+inline uint32_t decodeVarint(const uint8_t* buf, uint64_t& value) {
+  uint64_t word;
+  std::memcpy(&word, buf, sizeof(word));
+  word = THRIFT_letohll(word);
+
+  const uint64_t stops = ~word & 0x8080808080808080ULL;
+  if (stops == 0) {
+    return 0;
+  }
+  const uint32_t len = (countTrailingZeros(stops) >> 3) + 1;
+  if (len < 8) {
+    word &= (1ULL << (len * 8)) - 1;
+  }
+
+#if defined(__BMI2__)
+  value = _pext_u64(word, 0x7f7f7f7f7f7f7f7fULL);
+#else
+  word &= 0x7f7f7f7f7f7f7f7fULL;
+  word = ((word & 0x7f007f007f007f00ULL) >> 1) | (word & 0x007f007f007f007fULL);
+  word = ((word & 0x3fff00003fff0000ULL) >> 2) | (word & 0x00003fff00003fffULL);
+  word = ((word & 0x0fffffff00000000ULL) >> 4) | (word & 0x000000000fffffffULL);
+  value = word;
+#endif
+  return len;
+}
+
+/**
+ * Encodes value as a varint into the ten writable bytes at buf.
+ * Returns its length.
+ */
+inline uint32_t encodeVarint(uint64_t value, uint8_t* buf) {
+  if (value < 0x80) {
+    buf[0] = static_cast<uint8_t>(value);
+    return 1;
+  }
+
+  if (value >> 56) {
+    uint32_t len = 0;
+    while (value >= 0x80) {
+      buf[len++] = static_cast<uint8_t>((value & 0x7f) | 0x80);
+      value >>= 7;
+    }
+    buf[len++] = static_cast<uint8_t>(value);
+    return len;
+  }
+
+  const uint32_t len = (64 - countLeadingZeros(value) + 6) / 7;
+#if defined(__BMI2__)
+  uint64_t word = _pdep_u64(value, 0x7f7f7f7f7f7f7f7fULL);
+#else
+  uint64_t word = ((value & 0x00fffffff0000000ULL) << 4) | (value & 0x000000000fffffffULL);
+  word = ((word & 0x0fffc0000fffc000ULL) << 2) | (word & 0x00003fff00003fffULL);
+  word = ((word & 0x3f803f803f803f80ULL) << 1) | (word & 0x007f007f007f007fULL);
+#endif
+  word |= 0x8080808080808080ULL & ((1ULL << ((len - 1) * 8)) - 1);
+  word = THRIFT_htolell(word);
+  std::memcpy(buf, &word, sizeof(word));
+  return len;
+}
+
 }} // end detail::compact namespace
 
 
@@ -178,14 +279,17 @@ template <class Transport_>
 uint32_t TCompactProtocolT<Transport_>::writeMapBegin(const TType keyType,
                                                       const TType valType,
                                                       const uint32_t size) {
+  uint8_t buf[11];
+  uint8_t* out = transport::reserveOr(*trans_, buf, sizeof(buf));
   uint32_t wsize = 0;
 
   if (size == 0) {
-    wsize += writeByte(0);
+    out[wsize++] = 0;
   } else {
-    wsize += writeVarint32(size);
-    wsize += writeByte(getCompactType(keyType) << 4 | getCompactType(valType));
+    wsize += detail::compact::encodeVarint(size, out);
+    out[wsize++] = static_cast<uint8_t>(getCompactType(keyType) << 4 | getCompactType(valType));
   }
+  transport::commitOrWrite(*trans_, buf, out, wsize);
   return wsize;
 }
 
@@ -286,6 +390,17 @@ uint32_t TCompactProtocolT<Transport_>::writeBinary(const std::string& str) {
   return wsize;
 }
 
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::writeBinaryView(const TBinaryView& view) {
+  auto ssize = static_cast<uint32_t>(view.size());
+  uint32_t wsize = writeVarint32(ssize);
+  if(ssize > (std::numeric_limits<uint32_t>::max)() - wsize)
+    throw TProtocolException(TProtocolException::SIZE_LIMIT);
+  wsize += ssize;
+  trans_->write(view.data(), ssize);
+  return wsize;
+}
+
 //
 // Internal Writing methods
 //
@@ -307,16 +422,19 @@ int32_t TCompactProtocolT<Transport_>::writeFieldBeginInternal(
   // if there's a type override, use that.
   int8_t typeToWrite = (typeOverride == -1 ? getCompactType(fieldType) : typeOverride);
 
+  uint8_t buf[11];
+  uint8_t* out = transport::reserveOr(*trans_, buf, sizeof(buf));
+
   // check if we can use delta encoding for the field id
   if (fieldId > lastFieldId_ && fieldId - lastFieldId_ <= 15) {
     // write them together
-    wsize += writeByte(static_cast<int8_t>((fieldId - lastFieldId_)
-                                           << 4 | typeToWrite));
+    out[wsize++] = static_cast<uint8_t>((fieldId - lastFieldId_) << 4 | typeToWrite);
   } else {
     // write them separate
-    wsize += writeByte(typeToWrite);
-    wsize += writeI16(fieldId);
+    out[wsize++] = static_cast<uint8_t>(typeToWrite);
+    wsize += detail::compact::encodeVarint(i32ToZigzag(fieldId), out + wsize);
   }
+  transport::commitOrWrite(*trans_, buf, out, wsize);
 
   lastFieldId_ = fieldId;
   return wsize;
@@ -329,14 +447,16 @@ int32_t TCompactProtocolT<Transport_>::writeFieldBeginInternal(
 template <class Transport_>
 uint32_t TCompactProtocolT<Transport_>::writeCollectionBegin(const TType elemType,
                                                              int32_t size) {
+  uint8_t buf[11];
+  uint8_t* out = transport::reserveOr(*trans_, buf, sizeof(buf));
   uint32_t wsize = 0;
   if (size <= 14) {
-    wsize += writeByte(static_cast<int8_t>(size
-                                           << 4 | getCompactType(elemType)));
+    out[wsize++] = static_cast<uint8_t>(size << 4 | getCompactType(elemType));
   } else {
-    wsize += writeByte(0xf0 | getCompactType(elemType));
-    wsize += writeVarint32(size);
+    out[wsize++] = static_cast<uint8_t>(0xf0 | getCompactType(elemType));
+    wsize += detail::compact::encodeVarint(static_cast<uint32_t>(size), out + wsize);
   }
+  transport::commitOrWrite(*trans_, buf, out, wsize);
   return wsize;
 }
 
@@ -345,19 +465,10 @@ uint32_t TCompactProtocolT<Transport_>::writeCollectionBegin(const TType elemTyp
  */
 template <class Transport_>
 uint32_t TCompactProtocolT<Transport_>::writeVarint32(uint32_t n) {
-  uint8_t buf[5];
-  uint32_t wsize = 0;
-
-  while (true) {
-    if ((n & ~0x7F) == 0) {
-      buf[wsize++] = (int8_t)n;
-      break;
-    } else {
-      buf[wsize++] = (int8_t)((n & 0x7F) | 0x80);
-      n >>= 7;
-    }
-  }
-  trans_->write(buf, wsize);
+  uint8_t buf[10];
+  uint8_t* out = transport::reserveOr(*trans_, buf, sizeof(buf));
+  uint32_t wsize = detail::compact::encodeVarint(n, out);
+  transport::commitOrWrite(*trans_, buf, out, wsize);
   return wsize;
 }
 
@@ -367,18 +478,47 @@ uint32_t TCompactProtocolT<Transport_>::writeVarint32(uint32_t n) {
 template <class Transport_>
 uint32_t TCompactProtocolT<Transport_>::writeVarint64(uint64_t n) {
   uint8_t buf[10];
+  uint8_t* out = transport::reserveOr(*trans_, buf, sizeof(buf));
+  uint32_t wsize = detail::compact::encodeVarint(n, out);
+  transport::commitOrWrite(*trans_, buf, out, wsize);
+  return wsize;
+}
+
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::writeI16s(const int16_t* values, uint32_t count) {
+  return writeVarints(values, count);
+}
+
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::writeI32s(const int32_t* values, uint32_t count) {
+  return writeVarints(values, count);
+}
+
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::writeI64s(const int64_t* values, uint32_t count) {
+  return writeVarints(values, count);
+}
+
+/**
+ * Write count zigzag varints, encoding them straight into the transport's
+ * write buffer, or into a local chunk when it cannot reserve one, a chunk's
+ * worth at a time.
+ */
+template <class Transport_>
+template <typename T>
+uint32_t TCompactProtocolT<Transport_>::writeVarints(const T* values, uint32_t count) {
+  uint8_t chunk[1024];
   uint32_t wsize = 0;
 
-  while (true) {
-    if ((n & ~0x7FL) == 0) {
-      buf[wsize++] = (int8_t)n;
-      break;
-    } else {
-      buf[wsize++] = (int8_t)((n & 0x7F) | 0x80);
-      n >>= 7;
+  for (uint32_t i = 0; i < count;) {
+    uint8_t* out = transport::reserveOr(*trans_, chunk, sizeof(chunk));
+    uint32_t used = 0;
+    for (; i < count && sizeof(chunk) - used >= 10; ++i) {
+      used += detail::compact::encodeVarint(toZigzag(values[i]), out + used);
     }
+    transport::commitOrWrite(*trans_, chunk, out, used);
+    wsize += used;
   }
-  trans_->write(buf, wsize);
   return wsize;
 }
 
@@ -673,6 +813,60 @@ uint32_t TCompactProtocolT<Transport_>::readDouble(double& dub) {
   return 8;
 }
 
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::readI16s(int16_t* values, uint32_t count) {
+  return readVarints(values, count);
+}
+
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::readI32s(int32_t* values, uint32_t count) {
+  return readVarints(values, count);
+}
+
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::readI64s(int64_t* values, uint32_t count) {
+  return readVarints(values, count);
+}
+
+/**
+ * Read count zigzag varints.  They are decoded straight out of the
+ * transport's buffer for as long as a whole word is left to load from it;
+ * the rest, and any varint over eight bytes, go through readVarint64().
+ */
+template <class Transport_>
+template <typename T>
+uint32_t TCompactProtocolT<Transport_>::readVarints(T* values, uint32_t count) {
+  uint32_t rsize = 0;
+  uint32_t i = 0;
+
+  while (i < count) {
+    uint32_t avail = 1;
+    const uint8_t* buf = trans_->borrow(nullptr, &avail);
+    if (buf != nullptr) {
+      uint32_t used = 0;
+      while (i < count && avail - used >= 8) {
+        uint64_t value;
+        uint32_t len = detail::compact::decodeVarint(buf + used, value);
+        if (len == 0) {
+          break;
+        }
+        fromZigzag(value, values[i++]);
+        used += len;
+      }
+      trans_->consume(used);
+      rsize += used;
+      if (i == count) {
+        break;
+      }
+    }
+
+    int64_t value;
+    rsize += readVarint64(value);
+    fromZigzag(static_cast<uint64_t>(value), values[i++]);
+  }
+  return rsize;
+}
+
 template <class Transport_>
 uint32_t TCompactProtocolT<Transport_>::readString(std::string& str) {
   return readBinary(str);
@@ -718,6 +912,204 @@ uint32_t TCompactProtocolT<Transport_>::readBinary(std::string& str) {
   return rsize + (uint32_t)size;
 }
 
+/**
+ * Read a binary value as a view into the transport's buffer if it can be
+ * borrowed from and shared, or as a copy otherwise.
+ */
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::readBinaryView(TBinaryView& view) {
+  int32_t rsize = 0;
+  int32_t size;
+
+  rsize += readVarint32(size);
+  // Catch empty string case
+  if (size == 0) {
+    view.clear();
+    return rsize;
+  }
+
+  // Catch error cases
+  if (size < 0) {
+    throw TProtocolException(TProtocolException::NEGATIVE_SIZE);
+  }
+  if (string_limit_ > 0 && size > string_limit_) {
+    throw TProtocolException(TProtocolException::SIZE_LIMIT);
+  }
+
+  uint32_t got = size;
+  const uint8_t* borrowed = trans_->borrow(nullptr, &got);
+  if (borrowed) {
+    std::shared_ptr<const void> owner = trans_->shareReadBuffer();
+    if (owner) {
+      view = TBinaryView(std::move(owner), borrowed, size);
+    } else {
+      view.assign(std::string((const char*)borrowed, size));
+    }
+    trans_->consume(size);
+    return rsize + (uint32_t)size;
+  }
+
+  std::string str(size, '\0');
+  trans_->readAll(reinterpret_cast<uint8_t*>(&str[0]), size);
+  view.assign(std::move(str));
+
+  trans_->checkReadBytesAvailable(rsize + (uint32_t)size);
+
+  return rsize + (uint32_t)size;
+}
+
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::skip(TType type) {
+  TInputRecursionTracker tracker(*this);
+
+  // A bool field's value was in its header
+  if (type == T_BOOL && boolValue_.hasBoolValue) {
+    boolValue_.hasBoolValue = false;
+    return 0;
+  }
+
+  uint32_t rsize = getFixedSize(type);
+  if (rsize > 0) {
+    transport::skipAll(*trans_, rsize);
+    return rsize;
+  }
+  if (isVarint(type)) {
+    return skipVarints(1);
+  }
+
+  switch (type) {
+  case T_STRING: {
+    int32_t size;
+    rsize += readVarint32(size);
+    if (size < 0) {
+      throw TProtocolException(TProtocolException::NEGATIVE_SIZE);
+    }
+    if (string_limit_ > 0 && size > string_limit_) {
+      throw TProtocolException(TProtocolException::SIZE_LIMIT);
+    }
+    trans_->checkReadBytesAvailable(rsize + (uint32_t)size);
+    transport::skipAll(*trans_, size);
+    return rsize + (uint32_t)size;
+  }
+  case T_STRUCT: {
+    while (true) {
+      int8_t byte;
+      rsize += readByte(byte);
+      int8_t fieldType = (byte & 0x0f);
+      if (fieldType == T_STOP) {
+        return rsize;
+      }
+      // no delta means the field id follows
+      if (((uint8_t)byte & 0xf0) == 0) {
+        rsize += skipVarints(1);
+      }
+      if (fieldType != detail::compact::CT_BOOLEAN_TRUE &&
+          fieldType != detail::compact::CT_BOOLEAN_FALSE) {
+        rsize += skip(getTType(fieldType));
+      }
+    }
+  }
+  case T_MAP: {
+    TType keyType;
+    TType valType;
+    uint32_t size;
+    rsize += readMapBegin(keyType, valType, size);
+    uint32_t keySize = getFixedSize(keyType);
+    uint32_t valSize = getFixedSize(valType);
+    if (keySize > 0 && valSize > 0) {
+      uint64_t bytes = (uint64_t)size * (keySize + valSize);
+      transport::skipAll(*trans_, bytes);
+      return rsize + (uint32_t)bytes;
+    }
+    if (isVarint(keyType) && isVarint(valType)) {
+      return rsize + skipVarints(2 * size);
+    }
+    for (uint32_t i = 0; i < size; i++) {
+      rsize += skip(keyType);
+      rsize += skip(valType);
+    }
+    return rsize;
+  }
+  case T_SET:
+  case T_LIST: {
+    TType elemType;
+    uint32_t size;
+    rsize += readListBegin(elemType, size);
+    uint32_t elemSize = getFixedSize(elemType);
+    if (elemSize > 0) {
+      uint64_t bytes = (uint64_t)size * elemSize;
+      transport::skipAll(*trans_, bytes);
+      return rsize + (uint32_t)bytes;
+    }
+    if (isVarint(elemType)) {
+      return rsize + skipVarints(size);
+    }
+    for (uint32_t i = 0; i < size; i++) {
+      rsize += skip(elemType);
+    }
+    return rsize;
+  }
+  default:
+    break;
+  }
+
+  throw TProtocolException(TProtocolException::INVALID_DATA, "invalid TType");
+}
+
+/**
+ * Skip count varints.  Only the last byte of each has its MSB clear, so they
+ * are counted straight out of the transport's buffer.  A varint that runs
+ * past the end of what can be borrowed goes through readVarint64().
+ */
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::skipVarints(uint32_t count) {
+  uint32_t rsize = 0;
+
+  while (count > 0) {
+    uint32_t avail = 1;
+    const uint8_t* buf = trans_->borrow(nullptr, &avail);
+    if (buf != nullptr) {
+      uint32_t used = 0;
+      uint32_t end = 0;
+      while (count > 0 && used < avail) {
+        if (buf[used++] & 0x80) {
+          if (UNLIKELY(used - end == 10)) {
+            throw TProtocolException(TProtocolException::INVALID_DATA, "Variable-length int over 10 bytes.");
+          }
+        } else {
+          end = used;
+          count--;
+        }
+      }
+      trans_->consume(end);
+      rsize += end;
+      if (count == 0) {
+        break;
+      }
+    }
+
+    int64_t value;
+    rsize += readVarint64(value);
+    count--;
+  }
+  return rsize;
+}
+
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::getFixedSize(TType type) {
+  switch (type) {
+  case T_BOOL:
+  case T_BYTE:
+    return 1;
+  case T_DOUBLE:
+    return 8;
+  case T_UUID:
+    return 16;
+  default:
+    return 0;
+  }
+}
+
 /**
  * Read an i32 from the wire as a varint. The MSB of each byte is set
  * if there is another byte to follow. This can read up to 5 bytes.
@@ -830,6 +1222,79 @@ TType TCompactProtocolT<Transport_>::getTType(int8_t type) {
   }
 }
 
+// The factory makes protocols on plain TTransports, so that it is of the
+// same type for every transport this protocol is instantiated with
+template <class Transport_>
+std::shared_ptr<TProtocolFactory> TCompactProtocolT<Transport_>::getProtocolFactory() {
+  if (!factory_) {
+    factory_ = std::make_shared<TCompactProtocolFactoryT<TTransport> >(string_limit_,
+                                                                      container_limit_);
+  }
+  return factory_;
+}
+
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::serializedSizeFieldBegin(TType fieldType,
+                                                                 int16_t fieldId) {
+  (void)fieldType;
+  return 1 + varintSize(i32ToZigzag(fieldId));
+}
+
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::serializedSizeMapBegin(TType keyType,
+                                                               TType valType,
+                                                               uint32_t size) {
+  (void)keyType;
+  (void)valType;
+  return size == 0 ? 1 : varintSize(size) + 1;
+}
+
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::serializedSizeListBegin(TType elemType,
+                                                                uint32_t size) {
+  (void)elemType;
+  return size < 15 ? 1 : 1 + varintSize(size);
+}
+
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::serializedSizeSetBegin(TType elemType,
+                                                               uint32_t size) {
+  return serializedSizeListBegin(elemType, size);
+}
+
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::serializedSizeI16(int16_t i16) {
+  return varintSize(i32ToZigzag(i16));
+}
+
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::serializedSizeI32(int32_t i32) {
+  return varintSize(i32ToZigzag(i32));
+}
+
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::serializedSizeI64(int64_t i64) {
+  return varintSize(i64ToZigzag(i64));
+}
+
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::serializedSizeString(uint32_t size) {
+  return varintSize(size) + size;
+}
+
+/**
+ * The number of bytes n takes as a varint, seven bits to a byte.
+ */
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::varintSize(uint64_t n) {
+  uint32_t size = 1;
+  while (n >= 0x80) {
+    n >>= 7;
+    size++;
+  }
+  return size;
+}
+
 // Return the minimum number of bytes a type will consume on the wire
 template <class Transport_>
 int TCompactProtocolT<Transport_>::getMinSerializedSize(TType type)
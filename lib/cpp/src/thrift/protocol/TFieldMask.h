@@ -0,0 +1,124 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _THRIFT_PROTOCOL_TFIELDMASK_H_
+#define _THRIFT_PROTOCOL_TFIELDMASK_H_ 1
+
+#include <thrift/Thrift.h>
+
+#include <algorithm>
+#include <initializer_list>
+#include <memory>
+#include <vector>
+
+namespace apache {
+namespace thrift {
+namespace protocol {
+
+/**
+ * The set of field ids that a generated readPartial() decodes.  All other
+ * fields are skipped.
+ *
+ * A struct valued field may be given a mask of its own, in which case only
+ * those of its fields are decoded in turn.  Otherwise the whole value is.
+ *
+ *   TFieldMask mask{1, 2};
+ *   mask.add(5, TFieldMask{3});
+ *   request.readPartial(iprot, mask);
+ */
+class TFieldMask {
+public:
+  TFieldMask() : bits_(0) {}
+
+  TFieldMask(std::initializer_list<int16_t> ids) : bits_(0) {
+    for (int16_t id : ids) {
+      add(id);
+    }
+  }
+
+  /**
+   * Decode field id as a whole.
+   */
+  TFieldMask& add(int16_t id) {
+    entry(id).nested.reset();
+    return *this;
+  }
+
+  /**
+   * Decode only the fields in nested of the struct in field id.
+   */
+  TFieldMask& add(int16_t id, const TFieldMask& nested) {
+    entry(id).nested = std::make_shared<TFieldMask>(nested);
+    return *this;
+  }
+
+  bool contains(int16_t id) const {
+    if (id > 0 && id <= 64) {
+      return (bits_ >> (id - 1)) & 1;
+    }
+    return find(id) != entries_.end();
+  }
+
+  /**
+   * Returns the mask for the fields of field id, or nullptr if the field is
+   * to be decoded as a whole or is not in this mask at all.
+   */
+  const TFieldMask* nested(int16_t id) const {
+    auto it = find(id);
+    return it != entries_.end() ? it->nested.get() : nullptr;
+  }
+
+  bool empty() const { return entries_.empty(); }
+
+private:
+  struct Entry {
+    int16_t id;
+    std::shared_ptr<const TFieldMask> nested;
+  };
+
+  std::vector<Entry>::const_iterator find(int16_t id) const {
+    auto it = std::lower_bound(entries_.begin(), entries_.end(), id, less);
+    return it != entries_.end() && it->id == id ? it : entries_.end();
+  }
+
+  Entry& entry(int16_t id) {
+    if (id > 0 && id <= 64) {
+      bits_ |= uint64_t(1) << (id - 1);
+    }
+    auto it = std::lower_bound(entries_.begin(), entries_.end(), id, less);
+    if (it == entries_.end() || it->id != id) {
+      Entry added = {id, nullptr};
+      it = entries_.insert(it, added);
+    }
+    return *it;
+  }
+
+  static bool less(const Entry& entry, int16_t id) { return entry.id < id; }
+
+  // Field ids 1 to 64, which most are, for a quick contains()
+  uint64_t bits_;
+  // All field ids in order, with their nested masks
+  std::vector<Entry> entries_;
+};
+
+}
+}
+} // apache::thrift::protocol
+
+#endif // #define _THRIFT_PROTOCOL_TFIELDMASK_H_ 1
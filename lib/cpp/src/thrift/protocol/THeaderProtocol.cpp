@@ -246,6 +246,46 @@ uint32_t THeaderProtocol::readString(std::string& str) {
 uint32_t THeaderProtocol::readBinary(std::string& binary) {
   return proto_->readBinary(binary);
 }
+
+uint32_t THeaderProtocol::readI16s(int16_t* values, uint32_t count) {
+  return proto_->readI16s(values, count);
+}
+
+uint32_t THeaderProtocol::readI32s(int32_t* values, uint32_t count) {
+  return proto_->readI32s(values, count);
+}
+
+uint32_t THeaderProtocol::readI64s(int64_t* values, uint32_t count) {
+  return proto_->readI64s(values, count);
+}
+
+uint32_t THeaderProtocol::readDoubles(double* values, uint32_t count) {
+  return proto_->readDoubles(values, count);
+}
+
+uint32_t THeaderProtocol::writeI16s(const int16_t* values, uint32_t count) {
+  return proto_->writeI16s(values, count);
+}
+
+uint32_t THeaderProtocol::writeI32s(const int32_t* values, uint32_t count) {
+  return proto_->writeI32s(values, count);
+}
+
+uint32_t THeaderProtocol::writeI64s(const int64_t* values, uint32_t count) {
+  return proto_->writeI64s(values, count);
+}
+
+uint32_t THeaderProtocol::writeDoubles(const double* values, uint32_t count) {
+  return proto_->writeDoubles(values, count);
+}
+
+uint32_t THeaderProtocol::readBinaryView(TBinaryView& view) {
+  return proto_->readBinaryView(view);
+}
+
+uint32_t THeaderProtocol::writeBinaryView(const TBinaryView& view) {
+  return proto_->writeBinaryView(view);
+}
 }
 }
 } // apache::thrift::protocol
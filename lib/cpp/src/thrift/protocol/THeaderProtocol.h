@@ -181,6 +181,72 @@ public:
 
   uint32_t readBinary(std::string& binary);
 
+  uint32_t readI16s(int16_t* values, uint32_t count);
+
+  uint32_t readI32s(int32_t* values, uint32_t count);
+
+  uint32_t readI64s(int64_t* values, uint32_t count);
+
+  uint32_t readDoubles(double* values, uint32_t count);
+
+  uint32_t writeI16s(const int16_t* values, uint32_t count);
+
+  uint32_t writeI32s(const int32_t* values, uint32_t count);
+
+  uint32_t writeI64s(const int64_t* values, uint32_t count);
+
+  uint32_t writeDoubles(const double* values, uint32_t count);
+
+  uint32_t readBinaryView(TBinaryView& view);
+
+  uint32_t writeBinaryView(const TBinaryView& view);
+
+  std::shared_ptr<TProtocolFactory> getProtocolFactory() override {
+    return proto_->getProtocolFactory();
+  }
+
+  bool hasSerializedSizes() override { return proto_->hasSerializedSizes(); }
+  uint32_t serializedSizeFixed(TType type) override { return proto_->serializedSizeFixed(type); }
+  uint32_t serializedSizeFieldBegin(TType fieldType, int16_t fieldId) override {
+    return proto_->serializedSizeFieldBegin(fieldType, fieldId);
+  }
+  uint32_t serializedSizeFieldStop() override {
+    return proto_->serializedSizeFieldStop();
+  }
+  uint32_t serializedSizeMapBegin(TType keyType, TType valType, uint32_t size) override {
+    return proto_->serializedSizeMapBegin(keyType, valType, size);
+  }
+  uint32_t serializedSizeListBegin(TType elemType, uint32_t size) override {
+    return proto_->serializedSizeListBegin(elemType, size);
+  }
+  uint32_t serializedSizeSetBegin(TType elemType, uint32_t size) override {
+    return proto_->serializedSizeSetBegin(elemType, size);
+  }
+  uint32_t serializedSizeBool(bool value) override {
+    return proto_->serializedSizeBool(value);
+  }
+  uint32_t serializedSizeByte(int8_t byte) override {
+    return proto_->serializedSizeByte(byte);
+  }
+  uint32_t serializedSizeI16(int16_t i16) override {
+    return proto_->serializedSizeI16(i16);
+  }
+  uint32_t serializedSizeI32(int32_t i32) override {
+    return proto_->serializedSizeI32(i32);
+  }
+  uint32_t serializedSizeI64(int64_t i64) override {
+    return proto_->serializedSizeI64(i64);
+  }
+  uint32_t serializedSizeDouble(double dub) override {
+    return proto_->serializedSizeDouble(dub);
+  }
+  uint32_t serializedSizeString(uint32_t size) override {
+    return proto_->serializedSizeString(size);
+  }
+  uint32_t serializedSizeUUID() override {
+    return proto_->serializedSizeUUID();
+  }
+
 protected:
   std::shared_ptr<THeaderTransport> trans_;
 
@@ -193,15 +259,34 @@ public:
   std::shared_ptr<TProtocol> getProtocol(std::shared_ptr<transport::TTransport> trans) override {
     auto* headerProtocol
         = new THeaderProtocol(trans, trans, T_BINARY_PROTOCOL);
-    return std::shared_ptr<TProtocol>(headerProtocol);
+    return withDictionaries(headerProtocol);
   }
 
   std::shared_ptr<TProtocol> getProtocol(
       std::shared_ptr<transport::TTransport> inTrans,
       std::shared_ptr<transport::TTransport> outTrans) override {
     auto* headerProtocol = new THeaderProtocol(inTrans, outTrans, T_BINARY_PROTOCOL);
-    return std::shared_ptr<TProtocol>(headerProtocol);
+    return withDictionaries(headerProtocol);
   }
+
+  /**
+   * Protocols made from now on can read frames compressed with dict.
+   */
+  void addZstdDictionary(const std::shared_ptr<transport::TZstdDictionary>& dict) {
+    zstdDicts_.push_back(dict);
+  }
+
+protected:
+  std::shared_ptr<TProtocol> withDictionaries(THeaderProtocol* headerProtocol) {
+    std::shared_ptr<TProtocol> protocol(headerProtocol);
+    auto* trans = static_cast<THeaderTransport*>(protocol->getTransport().get());
+    for (const auto& dict : zstdDicts_) {
+      trans->addZstdDictionary(dict);
+    }
+    return protocol;
+  }
+
+  std::vector<std::shared_ptr<transport::TZstdDictionary> > zstdDicts_;
 };
 }
 }
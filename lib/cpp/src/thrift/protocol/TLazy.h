@@ -0,0 +1,221 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _THRIFT_PROTOCOL_TLAZY_H_
+#define _THRIFT_PROTOCOL_TLAZY_H_ 1
+
+#include <thrift/TBinaryView.h>
+#include <thrift/protocol/TProtocol.h>
+#include <thrift/transport/TBufferTransports.h>
+
+#include <memory>
+#include <ostream>
+#include <typeinfo>
+#include <utility>
+
+namespace apache {
+namespace thrift {
+namespace protocol {
+
+/**
+ * A struct valued field that is decoded on first use.
+ *
+ * Generated code declares fields annotated with cpp.lazy as TLazy<T>.  When
+ * such a field is read, its bytes are skipped over and kept as they are,
+ * provided the protocol can make another protocol of its kind (see
+ * TProtocol::getProtocolFactory()) and the transport can share the read
+ * buffer the bytes are in (see TTransport::shareReadBuffer()).  Otherwise,
+ * or if the bytes do not lie in one buffer, the value is read straight away.
+ *
+ * The value is decoded the first time it is accessed.  Until it is modified,
+ * which is any access through a non-const TLazy, writing it to a protocol of
+ * the same wire format copies the original bytes.
+ *
+ * Like the structs holding it, a TLazy is not safe for concurrent use, not
+ * even from const methods.
+ */
+template <typename T>
+class TLazy {
+public:
+  TLazy() : decoded_(true) {}
+
+  TLazy(const T& value) : value_(value), decoded_(true) {}
+
+  TLazy(T&& value) : value_(std::move(value)), decoded_(true) {}
+
+  TLazy& operator=(const T& value) {
+    set(value);
+    return *this;
+  }
+
+  TLazy& operator=(T&& value) {
+    set(std::move(value));
+    return *this;
+  }
+
+  const T& get() const {
+    decode();
+    return value_;
+  }
+
+  /**
+   * Returns the value for modification, so the original bytes are dropped.
+   */
+  T& get() {
+    decode();
+    raw_.clear();
+    factory_.reset();
+    return value_;
+  }
+
+  operator const T&() const { return get(); }
+
+  const T& operator*() const { return get(); }
+  T& operator*() { return get(); }
+  const T* operator->() const { return &get(); }
+  T* operator->() { return &get(); }
+
+  /**
+   * True until the value has been decoded from the bytes it was read as.
+   */
+  bool isLazy() const { return !decoded_; }
+
+  template <class Protocol_>
+  uint32_t read(Protocol_* iprot) {
+    raw_.clear();
+    factory_ = iprot->getProtocolFactory();
+    if (factory_) {
+      std::shared_ptr<TTransport> trans = iprot->getTransport();
+      uint32_t len = 1;
+      const uint8_t* start = trans->borrow(nullptr, &len);
+      uint32_t xfer = start ? measure(start, len) : 0;
+      std::shared_ptr<const void> owner = xfer ? trans->shareReadBuffer() : nullptr;
+      if (owner) {
+        trans->consume(xfer);
+        raw_ = TBinaryView(std::move(owner), start, xfer);
+        decoded_ = false;
+        return xfer;
+      }
+      factory_.reset();
+    }
+    decoded_ = true;
+    return value_.read(iprot);
+  }
+
+  template <class Protocol_>
+  uint32_t write(Protocol_* oprot) const {
+    if (factory_) {
+      std::shared_ptr<TProtocolFactory> factory = oprot->getProtocolFactory();
+      if (factory && sameType(*factory, *factory_)) {
+        oprot->getTransport()->write(raw_.data(), static_cast<uint32_t>(raw_.size()));
+        return static_cast<uint32_t>(raw_.size());
+      }
+    }
+    return get().write(oprot);
+  }
+
+  template <class Protocol_>
+  uint32_t serializedSize(Protocol_* oprot) const {
+    if (factory_) {
+      std::shared_ptr<TProtocolFactory> factory = oprot->getProtocolFactory();
+      if (factory && sameType(*factory, *factory_)) {
+        return static_cast<uint32_t>(raw_.size());
+      }
+    }
+    return get().serializedSize(oprot);
+  }
+
+  bool operator==(const TLazy& other) const { return get() == other.get(); }
+
+  bool operator!=(const TLazy& other) const { return !(*this == other); }
+
+  bool operator<(const TLazy& other) const { return get() < other.get(); }
+
+  void swap(TLazy& other) {
+    using std::swap;
+    swap(value_, other.value_);
+    swap(raw_, other.raw_);
+    swap(factory_, other.factory_);
+    swap(decoded_, other.decoded_);
+  }
+
+private:
+  static bool sameType(const TProtocolFactory& a, const TProtocolFactory& b) {
+    return typeid(a) == typeid(b);
+  }
+
+  void set(T value) {
+    value_ = std::move(value);
+    raw_.clear();
+    factory_.reset();
+    decoded_ = true;
+  }
+
+  // The size of the struct at the start of the len bytes at start, or 0 if
+  // it goes on past them, e.g. into the next segment of a TChainBuffer.
+  uint32_t measure(const uint8_t* start, uint32_t len) const {
+    std::shared_ptr<transport::TMemoryBuffer> buffer(
+        new transport::TMemoryBuffer(const_cast<uint8_t*>(start), len));
+    std::shared_ptr<TProtocol> prot = factory_->getProtocol(buffer);
+    try {
+      return prot->skip(T_STRUCT);
+    } catch (const transport::TTransportException&) {
+      return 0;
+    }
+  }
+
+  void decode() const {
+    if (decoded_) {
+      return;
+    }
+    std::shared_ptr<transport::TMemoryBuffer> buffer(
+        new transport::TMemoryBuffer(const_cast<uint8_t*>(raw_.data()),
+                                     static_cast<uint32_t>(raw_.size())));
+    std::shared_ptr<TProtocol> iprot = factory_->getProtocol(buffer);
+    value_ = T();
+    value_.read(iprot.get());
+    decoded_ = true;
+  }
+
+  mutable T value_;
+
+  // The value as read, and the factory for protocols that can decode it.
+  // Both are empty once the value is set or modified.
+  TBinaryView raw_;
+  std::shared_ptr<TProtocolFactory> factory_;
+
+  mutable bool decoded_;
+};
+
+template <typename T>
+void swap(TLazy<T>& lhs, TLazy<T>& rhs) {
+  lhs.swap(rhs);
+}
+
+template <typename T>
+std::ostream& operator<<(std::ostream& out, const TLazy<T>& lazy) {
+  out << lazy.get();
+  return out;
+}
+
+}
+}
+} // apache::thrift::protocol
+
+#endif // #define _THRIFT_PROTOCOL_TLAZY_H_ 1
@@ -68,7 +68,7 @@ public:
    * \param _serviceName The service name of the service communicating via this protocol.
    */
   TMultiplexedProtocol(shared_ptr<TProtocol> _protocol, const std::string& _serviceName)
-    : TProtocolDecorator(_protocol), serviceName(_serviceName), separator(":") {}
+    : TProtocolDecorator(_protocol), prefix(_serviceName + ":") {}
   ~TMultiplexedProtocol() override = default;
 
   /**
@@ -85,8 +85,10 @@ public:
                                   const int32_t _seqid) override;
 
 private:
-  const std::string serviceName;
-  const std::string separator;
+  // The service name and separator, and the last name sent with them, kept
+  // so that sending a call does not allocate
+  const std::string prefix;
+  std::string qualifiedName;
 };
 }
 }
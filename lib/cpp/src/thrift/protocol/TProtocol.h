@@ -50,6 +50,7 @@
 #include <thrift/protocol/TSet.h>
 #include <thrift/protocol/TMap.h>
 #include <thrift/TUuid.h>
+#include <thrift/TBinaryView.h>
 
 #include <memory>
 
@@ -207,6 +208,8 @@ namespace protocol {
 
 using apache::thrift::transport::TTransport;
 
+class TProtocolFactory;
+
 /**
  * Abstract class for a thrift protocol driver. These are all the methods that
  * a protocol must implement. Essentially, there must be some way of reading
@@ -555,6 +558,143 @@ public:
     return readBool_virt(value);
   }
 
+  /**
+   * Bulk reading and writing of list elements of a primitive type.  These
+   * transfer count consecutive values with no framing of their own, so they
+   * may only be used between readListBegin()/readListEnd() and friends.
+   * The defaults loop over the single value calls; protocols with a fixed
+   * width encoding override them to move the whole array at once.
+   */
+  uint32_t readI16s(int16_t* values, uint32_t count) {
+    T_VIRTUAL_CALL();
+    return readI16s_virt(values, count);
+  }
+
+  uint32_t readI32s(int32_t* values, uint32_t count) {
+    T_VIRTUAL_CALL();
+    return readI32s_virt(values, count);
+  }
+
+  uint32_t readI64s(int64_t* values, uint32_t count) {
+    T_VIRTUAL_CALL();
+    return readI64s_virt(values, count);
+  }
+
+  uint32_t readDoubles(double* values, uint32_t count) {
+    T_VIRTUAL_CALL();
+    return readDoubles_virt(values, count);
+  }
+
+  uint32_t writeI16s(const int16_t* values, uint32_t count) {
+    T_VIRTUAL_CALL();
+    return writeI16s_virt(values, count);
+  }
+
+  uint32_t writeI32s(const int32_t* values, uint32_t count) {
+    T_VIRTUAL_CALL();
+    return writeI32s_virt(values, count);
+  }
+
+  uint32_t writeI64s(const int64_t* values, uint32_t count) {
+    T_VIRTUAL_CALL();
+    return writeI64s_virt(values, count);
+  }
+
+  uint32_t writeDoubles(const double* values, uint32_t count) {
+    T_VIRTUAL_CALL();
+    return writeDoubles_virt(values, count);
+  }
+
+  virtual uint32_t readI16s_virt(int16_t* values, uint32_t count) {
+    uint32_t xfer = 0;
+    for (uint32_t i = 0; i < count; ++i) {
+      xfer += readI16_virt(values[i]);
+    }
+    return xfer;
+  }
+
+  virtual uint32_t readI32s_virt(int32_t* values, uint32_t count) {
+    uint32_t xfer = 0;
+    for (uint32_t i = 0; i < count; ++i) {
+      xfer += readI32_virt(values[i]);
+    }
+    return xfer;
+  }
+
+  virtual uint32_t readI64s_virt(int64_t* values, uint32_t count) {
+    uint32_t xfer = 0;
+    for (uint32_t i = 0; i < count; ++i) {
+      xfer += readI64_virt(values[i]);
+    }
+    return xfer;
+  }
+
+  virtual uint32_t readDoubles_virt(double* values, uint32_t count) {
+    uint32_t xfer = 0;
+    for (uint32_t i = 0; i < count; ++i) {
+      xfer += readDouble_virt(values[i]);
+    }
+    return xfer;
+  }
+
+  virtual uint32_t writeI16s_virt(const int16_t* values, uint32_t count) {
+    uint32_t xfer = 0;
+    for (uint32_t i = 0; i < count; ++i) {
+      xfer += writeI16_virt(values[i]);
+    }
+    return xfer;
+  }
+
+  virtual uint32_t writeI32s_virt(const int32_t* values, uint32_t count) {
+    uint32_t xfer = 0;
+    for (uint32_t i = 0; i < count; ++i) {
+      xfer += writeI32_virt(values[i]);
+    }
+    return xfer;
+  }
+
+  virtual uint32_t writeI64s_virt(const int64_t* values, uint32_t count) {
+    uint32_t xfer = 0;
+    for (uint32_t i = 0; i < count; ++i) {
+      xfer += writeI64_virt(values[i]);
+    }
+    return xfer;
+  }
+
+  virtual uint32_t writeDoubles_virt(const double* values, uint32_t count) {
+    uint32_t xfer = 0;
+    for (uint32_t i = 0; i < count; ++i) {
+      xfer += writeDouble_virt(values[i]);
+    }
+    return xfer;
+  }
+
+  /**
+   * Binary values as a TBinaryView.  Protocols whose transport can share its
+   * read buffer hand out views into that buffer instead of copying; the
+   * defaults go through readBinary() and writeBinary().
+   */
+  uint32_t readBinaryView(TBinaryView& view) {
+    T_VIRTUAL_CALL();
+    return readBinaryView_virt(view);
+  }
+
+  uint32_t writeBinaryView(const TBinaryView& view) {
+    T_VIRTUAL_CALL();
+    return writeBinaryView_virt(view);
+  }
+
+  virtual uint32_t readBinaryView_virt(TBinaryView& view) {
+    std::string str;
+    uint32_t xfer = readBinary_virt(str);
+    view.assign(std::move(str));
+    return xfer;
+  }
+
+  virtual uint32_t writeBinaryView_virt(const TBinaryView& view) {
+    return writeBinary_virt(view.str());
+  }
+
   /**
    * Method to arbitrarily skip over data.
    */
@@ -596,6 +736,50 @@ public:
     return 0;
   }
 
+  /**
+   * Returns a factory for protocols that speak the same wire format as this
+   * one, with the same limits, or nullptr if there is none.  Protocols whose
+   * factories are of the same type encode every value the same way, so bytes
+   * read by one can be decoded by, or copied verbatim to, the other.
+   */
+  virtual std::shared_ptr<TProtocolFactory> getProtocolFactory() { return nullptr; }
+
+  /**
+   * Serialized sizes.  Each returns the number of bytes the matching write
+   * call puts on the wire, or an upper bound for it.  Generated
+   * serializedSize() methods add them up to size a struct before it is
+   * written.  Struct begin and end markers are taken to be free.  Protocols
+   * that cannot tell the sizes return 0 throughout, and false from
+   * hasSerializedSizes(), so that nothing is sized for them.
+   */
+  virtual bool hasSerializedSizes() { return false; }
+  // Size of every value of type if they all have the same one, 0 otherwise
+  virtual uint32_t serializedSizeFixed(TType /* type */) { return 0; }
+  virtual uint32_t serializedSizeFieldBegin(TType /* fieldType */, int16_t /* fieldId */) {
+    return 0;
+  }
+  virtual uint32_t serializedSizeFieldStop() { return 0; }
+  virtual uint32_t serializedSizeMapBegin(TType /* keyType */,
+                                          TType /* valType */,
+                                          uint32_t /* size */) {
+    return 0;
+  }
+  virtual uint32_t serializedSizeListBegin(TType /* elemType */, uint32_t /* size */) {
+    return 0;
+  }
+  virtual uint32_t serializedSizeSetBegin(TType /* elemType */, uint32_t /* size */) {
+    return 0;
+  }
+  virtual uint32_t serializedSizeBool(bool /* value */) { return 0; }
+  virtual uint32_t serializedSizeByte(int8_t /* byte */) { return 0; }
+  virtual uint32_t serializedSizeI16(int16_t /* i16 */) { return 0; }
+  virtual uint32_t serializedSizeI32(int32_t /* i32 */) { return 0; }
+  virtual uint32_t serializedSizeI64(int64_t /* i64 */) { return 0; }
+  virtual uint32_t serializedSizeDouble(double /* dub */) { return 0; }
+  // Strings and binary values of size bytes
+  virtual uint32_t serializedSizeString(uint32_t /* size */) { return 0; }
+  virtual uint32_t serializedSizeUUID() { return 0; }
+
 protected:
   TProtocol(std::shared_ptr<TTransport> ptrans)
     : ptrans_(ptrans), input_recursion_depth_(0), output_recursion_depth_(0),
@@ -792,6 +976,31 @@ uint32_t skip(Protocol_& prot, TType type) {
                            "invalid TType");
 }
 
+/**
+ * Makes room in the protocol's transport for value before it is written, so
+ * that a buffered transport grows its buffer once rather than as it fills.
+ * Sizing walks the whole value, costing about as much as writing it, while
+ * growing as it fills costs little, so this only sizes the value when the
+ * transport has less than sizeHint bytes free.  Does nothing if the protocol
+ * cannot size the value or the transport cannot reserve space.
+ */
+template <class Protocol_, class T>
+void reserveSerializedSize(Protocol_* prot, const T& value, uint32_t sizeHint = 1024) {
+  if (!prot->hasSerializedSizes()) {
+    return;
+  }
+  // Asking for nothing hands out the free space without growing the buffer
+  std::shared_ptr<TTransport> trans = prot->getTransport();
+  uint32_t room = 0;
+  if (trans->reserve(&room) == nullptr || room >= sizeHint) {
+    return;
+  }
+  uint32_t size = value.serializedSize(prot);
+  if (size > room) {
+    trans->reserve(&size);
+  }
+}
+
 }}} // apache::thrift::protocol
 
 #endif // #define _THRIFT_PROTOCOL_TPROTOCOL_H_ 1
@@ -143,6 +143,88 @@ public:
   uint32_t readBinary_virt(std::string& str) override { return protocol->readBinary(str); }
   uint32_t readUUID_virt(TUuid& uuid) override { return protocol->readUUID(uuid); }
 
+  uint32_t readI16s_virt(int16_t* values, uint32_t count) override {
+    return protocol->readI16s(values, count);
+  }
+  uint32_t readI32s_virt(int32_t* values, uint32_t count) override {
+    return protocol->readI32s(values, count);
+  }
+  uint32_t readI64s_virt(int64_t* values, uint32_t count) override {
+    return protocol->readI64s(values, count);
+  }
+  uint32_t readDoubles_virt(double* values, uint32_t count) override {
+    return protocol->readDoubles(values, count);
+  }
+  uint32_t writeI16s_virt(const int16_t* values, uint32_t count) override {
+    return protocol->writeI16s(values, count);
+  }
+  uint32_t writeI32s_virt(const int32_t* values, uint32_t count) override {
+    return protocol->writeI32s(values, count);
+  }
+  uint32_t writeI64s_virt(const int64_t* values, uint32_t count) override {
+    return protocol->writeI64s(values, count);
+  }
+  uint32_t writeDoubles_virt(const double* values, uint32_t count) override {
+    return protocol->writeDoubles(values, count);
+  }
+  uint32_t readBinaryView_virt(TBinaryView& view) override {
+    return protocol->readBinaryView(view);
+  }
+  uint32_t writeBinaryView_virt(const TBinaryView& view) override {
+    return protocol->writeBinaryView(view);
+  }
+  std::shared_ptr<TProtocolFactory> getProtocolFactory() override {
+    return protocol->getProtocolFactory();
+  }
+  bool hasSerializedSizes() override { return protocol->hasSerializedSizes(); }
+  uint32_t serializedSizeFixed(TType type) override { return protocol->serializedSizeFixed(type); }
+  uint32_t serializedSizeFieldBegin(TType fieldType, int16_t fieldId) override {
+    return protocol->serializedSizeFieldBegin(fieldType, fieldId);
+  }
+  uint32_t serializedSizeFieldStop() override {
+    return protocol->serializedSizeFieldStop();
+  }
+  uint32_t serializedSizeMapBegin(TType keyType, TType valType, uint32_t size) override {
+    return protocol->serializedSizeMapBegin(keyType, valType, size);
+  }
+  uint32_t serializedSizeListBegin(TType elemType, uint32_t size) override {
+    return protocol->serializedSizeListBegin(elemType, size);
+  }
+  uint32_t serializedSizeSetBegin(TType elemType, uint32_t size) override {
+    return protocol->serializedSizeSetBegin(elemType, size);
+  }
+  uint32_t serializedSizeBool(bool value) override {
+    return protocol->serializedSizeBool(value);
+  }
+  uint32_t serializedSizeByte(int8_t byte) override {
+    return protocol->serializedSizeByte(byte);
+  }
+  uint32_t serializedSizeI16(int16_t i16) override {
+    return protocol->serializedSizeI16(i16);
+  }
+  uint32_t serializedSizeI32(int32_t i32) override {
+    return protocol->serializedSizeI32(i32);
+  }
+  uint32_t serializedSizeI64(int64_t i64) override {
+    return protocol->serializedSizeI64(i64);
+  }
+  uint32_t serializedSizeDouble(double dub) override {
+    return protocol->serializedSizeDouble(dub);
+  }
+  uint32_t serializedSizeString(uint32_t size) override {
+    return protocol->serializedSizeString(size);
+  }
+  uint32_t serializedSizeUUID() override {
+    return protocol->serializedSizeUUID();
+  }
+
+protected:
+  // Desc: Decorates proto from now on, for decorators that are reused.
+  void setProtocol(shared_ptr<TProtocol> proto) {
+    ptrans_ = proto ? proto->getTransport() : nullptr;
+    protocol = std::move(proto);
+  }
+
 private:
   shared_ptr<TProtocol> protocol;
 };
@@ -447,6 +447,46 @@ public:
     return static_cast<Protocol_*>(this)->readBool(value);
   }
 
+  uint32_t readI16s_virt(int16_t* values, uint32_t count) override {
+    return static_cast<Protocol_*>(this)->readI16s(values, count);
+  }
+
+  uint32_t readI32s_virt(int32_t* values, uint32_t count) override {
+    return static_cast<Protocol_*>(this)->readI32s(values, count);
+  }
+
+  uint32_t readI64s_virt(int64_t* values, uint32_t count) override {
+    return static_cast<Protocol_*>(this)->readI64s(values, count);
+  }
+
+  uint32_t readDoubles_virt(double* values, uint32_t count) override {
+    return static_cast<Protocol_*>(this)->readDoubles(values, count);
+  }
+
+  uint32_t writeI16s_virt(const int16_t* values, uint32_t count) override {
+    return static_cast<Protocol_*>(this)->writeI16s(values, count);
+  }
+
+  uint32_t writeI32s_virt(const int32_t* values, uint32_t count) override {
+    return static_cast<Protocol_*>(this)->writeI32s(values, count);
+  }
+
+  uint32_t writeI64s_virt(const int64_t* values, uint32_t count) override {
+    return static_cast<Protocol_*>(this)->writeI64s(values, count);
+  }
+
+  uint32_t writeDoubles_virt(const double* values, uint32_t count) override {
+    return static_cast<Protocol_*>(this)->writeDoubles(values, count);
+  }
+
+  uint32_t readBinaryView_virt(TBinaryView& view) override {
+    return static_cast<Protocol_*>(this)->readBinaryView(view);
+  }
+
+  uint32_t writeBinaryView_virt(const TBinaryView& view) override {
+    return static_cast<Protocol_*>(this)->writeBinaryView(view);
+  }
+
   uint32_t readByte_virt(int8_t& byte) override {
     return static_cast<Protocol_*>(this)->readByte(byte);
   }
@@ -511,6 +551,90 @@ public:
   }
   using Super_::readBool; // so we don't hide readBool(bool&)
 
+  /*
+   * Default bulk list element implementations, which loop over the
+   * subclass's single value calls without going through a vtable.
+   * Protocols with a fixed width encoding provide faster versions.
+   */
+  uint32_t readI16s(int16_t* values, uint32_t count) {
+    uint32_t xfer = 0;
+    for (uint32_t i = 0; i < count; ++i) {
+      xfer += static_cast<Protocol_*>(this)->readI16(values[i]);
+    }
+    return xfer;
+  }
+
+  uint32_t readI32s(int32_t* values, uint32_t count) {
+    uint32_t xfer = 0;
+    for (uint32_t i = 0; i < count; ++i) {
+      xfer += static_cast<Protocol_*>(this)->readI32(values[i]);
+    }
+    return xfer;
+  }
+
+  uint32_t readI64s(int64_t* values, uint32_t count) {
+    uint32_t xfer = 0;
+    for (uint32_t i = 0; i < count; ++i) {
+      xfer += static_cast<Protocol_*>(this)->readI64(values[i]);
+    }
+    return xfer;
+  }
+
+  uint32_t readDoubles(double* values, uint32_t count) {
+    uint32_t xfer = 0;
+    for (uint32_t i = 0; i < count; ++i) {
+      xfer += static_cast<Protocol_*>(this)->readDouble(values[i]);
+    }
+    return xfer;
+  }
+
+  uint32_t writeI16s(const int16_t* values, uint32_t count) {
+    uint32_t xfer = 0;
+    for (uint32_t i = 0; i < count; ++i) {
+      xfer += static_cast<Protocol_*>(this)->writeI16(values[i]);
+    }
+    return xfer;
+  }
+
+  uint32_t writeI32s(const int32_t* values, uint32_t count) {
+    uint32_t xfer = 0;
+    for (uint32_t i = 0; i < count; ++i) {
+      xfer += static_cast<Protocol_*>(this)->writeI32(values[i]);
+    }
+    return xfer;
+  }
+
+  uint32_t writeI64s(const int64_t* values, uint32_t count) {
+    uint32_t xfer = 0;
+    for (uint32_t i = 0; i < count; ++i) {
+      xfer += static_cast<Protocol_*>(this)->writeI64(values[i]);
+    }
+    return xfer;
+  }
+
+  uint32_t writeDoubles(const double* values, uint32_t count) {
+    uint32_t xfer = 0;
+    for (uint32_t i = 0; i < count; ++i) {
+      xfer += static_cast<Protocol_*>(this)->writeDouble(values[i]);
+    }
+    return xfer;
+  }
+
+  /*
+   * Default binary view implementations, which copy.  Protocols that can
+   * borrow from a shared read buffer provide zero-copy versions.
+   */
+  uint32_t readBinaryView(TBinaryView& view) {
+    std::string str;
+    uint32_t xfer = static_cast<Protocol_*>(this)->readBinary(str);
+    view.assign(std::move(str));
+    return xfer;
+  }
+
+  uint32_t writeBinaryView(const TBinaryView& view) {
+    return static_cast<Protocol_*>(this)->writeBinary(view.str());
+  }
+
 protected:
   TVirtualProtocol(std::shared_ptr<TTransport> ptrans) : Super_(ptrans) {}
 };
@@ -26,7 +26,11 @@
 #include <thrift/transport/PlatformSocket.h>
 
 #include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <deque>
 #include <iostream>
+#include <iterator>
 
 #ifdef HAVE_POLL_H
 #include <poll.h>
@@ -40,6 +44,17 @@
 #include <sys/socket.h>
 #endif
 
+#ifdef HAVE_SYS_EVENTFD_H
+#include <sys/eventfd.h>
+#endif
+
+#ifdef HAVE_SYS_EPOLL_H
+#include <sys/epoll.h>
+#else
+// only needed to destroy the (always empty) event array
+struct epoll_event {};
+#endif
+
 #ifdef HAVE_NETINET_IN_H
 #include <netinet/in.h>
 #include <netinet/tcp.h>
@@ -86,6 +101,9 @@ using apache::thrift::transport::TSocket;
 using apache::thrift::transport::TTransportException;
 using std::shared_ptr;
 
+/// Maximum number of events fetched by one epoll_wait()
+static const int EPOLL_BATCH_SIZE = 256;
+
 /// Three states for sockets: recv frame size, recv data, and send mode
 enum TSocketState { SOCKET_RECV_FRAMING, SOCKET_RECV, SOCKET_SEND };
 
@@ -106,12 +124,65 @@ enum TAppState {
   APP_CLOSE_CONNECTION
 };
 
+/**
+ * Memory buffer that can take over storage from a TConnectionBufferPool and
+ * give it back without freeing it.
+ */
+class TPooledMemoryBuffer : public TMemoryBuffer {
+public:
+  TPooledMemoryBuffer(uint32_t size) : TMemoryBuffer(size), attached_(false) {}
+
+  /// Empties the buffer and makes it write into buf (allocated with malloc).
+  void attach(uint8_t* buf, uint32_t size) {
+    // a shared buffer is freed by the last of its readers
+    if (owner_ && !shared_) {
+      std::free(buffer_);
+    }
+    shared_.reset();
+    buffer_ = buf;
+    bufferSize_ = size;
+    owner_ = true;
+    attached_ = true;
+    rBase_ = rBound_ = wBase_ = buffer_;
+    wBound_ = buffer_ + bufferSize_;
+  }
+
+  /**
+   * Gives up the storage taken over with attach(), or what it was grown or
+   * replaced with since.  Further writes allocate a new one.
+   *
+   * @param buf set to the storage, or to nullptr if readers of
+   *            shareReadBuffer() still hold it; they free it.
+   * @param size set to the size of the storage.
+   * @return false if nothing was attached.
+   */
+  bool detach(uint8_t** buf, uint32_t* size) {
+    if (!attached_) {
+      return false;
+    }
+    *buf = shared_ ? nullptr : buffer_;
+    *size = bufferSize_;
+    shared_.reset();
+    buffer_ = nullptr;
+    bufferSize_ = 0;
+    owner_ = true;
+    attached_ = false;
+    rBase_ = rBound_ = wBase_ = wBound_ = nullptr;
+    return true;
+  }
+
+private:
+  bool attached_;
+};
+
 /**
  * Represents a connection that is handled via libevent. This connection
  * essentially encapsulates a socket that has some associated libevent state.
  */
 class TNonblockingServer::TConnection {
 private:
+  class Request;
+
   /// Server IO Thread handling this connection
   TNonblockingIOThread* ioThread_;
 
@@ -130,6 +201,23 @@ private:
   /// Libevent flags
   short eventFlags_;
 
+  /// Whether the IO thread drives this connection with edge-triggered epoll
+  bool edgeTriggered_;
+
+  /// Whether the socket is in the IO thread's epoll set
+  bool epollRegistered_;
+
+  /// Edge-triggered readiness: set by events, cleared once the socket would block
+  bool readable_;
+  bool writable_;
+
+  /// Set once the peer hung up or the socket failed; no further edge follows
+  bool hangup_;
+
+  /// Whether a short read means the socket is drained.  Only true for a
+  /// plain TSocket, a TSSLSocket read stops at the end of a record.
+  bool shortReadDrains_;
+
   /// Socket mode
   TSocketState socketState_;
 
@@ -157,6 +245,12 @@ private:
   /// How far through writing are we?
   uint32_t writeBufferPos_;
 
+  /// Keeps the write buffer alive while the socket sends it without copying
+  std::shared_ptr<const void> writeOwner_;
+
+  /// Set while the socket may hold buffers sent without copying
+  bool zeroCopyPending_;
+
   /// Largest size of write buffer seen since buffer was constructed
   size_t largestWriteBufferSize_;
 
@@ -167,7 +261,7 @@ private:
   std::shared_ptr<TMemoryBuffer> inputTransport_;
 
   /// Transport that processor writes to
-  std::shared_ptr<TMemoryBuffer> outputTransport_;
+  std::shared_ptr<TPooledMemoryBuffer> outputTransport_;
 
   /// extra transport generated by transport factory (e.g. BufferedRouterTransport)
   std::shared_ptr<TTransport> factoryInputTransport_;
@@ -185,14 +279,87 @@ private:
   /// Thrift call context, if any
   void* connectionContext_;
 
+  /// Next connection in the IO thread's completion queue
+  TConnection* nextCompletion_;
+
+  /// Next connection in the IO thread's connection cache
+  TConnection* nextIdle_;
+
+  /// Whether several requests may be processed at once (see setMaxPipelinedRequests())
+  bool pipelined_;
+
+  /// Number of pipelined requests dispatched but not completed yet
+  size_t inFlight_;
+
+  /// Set if close() was called while pipelined requests were still running
+  bool closePending_;
+
+  /// Pipelined request objects owned by this connection, and the unused ones
+  std::vector<std::unique_ptr<Request> > requests_;
+  std::vector<Request*> idleRequests_;
+
+  /// Pipelined requests completed by worker threads, guarded by completedMutex_
+  Mutex completedMutex_;
+  std::vector<Request*> completed_;
+  bool completionQueued_;
+
+  /// Completed requests being handled by the IO thread
+  std::vector<Request*> completing_;
+
+  /// Pipelined requests whose framed responses are being sent, in order,
+  /// and how much of the first one is out already
+  std::deque<Request*> sending_;
+  uint32_t sendingPos_;
+
+  /// Method name of the request being dispatched, empty if it was not looked at
+  std::string method_;
+
+  /// Time in microseconds the last task spent in the processor
+  int64_t taskMicros_;
+
+  /// Frame of the request being dispatched, as seen by peekMethodName()
+  std::shared_ptr<TMemoryBuffer> peekTransport_;
+
+  /// Whether init() keeps the factory transports and protocols
+  bool keepProtocols_;
+
+  /// Protocol peekMessage() reads peekTransport_ with, made on first use
+  std::shared_ptr<TProtocol> peekProtocol_;
+
+  /// Whether buffers are borrowed from the IO thread's pool per request
+  bool pooled_;
+
+  /// Size of the last response, the next one likely needs as much
+  uint32_t lastResponseSize_;
+
+  /// Size of the output buffer to borrow for a request
+  uint32_t responseBufferSize() const {
+    return (std::max)(static_cast<uint32_t>(server_->getWriteBufferDefaultSize()),
+                      lastResponseSize_);
+  }
+
+  /// Borrows a pooled buffer of at least size bytes for a memory buffer.
+  void borrowBuffer(TPooledMemoryBuffer& transport, uint32_t size);
+
+  /// Gives the storage of a memory buffer back to the pool.
+  void returnBuffer(TPooledMemoryBuffer& transport);
+
+  /// Gives the buffers of the finished request back to the pool.
+  void returnRequestBuffers();
+
+  /// Write interest needed for pending pipelined responses
+  short pipelineWriteFlags() const {
+    return !sending_.empty() ? EV_WRITE | EV_PERSIST : 0;
+  }
+
   /// Go into read mode
-  void setRead() { setFlags(EV_READ | EV_PERSIST); }
+  void setRead() { setFlags(EV_READ | EV_PERSIST | pipelineWriteFlags()); }
 
   /// Go into write mode
   void setWrite() { setFlags(EV_WRITE | EV_PERSIST); }
 
   /// Set socket idle
-  void setIdle() { setFlags(0); }
+  void setIdle() { setFlags(pipelineWriteFlags()); }
 
   /**
    * Set event flags for this connection.
@@ -209,6 +376,88 @@ private:
    */
   void workSocket();
 
+  /// Whether the socket can make progress in the current state (epoll only).
+  bool edgeReady() const {
+    return ((eventFlags_ & EV_READ) && readable_) || ((eventFlags_ & EV_WRITE) && writable_);
+  }
+
+  /**
+   * Whether to read again after a read that did not complete the frame.  A
+   * socket that buffers data itself gets no event for what it holds.
+   */
+  bool moreToRead() {
+    if (edgeTriggered_) {
+      return readable_;
+    }
+    return !shortReadDrains_ && tSocket_->hasPendingDataToRead();
+  }
+
+  /// Hands the request just read to the thread manager as a pipelined task.
+  void dispatchPipelined();
+
+  /**
+   * Decides whether the request just read is processed on the IO thread,
+   * following the server's dispatch policy.  Sets method_ if the request
+   * had to be looked at.
+   */
+  bool dispatchInline();
+
+  /**
+   * Reads the method name of a request into method_ without consuming it.
+   *
+   * @return false if the request could not be decoded.
+   */
+  bool peekMethodName(uint8_t* buf, uint32_t len);
+
+  /**
+   * Reads the header of the message in buf without consuming it.
+   *
+   * @return false if the message could not be decoded.
+   */
+  bool peekMessage(uint8_t* buf, uint32_t len, std::string& name, TMessageType& type);
+
+  /**
+   * Whether a handler produced the response in buf, the one of the request
+   * method_ was peeked from.  An exception (such as for an unknown method)
+   * says nothing about how fast the method is.  A oneway call has no
+   * response and is counted.
+   */
+  bool wasHandled(uint8_t* buf, uint32_t len);
+
+  /// Method name of the response looked at by wasHandled()
+  std::string responseName_;
+
+  /**
+   * Queues the framed response of a processed pipelined request for sending
+   * and records its latency.  The request is released once it is sent, or
+   * right away if it has none.
+   */
+  void appendPipelineOutput(Request* request);
+
+  /// Returns an unused pipelined request object.
+  Request* acquireRequest();
+
+  /// Puts a pipelined request object back to the unused ones.
+  void releaseRequest(Request* request);
+
+  /**
+   * Writes as much of the pending pipelined responses as the socket takes,
+   * several of them with a single call.
+   *
+   * @return false if the connection was closed.
+   */
+  bool sendPipelineOutput();
+
+  /**
+   * Lets go of the buffers the kernel is done sending without copying.  Its
+   * completions make the socket report an error, so this tells the event
+   * handlers whether that is all that woke them up.
+   *
+   * @param events the poll events the connection waits for.
+   * @return true if none of them is ready and the socket has no error.
+   */
+  bool onlyZeroCopyCompletions(short events);
+
 public:
   class Task;
 
@@ -224,15 +473,19 @@ public:
     // Allocate input and output transports these only need to be allocated
     // once per TConnection (they don't need to be reallocated on init() call)
     inputTransport_.reset(new TMemoryBuffer(readBuffer_, readBufferSize_));
-    outputTransport_.reset(
-        new TMemoryBuffer(static_cast<uint32_t>(server_->getWriteBufferDefaultSize())));
+    outputTransport_.reset(new TPooledMemoryBuffer(
+        server_->getBufferPoolSize() > 0
+            ? 0
+            : static_cast<uint32_t>(server_->getWriteBufferDefaultSize())));
+    peekTransport_.reset(new TMemoryBuffer());
 
     tSocket_ =  socket;
+    keepProtocols_ = false;
 
     init(ioThread);
   }
 
-  ~TConnection() { std::free(readBuffer_); }
+  ~TConnection();
 
   /// Close this connection and free or reset its resources.
   void close();
@@ -267,8 +520,34 @@ public:
    * @param v void* callback arg where we placed TConnection's "this".
    */
   static void eventHandler(evutil_socket_t fd, short /* which */, void* v) {
-    assert(fd == static_cast<evutil_socket_t>(((TConnection*)v)->getTSocket()->getSocketFD()));
-    ((TConnection*)v)->workSocket();
+    auto* connection = (TConnection*)v;
+    assert(fd == static_cast<evutil_socket_t>(connection->getTSocket()->getSocketFD()));
+    short events = ((connection->eventFlags_ & EV_READ) ? POLLIN : 0)
+                   | ((connection->eventFlags_ & EV_WRITE) ? POLLOUT : 0);
+    if (connection->zeroCopyPending_ && connection->onlyZeroCopyCompletions(events)) {
+      return;
+    }
+    connection->workSocket();
+  }
+
+  /**
+   * Handler for the events an epoll based IO thread reports for this
+   * connection.  Events only record readiness; the socket is worked until it
+   * would block in the direction the current state needs.
+   *
+   * @param events the epoll event mask.
+   */
+  void epollHandler(uint32_t events);
+
+  /**
+   * Works the socket after a transition() that was not triggered by socket
+   * readiness (e.g. a finished task).  Edge-triggered readiness was already
+   * reported, so waiting for another event could wait forever.
+   */
+  void workSocketIfReady() {
+    if (edgeTriggered_ && edgeReady()) {
+      workSocket();
+    }
   }
 
   /**
@@ -282,6 +561,41 @@ public:
    */
   bool notifyIOThread() { return ioThread_->notify(this); }
 
+  /**
+   * Link used by the IO thread's completion queue.  A connection has at most
+   * one notification outstanding, so a single link is enough.
+   */
+  TConnection* getNextCompletion() const { return nextCompletion_; }
+  void setNextCompletion(TConnection* next) { nextCompletion_ = next; }
+
+  /// Link used by the IO thread's connection cache while the connection is unused.
+  TConnection* getNextIdle() const { return nextIdle_; }
+  void setNextIdle(TConnection* next) { nextIdle_ = next; }
+
+  /// Whether the connection is in use (not closed yet).
+  bool isActive() const { return ioThread_ != nullptr; }
+
+  /**
+   * Handles a notification from notifyIOThread() on the IO thread: either
+   * transitions out of APP_WAIT_TASK (or closes), or picks up the responses
+   * of all completed pipelined requests.
+   *
+   * @return false if the connection must not be touched any more.
+   */
+  bool handleNotification();
+
+  /**
+   * Records that a pipelined request has finished and notifies the IO
+   * thread, unless a notification for this connection is still pending.
+   * Called by worker threads.
+   *
+   * @return false if unable to notify.
+   */
+  bool completeRequest(Request* request);
+
+  /// Completes a pipelined request that will never run and closes the connection.
+  void dropRequest(Request* request);
+
   /*
    * Returns the number of this connection's currently assigned IO
    * thread.
@@ -307,27 +621,66 @@ public:
   /// return the TSocket transport wrapping this network connection
   std::shared_ptr<TSocket> getTSocket() const { return tSocket_; }
 
+  /// The closed socket of a cached connection, if nothing else holds on to it
+  std::shared_ptr<TSocket> getIdleSocket() const {
+    return tSocket_.use_count() == 1 ? tSocket_ : nullptr;
+  }
+
   /// return the server event handler if any
   std::shared_ptr<TServerEventHandler> getServerEventHandler() { return serverEventHandler_; }
 
   /// return the Thrift connection context if any
   void* getConnectionContext() { return connectionContext_; }
+
+  /// Records the processing time of a (non pipelined) task.
+  void setTaskMicros(int64_t micros) { taskMicros_ = micros; }
+};
+
+/**
+ * A request of a pipelined connection.  Each one has its own buffers and
+ * protocols, so that it can be processed while the connection reads the
+ * next request.
+ */
+class TNonblockingServer::TConnection::Request {
+public:
+  Request() : micros(0), dropped(false) {}
+
+  std::shared_ptr<TPooledMemoryBuffer> inputTransport;
+  std::shared_ptr<TPooledMemoryBuffer> outputTransport;
+  std::shared_ptr<TTransport> factoryInputTransport;
+  std::shared_ptr<TTransport> factoryOutputTransport;
+  std::shared_ptr<TProtocol> inputProtocol;
+  std::shared_ptr<TProtocol> outputProtocol;
+
+  /// Method name if the request was looked at, and the time spent processing it
+  std::string method;
+  int64_t micros;
+
+  /// Set if the task was dropped instead of run
+  bool dropped;
 };
 
+TNonblockingServer::TConnection::~TConnection() {
+  std::free(readBuffer_);
+}
+
 class TNonblockingServer::TConnection::Task : public Runnable {
 public:
   Task(std::shared_ptr<TProcessor> processor,
        std::shared_ptr<TProtocol> input,
        std::shared_ptr<TProtocol> output,
-       TConnection* connection)
+       TConnection* connection,
+       Request* request = nullptr)
     : processor_(processor),
       input_(input),
       output_(output),
       connection_(connection),
+      request_(request),
       serverEventHandler_(connection_->getServerEventHandler()),
       connectionContext_(connection_->getConnectionContext()) {}
 
   void run() override {
+    auto start = std::chrono::steady_clock::now();
     try {
       for (;;) {
         if (serverEventHandler_) {
@@ -350,8 +703,20 @@ public:
     } catch (...) {
       GlobalOutput.printf("TNonblockingServer: unknown exception while processing.");
     }
+    int64_t micros = std::chrono::duration_cast<std::chrono::microseconds>(
+                         std::chrono::steady_clock::now() - start).count();
+
+    if (request_) {
+      request_->micros = micros;
+      if (!connection_->completeRequest(request_)) {
+        GlobalOutput.printf("TNonblockingServer: failed to notifyIOThread for pipelined request.");
+        throw TException("TNonblockingServer::Task::run: failed write on notify pipe");
+      }
+      return;
+    }
 
     // Signal completion back to the libevent thread via a pipe
+    connection_->setTaskMicros(micros);
     if (!connection_->notifyIOThread()) {
       GlobalOutput.printf("TNonblockingServer: failed to notifyIOThread, closing.");
       connection_->server_->decrementActiveProcessors();
@@ -362,11 +727,22 @@ public:
 
   TConnection* getTConnection() { return connection_; }
 
+  /// Called instead of run() when the task was removed before it ran.
+  void drop() {
+    if (request_) {
+      connection_->dropRequest(request_);
+    } else {
+      assert(connection_->getServer() && connection_->getState() == APP_WAIT_TASK);
+      connection_->forceClose();
+    }
+  }
+
 private:
   std::shared_ptr<TProcessor> processor_;
   std::shared_ptr<TProtocol> input_;
   std::shared_ptr<TProtocol> output_;
   TConnection* connection_;
+  Request* request_;
   std::shared_ptr<TServerEventHandler> serverEventHandler_;
   void* connectionContext_;
 };
@@ -376,6 +752,28 @@ void TNonblockingServer::TConnection::init(TNonblockingIOThread* ioThread) {
   server_ = ioThread->getServer();
   appState_ = APP_INIT;
   eventFlags_ = 0;
+#ifdef HAVE_SYS_EPOLL_H
+  edgeTriggered_ = server_->getEventLoopType() == T_EVENT_LOOP_EPOLL;
+#else
+  edgeTriggered_ = false;
+#endif
+  epollRegistered_ = false;
+  readable_ = false;
+  writable_ = true;
+  hangup_ = false;
+  shortReadDrains_ = typeid(*tSocket_) == typeid(TSocket);
+  nextCompletion_ = nullptr;
+  nextIdle_ = nullptr;
+  pipelined_ = server_->isThreadPoolProcessing() && server_->getMaxPipelinedRequests() > 1;
+  inFlight_ = 0;
+  closePending_ = false;
+  completionQueued_ = false;
+  sending_.clear();
+  sendingPos_ = 0;
+  method_.clear();
+  taskMicros_ = 0;
+  pooled_ = server_->getBufferPoolSize() > 0;
+  lastResponseSize_ = 0;
 
   readBufferPos_ = 0;
   readWant_ = 0;
@@ -384,22 +782,35 @@ void TNonblockingServer::TConnection::init(TNonblockingIOThread* ioThread) {
   writeBufferSize_ = 0;
   writeBufferPos_ = 0;
   largestWriteBufferSize_ = 0;
+  writeOwner_.reset();
+  zeroCopyPending_ = false;
+  tSocket_->setZeroCopyThreshold(server_->getZeroCopyThreshold());
 
   socketState_ = SOCKET_RECV_FRAMING;
   callsForResize_ = 0;
 
-  // get input/transports
-  factoryInputTransport_ = server_->getInputTransportFactory()->getTransport(inputTransport_);
-  factoryOutputTransport_ = server_->getOutputTransportFactory()->getTransport(outputTransport_);
+  if (!keepProtocols_) {
+    // get input/transports
+    factoryInputTransport_ = server_->getInputTransportFactory()->getTransport(inputTransport_);
+    factoryOutputTransport_ = server_->getOutputTransportFactory()->getTransport(outputTransport_);
 
-  // Create protocol
-  if (server_->getHeaderTransport()) {
-    inputProtocol_ = server_->getInputProtocolFactory()->getProtocol(factoryInputTransport_,
-                                                                     factoryOutputTransport_);
-    outputProtocol_ = inputProtocol_;
-  } else {
-    inputProtocol_ = server_->getInputProtocolFactory()->getProtocol(factoryInputTransport_);
-    outputProtocol_ = server_->getOutputProtocolFactory()->getProtocol(factoryOutputTransport_);
+    // Create protocol
+    if (server_->getHeaderTransport()) {
+      inputProtocol_ = server_->getInputProtocolFactory()->getProtocol(factoryInputTransport_,
+                                                                       factoryOutputTransport_);
+      outputProtocol_ = inputProtocol_;
+    } else {
+      inputProtocol_ = server_->getInputProtocolFactory()->getProtocol(factoryInputTransport_);
+      outputProtocol_ = server_->getOutputProtocolFactory()->getProtocol(factoryOutputTransport_);
+    }
+
+    // Protocols right on the memory buffers keep no more from one client to
+    // the next than from one request to the next, so the next client of
+    // this connection gets them too.  Transports added by the factories
+    // (and THeaderTransport) have per client state.
+    keepProtocols_ = !server_->getHeaderTransport()
+                     && factoryInputTransport_ == inputTransport_
+                     && factoryOutputTransport_ == outputTransport_;
   }
 
   // Set up for any server event handler
@@ -423,6 +834,16 @@ void TNonblockingServer::TConnection::workSocket() {
     int got = 0, left = 0, sent = 0;
     uint32_t fetch = 0;
 
+    // Pipelined responses are sent whenever the socket takes them,
+    // independent of the request being read.
+    if (!sending_.empty() && (!edgeTriggered_ || writable_)
+        && !sendPipelineOutput()) {
+      return;
+    }
+    if (pipelined_ && !(eventFlags_ & EV_READ)) {
+      return;
+    }
+
     switch (socketState_) {
     case SOCKET_RECV_FRAMING:
       union {
@@ -435,15 +856,25 @@ void TNonblockingServer::TConnection::workSocket() {
       // determine size of this frame
       try {
         // Read from the socket
-        fetch = tSocket_->read(&framing.buf[readBufferPos_],
-                               uint32_t(sizeof(framing.size) - readBufferPos_));
+        uint32_t want = uint32_t(sizeof(framing.size) - readBufferPos_);
+        fetch = tSocket_->read(&framing.buf[readBufferPos_], want);
         if (fetch == 0) {
           // Whenever we get here it means a remote disconnect
           close();
           return;
         }
         readBufferPos_ += fetch;
+        if (fetch < want && shortReadDrains_ && !hangup_) {
+          // a short read drained the socket
+          readable_ = false;
+        }
       } catch (TTransportException& te) {
+        // Pipelined connections also get here on write readiness
+        if ((edgeTriggered_ || pipelined_) && te.getType() == TTransportException::TIMED_OUT) {
+          // nothing left to read, wait for the next edge
+          readable_ = false;
+          return;
+        }
         //In Nonblocking SSLSocket some operations need to be retried again.
         //Current approach is parsing exception message, but a better solution needs to be investigated.
         if(!strstr(te.what(), "retry")) {
@@ -452,11 +883,16 @@ void TNonblockingServer::TConnection::workSocket() {
 
           return;
         }
+        // the SSL socket read all the socket had
+        readable_ = false;
       }
 
       if (readBufferPos_ < sizeof(framing.size)) {
         // more needed before frame size is known -- save what we have so far
         readWant_ = framing.size;
+        if (moreToRead()) {
+          continue;
+        }
         return;
       }
 
@@ -478,6 +914,14 @@ void TNonblockingServer::TConnection::workSocket() {
       // size known; now get the rest of the frame
       transition();
 
+      // With edge-triggered epoll the readiness flags tell whether to go on.
+      if (edgeTriggered_) {
+        if (edgeReady()) {
+          continue;
+        }
+        return;
+      }
+
       // If the socket has more data than the frame header, continue to work on it. This is not strictly necessary for
       // regular sockets, because if there is more data, libevent will fire the event handler registered for read
       // readiness, which will in turn call workSocket(). However, some socket types (such as TSSLSocket) may have the
@@ -504,13 +948,19 @@ void TNonblockingServer::TConnection::workSocket() {
         fetch = readWant_ - readBufferPos_;
         got = tSocket_->read(readBuffer_ + readBufferPos_, fetch);
       } catch (TTransportException& te) {
+        if ((edgeTriggered_ || pipelined_) && te.getType() == TTransportException::TIMED_OUT) {
+          readable_ = false;
+          return;
+        }
         //In Nonblocking SSLSocket some operations need to be retried again.
         //Current approach is parsing exception message, but a better solution needs to be investigated.
         if(!strstr(te.what(), "retry")) {
           GlobalOutput.printf("TConnection::workSocket(): %s", te.what());
           close();
+          return;
         }
-
+        // the SSL socket read all the socket had
+        readable_ = false;
         return;
       }
 
@@ -521,13 +971,25 @@ void TNonblockingServer::TConnection::workSocket() {
         // Check that we did not overdo it
         assert(readBufferPos_ <= readWant_);
 
+        if (static_cast<uint32_t>(got) < fetch && shortReadDrains_ && !hangup_) {
+          readable_ = false;
+        }
+
         // We are done reading, move onto the next state
         if (readBufferPos_ == readWant_) {
           transition();
+          if (edgeTriggered_) {
+            if (edgeReady()) {
+              continue;
+            }
+            return;
+          }
           if (socketState_ == SOCKET_RECV_FRAMING && tSocket_->hasPendingDataToRead())
           {
               continue;
           }
+        } else if (moreToRead()) {
+          continue;
         }
         return;
       }
@@ -550,7 +1012,17 @@ void TNonblockingServer::TConnection::workSocket() {
 
       try {
         left = writeBufferSize_ - writeBufferPos_;
-        sent = tSocket_->write_partial(writeBuffer_ + writeBufferPos_, left);
+        if (!writeOwner_ && tSocket_->isZeroCopy(left)) {
+          // the socket holds on to the buffer until the kernel is done with it
+          writeOwner_ = outputTransport_->shareReadBuffer();
+        }
+        if (writeOwner_) {
+          TIoVec vec = {writeBuffer_ + writeBufferPos_, static_cast<uint32_t>(left)};
+          sent = tSocket_->writevZeroCopy_partial(&vec, 1, &writeOwner_);
+          zeroCopyPending_ = true;
+        } else {
+          sent = tSocket_->write_partial(writeBuffer_ + writeBufferPos_, left);
+        }
       } catch (TTransportException& te) {
         GlobalOutput.printf("TConnection::workSocket(): %s ", te.what());
         close();
@@ -562,9 +1034,18 @@ void TNonblockingServer::TConnection::workSocket() {
       // Did we overdo it?
       assert(writeBufferPos_ <= writeBufferSize_);
 
+      if (sent < left) {
+        // the socket buffer is full
+        writable_ = false;
+      }
+
       // We are done!
       if (writeBufferPos_ == writeBufferSize_) {
         transition();
+        // the next request may already be waiting
+        if (edgeTriggered_ && edgeReady()) {
+          continue;
+        }
       }
 
       return;
@@ -598,8 +1079,16 @@ void TNonblockingServer::TConnection::transition() {
   switch (appState_) {
 
   case APP_READ_REQUEST:
+    if (pipelined_) {
+      dispatchPipelined();
+      return;
+    }
+
     // We are done reading the request, package the read buffer into transport
     // and get back some data from the dispatch function
+    if (pooled_) {
+      borrowBuffer(*outputTransport_, responseBufferSize());
+    }
     if (server_->getHeaderTransport()) {
       inputTransport_->resetBuffer(readBuffer_, readBufferPos_);
       outputTransport_->resetBuffer();
@@ -617,7 +1106,7 @@ void TNonblockingServer::TConnection::transition() {
 
     server_->incrementActiveProcessors();
 
-    if (server_->isThreadPoolProcessing()) {
+    if (server_->isThreadPoolProcessing() && !dispatchInline()) {
       // We are setting up a Task to do this work and we will wait on it
 
       // Create task and dispatch to the thread manager
@@ -651,7 +1140,10 @@ void TNonblockingServer::TConnection::transition() {
           serverEventHandler_->processContext(connectionContext_, getTSocket());
         }
         // Invoke the processor
+        auto start = std::chrono::steady_clock::now();
         processor_->process(inputProtocol_, outputProtocol_, connectionContext_);
+        taskMicros_ = std::chrono::duration_cast<std::chrono::microseconds>(
+                          std::chrono::steady_clock::now() - start).count();
       } catch (const TTransportException& ttx) {
         GlobalOutput.printf(
             "TNonblockingServer transport error in "
@@ -687,6 +1179,10 @@ void TNonblockingServer::TConnection::transition() {
     server_->decrementActiveProcessors();
     // Get the result of the operation
     outputTransport_->getBuffer(&writeBuffer_, &writeBufferSize_);
+    lastResponseSize_ = writeBufferSize_;
+    if (!method_.empty() && wasHandled(writeBuffer_, writeBufferSize_)) {
+      ioThread_->recordLatency(method_, taskMicros_);
+    }
 
     // If the function call generated return data, then move into the send
     // state and get going
@@ -717,7 +1213,7 @@ void TNonblockingServer::TConnection::transition() {
     if (writeBufferSize_ > largestWriteBufferSize_) {
       largestWriteBufferSize_ = writeBufferSize_;
     }
-    if (server_->getResizeBufferEveryN() > 0
+    if (!pooled_ && server_->getResizeBufferEveryN() > 0
         && ++callsForResize_ >= server_->getResizeBufferEveryN()) {
       checkIdleBufferMemLimit(server_->getIdleReadBufferLimit(),
                               server_->getIdleWriteBufferLimit());
@@ -734,6 +1230,12 @@ void TNonblockingServer::TConnection::transition() {
     writeBuffer_ = nullptr;
     writeBufferPos_ = 0;
     writeBufferSize_ = 0;
+    writeOwner_.reset();
+
+    // Nothing is kept between requests if the buffers are borrowed
+    if (pooled_) {
+      returnRequestBuffers();
+    }
 
     // Into read4 state we go
     socketState_ = SOCKET_RECV_FRAMING;
@@ -750,6 +1252,10 @@ void TNonblockingServer::TConnection::transition() {
     readWant_ += 4;
 
     // We just read the request length
+    if (pooled_) {
+      readBuffer_ = ioThread_->getBufferPool().allocate(readWant_, &readBufferSize_);
+    }
+
     // Double the buffer size until it is big enough
     if (readWant_ > readBufferSize_) {
       if (readBufferSize_ == 0) {
@@ -789,75 +1295,482 @@ void TNonblockingServer::TConnection::transition() {
   }
 }
 
-void TNonblockingServer::TConnection::setFlags(short eventFlags) {
-  // Catch the do nothing case
-  if (eventFlags_ == eventFlags) {
-    return;
-  }
+void TNonblockingServer::TConnection::dispatchPipelined() {
+  Request* request = acquireRequest();
 
-  // Delete a previously existing event
-  if (eventFlags_ && event_del(&event_) == -1) {
-    GlobalOutput.perror("TConnection::setFlags() event_del", THRIFT_GET_SOCKET_ERROR);
-    return;
+  // The read buffer is reused for the next frame, so the request gets a copy
+  if (pooled_) {
+    borrowBuffer(*request->inputTransport, readBufferPos_);
+    borrowBuffer(*request->outputTransport, responseBufferSize());
+  }
+  request->inputTransport->resetBuffer();
+  request->outputTransport->resetBuffer();
+  if (server_->getHeaderTransport()) {
+    request->inputTransport->write(readBuffer_, readBufferPos_);
+  } else {
+    request->inputTransport->write(readBuffer_ + 4, readBufferPos_ - 4);
+    request->outputTransport->getWritePtr(4);
+    request->outputTransport->wroteBytes(4);
   }
 
-  // Update in memory structure
-  eventFlags_ = eventFlags;
+  server_->incrementActiveProcessors();
 
-  // Do not call event_set if there are no flags
-  if (!eventFlags_) {
+  if (dispatchInline()) {
+    request->method.swap(method_);
+    try {
+      if (serverEventHandler_) {
+        serverEventHandler_->processContext(connectionContext_, getTSocket());
+      }
+      auto start = std::chrono::steady_clock::now();
+      processor_->process(request->inputProtocol, request->outputProtocol, connectionContext_);
+      request->micros = std::chrono::duration_cast<std::chrono::microseconds>(
+                            std::chrono::steady_clock::now() - start).count();
+    } catch (const std::exception& x) {
+      GlobalOutput.printf("Server::process() uncaught exception: %s: %s",
+                          typeid(x).name(),
+                          x.what());
+      releaseRequest(request);
+      server_->decrementActiveProcessors();
+      close();
+      return;
+    } catch (...) {
+      GlobalOutput.printf("Server::process() unknown exception");
+      releaseRequest(request);
+      server_->decrementActiveProcessors();
+      close();
+      return;
+    }
+    server_->decrementActiveProcessors();
+    appendPipelineOutput(request);
+
+    // the response goes out while the next request is read
+    appState_ = APP_INIT;
+    transition();
     return;
   }
 
-  /*
-   * event_set:
-   *
-   * Prepares the event structure &event to be used in future calls to
-   * event_add() and event_del().  The event will be prepared to call the
-   * eventHandler using the 'sock' file descriptor to monitor events.
-   *
-   * The events can be either EV_READ, EV_WRITE, or both, indicating
-   * that an application can read or write from the file respectively without
-   * blocking.
-   *
-   * The eventHandler will be called with the file descriptor that triggered
-   * the event and the type of event which will be one of: EV_TIMEOUT,
-   * EV_SIGNAL, EV_READ, EV_WRITE.
-   *
-   * The additional flag EV_PERSIST makes an event_add() persistent until
-   * event_del() has been called.
-   *
-   * Once initialized, the &event struct can be used repeatedly with
-   * event_add() and event_del() and does not need to be reinitialized unless
-   * the eventHandler and/or the argument to it are to be changed.  However,
-   * when an ev structure has been added to libevent using event_add() the
-   * structure must persist until the event occurs (assuming EV_PERSIST
-   * is not set) or is removed using event_del().  You may not reuse the same
-   * ev structure for multiple monitored descriptors; each descriptor needs
-   * its own ev.
-   */
-  event_set(&event_, tSocket_->getSocketFD(), eventFlags_, TConnection::eventHandler, this);
-  event_base_set(ioThread_->getEventBase(), &event_);
+  request->method.swap(method_);
+  ++inFlight_;
+
+  std::shared_ptr<Runnable> task = std::shared_ptr<Runnable>(
+      new Task(processor_, request->inputProtocol, request->outputProtocol, this, request));
+  bool added = false;
+  try {
+    server_->addTask(task);
+    added = true;
+  } catch (IllegalStateException& ise) {
+    // The ThreadManager is not ready to handle any more tasks (it's probably shutting down).
+    GlobalOutput.printf("IllegalStateException: Server::process() %s", ise.what());
+  } catch (TimedOutException& to) {
+    GlobalOutput.printf("[ERROR] TimedOutException: Server::process() %s", to.what());
+  }
+  if (!added) {
+    --inFlight_;
+    releaseRequest(request);
+    server_->decrementActiveProcessors();
+    close();
+    return;
+  }
 
-  // Add the event
-  if (event_add(&event_, nullptr) == -1) {
-    GlobalOutput.perror("TConnection::setFlags(): could not event_add", THRIFT_GET_SOCKET_ERROR);
+  if (inFlight_ < server_->getMaxPipelinedRequests()) {
+    // go on with the next request right away
+    appState_ = APP_INIT;
+    transition();
+  } else {
+    // stop reading until one of the requests has finished
+    appState_ = APP_WAIT_TASK;
+    setIdle();
   }
 }
 
-/**
- * Closes a connection
- */
-void TNonblockingServer::TConnection::close() {
-  setIdle();
+TNonblockingServer::TConnection::Request* TNonblockingServer::TConnection::acquireRequest() {
+  if (!idleRequests_.empty()) {
+    Request* request = idleRequests_.back();
+    idleRequests_.pop_back();
+    return request;
+  }
+
+  std::unique_ptr<Request> request(new Request);
+  request->inputTransport.reset(new TPooledMemoryBuffer(
+      pooled_ ? 0 : static_cast<uint32_t>(TMemoryBuffer::defaultSize)));
+  request->outputTransport.reset(new TPooledMemoryBuffer(
+      pooled_ ? 0 : static_cast<uint32_t>(server_->getWriteBufferDefaultSize())));
+  request->factoryInputTransport
+      = server_->getInputTransportFactory()->getTransport(request->inputTransport);
+  request->factoryOutputTransport
+      = server_->getOutputTransportFactory()->getTransport(request->outputTransport);
+  if (server_->getHeaderTransport()) {
+    request->inputProtocol
+        = server_->getInputProtocolFactory()->getProtocol(request->factoryInputTransport,
+                                                          request->factoryOutputTransport);
+    request->outputProtocol = request->inputProtocol;
+  } else {
+    request->inputProtocol
+        = server_->getInputProtocolFactory()->getProtocol(request->factoryInputTransport);
+    request->outputProtocol
+        = server_->getOutputProtocolFactory()->getProtocol(request->factoryOutputTransport);
+  }
+  requests_.push_back(std::move(request));
+  return requests_.back().get();
+}
+
+bool TNonblockingServer::TConnection::dispatchInline() {
+  method_.clear();
+  if (!server_->hasDispatchPolicy()) {
+    return false;
+  }
+
+  // the method name is only known after looking into the request
+  uint32_t skip = server_->getHeaderTransport() ? 0 : 4;
+  if (!peekMethodName(readBuffer_ + skip, readBufferPos_ - skip)) {
+    return false;
+  }
+  switch (server_->getMethodDispatchMode(method_)) {
+  case T_DISPATCH_INLINE:
+    return true;
+  case T_DISPATCH_THREAD_POOL:
+    return false;
+  default:
+    // a method runs as a task until its latency is known
+    return server_->getInlineDispatchThreshold() > 0
+           && ioThread_->isFastMethod(method_, server_->getInlineDispatchThreshold());
+  }
+}
+
+bool TNonblockingServer::TConnection::peekMethodName(uint8_t* buf, uint32_t len) {
+  TMessageType type;
+  if (!peekMessage(buf, len, method_, type)) {
+    // let the processor report the problem
+    method_.clear();
+  }
+  return !method_.empty();
+}
+
+bool TNonblockingServer::TConnection::peekMessage(uint8_t* buf,
+                                                  uint32_t len,
+                                                  std::string& name,
+                                                  TMessageType& type) {
+  int32_t seqid;
+  bool decoded = false;
+  // the protocol is kept between messages; one that carries state from the
+  // last message (such as JSON) fails to read and is made again
+  for (int attempt = 0; attempt < 2 && !decoded; ++attempt) {
+    if (!peekProtocol_) {
+      peekProtocol_ = server_->getInputProtocolFactory()->getProtocol(peekTransport_);
+    }
+    peekTransport_->resetBuffer(buf, len);
+    try {
+      peekProtocol_->readMessageBegin(name, type, seqid);
+      decoded = true;
+    } catch (const std::exception&) {
+      peekProtocol_.reset();
+    }
+  }
+  peekTransport_->resetBuffer();
+  return decoded;
+}
+
+bool TNonblockingServer::TConnection::wasHandled(uint8_t* buf, uint32_t len) {
+  uint32_t skip = server_->getHeaderTransport() ? 0 : 4;
+  if (len <= skip) {
+    return true;
+  }
+  TMessageType type;
+  // a response the input protocol cannot read is taken as handled
+  return !peekMessage(buf + skip, len - skip, responseName_, type) || type != T_EXCEPTION;
+}
+
+void TNonblockingServer::TConnection::appendPipelineOutput(Request* request) {
+  uint8_t* buf;
+  uint32_t size;
+  request->outputTransport->getBuffer(&buf, &size);
+  lastResponseSize_ = size;
+  if (!request->method.empty() && wasHandled(buf, size)) {
+    ioThread_->recordLatency(request->method, request->micros);
+  }
+  // 4 bytes were reserved for frame size, a oneway request has no result
+  if (size > 4) {
+    auto frameSize = (int32_t)htonl(size - 4);
+    memcpy(buf, &frameSize, 4);
+    sending_.push_back(request);
+  } else {
+    releaseRequest(request);
+  }
+}
+
+void TNonblockingServer::TConnection::releaseRequest(Request* request) {
+  if (pooled_) {
+    returnBuffer(*request->inputTransport);
+    returnBuffer(*request->outputTransport);
+  }
+  idleRequests_.push_back(request);
+}
+
+void TNonblockingServer::TConnection::borrowBuffer(TPooledMemoryBuffer& transport, uint32_t size) {
+  uint32_t capacity;
+  uint8_t* buffer = ioThread_->getBufferPool().allocate(size, &capacity);
+  transport.attach(buffer, capacity);
+}
+
+void TNonblockingServer::TConnection::returnBuffer(TPooledMemoryBuffer& transport) {
+  uint8_t* buffer;
+  uint32_t capacity;
+  if (transport.detach(&buffer, &capacity)) {
+    ioThread_->getBufferPool().release(buffer, capacity);
+  }
+}
+
+void TNonblockingServer::TConnection::returnRequestBuffers() {
+  if (readBuffer_) {
+    ioThread_->getBufferPool().release(readBuffer_, readBufferSize_);
+    readBuffer_ = nullptr;
+    readBufferSize_ = 0;
+  }
+  returnBuffer(*outputTransport_);
+}
+
+bool TNonblockingServer::TConnection::sendPipelineOutput() {
+  while (!sending_.empty()) {
+    // hand the socket the responses straight from their output buffers
+    TIoVec vecs[16];
+    uint32_t count = 0;
+    uint32_t left = 0;
+    for (auto it = sending_.begin(); it != sending_.end() && count < 16; ++it) {
+      uint8_t* buf;
+      uint32_t size;
+      (*it)->outputTransport->getBuffer(&buf, &size);
+      uint32_t skip = count == 0 ? sendingPos_ : 0;
+      vecs[count].base = buf + skip;
+      vecs[count].len = size - skip;
+      left += vecs[count].len;
+      ++count;
+    }
+
+    // the socket holds on to the buffers until the kernel is done with them
+    std::shared_ptr<const void> owners[16];
+    bool zeroCopy = tSocket_->isZeroCopy(left);
+    for (uint32_t i = 0; zeroCopy && i < count; ++i) {
+      owners[i] = sending_[i]->outputTransport->shareReadBuffer();
+      zeroCopy = owners[i] != nullptr;
+    }
+
+    uint32_t sent;
+    try {
+      if (zeroCopy) {
+        sent = tSocket_->writevZeroCopy_partial(vecs, count, owners);
+        zeroCopyPending_ = true;
+      } else {
+        sent = tSocket_->writev_partial(vecs, count);
+      }
+    } catch (TTransportException& te) {
+      GlobalOutput.printf("TConnection::workSocket(): %s ", te.what());
+      close();
+      return false;
+    }
+
+    // release the requests that are out
+    bool full = sent < left;
+    for (uint32_t i = 0; i < count && sent >= vecs[i].len; ++i) {
+      sent -= vecs[i].len;
+      sendingPos_ = 0;
+      releaseRequest(sending_.front());
+      sending_.pop_front();
+    }
+    sendingPos_ += sent;
+    if (full) {
+      // the socket buffer is full
+      writable_ = false;
+      return true;
+    }
+  }
+
+  // everything is out, only keep reading if we were
+  setFlags((eventFlags_ & EV_READ) ? EV_READ | EV_PERSIST : 0);
+  return true;
+}
+
+bool TNonblockingServer::TConnection::completeRequest(Request* request) {
+  bool queued;
+  {
+    Guard g(completedMutex_);
+    completed_.push_back(request);
+    queued = completionQueued_;
+    completionQueued_ = true;
+  }
+  // one notification covers everything completed until the IO thread runs
+  return queued || notifyIOThread();
+}
+
+void TNonblockingServer::TConnection::dropRequest(Request* request) {
+  request->dropped = true;
+  if (!completeRequest(request)) {
+    throw TException("TConnection::dropRequest: failed write on notify pipe");
+  }
+}
+
+bool TNonblockingServer::TConnection::handleNotification() {
+  // fresh connections handed over by the listening thread start out in APP_INIT
+  if (!pipelined_ || appState_ == APP_INIT) {
+    // a closed connection must not be touched after transition()
+    bool closing = appState_ == APP_CLOSE_CONNECTION;
+    transition();
+    return !closing;
+  }
+
+  {
+    Guard g(completedMutex_);
+    completing_.swap(completed_);
+    completionQueued_ = false;
+  }
+  for (auto request : completing_) {
+    server_->decrementActiveProcessors();
+    --inFlight_;
+    if (request->dropped) {
+      request->dropped = false;
+      closePending_ = true;
+      releaseRequest(request);
+    } else if (!closePending_) {
+      appendPipelineOutput(request);
+    } else {
+      releaseRequest(request);
+    }
+  }
+  completing_.clear();
+
+  if (closePending_) {
+    close();
+    return false;
+  }
+
+  if (appState_ == APP_WAIT_TASK && inFlight_ < server_->getMaxPipelinedRequests()) {
+    // below the limit again, resume reading
+    appState_ = APP_INIT;
+    transition();
+  } else if (appState_ == APP_WAIT_TASK) {
+    setIdle();
+  } else {
+    setRead();
+  }
+  return true;
+}
+
+void TNonblockingServer::TConnection::setFlags(short eventFlags) {
+  // Catch the do nothing case
+  if (eventFlags_ == eventFlags) {
+    return;
+  }
+
+  // The epoll registration covers both directions for the lifetime of the
+  // connection; the flags only tell workSocket() what the state needs.
+  if (edgeTriggered_) {
+    if (eventFlags && !epollRegistered_) {
+      epollRegistered_ = ioThread_->registerConnection(this, tSocket_->getSocketFD());
+    }
+    eventFlags_ = eventFlags;
+    return;
+  }
+
+  // Delete a previously existing event
+  if (eventFlags_ && event_del(&event_) == -1) {
+    GlobalOutput.perror("TConnection::setFlags() event_del", THRIFT_GET_SOCKET_ERROR);
+    return;
+  }
+
+  // Update in memory structure
+  eventFlags_ = eventFlags;
+
+  // Do not call event_set if there are no flags
+  if (!eventFlags_) {
+    return;
+  }
+
+  /*
+   * event_set:
+   *
+   * Prepares the event structure &event to be used in future calls to
+   * event_add() and event_del().  The event will be prepared to call the
+   * eventHandler using the 'sock' file descriptor to monitor events.
+   *
+   * The events can be either EV_READ, EV_WRITE, or both, indicating
+   * that an application can read or write from the file respectively without
+   * blocking.
+   *
+   * The eventHandler will be called with the file descriptor that triggered
+   * the event and the type of event which will be one of: EV_TIMEOUT,
+   * EV_SIGNAL, EV_READ, EV_WRITE.
+   *
+   * The additional flag EV_PERSIST makes an event_add() persistent until
+   * event_del() has been called.
+   *
+   * Once initialized, the &event struct can be used repeatedly with
+   * event_add() and event_del() and does not need to be reinitialized unless
+   * the eventHandler and/or the argument to it are to be changed.  However,
+   * when an ev structure has been added to libevent using event_add() the
+   * structure must persist until the event occurs (assuming EV_PERSIST
+   * is not set) or is removed using event_del().  You may not reuse the same
+   * ev structure for multiple monitored descriptors; each descriptor needs
+   * its own ev.
+   */
+  event_set(&event_, tSocket_->getSocketFD(), eventFlags_, TConnection::eventHandler, this);
+  event_base_set(ioThread_->getEventBase(), &event_);
+
+  // Add the event
+  if (event_add(&event_, nullptr) == -1) {
+    GlobalOutput.perror("TConnection::setFlags(): could not event_add", THRIFT_GET_SOCKET_ERROR);
+  }
+}
+
+bool TNonblockingServer::TConnection::onlyZeroCopyCompletions(short events) {
+  try {
+    zeroCopyPending_ = tSocket_->reclaimZeroCopy();
+  } catch (const TTransportException&) {
+    // the next read or write runs into the error
+    return false;
+  }
+  struct THRIFT_POLLFD fds[1];
+  std::memset(fds, 0, sizeof(fds));
+  fds[0].fd = tSocket_->getSocketFD();
+  fds[0].events = events;
+  return THRIFT_POLL(fds, 1, 0) == 0;
+}
+
+/**
+ * Closes a connection
+ */
+void TNonblockingServer::TConnection::close() {
+  setFlags(0);
+  if (epollRegistered_) {
+    ioThread_->unregisterConnection(this, tSocket_->getSocketFD());
+    epollRegistered_ = false;
+  }
+
+  if (inFlight_ > 0) {
+    // Pipelined tasks still use the processor and the connection context,
+    // the last one to finish completes the close.
+    closePending_ = true;
+    return;
+  }
+  for (auto request : sending_) {
+    releaseRequest(request);
+  }
+  sending_.clear();
+  sendingPos_ = 0;
+  idleRequests_.clear();
+  requests_.clear();
+  if (pooled_) {
+    returnRequestBuffers();
+  }
 
   if (serverEventHandler_) {
     serverEventHandler_->deleteContext(connectionContext_, inputProtocol_, outputProtocol_);
   }
+  TNonblockingIOThread* ioThread = ioThread_;
   ioThread_ = nullptr;
 
-  // Close the socket
+  // Close the socket, it lets go of the buffers it was sending
   tSocket_->close();
+  writeOwner_.reset();
+  zeroCopyPending_ = false;
 
   // close any factory produced transports
   factoryInputTransport_->close();
@@ -867,10 +1780,41 @@ void TNonblockingServer::TConnection::close() {
   processor_.reset();
 
   // Give this object back to the server that owns it
-  server_->returnConnection(this);
+  server_->returnConnection(this, ioThread);
+}
+
+void TNonblockingServer::TConnection::epollHandler(uint32_t events) {
+#ifdef HAVE_SYS_EPOLL_H
+  // completions of writes sent without copying are not a hangup
+  if ((events & EPOLLERR) && !(events & (EPOLLRDHUP | EPOLLHUP)) && zeroCopyPending_
+      && onlyZeroCopyCompletions(0)) {
+    events &= ~EPOLLERR;
+  }
+  // errors and hangups surface through the next read or write
+  if (events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
+    readable_ = true;
+  }
+  if (events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
+    // data queued before the hangup can still take a short read, keep
+    // reading until the end of stream or the error shows up
+    hangup_ = true;
+  }
+  if (events & (EPOLLOUT | EPOLLHUP | EPOLLERR)) {
+    writable_ = true;
+  }
+  if (edgeReady()) {
+    workSocket();
+  }
+#else
+  THRIFT_UNUSED_VARIABLE(events);
+#endif
 }
 
 void TNonblockingServer::TConnection::checkIdleBufferMemLimit(size_t readLimit, size_t writeLimit) {
+  if (pooled_) {
+    // the buffers went back to the pool already
+    return;
+  }
   if (readLimit > 0 && readBufferSize_ > readLimit) {
     free(readBuffer_);
     readBuffer_ = nullptr;
@@ -885,16 +1829,18 @@ void TNonblockingServer::TConnection::checkIdleBufferMemLimit(size_t readLimit,
 }
 
 TNonblockingServer::~TNonblockingServer() {
-  // Close any active connections (moves them to the idle connection stack)
-  while (!activeConnections_.empty()) {
-    (*activeConnections_.begin())->close();
-  }
-  // Clean up unused TConnection objects in connectionStack_
-  while (!connectionStack_.empty()) {
-    TConnection* connection = connectionStack_.top();
-    connectionStack_.pop();
+  // Close any active connections (moves them to the connection caches)
+  std::vector<TConnection*> connections(connections_.begin(), connections_.end());
+  for (auto connection : connections) {
+    if (connection->isActive()) {
+      connection->close();
+    }
+  }
+  // Clean up all TConnection objects, the caches are not used any more
+  for (auto connection : connections_) {
     delete connection;
   }
+  connections_.clear();
   // The TNonblockingIOThread objects have shared_ptrs to the Thread
   // objects and the Thread objects have shared_ptrs to the TNonblockingIOThread
   // objects (as runnable) so these objects will never deallocate without help.
@@ -906,52 +1852,49 @@ TNonblockingServer::~TNonblockingServer() {
 }
 
 /**
- * Creates a new connection either by reusing an object off the stack or
- * by allocating a new one entirely
+ * Creates a new connection either by reusing a cached object or by
+ * allocating a new one entirely
  */
-TNonblockingServer::TConnection* TNonblockingServer::createConnection(std::shared_ptr<TSocket> socket) {
-  // Check the stack
-  Guard g(connMutex_);
-
-  // pick an IO thread to handle this connection -- currently round robin
-  assert(nextIOThread_ < ioThreads_.size());
-  int selectedThreadIdx = nextIOThread_;
-  nextIOThread_ = static_cast<uint32_t>((nextIOThread_ + 1) % ioThreads_.size());
-
-  TNonblockingIOThread* ioThread = ioThreads_[selectedThreadIdx].get();
-
-  // Check the connection stack to see if we can re-use
-  TConnection* result = nullptr;
-  if (connectionStack_.empty()) {
+TNonblockingServer::TConnection* TNonblockingServer::createConnection(std::shared_ptr<TSocket> socket,
+                                                                      TNonblockingIOThread* ioThread,
+                                                                      TConnection* cached) {
+  TConnection* result = cached;
+  if (result == nullptr) {
     result = new TConnection(socket, ioThread);
+    Guard g(connMutex_);
+    connections_.insert(result);
     ++numTConnections_;
   } else {
-    result = connectionStack_.top();
-    connectionStack_.pop();
     result->setSocket(socket);
     result->init(ioThread);
   }
-
-  activeConnections_.insert(result);
   return result;
 }
 
 /**
- * Returns a connection to the stack
+ * Returns a connection to the cache of its IO thread
  */
-void TNonblockingServer::returnConnection(TConnection* connection) {
-  Guard g(connMutex_);
-
-  activeConnections_.erase(connection);
-  if (connectionStackLimit_ && (connectionStack_.size() >= connectionStackLimit_)) {
+void TNonblockingServer::returnConnection(TConnection* connection,
+                                          TNonblockingIOThread* ioThread) {
+  if (connectionStackLimit_ && (getNumIdleConnections() >= connectionStackLimit_)) {
+    Guard g(connMutex_);
+    connections_.erase(connection);
     delete connection;
     --numTConnections_;
   } else {
     connection->checkIdleBufferMemLimit(idleReadBufferLimit_, idleWriteBufferLimit_);
-    connectionStack_.push(connection);
+    ioThread->cacheConnection(connection);
   }
 }
 
+size_t TNonblockingServer::getNumIdleConnections() const {
+  size_t total = 0;
+  for (const auto& ioThread : ioThreads_) {
+    total += ioThread->getNumCachedConnections();
+  }
+  return total;
+}
+
 /**
  * Server socket had something happen.  We accept all waiting client
  * connections on fd and assign TConnection objects to handle those requests.
@@ -961,30 +1904,43 @@ void TNonblockingServer::handleEvent(THRIFT_SOCKET fd, short which) {
   // Make sure that libevent didn't mess up the socket handles
   assert(fd == serverSocket_);
 
-  // Going to accept a new client socket
-  std::shared_ptr<TSocket> clientSocket;
+  // pick an IO thread to handle this connection -- currently round robin
+  assert(nextIOThread_ < ioThreads_.size());
+  TNonblockingIOThread* ioThread = ioThreads_[nextIOThread_].get();
 
-  clientSocket = serverTransport_->accept();
+  // Going to accept a new client socket, into the socket of a connection
+  // the IO thread has cached if nothing else holds on to that
+  TConnection* cached = ioThread->takeCachedConnection();
+  std::shared_ptr<TSocket> clientSocket;
+  try {
+    clientSocket = serverTransport_->acceptInto(cached ? cached->getIdleSocket() : nullptr);
+  } catch (...) {
+    if (cached) {
+      ioThread->cacheConnection(cached);
+    }
+    throw;
+  }
   if (clientSocket) {
+    nextIOThread_ = static_cast<uint32_t>((nextIOThread_ + 1) % ioThreads_.size());
+
     // If we're overloaded, take action here
     if (overloadAction_ != T_OVERLOAD_NO_ACTION && serverOverloaded()) {
       Guard g(connMutex_);
       nConnectionsDropped_++;
       nTotalConnectionsDropped_++;
-      if (overloadAction_ == T_OVERLOAD_CLOSE_ON_ACCEPT) {
+      if (overloadAction_ == T_OVERLOAD_CLOSE_ON_ACCEPT
+          || (overloadAction_ == T_OVERLOAD_DRAIN_TASK_QUEUE && !drainPendingTask())) {
+        // Nothing left to discard, so we drop connection instead.
         clientSocket->close();
-        return;
-      } else if (overloadAction_ == T_OVERLOAD_DRAIN_TASK_QUEUE) {
-        if (!drainPendingTask()) {
-          // Nothing left to discard, so we drop connection instead.
-          clientSocket->close();
-          return;
+        if (cached) {
+          ioThread->cacheConnection(cached);
         }
+        return;
       }
     }
 
     // Create a new TConnection for this client socket.
-    TConnection* clientConnection = createConnection(clientSocket);
+    TConnection* clientConnection = createConnection(clientSocket, ioThread, cached);
 
     // Fail fast if we could not create a TConnection object
     if (clientConnection == nullptr) {
@@ -998,8 +1954,8 @@ void TNonblockingServer::handleEvent(THRIFT_SOCKET fd, short which) {
      * start processing, or if it is us, we'll just ask this
      * connection to do its initial state change here.
      *
-     * (We need to avoid writing to our own notification pipe, to
-     * avoid possible deadlocks if the pipe is full.)
+     * (Going through our own completion queue would only cost an
+     * extra wakeup.)
      *
      * The IO thread #0 is the only one that handles these listen
      * events, so unless the connection has been assigned to thread #0
@@ -1028,10 +1984,11 @@ void TNonblockingServer::createAndListenOnSocket() {
 void TNonblockingServer::setThreadManager(std::shared_ptr<ThreadManager> threadManager) {
   threadManager_ = threadManager;
   if (threadManager) {
-    threadManager->setExpireCallback(
+    threadManager->setExpireInfoCallback(
         std::bind(&TNonblockingServer::expireClose,
                                      this,
-                                     std::placeholders::_1));
+                                     std::placeholders::_1,
+                                     std::placeholders::_2));
     threadPoolProcessing_ = true;
   } else {
     threadPoolProcessing_ = false;
@@ -1039,7 +1996,7 @@ void TNonblockingServer::setThreadManager(std::shared_ptr<ThreadManager> threadM
 }
 
 bool TNonblockingServer::serverOverloaded() {
-  size_t activeConnections = numTConnections_ - connectionStack_.size();
+  size_t activeConnections = getNumActiveConnections();
   if (numActiveProcessors_ > maxActiveProcessors_ || activeConnections > maxConnections_) {
     if (!overloaded_) {
       GlobalOutput.printf("TNonblockingServer: overload condition begun.");
@@ -1065,19 +2022,65 @@ bool TNonblockingServer::drainPendingTask() {
   if (threadManager_) {
     std::shared_ptr<Runnable> task = threadManager_->removeNextPending();
     if (task) {
-      TConnection* connection = static_cast<TConnection::Task*>(task.get())->getTConnection();
-      assert(connection && connection->getServer() && connection->getState() == APP_WAIT_TASK);
-      connection->forceClose();
+      static_cast<TConnection::Task*>(task.get())->drop();
       return true;
     }
   }
   return false;
 }
 
-void TNonblockingServer::expireClose(std::shared_ptr<Runnable> task) {
-  TConnection* connection = static_cast<TConnection::Task*>(task.get())->getTConnection();
-  assert(connection && connection->getServer() && connection->getState() == APP_WAIT_TASK);
-  connection->forceClose();
+void TNonblockingServer::expireClose(std::shared_ptr<Runnable> task,
+                                     const ThreadManager::ExpireInfo& info) {
+  nTasksExpired_[info.reason].fetch_add(1, std::memory_order_relaxed);
+  static_cast<TConnection::Task*>(task.get())->drop();
+}
+
+uint64_t TNonblockingServer::getNumTaskCompletions() const {
+  uint64_t total = 0;
+  for (const auto& ioThread : ioThreads_) {
+    total += ioThread->getNumTaskCompletions();
+  }
+  return total;
+}
+
+uint64_t TNonblockingServer::getNumCompletionWakeups() const {
+  uint64_t total = 0;
+  for (const auto& ioThread : ioThreads_) {
+    total += ioThread->getNumCompletionWakeups();
+  }
+  return total;
+}
+
+size_t TNonblockingServer::getNumMeasuredMethods() const {
+  size_t total = 0;
+  for (const auto& ioThread : ioThreads_) {
+    total += ioThread->getNumMeasuredMethods();
+  }
+  return total;
+}
+
+size_t TNonblockingServer::getNumBorrowedBuffers() const {
+  size_t total = 0;
+  for (const auto& ioThread : ioThreads_) {
+    total += ioThread->getBufferPool().getNumBorrowed();
+  }
+  return total;
+}
+
+size_t TNonblockingServer::getNumPooledBuffers() const {
+  size_t total = 0;
+  for (const auto& ioThread : ioThreads_) {
+    total += ioThread->getBufferPool().getNumIdle();
+  }
+  return total;
+}
+
+size_t TNonblockingServer::getPooledBufferBytes() const {
+  size_t total = 0;
+  for (const auto& ioThread : ioThreads_) {
+    total += ioThread->getBufferPool().getIdleBytes();
+  }
+  return total;
 }
 
 void TNonblockingServer::stop() {
@@ -1164,6 +2167,72 @@ void TNonblockingServer::serve() {
   }
 }
 
+TConnectionBufferPool::TConnectionBufferPool(size_t maxIdleBytes)
+  : maxIdleBytes_(maxIdleBytes), numBorrowed_(0), numIdle_(0), idleBytes_(0) {}
+
+TConnectionBufferPool::~TConnectionBufferPool() {
+  for (auto& buffers : free_) {
+    for (auto buffer : buffers) {
+      std::free(buffer);
+    }
+  }
+}
+
+uint8_t* TConnectionBufferPool::allocate(uint32_t size, uint32_t* capacity) {
+  uint8_t* buffer;
+  if (size > MAX_BUFFER_SIZE) {
+    // too large to keep around
+    buffer = static_cast<uint8_t*>(std::malloc(size));
+    *capacity = size;
+  } else {
+    int sizeClass = 0;
+    while ((MIN_BUFFER_SIZE << sizeClass) < size) {
+      ++sizeClass;
+    }
+    *capacity = MIN_BUFFER_SIZE << sizeClass;
+    if (!free_[sizeClass].empty()) {
+      buffer = free_[sizeClass].back();
+      free_[sizeClass].pop_back();
+      numIdle_.store(numIdle_.load(std::memory_order_relaxed) - 1, std::memory_order_relaxed);
+      idleBytes_.store(idleBytes_.load(std::memory_order_relaxed) - *capacity,
+                       std::memory_order_relaxed);
+    } else {
+      buffer = static_cast<uint8_t*>(std::malloc(*capacity));
+    }
+  }
+  if (buffer == nullptr) {
+    throw std::bad_alloc();
+  }
+  numBorrowed_.store(numBorrowed_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+  return buffer;
+}
+
+void TConnectionBufferPool::release(uint8_t* buffer, uint32_t capacity) {
+  numBorrowed_.store(numBorrowed_.load(std::memory_order_relaxed) - 1, std::memory_order_relaxed);
+  if (buffer == nullptr) {
+    return;
+  }
+  if (capacity < MIN_BUFFER_SIZE || capacity > MAX_BUFFER_SIZE) {
+    std::free(buffer);
+    return;
+  }
+
+  // a buffer grown while borrowed goes to the largest class it can serve
+  int sizeClass = 0;
+  while ((MIN_BUFFER_SIZE << (sizeClass + 1)) <= capacity) {
+    ++sizeClass;
+  }
+  size_t classSize = MIN_BUFFER_SIZE << sizeClass;
+  size_t idleBytes = idleBytes_.load(std::memory_order_relaxed);
+  if (idleBytes + classSize > maxIdleBytes_) {
+    std::free(buffer);
+    return;
+  }
+  free_[sizeClass].push_back(buffer);
+  numIdle_.store(numIdle_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+  idleBytes_.store(idleBytes + classSize, std::memory_order_relaxed);
+}
+
 TNonblockingIOThread::TNonblockingIOThread(TNonblockingServer* server,
                                            int number,
                                            THRIFT_SOCKET listenSocket,
@@ -1176,7 +2245,19 @@ TNonblockingIOThread::TNonblockingIOThread(TNonblockingServer* server,
     eventBase_(nullptr),
     ownEventBase_(false),
     serverEvent_{},
-    notificationEvent_{} {
+    notificationEvent_{},
+    epollFd_(-1),
+    epollStop_(false),
+    epollEventCount_(0),
+    epollEventIndex_(0),
+    completions_(nullptr),
+    stopRequested_(false),
+    numCompletions_(0),
+    numCompletionWakeups_(0),
+    numMeasuredMethods_(0),
+    bufferPool_(server->getBufferPoolSize()),
+    connectionCache_(nullptr),
+    numCachedConnections_(0) {
   notificationPipeFDs_[0] = -1;
   notificationPipeFDs_[1] = -1;
 }
@@ -1190,6 +2271,11 @@ TNonblockingIOThread::~TNonblockingIOThread() {
     ownEventBase_ = false;
   }
 
+  if (epollFd_ >= 0) {
+    ::close(epollFd_);
+    epollFd_ = -1;
+  }
+
   if (listenSocket_ != THRIFT_INVALID_SOCKET) {
     if (0 != ::THRIFT_CLOSESOCKET(listenSocket_)) {
       GlobalOutput.perror("TNonblockingIOThread listenSocket_ close(): ", THRIFT_GET_SOCKET_ERROR);
@@ -1197,7 +2283,11 @@ TNonblockingIOThread::~TNonblockingIOThread() {
     listenSocket_ = THRIFT_INVALID_SOCKET;
   }
 
-  for (auto notificationPipeFD : notificationPipeFDs_) {
+  // an eventfd is stored in both slots
+  if (notificationPipeFDs_[1] == notificationPipeFDs_[0]) {
+    notificationPipeFDs_[1] = THRIFT_INVALID_SOCKET;
+  }
+  for (auto& notificationPipeFD : notificationPipeFDs_) {
     if (notificationPipeFD >= 0) {
       if (0 != ::THRIFT_CLOSESOCKET(notificationPipeFD)) {
         GlobalOutput.perror("TNonblockingIOThread notificationPipe close(): ",
@@ -1209,6 +2299,15 @@ TNonblockingIOThread::~TNonblockingIOThread() {
 }
 
 void TNonblockingIOThread::createNotificationPipe() {
+#ifdef HAVE_SYS_EVENTFD_H
+  int efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (efd == -1) {
+    GlobalOutput.perror("TNonblockingServer::createNotificationPipe eventfd ", errno);
+    throw TException("can't create notification eventfd");
+  }
+  notificationPipeFDs_[0] = efd;
+  notificationPipeFDs_[1] = efd;
+#else
   if (evutil_socketpair(AF_LOCAL, SOCK_STREAM, 0, notificationPipeFDs_) == -1) {
     GlobalOutput.perror("TNonblockingServer::createNotificationPipe ", EVUTIL_SOCKET_ERROR());
     throw TException("can't create notification pipe");
@@ -1234,6 +2333,7 @@ void TNonblockingIOThread::createNotificationPipe() {
           "FD_CLOEXEC");
     }
   }
+#endif
 }
 
 /**
@@ -1242,6 +2342,22 @@ void TNonblockingIOThread::createNotificationPipe() {
 void TNonblockingIOThread::registerEvents() {
   threadId_ = Thread::get_current();
 
+  if (getServer()->getEventLoopType() == T_EVENT_LOOP_EPOLL) {
+#ifdef HAVE_SYS_EPOLL_H
+    if (getServer()->getUserEventBase() != nullptr) {
+      throw TException(
+          "TNonblockingServer::serve(): "
+          "a user-provided event base requires the libevent event loop");
+    }
+    registerEpollEvents();
+    return;
+#else
+    if (number_ == 0) {
+      GlobalOutput.printf("TNonblockingServer: epoll not available, using libevent");
+    }
+#endif
+  }
+
   assert(eventBase_ == nullptr);
   eventBase_ = getServer()->getUserEventBase();
   if (eventBase_ == nullptr) {
@@ -1295,86 +2411,247 @@ void TNonblockingIOThread::registerEvents() {
   GlobalOutput.printf("TNonblocking: IO thread #%d registered for notify.", number_);
 }
 
-bool TNonblockingIOThread::notify(TNonblockingServer::TConnection* conn) {
-  auto fd = getNotificationSendFD();
-  if (fd < 0) {
-    return false;
+void TNonblockingIOThread::registerEpollEvents() {
+#ifdef HAVE_SYS_EPOLL_H
+  assert(epollFd_ < 0);
+  epollFd_ = epoll_create1(EPOLL_CLOEXEC);
+  if (epollFd_ < 0) {
+    GlobalOutput.perror("TNonblockingIOThread::registerEpollEvents() epoll_create1 ", errno);
+    throw TException("TNonblockingServer::serve(): epoll_create1() failed");
   }
+  epollEvents_.reset(new struct epoll_event[EPOLL_BATCH_SIZE]);
 
-  int ret = -1;
-  long kSize = sizeof(conn);
-  const char * pos = (const char *)const_cast_sockopt(&conn);
+  if (number_ == 0) {
+    GlobalOutput.printf("TNonblockingServer: using edge-triggered epoll");
+  }
 
-#if defined(HAVE_POLL_H) || defined(HAVE_SYS_POLL_H)
-  struct pollfd pfd = {fd, POLLOUT, 0};
+  struct epoll_event ev;
+  std::memset(&ev, 0, sizeof(ev));
 
-  while (kSize > 0) {
-    pfd.revents = 0;
-    ret = poll(&pfd, 1, -1);
-    if (ret < 0) {
-      return false;
-    } else if (ret == 0) {
-      continue;
+  if (listenSocket_ != THRIFT_INVALID_SOCKET) {
+    // Level-triggered: handleEvent() accepts a single connection per call
+    ev.events = EPOLLIN;
+    ev.data.ptr = &listenSocket_;
+    if (-1 == epoll_ctl(epollFd_, EPOLL_CTL_ADD, listenSocket_, &ev)) {
+      throw TException(
+          "TNonblockingServer::serve(): "
+          "epoll_ctl() failed on server listen event");
     }
+    GlobalOutput.printf("TNonblocking: IO thread #%d registered for listen.", number_);
+  }
 
-    if (pfd.revents & POLLHUP || pfd.revents & POLLERR) {
-      ::THRIFT_CLOSESOCKET(fd);
-      return false;
-    }
+  createNotificationPipe();
 
-    if (pfd.revents & POLLOUT) {
-      ret = send(fd, pos, kSize, 0);
-      if (ret < 0) {
-        if (errno == EAGAIN) {
-          continue;
-        }
+  ev.events = EPOLLIN;
+  ev.data.ptr = notificationPipeFDs_;
+  if (-1 == epoll_ctl(epollFd_, EPOLL_CTL_ADD, getNotificationRecvFD(), &ev)) {
+    throw TException(
+        "TNonblockingServer::serve(): "
+        "epoll_ctl() failed on task-done notification event");
+  }
+  GlobalOutput.printf("TNonblocking: IO thread #%d registered for notify.", number_);
+#endif
+}
 
-        ::THRIFT_CLOSESOCKET(fd);
-        return false;
-      }
+bool TNonblockingIOThread::registerConnection(TNonblockingServer::TConnection* conn,
+                                              THRIFT_SOCKET fd) {
+#ifdef HAVE_SYS_EPOLL_H
+  struct epoll_event ev;
+  std::memset(&ev, 0, sizeof(ev));
+  ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+  ev.data.ptr = conn;
+  if (-1 == epoll_ctl(epollFd_, EPOLL_CTL_ADD, fd, &ev)) {
+    GlobalOutput.perror("TNonblockingIOThread::registerConnection() epoll_ctl ", errno);
+    return false;
+  }
+  return true;
+#else
+  THRIFT_UNUSED_VARIABLE(conn);
+  THRIFT_UNUSED_VARIABLE(fd);
+  return false;
+#endif
+}
 
-      kSize -= ret;
-      pos += ret;
+void TNonblockingIOThread::unregisterConnection(TNonblockingServer::TConnection* conn,
+                                                THRIFT_SOCKET fd) {
+#ifdef HAVE_SYS_EPOLL_H
+  if (-1 == epoll_ctl(epollFd_, EPOLL_CTL_DEL, fd, nullptr)) {
+    GlobalOutput.perror("TNonblockingIOThread::unregisterConnection() epoll_ctl ", errno);
+  }
+  // The connection object may be reused or freed before the rest of the
+  // current batch is dispatched, so forget about its events.
+  for (int i = epollEventIndex_ + 1; i < epollEventCount_; ++i) {
+    if (epollEvents_[i].data.ptr == conn) {
+      epollEvents_[i].data.ptr = nullptr;
     }
   }
 #else
-  fd_set wfds, efds;
-
-  while (kSize > 0) {
-    FD_ZERO(&wfds);
-    FD_ZERO(&efds);
-    FD_SET(fd, &wfds);
-    FD_SET(fd, &efds);
-    ret = select(static_cast<int>(fd + 1), nullptr, &wfds, &efds, nullptr);
-    if (ret < 0) {
-      return false;
-    } else if (ret == 0) {
-      continue;
+  THRIFT_UNUSED_VARIABLE(conn);
+  THRIFT_UNUSED_VARIABLE(fd);
+#endif
+}
+
+void TNonblockingIOThread::runEpollLoop() {
+#ifdef HAVE_SYS_EPOLL_H
+  while (!epollStop_) {
+    int count = epoll_wait(epollFd_, epollEvents_.get(), EPOLL_BATCH_SIZE, -1);
+    if (count < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      GlobalOutput.perror("TNonblockingIOThread::runEpollLoop() epoll_wait ", errno);
+      breakLoop(true);
     }
 
-    if (FD_ISSET(fd, &efds)) {
-      ::THRIFT_CLOSESOCKET(fd);
-      return false;
+    epollEventCount_ = count;
+    for (epollEventIndex_ = 0; epollEventIndex_ < epollEventCount_ && !epollStop_;
+         ++epollEventIndex_) {
+      const struct epoll_event& ev = epollEvents_[epollEventIndex_];
+      if (ev.data.ptr == nullptr) {
+        // connection closed while dispatching an earlier event
+        continue;
+      } else if (ev.data.ptr == &listenSocket_) {
+        server_->handleEvent(listenSocket_, EV_READ);
+      } else if (ev.data.ptr == notificationPipeFDs_) {
+        notifyHandler(getNotificationRecvFD(), EV_READ, this);
+      } else {
+        static_cast<TNonblockingServer::TConnection*>(ev.data.ptr)->epollHandler(ev.events);
+      }
     }
+    epollEventCount_ = 0;
+    epollEventIndex_ = 0;
+  }
+#endif
+}
 
-    if (FD_ISSET(fd, &wfds)) {
-      ret = send(fd, pos, kSize, 0);
-      if (ret < 0) {
-        if (errno == EAGAIN) {
-          continue;
-        }
+bool TNonblockingIOThread::notify(TNonblockingServer::TConnection* conn) {
+  if (getNotificationSendFD() < 0) {
+    return false;
+  }
 
-        ::THRIFT_CLOSESOCKET(fd);
-        return false;
-      }
+  if (conn == nullptr) {
+    stopRequested_.store(true);
+    return ringDoorbell();
+  }
 
-      kSize -= ret;
-      pos += ret;
-    }
+  // Push onto the completion queue; only the producer that finds it empty
+  // has to wake up the IO thread, everybody else rides along.
+  TNonblockingServer::TConnection* head = completions_.load(std::memory_order_relaxed);
+  do {
+    conn->setNextCompletion(head);
+  } while (!completions_.compare_exchange_weak(head,
+                                               conn,
+                                               std::memory_order_release,
+                                               std::memory_order_relaxed));
+  return head != nullptr || ringDoorbell();
+}
+
+bool TNonblockingIOThread::isFastMethod(const std::string& method, int64_t threshold) const {
+  auto it = methodLatency_.find(method);
+  return it != methodLatency_.end() && it->second->second < static_cast<double>(threshold);
+}
+
+void TNonblockingIOThread::recordLatency(const std::string& method, int64_t micros) {
+  auto sample = static_cast<double>(micros);
+  auto it = methodLatency_.find(method);
+  if (it != methodLatency_.end()) {
+    // exponentially weighted, so a method that got slow is offloaded again soon
+    it->second->second += (sample - it->second->second) / 8;
+    methodLatencies_.splice(methodLatencies_.begin(), methodLatencies_, it->second);
+    return;
+  }
+
+  // Method names come from clients, so the table is bounded.  The method
+  // measured longest ago makes room; one still in use is measured again.
+  if (methodLatencies_.size() >= MAX_MEASURED_METHODS) {
+    auto oldest = std::prev(methodLatencies_.end());
+    methodLatency_.erase(oldest->first);
+    oldest->first = method;
+    oldest->second = sample;
+    methodLatencies_.splice(methodLatencies_.begin(), methodLatencies_, oldest);
+  } else {
+    methodLatencies_.emplace_front(method, sample);
   }
+  methodLatency_.emplace(method, methodLatencies_.begin());
+  numMeasuredMethods_.store(methodLatencies_.size(), std::memory_order_relaxed);
+}
+
+bool TNonblockingIOThread::ringDoorbell() {
+  auto fd = getNotificationSendFD();
+  for (;;) {
+#ifdef HAVE_SYS_EVENTFD_H
+    uint64_t one = 1;
+    long ret = ::write(fd, &one, sizeof(one));
+#else
+    char one = 1;
+    long ret = send(fd, &one, sizeof(one), 0);
 #endif
+    if (ret > 0) {
+      return true;
+    }
+    int errno_copy = THRIFT_GET_SOCKET_ERROR;
+    if (errno_copy == THRIFT_EAGAIN || errno_copy == THRIFT_EWOULDBLOCK) {
+      // the IO thread has not consumed earlier rings yet, it will wake up
+      return true;
+    }
+    if (errno_copy != THRIFT_EINTR) {
+      GlobalOutput.perror("TNonblockingIOThread::ringDoorbell() ", errno_copy);
+      return false;
+    }
+  }
+}
 
-  return true;
+void TNonblockingIOThread::cacheConnection(TNonblockingServer::TConnection* connection) {
+  // counted first, so that takeCachedConnection() never makes the count wrap
+  numCachedConnections_.fetch_add(1, std::memory_order_relaxed);
+  TNonblockingServer::TConnection* head = connectionCache_.load(std::memory_order_relaxed);
+  do {
+    connection->setNextIdle(head);
+  } while (!connectionCache_.compare_exchange_weak(head,
+                                                   connection,
+                                                   std::memory_order_release,
+                                                   std::memory_order_relaxed));
+}
+
+TNonblockingServer::TConnection* TNonblockingIOThread::takeCachedConnection() {
+  // Only one thread pops and connections are not freed while cached, so the
+  // head's link cannot change under us (no ABA problem).
+  TNonblockingServer::TConnection* head = connectionCache_.load(std::memory_order_acquire);
+  while (head != nullptr
+         && !connectionCache_.compare_exchange_weak(head,
+                                                    head->getNextIdle(),
+                                                    std::memory_order_acquire,
+                                                    std::memory_order_acquire)) {
+  }
+  if (head != nullptr) {
+    numCachedConnections_.fetch_sub(1, std::memory_order_relaxed);
+  }
+  return head;
+}
+
+void TNonblockingIOThread::drainCompletions() {
+  TNonblockingServer::TConnection* list = completions_.exchange(nullptr, std::memory_order_acquire);
+
+  // the queue is a stack, restore the order of completion
+  TNonblockingServer::TConnection* ordered = nullptr;
+  uint64_t count = 0;
+  while (list != nullptr) {
+    TNonblockingServer::TConnection* next = list->getNextCompletion();
+    list->setNextCompletion(ordered);
+    ordered = list;
+    list = next;
+    ++count;
+  }
+  numCompletions_.fetch_add(count, std::memory_order_relaxed);
+
+  while (ordered != nullptr) {
+    TNonblockingServer::TConnection* connection = ordered;
+    ordered = connection->getNextCompletion();
+    connection->setNextCompletion(nullptr);
+    if (connection->handleNotification()) {
+      connection->workSocketIfReady();
+    }
+  }
 }
 
 /* static */
@@ -1383,37 +2660,34 @@ void TNonblockingIOThread::notifyHandler(evutil_socket_t fd, short which, void*
   assert(ioThread);
   (void)which;
 
-  while (true) {
-    TNonblockingServer::TConnection* connection = nullptr;
-    const int kSize = sizeof(connection);
-    long nBytes = recv(fd, cast_sockopt(&connection), kSize, 0);
-    if (nBytes == kSize) {
-      if (connection == nullptr) {
-        // this is the command to stop our thread, exit the handler!
-        ioThread->breakLoop(false);
-        return;
-      }
-      connection->transition();
-    } else if (nBytes > 0) {
-      // throw away these bytes and hope that next time we get a solid read
-      GlobalOutput.printf("notifyHandler: Bad read of %d bytes, wanted %d", nBytes, kSize);
-      ioThread->breakLoop(true);
-      return;
-    } else if (nBytes == 0) {
-      GlobalOutput.printf("notifyHandler: Notify socket closed!");
-      ioThread->breakLoop(false);
-      // exit the loop
-      break;
-    } else { // nBytes < 0
-      if (THRIFT_GET_SOCKET_ERROR != THRIFT_EWOULDBLOCK
-          && THRIFT_GET_SOCKET_ERROR != THRIFT_EAGAIN) {
-        GlobalOutput.perror("TNonblocking: notifyHandler read() failed: ", THRIFT_GET_SOCKET_ERROR);
-        ioThread->breakLoop(true);
-        return;
-      }
-      // exit the loop
-      break;
-    }
+  // Reset the doorbell before draining: completions queued after this point
+  // ring it again.
+#ifdef HAVE_SYS_EVENTFD_H
+  uint64_t rings;
+  long nBytes = ::read(fd, &rings, sizeof(rings));
+#else
+  char rings[64];
+  long nBytes;
+  while ((nBytes = recv(fd, rings, sizeof(rings), 0)) == sizeof(rings)) {
+  }
+#endif
+  if (nBytes == 0) {
+    GlobalOutput.printf("notifyHandler: Notify socket closed!");
+    ioThread->breakLoop(false);
+    return;
+  } else if (nBytes < 0 && THRIFT_GET_SOCKET_ERROR != THRIFT_EWOULDBLOCK
+             && THRIFT_GET_SOCKET_ERROR != THRIFT_EAGAIN) {
+    GlobalOutput.perror("TNonblocking: notifyHandler read() failed: ", THRIFT_GET_SOCKET_ERROR);
+    ioThread->breakLoop(true);
+    return;
+  }
+  ioThread->numCompletionWakeups_.fetch_add(1, std::memory_order_relaxed);
+
+  ioThread->drainCompletions();
+
+  if (ioThread->stopRequested_.load()) {
+    // this is the command to stop our thread
+    ioThread->breakLoop(false);
   }
 }
 
@@ -1432,6 +2706,8 @@ void TNonblockingIOThread::breakLoop(bool error) {
   // loop either.
   if (!Thread::is_current(threadId_)) {
     notify(nullptr);
+  } else if (usesEpoll()) {
+    epollStop_ = true;
   } else {
     // cause the loop to stop ASAP - even if it has things to do in it
     event_base_loopbreak(eventBase_);
@@ -1468,15 +2744,21 @@ void TNonblockingIOThread::setCurrentThreadHighPriority(bool value) {
 }
 
 void TNonblockingIOThread::run() {
-  if (eventBase_ == nullptr) {
+  if (eventBase_ == nullptr && !usesEpoll()) {
     registerEvents();
   }
   if (useHighPriority_) {
     setCurrentThreadHighPriority(true);
   }
 
-  if (eventBase_ != nullptr)
-  {
+  if (usesEpoll()) {
+    GlobalOutput.printf("TNonblockingServer: IO thread #%d entering loop...", number_);
+    runEpollLoop();
+
+    if (useHighPriority_) {
+      setCurrentThreadHighPriority(false);
+    }
+  } else if (eventBase_ != nullptr) {
     GlobalOutput.printf("TNonblockingServer: IO thread #%d entering loop...", number_);
     // Run libevent engine, never returns, invokes calls to eventHandler
     event_base_loop(eventBase_, 0);
@@ -21,6 +21,7 @@
 #define _THRIFT_SERVER_TNONBLOCKINGSERVER_H_ 1
 
 #include <thrift/Thrift.h>
+#include <atomic>
 #include <memory>
 #include <thrift/server/TServer.h>
 #include <thrift/transport/PlatformSocket.h>
@@ -32,10 +33,11 @@
 #include <thrift/concurrency/Thread.h>
 #include <thrift/concurrency/ThreadFactory.h>
 #include <thrift/concurrency/Mutex.h>
-#include <stack>
+#include <list>
 #include <vector>
 #include <string>
 #include <cstdlib>
+#include <unordered_map>
 #include <unordered_set>
 #ifdef HAVE_UNISTD_H
 #include <unistd.h>
@@ -44,6 +46,8 @@
 #include <event2/event_compat.h>
 #include <event2/event_struct.h>
 
+struct epoll_event;
+
 namespace apache {
 namespace thrift {
 namespace server {
@@ -108,6 +112,19 @@ enum TOverloadAction {
   T_OVERLOAD_DRAIN_TASK_QUEUE ///< Drop some tasks from head of task queue */
 };
 
+/// Event loops the IO threads can be driven by.
+enum TEventLoopType {
+  T_EVENT_LOOP_LIBEVENT, ///< libevent event_base, the default */
+  T_EVENT_LOOP_EPOLL     ///< Edge-triggered epoll, Linux only */
+};
+
+/// Where requests are processed when a thread manager is set.
+enum TDispatchMode {
+  T_DISPATCH_AUTO,       ///< Inline if the method is measured to be fast */
+  T_DISPATCH_INLINE,     ///< Always on the IO thread */
+  T_DISPATCH_THREAD_POOL ///< Always as a task of the thread manager */
+};
+
 class TNonblockingIOThread;
 
 class TNonblockingServer : public TServer {
@@ -153,6 +170,9 @@ private:
   /// Whether to set high scheduling priority for IO threads
   bool useHighPriorityIOThreads_;
 
+  /// Event loop used by the IO threads
+  TEventLoopType eventLoopType_;
+
   /// Server socket file descriptor
   THRIFT_SOCKET serverSocket_;
 
@@ -171,14 +191,15 @@ private:
   // Vector of IOThread objects that will handle our IO
   std::vector<std::shared_ptr<TNonblockingIOThread> > ioThreads_;
 
-  // Index of next IO Thread to be used (for round-robin)
+  // Index of next IO Thread to be used (for round-robin), only used by the
+  // listening IO thread
   uint32_t nextIOThread_;
 
-  // Synchronizes access to connection stack and similar data
+  // Synchronizes access to the connection registry and similar data
   Mutex connMutex_;
 
   /// Number of TConnection object we've created
-  size_t numTConnections_;
+  std::atomic<size_t> numTConnections_;
 
   /// Number of Connections processing or waiting to process
   size_t numActiveProcessors_;
@@ -195,6 +216,15 @@ private:
   /// Limit for frame size
   size_t maxFrameSize_;
 
+  /// Limit for requests of one connection processed at the same time
+  size_t maxPipelinedRequests_;
+
+  /// Average handler latency below which requests run on the IO thread (0 == never)
+  int64_t inlineDispatchThreshold_;
+
+  /// Dispatch modes forced for single methods
+  std::unordered_map<std::string, TDispatchMode> methodDispatchModes_;
+
   /// Time in milliseconds before an unperformed task expires (0 == infinite).
   int64_t taskExpireTime_;
 
@@ -237,6 +267,16 @@ private:
    */
   int32_t resizeBufferEveryN_;
 
+  /**
+   * Max bytes of unused buffers each IO thread keeps for reuse.  If nonzero,
+   * connections borrow their buffers from their IO thread's pool for the
+   * duration of a request and hold none while idle.  0 disables the pool.
+   */
+  size_t bufferPoolSize_;
+
+  /// Smallest response sent without copying, 0 to always copy
+  uint32_t zeroCopyThreshold_;
+
   /// Set if we are currently in an overloaded state.
   bool overloaded_;
 
@@ -246,21 +286,18 @@ private:
   /// Count of connections dropped on overload since server started
   uint64_t nTotalConnectionsDropped_;
 
-  /**
-   * This is a stack of all the objects that have been created but that
-   * are NOT currently in use. When we close a connection, we place it on this
-   * stack so that the object can be reused later, rather than freeing the
-   * memory and reallocating a new object later.
-   */
-  std::stack<TConnection*> connectionStack_;
+  /// Count of tasks expired since server started, by ThreadManager::EXPIRE_REASON
+  std::atomic<uint64_t> nTasksExpired_[ThreadManager::EXPIRED_AT_LIMIT + 1];
 
   /**
-   * This container holds pointers to all active connections. This container
-   * allows the server to clean up unlcosed connection objects at destruction,
-   * which in turn allows their transports, protocols, processors and handlers
-   * to deallocate and clean up correctly.
+   * This container holds pointers to all TConnection objects, in use or not.
+   * It allows the server to clean up unclosed connection objects at
+   * destruction, which in turn allows their transports, protocols, processors
+   * and handlers to deallocate and clean up correctly.  It only changes when
+   * an object is created or deleted; objects that are not in use wait for
+   * reuse in the connection cache of the IO thread they belonged to.
    */
-  std::unordered_set<TConnection*> activeConnections_;
+  std::unordered_set<TConnection*> connections_;
 
   /*
   */
@@ -280,6 +317,7 @@ private:
     numIOThreads_ = DEFAULT_IO_THREADS;
     nextIOThread_ = 0;
     useHighPriorityIOThreads_ = false;
+    eventLoopType_ = T_EVENT_LOOP_LIBEVENT;
     userEventBase_ = nullptr;
     threadPoolProcessing_ = false;
     numTConnections_ = 0;
@@ -288,16 +326,23 @@ private:
     maxActiveProcessors_ = MAX_ACTIVE_PROCESSORS;
     maxConnections_ = MAX_CONNECTIONS;
     maxFrameSize_ = MAX_FRAME_SIZE;
+    maxPipelinedRequests_ = 1;
+    inlineDispatchThreshold_ = 0;
     taskExpireTime_ = 0;
     overloadHysteresis_ = 0.8;
     overloadAction_ = T_OVERLOAD_NO_ACTION;
     writeBufferDefaultSize_ = WRITE_BUFFER_DEFAULT_SIZE;
     idleReadBufferLimit_ = IDLE_READ_BUFFER_LIMIT;
     idleWriteBufferLimit_ = IDLE_WRITE_BUFFER_LIMIT;
+    bufferPoolSize_ = 0;
+    zeroCopyThreshold_ = 0;
     resizeBufferEveryN_ = RESIZE_BUFFER_EVERY_N;
     overloaded_ = false;
     nConnectionsDropped_ = 0;
     nTotalConnectionsDropped_ = 0;
+    for (auto& count : nTasksExpired_) {
+      count = 0;
+    }
   }
 
 public:
@@ -404,7 +449,21 @@ public:
   size_t getNumIOThreads() const { return numIOThreads_; }
 
   /**
-   * Get the maximum number of unused TConnection we will hold in reserve.
+   * Selects the event loop of the IO threads.  With T_EVENT_LOOP_EPOLL each
+   * connection is registered once, edge-triggered, for both directions and
+   * state transitions no longer touch the event registration.  Falls back to
+   * libevent where epoll is not available.  Can only be used before the call
+   * to serve() and has no effect afterwards; a user-provided event-base
+   * requires T_EVENT_LOOP_LIBEVENT.
+   */
+  void setEventLoopType(TEventLoopType type) { eventLoopType_ = type; }
+
+  /** Return the event loop the IO threads will use. */
+  TEventLoopType getEventLoopType() const { return eventLoopType_; }
+
+  /**
+   * Get the maximum number of unused TConnection we will hold in reserve,
+   * over the caches of all IO threads.
    *
    * @return the current limit on TConnection pool size.
    */
@@ -442,7 +501,7 @@ public:
    *
    * @return count of idle connection objects.
    */
-  size_t getNumIdleConnections() const { return connectionStack_.size(); }
+  size_t getNumIdleConnections() const;
 
   /**
    * Return count of number of connections which are currently processing.
@@ -454,6 +513,44 @@ public:
    */
   size_t getNumActiveProcessors() const { return numActiveProcessors_; }
 
+  /**
+   * Return the number of finished tasks the IO threads have picked up from
+   * their completion queues since the server started.
+   *
+   * @return # of task completions.
+   */
+  uint64_t getNumTaskCompletions() const;
+
+  /**
+   * Return the number of tasks the thread manager expired instead of
+   * running, and closed the connections of, since the server started.
+   *
+   * @param reason why the tasks were expired.
+   * @return # of expired tasks.
+   */
+  uint64_t getNumExpiredTasks(ThreadManager::EXPIRE_REASON reason) const {
+    return nTasksExpired_[reason].load(std::memory_order_relaxed);
+  }
+
+  /**
+   * Return the number of times an IO thread was woken up to pick up task
+   * completions.  Completions that arrive while a wakeup is pending share
+   * it, so getNumTaskCompletions() / getNumCompletionWakeups() is the
+   * average batch size.
+   *
+   * @return # of completion wakeups.
+   */
+  uint64_t getNumCompletionWakeups() const;
+
+  /**
+   * Return the number of methods whose handler latency the IO threads keep
+   * for inline dispatch, at most TNonblockingIOThread::MAX_MEASURED_METHODS
+   * per thread.
+   *
+   * @return # of measured methods.
+   */
+  size_t getNumMeasuredMethods() const;
+
   /// Increment the count of connections currently processing.
   void incrementActiveProcessors() {
     Guard g(connMutex_);
@@ -515,6 +612,85 @@ public:
    */
   void setMaxFrameSize(size_t maxFrameSize) { maxFrameSize_ = maxFrameSize; }
 
+  /**
+   * Get the maximum # of requests of a single connection that may be
+   * processed at the same time.
+   *
+   * @return current setting.
+   */
+  size_t getMaxPipelinedRequests() const { return maxPipelinedRequests_; }
+
+  /**
+   * Set the maximum # of requests of a single connection that may be
+   * processed at the same time.  With a value above 1 and a thread manager,
+   * a connection keeps reading frames while earlier requests are still
+   * running, dispatches each one as a separate task and writes responses
+   * in the order the tasks finish.  Clients have to match responses by
+   * seqid, as a TConcurrentClientSyncInfo based client does.  Once the
+   * limit is reached the connection stops reading until a request finishes.
+   *
+   * Processors, handlers and server event handlers are called concurrently
+   * for the same connection in this mode.  The default of 1 processes one
+   * request per connection at a time.
+   *
+   * @param maxPipelinedRequests new setting; must be set before serve().
+   */
+  void setMaxPipelinedRequests(size_t maxPipelinedRequests) {
+    maxPipelinedRequests_ = maxPipelinedRequests;
+  }
+
+  /**
+   * Get the average handler latency below which requests are processed on
+   * the IO thread.
+   *
+   * @return threshold in microseconds, 0 if disabled.
+   */
+  int64_t getInlineDispatchThreshold() const { return inlineDispatchThreshold_; }
+
+  /**
+   * Set the average handler latency below which requests are processed on
+   * the IO thread instead of being handed to the thread manager.  The
+   * latency is tracked per method name by each IO thread; a method runs as
+   * a task until it has been measured, and goes back to the thread manager
+   * once its average rises above the threshold.  Saves two thread switches
+   * per call of a fast method, at the price of delaying other connections
+   * of the IO thread while it runs.  Has no effect without a thread manager.
+   *
+   * @param micros threshold in microseconds; 0 (the default) disables it.
+   */
+  void setInlineDispatchThreshold(int64_t micros) { inlineDispatchThreshold_ = micros; }
+
+  /**
+   * Force where the requests for a method are processed, regardless of the
+   * inline dispatch threshold.  The name is the one the client sends, i.e.
+   * "service:method" for multiplexed services.  Must be set before serve().
+   *
+   * @param method name of the method.
+   * @param mode T_DISPATCH_AUTO to remove a forced mode.
+   */
+  void setMethodDispatchMode(const std::string& method, TDispatchMode mode) {
+    if (mode == T_DISPATCH_AUTO) {
+      methodDispatchModes_.erase(method);
+    } else {
+      methodDispatchModes_[method] = mode;
+    }
+  }
+
+  /**
+   * Get the dispatch mode forced for a method.
+   *
+   * @return T_DISPATCH_AUTO if none was set.
+   */
+  TDispatchMode getMethodDispatchMode(const std::string& method) const {
+    auto it = methodDispatchModes_.find(method);
+    return it == methodDispatchModes_.end() ? T_DISPATCH_AUTO : it->second;
+  }
+
+  /// Whether requests have to be looked at to choose where they are processed.
+  bool hasDispatchPolicy() const {
+    return inlineDispatchThreshold_ > 0 || !methodDispatchModes_.empty();
+  }
+
   /**
    * Get fraction of maximum limits before an overload condition is cleared.
    *
@@ -557,6 +733,15 @@ public:
 
   /**
    * Set the time in milliseconds after which a task expires (0 == infinite).
+   * The connection of an expired task is closed without running the task,
+   * see getNumExpiredTasks().
+   *
+   * Consider a thread manager with EARLIEST_DEADLINE_FIRST scheduling, see
+   * ThreadManager::newSimpleThreadManager().  All tasks expire the same time
+   * after being added, so they still run in the order they arrived, but under
+   * overload expired tasks are dropped without scanning the queue, and the
+   * T_OVERLOAD_DRAIN_TASK_QUEUE action drops the task closest to expiring.
+   * The server does not change the scheduling of the thread manager.
    *
    * @param taskExpireTime a 64-bit time in milliseconds.
    */
@@ -665,6 +850,68 @@ public:
    */
   void setResizeBufferEveryN(int32_t count) { resizeBufferEveryN_ = count; }
 
+  /**
+   * Get the maximum memory each IO thread keeps in unused pooled buffers.
+   *
+   * @return # bytes, 0 if connections own their buffers.
+   */
+  size_t getBufferPoolSize() const { return bufferPoolSize_; }
+
+  /**
+   * Make connections borrow their read and write buffers from a size-classed
+   * pool of their IO thread while a request is processed, and give them back
+   * once the response is sent.  Idle connections then hold no buffers at all,
+   * which matters with many mostly idle connections.  The buffer size limits
+   * and resizeBufferEveryN_ have no effect while the pool is used.  Must be
+   * set before serve().
+   *
+   * @param size # bytes of unused buffers each IO thread keeps for reuse;
+   *             0 (the default) disables the pool.
+   */
+  void setBufferPoolSize(size_t size) { bufferPoolSize_ = size; }
+
+  /**
+   * Get the smallest response sent without copying it.
+   *
+   * @return # bytes, 0 if responses are always copied.
+   */
+  uint32_t getZeroCopyThreshold() const { return zeroCopyThreshold_; }
+
+  /**
+   * Send responses of at least this many bytes straight from their output
+   * buffers with MSG_ZEROCOPY, see TSocket::setZeroCopyThreshold().  The
+   * socket holds on to such a buffer until the client has acknowledged it,
+   * and the connection writes its next response into a new one.  Pays off
+   * for responses of a few hundred KB and more.  Must be set before serve().
+   * This is the only server that sends without copying; the blocking
+   * servers and clients always copy.  Closing a connection does not wait for
+   * the client: one that has not acknowledged such a response yet is reset.
+   *
+   * @param threshold # bytes; 0 (the default) always copies.
+   */
+  void setZeroCopyThreshold(uint32_t threshold) { zeroCopyThreshold_ = threshold; }
+
+  /**
+   * Return the number of pooled buffers currently borrowed by connections.
+   *
+   * @return # of buffers in use.
+   */
+  size_t getNumBorrowedBuffers() const;
+
+  /**
+   * Return the number of unused buffers the IO threads keep for reuse.
+   *
+   * @return # of idle buffers.
+   */
+  size_t getNumPooledBuffers() const;
+
+  /**
+   * Return the memory held by the unused buffers the IO threads keep.
+   *
+   * @return # bytes of idle buffers.
+   */
+  size_t getPooledBufferBytes() const;
+
   /**
    * Main workhorse function, starts up the server listening on a port and
    * loops over the libevent handler.
@@ -706,33 +953,106 @@ private:
    * its expiration time.  It is needed to clean up the expired connection.
    *
    * @param task the runnable associated with the expired task.
+   * @param info why and how late the task was expired.
    */
-  void expireClose(std::shared_ptr<Runnable> task);
+  void expireClose(std::shared_ptr<Runnable> task, const ThreadManager::ExpireInfo& info);
 
   /**
-   * Return an initialized connection object.  Creates or recovers from
-   * pool a TConnection and initializes it with the provided socket FD
-   * and flags.
+   * Return an initialized connection object.  Reinitializes a connection
+   * taken from the IO thread's cache or creates a new one.  Only called by
+   * the listening IO thread.
    *
-   * @param socket FD of socket associated with this connection.
-   * @param addr the sockaddr of the client
-   * @param addrLen the length of addr
+   * @param socket the accepted socket.
+   * @param ioThread the IO thread that will handle the connection.
+   * @param cached connection taken from its cache, or nullptr.
    * @return pointer to initialized TConnection object.
    */
-  TConnection* createConnection(std::shared_ptr<TSocket> socket);
+  TConnection* createConnection(std::shared_ptr<TSocket> socket,
+                                TNonblockingIOThread* ioThread,
+                                TConnection* cached);
 
   /**
-   * Returns a connection to pool or deletion.  If the connection pool
-   * (a stack) isn't full, place the connection object on it, otherwise
-   * just delete it.
+   * Returns a connection to pool or deletion.  If the connection pool isn't
+   * full, place the connection object into the cache of the IO thread it
+   * belonged to, otherwise just delete it.  Can be called from any thread.
    *
    * @param connection the TConection being returned.
+   * @param ioThread the IO thread the connection belonged to.
    */
-  void returnConnection(TConnection* connection);
+  void returnConnection(TConnection* connection, TNonblockingIOThread* ioThread);
+};
+
+/**
+ * Size-classed pool of the buffers TConnection objects use for requests and
+ * responses.  Each IO thread owns one, and only that thread allocates from
+ * and releases to it; the statistics may be read from any thread.
+ *
+ * Sizes are rounded up to a power of two between MIN_BUFFER_SIZE and
+ * MAX_BUFFER_SIZE.  Larger buffers are not pooled.  All buffers are
+ * allocated with malloc, so they may be grown with realloc while borrowed.
+ */
+class TConnectionBufferPool {
+public:
+  /// Size of the smallest size class
+  static const uint32_t MIN_BUFFER_SIZE = 256;
+
+  /// Size of the largest size class
+  static const uint32_t MAX_BUFFER_SIZE = 1024 * 1024;
+
+  /**
+   * Creates a pool.
+   *
+   * @param maxIdleBytes # bytes of unused buffers kept for reuse.
+   */
+  explicit TConnectionBufferPool(size_t maxIdleBytes);
+
+  ~TConnectionBufferPool();
+
+  /**
+   * Borrows a buffer.
+   *
+   * @param size # bytes needed.
+   * @param capacity set to the actual size of the buffer, at least size.
+   * @return the buffer.
+   * @throws std::bad_alloc if out of memory.
+   */
+  uint8_t* allocate(uint32_t size, uint32_t* capacity);
+
+  /**
+   * Gives back a borrowed buffer; it is freed if the pool is full.
+   *
+   * @param buffer the buffer, may have been grown with realloc, or nullptr
+   *               if it was handed on to someone who frees it.
+   * @param capacity the current size of the buffer.
+   */
+  void release(uint8_t* buffer, uint32_t capacity);
+
+  size_t getNumBorrowed() const { return numBorrowed_.load(std::memory_order_relaxed); }
+  size_t getNumIdle() const { return numIdle_.load(std::memory_order_relaxed); }
+  size_t getIdleBytes() const { return idleBytes_.load(std::memory_order_relaxed); }
+
+private:
+  static const int NUM_SIZE_CLASSES = 13;
+
+  TConnectionBufferPool(const TConnectionBufferPool&) = delete;
+  TConnectionBufferPool& operator=(const TConnectionBufferPool&) = delete;
+
+  /// Unused buffers of each size class
+  std::vector<uint8_t*> free_[NUM_SIZE_CLASSES];
+
+  size_t maxIdleBytes_;
+
+  /// Statistics, only written by the owning IO thread
+  std::atomic<size_t> numBorrowed_;
+  std::atomic<size_t> numIdle_;
+  std::atomic<size_t> idleBytes_;
 };
 
 class TNonblockingIOThread : public Runnable {
 public:
+  /// Most methods whose latency is tracked for inline dispatch
+  static const size_t MAX_MEASURED_METHODS = 256;
+
   // Creates an IO thread and sets up the event base.  The listenSocket should
   // be a valid FD on which listen() has already been called.  If the
   // listenSocket is < 0, accepting will not be done.
@@ -743,9 +1063,12 @@ public:
 
   ~TNonblockingIOThread() override;
 
-  // Returns the event-base for this thread.
+  // Returns the event-base for this thread, nullptr if it uses epoll.
   event_base* getEventBase() const { return eventBase_; }
 
+  // Returns whether this thread drives its connections with epoll.
+  bool usesEpoll() const { return epollFd_ >= 0; }
+
   // Returns the server for this thread.
   TNonblockingServer* getServer() const { return server_; }
 
@@ -756,19 +1079,63 @@ public:
   // only be called after the thread has been started.
   Thread::id_t getThreadId() const { return threadId_; }
 
-  // Returns the send-fd for task complete notifications.
+  // Returns the send-fd for task complete notifications.  This is the same
+  // descriptor as the read-fd if an eventfd is used.
   evutil_socket_t getNotificationSendFD() const { return notificationPipeFDs_[1]; }
 
   // Returns the read-fd for task complete notifications.
   evutil_socket_t getNotificationRecvFD() const { return notificationPipeFDs_[0]; }
 
+  // Returns the number of task completions handled by this thread.
+  uint64_t getNumTaskCompletions() const {
+    return numCompletions_.load(std::memory_order_relaxed);
+  }
+
+  // Returns the number of wakeups that delivered those completions.
+  uint64_t getNumCompletionWakeups() const {
+    return numCompletionWakeups_.load(std::memory_order_relaxed);
+  }
+
+  // Returns whether the average latency measured for a method is below
+  // threshold microseconds; false if it has not been measured yet.
+  bool isFastMethod(const std::string& method, int64_t threshold) const;
+
+  // Returns the number of methods with a latency measurement.
+  size_t getNumMeasuredMethods() const {
+    return numMeasuredMethods_.load(std::memory_order_relaxed);
+  }
+
+  // Adds a handler latency sample for a method.  At most MAX_MEASURED_METHODS
+  // methods are tracked, the one measured longest ago is forgotten to make
+  // room.
+  void recordLatency(const std::string& method, int64_t micros);
+
+  // Puts a closed connection of this thread into its connection cache.  Can
+  // be called from any thread.
+  void cacheConnection(TNonblockingServer::TConnection* connection);
+
+  // Takes a connection out of the connection cache, or returns nullptr if it
+  // is empty.  Only the listening IO thread calls this.
+  TNonblockingServer::TConnection* takeCachedConnection();
+
+  // Returns the number of connections in the connection cache.
+  size_t getNumCachedConnections() const {
+    return numCachedConnections_.load(std::memory_order_relaxed);
+  }
+
+  // Returns the pool connections of this thread borrow buffers from.
+  TConnectionBufferPool& getBufferPool() { return bufferPool_; }
+  const TConnectionBufferPool& getBufferPool() const { return bufferPool_; }
+
   // Returns the actual thread object associated with this IO thread.
   std::shared_ptr<Thread> getThread() const { return thread_; }
 
   // Sets the actual thread object associated with this IO thread.
   void setThread(const std::shared_ptr<Thread>& t) { thread_ = t; }
 
-  // Used by TConnection objects to indicate processing has finished.
+  // Used by TConnection objects to indicate processing has finished.  The
+  // connection is queued and the thread is only woken up if the queue was
+  // empty.  Passing nullptr asks the thread to leave its event loop.
   bool notify(TNonblockingServer::TConnection* conn);
 
   // Enters the event loop and does not return until a call to stop().
@@ -783,12 +1150,23 @@ public:
   /// Registers the events for the notification & listen sockets
   void registerEvents();
 
+  /**
+   * Adds a connection to the epoll set, edge-triggered for reading and
+   * writing.  Stays registered until unregisterConnection().
+   *
+   * @return false if the registration failed.
+   */
+  bool registerConnection(TNonblockingServer::TConnection* conn, THRIFT_SOCKET fd);
+
+  /// Removes a connection from the epoll set and drops its pending events.
+  void unregisterConnection(TNonblockingServer::TConnection* conn, THRIFT_SOCKET fd);
+
 private:
   /**
    * C-callable event handler for signaling task completion.  Provides a
-   * callback that libevent can understand that will read a connection
-   * object's address from a pipe and call connection->transition() for
-   * that object.
+   * callback that libevent can understand that will reset the notification
+   * descriptor and call connection->transition() for every connection in
+   * the completion queue.
    *
    * @param fd the descriptor the event occurred on.
    */
@@ -809,9 +1187,21 @@ private:
   /// Exits the loop ASAP in case of shutdown or error.
   void breakLoop(bool error);
 
-  /// Create the pipe used to notify I/O process of task completion.
+  /// Create the eventfd (or pipe) used to notify I/O process of task completion.
   void createNotificationPipe();
 
+  /// Wakes up the IO thread through the notification descriptor.
+  bool ringDoorbell();
+
+  /// Transitions all connections in the completion queue.
+  void drainCompletions();
+
+  /// Sets up epoll instead of an event base and registers the sockets.
+  void registerEpollEvents();
+
+  /// Dispatches epoll events until breakLoop() is called.
+  void runEpollLoop();
+
   /// Unregisters our events for notification and listen sockets.
   void cleanupEvents();
 
@@ -850,6 +1240,41 @@ private:
   /// File descriptors for pipe used for task completion notification.
   evutil_socket_t notificationPipeFDs_[2];
 
+  /// epoll instance used instead of eventBase_, or -1
+  int epollFd_;
+
+  /// Set by breakLoop() to leave runEpollLoop()
+  bool epollStop_;
+
+  /// Events returned by the last epoll_wait() and the one being dispatched
+  std::unique_ptr<struct epoll_event[]> epollEvents_;
+  int epollEventCount_;
+  int epollEventIndex_;
+
+  /// Completion queue (most recent first), filled by notify()
+  std::atomic<TNonblockingServer::TConnection*> completions_;
+
+  /// Set by notify(nullptr) to leave the event loop
+  std::atomic<bool> stopRequested_;
+
+  /// Statistics for getNumTaskCompletions() and getNumCompletionWakeups()
+  std::atomic<uint64_t> numCompletions_;
+  std::atomic<uint64_t> numCompletionWakeups_;
+
+  /// Smoothed handler latency in microseconds per method name, most
+  /// recently measured first, and where to find each method in it
+  typedef std::list<std::pair<std::string, double> > MethodLatencyList;
+  MethodLatencyList methodLatencies_;
+  std::unordered_map<std::string, MethodLatencyList::iterator> methodLatency_;
+  std::atomic<size_t> numMeasuredMethods_;
+
+  /// Buffers for the requests of this thread's connections
+  TConnectionBufferPool bufferPool_;
+
+  /// Unused connections of this thread (most recent first), see cacheConnection()
+  std::atomic<TNonblockingServer::TConnection*> connectionCache_;
+  std::atomic<size_t> numCachedConnections_;
+
   /// Actual IO Thread
   std::shared_ptr<Thread> thread_;
 };
@@ -118,6 +118,21 @@ const uint8_t* TBufferedTransport::borrowSlow(uint8_t* buf, uint32_t* len) {
   return nullptr;
 }
 
+uint8_t* TBufferedTransport::reserveSlow(uint32_t* len) {
+  if (*len > wBufSize_) {
+    return nullptr;
+  }
+
+  // Make room by writing out what is buffered.
+  auto have_bytes = static_cast<uint32_t>(wBase_ - wBuf_.get());
+  if (have_bytes > 0) {
+    wBase_ = wBuf_.get();
+    transport_->write(wBuf_.get(), have_bytes);
+  }
+  *len = wBufSize_;
+  return wBase_;
+}
+
 void TBufferedTransport::flush() {
   resetConsumedMessageSize();
   // Write out any data waiting in the write buffer.
@@ -148,7 +163,7 @@ uint32_t TFramedTransport::readSlow(uint8_t* buf, uint32_t len) {
   // attempting to read from it could block.
   if (have > 0) {
     memcpy(buf, rBase_, have);
-    setReadBuffer(rBuf_.get(), 0);
+    setReadBuffer(rBound_, 0);
     return have;
   }
 
@@ -207,6 +222,9 @@ bool TFramedTransport::readFrame() {
   if (sz > static_cast<int32_t>(maxFrameSize_))
     throw TTransportException(TTransportException::CORRUPTED_DATA, "Received an oversized frame");
 
+  // Let go of the last frame if it was shared; its readers keep it alive.
+  rBufShared_.reset();
+
   // Read the frame payload, and reset markers.
   if (sz > static_cast<int32_t>(rBufSize_)) {
     rBuf_.reset(new uint8_t[sz]);
@@ -218,14 +236,54 @@ bool TFramedTransport::readFrame() {
 }
 
 void TFramedTransport::writeSlow(const uint8_t* buf, uint32_t len) {
+  // Fill up the current segment and start another for the rest.
+  auto space = static_cast<uint32_t>(wBound_ - wBase_);
+  memcpy(wBase_, buf, space);
+  wBase_ += space;
+  buf += space;
+  len -= space;
+
+  uint32_t rest = len;
+  reserveSlow(&rest);
+  memcpy(wBase_, buf, len);
+  wBase_ += len;
+}
+
+uint8_t* TFramedTransport::reserveSlow(uint32_t* len) {
+  auto have = static_cast<uint32_t>(wBase_ - wBuf_.get());
+  uint32_t frame = wChainBytes_ + have;
+  if (*len + frame < frame /* overflow */ || *len + frame > 0x7fffffff) {
+    throw TTransportException(TTransportException::BAD_ARGS,
+                              "Attempted to write over 2 GB to TFramedTransport.");
+  }
+
+  // Keep what was written and carry on in a new segment at least twice the
+  // size of the last one, so the frame is never copied to grow it.
+  uint32_t new_size = wBufSize_ > 0 ? wBufSize_ * 2 : 1;
+  while (new_size < *len) {
+    new_size *= 2;
+  }
+  if (have > 0) {
+    wChain_.push_back(WriteSegment(std::move(wBuf_), have));
+    wChainBytes_ += have;
+  }
+  wBuf_.reset(new uint8_t[new_size]);
+  wBufSize_ = new_size;
+  setWriteBuffer(wBuf_.get(), wBufSize_);
+
+  *len = wBufSize_;
+  return wBase_;
+}
+
+uint8_t* TFramedTransport::reserveContiguous(uint32_t* len) {
   // Double buffer size until sufficient.
   auto have = static_cast<uint32_t>(wBase_ - wBuf_.get());
   uint32_t new_size = wBufSize_;
-  if (len + have < have /* overflow */ || len + have > 0x7fffffff) {
+  if (*len + have < have /* overflow */ || *len + have > 0x7fffffff) {
     throw TTransportException(TTransportException::BAD_ARGS,
                               "Attempted to write over 2 GB to TFramedTransport.");
   }
-  while (new_size < len + have) {
+  while (new_size < *len + have) {
     new_size = new_size > 0 ? new_size * 2 : 1;
   }
 
@@ -244,9 +302,8 @@ void TFramedTransport::writeSlow(const uint8_t* buf, uint32_t len) {
   wBase_ = wBuf_.get() + have;
   wBound_ = wBuf_.get() + wBufSize_;
 
-  // Copy the data into the new buffer.
-  memcpy(wBase_, buf, len);
-  wBase_ += len;
+  *len = static_cast<uint32_t>(wBound_ - wBase_);
+  return wBase_;
 }
 
 void TFramedTransport::flush() {
@@ -254,10 +311,12 @@ void TFramedTransport::flush() {
   int32_t sz_hbo, sz_nbo;
   assert(wBufSize_ > sizeof(sz_nbo));
 
-  // Slip the frame size into the start of the buffer.
-  sz_hbo = static_cast<uint32_t>(wBase_ - (wBuf_.get() + sizeof(sz_nbo)));
+  // Slip the frame size into the start of the first segment.
+  auto have = static_cast<uint32_t>(wBase_ - wBuf_.get());
+  sz_hbo = static_cast<uint32_t>(wChainBytes_ + have - sizeof(sz_nbo));
   sz_nbo = (int32_t)htonl((uint32_t)(sz_hbo));
-  memcpy(wBuf_.get(), (uint8_t*)&sz_nbo, sizeof(sz_nbo));
+  memcpy(wChain_.empty() ? wBuf_.get() : wChain_.front().data.get(), (uint8_t*)&sz_nbo,
+         sizeof(sz_nbo));
 
   if (sz_hbo > 0) {
     // Note that we reset wBase_ (with a pad for the frame size)
@@ -266,8 +325,35 @@ void TFramedTransport::flush() {
     // up an exception
     wBase_ = wBuf_.get() + sizeof(sz_nbo);
 
-    // Write size and frame body.
-    transport_->write(wBuf_.get(), static_cast<uint32_t>(sizeof(sz_nbo)) + sz_hbo);
+    if (wChain_.empty()) {
+      // Write size and frame body.
+      transport_->write(wBuf_.get(), static_cast<uint32_t>(sizeof(sz_nbo)) + sz_hbo);
+    } else {
+      std::vector<WriteSegment> chain;
+      chain.swap(wChain_);
+      wChainBytes_ = 0;
+
+      // Write all segments at once.
+      std::vector<TIoVec> vecs;
+      vecs.reserve(chain.size() + 1);
+      for (const WriteSegment& segment : chain) {
+        TIoVec vec = {segment.data.get(), segment.len};
+        vecs.push_back(vec);
+      }
+      TIoVec last = {wBuf_.get(), have};
+      vecs.push_back(last);
+      transport_->writev(vecs.data(), static_cast<uint32_t>(vecs.size()));
+
+      // Make the next frame of this size fit into a single segment.
+      uint32_t new_size = wBufSize_;
+      while (new_size < sizeof(sz_nbo) + static_cast<uint32_t>(sz_hbo)) {
+        new_size *= 2;
+      }
+      wBufSize_ = new_size;
+      wBuf_.reset(new uint8_t[wBufSize_]);
+      setWriteBuffer(wBuf_.get(), wBufSize_);
+      wBase_ = wBuf_.get() + sizeof(sz_nbo);
+    }
   }
 
   // Flush the underlying transport.
@@ -286,7 +372,7 @@ void TFramedTransport::flush() {
 }
 
 uint32_t TFramedTransport::writeEnd() {
-  return static_cast<uint32_t>(wBase_ - wBuf_.get());
+  return wChainBytes_ + static_cast<uint32_t>(wBase_ - wBuf_.get());
 }
 
 const uint8_t* TFramedTransport::borrowSlow(uint8_t* buf, uint32_t* len) {
@@ -298,9 +384,20 @@ const uint8_t* TFramedTransport::borrowSlow(uint8_t* buf, uint32_t* len) {
   return nullptr;
 }
 
+std::shared_ptr<const void> TFramedTransport::shareReadBuffer() {
+  if (!rBufShared_ && rBuf_) {
+    // Whoever holds the frame now decides when to free it, so take it out of
+    // rBuf_ and make readFrame() allocate another.
+    rBufShared_.reset(rBuf_.release(), std::default_delete<uint8_t[]>());
+    rBufSize_ = 0;
+  }
+  return rBufShared_;
+}
+
 uint32_t TFramedTransport::readEnd() {
   // include framing bytes
-  auto bytes_read = static_cast<uint32_t>(rBound_ - rBuf_.get() + sizeof(uint32_t));
+  const uint8_t* frame = rBufShared_ ? rBufShared_.get() : rBuf_.get();
+  auto bytes_read = static_cast<uint32_t>(rBound_ - frame + sizeof(uint32_t));
 
   if (rBufSize_ > bufReclaimThresh_) {
     rBufSize_ = 0;
@@ -377,7 +474,16 @@ void TMemoryBuffer::ensureCanWrite(uint32_t len) {
   const uint64_t new_size = static_cast<uint64_t>((std::min)(suggested_buffer_size, static_cast<double>(maxBufferSize_)));
 
   // Allocate into a new pointer so we don't bork ours if it fails.
-  auto* new_buffer = static_cast<uint8_t*>(std::realloc(buffer_, static_cast<std::size_t>(new_size)));
+  uint8_t* new_buffer;
+  if (shared_) {
+    // Readers keep the old buffer, so copy rather than realloc.
+    new_buffer = static_cast<uint8_t*>(std::malloc(static_cast<std::size_t>(new_size)));
+    if (new_buffer != nullptr) {
+      memcpy(new_buffer, buffer_, wBase_ - buffer_);
+    }
+  } else {
+    new_buffer = static_cast<uint8_t*>(std::realloc(buffer_, static_cast<std::size_t>(new_size)));
+  }
   if (new_buffer == nullptr) {
     throw std::bad_alloc();
   }
@@ -389,6 +495,30 @@ void TMemoryBuffer::ensureCanWrite(uint32_t len) {
   // Note: with realloc() we do not need to free the previous buffer:
   buffer_ = new_buffer;
   bufferSize_ = static_cast<uint32_t>(new_size);
+  shared_.reset();
+}
+
+std::shared_ptr<const void> TMemoryBuffer::shareReadBuffer() {
+  if (!owner_ || buffer_ == nullptr) {
+    return nullptr;
+  }
+  if (!shared_) {
+    shared_.reset(buffer_, [](uint8_t* buf) { std::free(buf); });
+  }
+  return shared_;
+}
+
+void TMemoryBuffer::replaceSharedBuffer() {
+  auto* new_buffer = static_cast<uint8_t*>(std::malloc(bufferSize_));
+  if (new_buffer == nullptr) {
+    throw std::bad_alloc();
+  }
+  buffer_ = new_buffer;
+  rBase_ = buffer_;
+  rBound_ = buffer_;
+  wBase_ = buffer_;
+  wBound_ = buffer_ + bufferSize_;
+  shared_.reset();
 }
 
 void TMemoryBuffer::writeSlow(const uint8_t* buf, uint32_t len) {
@@ -407,6 +537,18 @@ void TMemoryBuffer::wroteBytes(uint32_t len) {
   wBase_ += len;
 }
 
+uint8_t* TMemoryBuffer::reserveSlow(uint32_t* len) {
+  // Leave a buffer that cannot grow that far to write(), which may still
+  // fit the bytes actually encoded.
+  const uint64_t required = static_cast<uint64_t>(*len) + bufferSize_ - available_write();
+  if (!owner_ || required > maxBufferSize_) {
+    return nullptr;
+  }
+  ensureCanWrite(*len);
+  *len = available_write();
+  return wBase_;
+}
+
 const uint8_t* TMemoryBuffer::borrowSlow(uint8_t* buf, uint32_t* len) {
   (void)buf;
   rBound_ = wBase_;
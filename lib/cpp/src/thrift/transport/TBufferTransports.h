@@ -23,6 +23,7 @@
 #include <cstdlib>
 #include <cstring>
 #include <limits>
+#include <vector>
 
 #include <thrift/transport/TTransport.h>
 #include <thrift/transport/TVirtualTransport.h>
@@ -128,6 +129,28 @@ public:
     }
   }
 
+  /**
+   * Fast-path reserve.  Hands out the free space in the write buffer.
+   */
+  uint8_t* reserve(uint32_t* len) {
+    if (TDB_LIKELY(static_cast<ptrdiff_t>(*len) <= wBound_ - wBase_)) {
+      *len = static_cast<uint32_t>(wBound_ - wBase_);
+      return wBase_;
+    }
+    return reserveSlow(len);
+  }
+
+  /**
+   * Commit doesn't require a slow path either.
+   */
+  void commit(uint32_t len) {
+    if (TDB_LIKELY(static_cast<ptrdiff_t>(len) <= wBound_ - wBase_)) {
+      wBase_ += len;
+    } else {
+      throw TTransportException(TTransportException::BAD_ARGS, "commit did not follow a reserve.");
+    }
+  }
+
 protected:
   /// Slow path read.
   virtual uint32_t readSlow(uint8_t* buf, uint32_t len) = 0;
@@ -142,6 +165,17 @@ protected:
    */
   virtual const uint8_t* borrowSlow(uint8_t* buf, uint32_t* len) = 0;
 
+  /**
+   * Slow path reserve.  The default never makes room, leaving the caller
+   * to fall back to write().
+   *
+   * POSTCONDITION: return == nullptr || wBound_ - wBase_ >= *len
+   */
+  virtual uint8_t* reserveSlow(uint32_t* len) {
+    (void)len;
+    return nullptr;
+  }
+
   /**
    * Trivial constructor.
    *
@@ -261,6 +295,8 @@ public:
    */
   const uint8_t* borrowSlow(uint8_t* buf, uint32_t* len) override;
 
+  uint8_t* reserveSlow(uint32_t* len) override;
+
   std::shared_ptr<TTransport> getUnderlyingTransport() { return transport_; }
 
   /*
@@ -327,6 +363,7 @@ public:
       wBufSize_(DEFAULT_BUFFER_SIZE),
       rBuf_(),
       wBuf_(new uint8_t[wBufSize_]),
+      wChainBytes_(0),
       bufReclaimThresh_((std::numeric_limits<uint32_t>::max)()) {
     initPointers();
   }
@@ -338,6 +375,7 @@ public:
       wBufSize_(DEFAULT_BUFFER_SIZE),
       rBuf_(),
       wBuf_(new uint8_t[wBufSize_]),
+      wChainBytes_(0),
       bufReclaimThresh_((std::numeric_limits<uint32_t>::max)()),
       maxFrameSize_(configuration_->getMaxFrameSize()) {
     initPointers();
@@ -353,6 +391,7 @@ public:
       wBufSize_(sz),
       rBuf_(),
       wBuf_(new uint8_t[wBufSize_]),
+      wChainBytes_(0),
       bufReclaimThresh_(bufReclaimThresh),
       maxFrameSize_(configuration_->getMaxFrameSize()) {
     initPointers();
@@ -381,6 +420,19 @@ public:
 
   const uint8_t* borrowSlow(uint8_t* buf, uint32_t* len) override;
 
+  /**
+   * A frame outgrowing the write buffer is continued in a new, larger
+   * segment rather than copied over, and flush() sends the segments with a
+   * single writev() on the underlying transport.
+   */
+  uint8_t* reserveSlow(uint32_t* len) override;
+
+  /**
+   * Hands the current frame over to its readers.  The next frame is read
+   * into a fresh buffer.
+   */
+  std::shared_ptr<const void> shareReadBuffer() override;
+
   std::shared_ptr<TTransport> getUnderlyingTransport() { return transport_; }
 
   /*
@@ -404,6 +456,12 @@ public:
    */
   uint32_t getMaxFrameSize() { return maxFrameSize_; }
 
+  /**
+   * Set the size above which buffers are freed once a frame is done with
+   * them, instead of being kept for the next frame
+   */
+  void setBufReclaimThresh(uint32_t bufReclaimThresh) { bufReclaimThresh_ = bufReclaimThresh; }
+
 protected:
   /**
    * Reads a frame of input from the underlying stream.
@@ -413,6 +471,12 @@ protected:
    */
   virtual bool readFrame();
 
+  /**
+   * Grows the write buffer by copying, for subclasses that need the frame in
+   * one piece.
+   */
+  uint8_t* reserveContiguous(uint32_t* len);
+
   void initPointers() {
     setReadBuffer(nullptr, 0);
     setWriteBuffer(wBuf_.get(), wBufSize_);
@@ -428,6 +492,16 @@ protected:
   uint32_t wBufSize_;
   std::unique_ptr<uint8_t[]> rBuf_;
   std::unique_ptr<uint8_t[]> wBuf_;
+  // The segments of the frame being written before wBuf_, and their length.
+  struct WriteSegment {
+    WriteSegment(std::unique_ptr<uint8_t[]> d, uint32_t l) : data(std::move(d)), len(l) {}
+    std::unique_ptr<uint8_t[]> data;
+    uint32_t len;
+  };
+  std::vector<WriteSegment> wChain_;
+  uint32_t wChainBytes_;
+  // The current frame, once rBuf_ has been handed over by shareReadBuffer().
+  std::shared_ptr<uint8_t> rBufShared_;
   uint32_t bufReclaimThresh_;
   uint32_t maxFrameSize_;
 };
@@ -484,6 +558,7 @@ private:
     wBound_ = buffer_ + bufferSize_;
 
     owner_ = owner;
+    shared_.reset();
 
     // rBound_ is really an artifact.  In principle, it should always be
     // equal to wBase_.  We update it in a few places (computeRead, etc.).
@@ -567,7 +642,8 @@ public:
   }
 
   ~TMemoryBuffer() override {
-    if (owner_) {
+    // A shared buffer is freed by whoever lets go of it last.
+    if (owner_ && !shared_) {
       std::free(buffer_);
     }
   }
@@ -607,6 +683,11 @@ public:
   }
 
   void resetBuffer() {
+    // Readers may still be looking at a shared buffer, so don't overwrite it.
+    if (shared_) {
+      replaceSharedBuffer();
+      return;
+    }
     rBase_ = buffer_;
     rBound_ = buffer_;
     wBase_ = buffer_;
@@ -699,6 +780,13 @@ public:
    */
   uint32_t readAll(uint8_t* buf, uint32_t len) { return TBufferBase::readAll(buf, len); }
 
+  /**
+   * Shares a buffer this TMemoryBuffer owns.  Writes after that go on in the
+   * same buffer as long as they fit, and into a new one when it has to grow
+   * or is reset.  Observed buffers are not ours to share.
+   */
+  std::shared_ptr<const void> shareReadBuffer() override;
+
   //! \brief Get the current buffer size
   //! \returns the current buffer size
   uint32_t getBufferSize() const {
@@ -734,6 +822,7 @@ protected:
     swap(wBound_, that.wBound_);
 
     swap(owner_, that.owner_);
+    swap(shared_, that.shared_);
   }
 
   // Make sure there's at least 'len' bytes available for writing.
@@ -748,6 +837,11 @@ protected:
 
   const uint8_t* borrowSlow(uint8_t* buf, uint32_t* len) override;
 
+  uint8_t* reserveSlow(uint32_t* len) override;
+
+  // Start over in a new, empty buffer, leaving the shared one to its readers.
+  void replaceSharedBuffer();
+
   // Data buffer
   uint8_t* buffer_;
 
@@ -760,6 +854,10 @@ protected:
   // Is this object the owner of the buffer?
   bool owner_;
 
+  // Set once shareReadBuffer() has handed out buffer_, which from then on
+  // must be neither freed, reallocated nor rewritten by us.
+  std::shared_ptr<uint8_t> shared_;
+
   // Don't forget to update constrctors, initCommon, and swap if
   // you add new members.
 };
@@ -0,0 +1,304 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include <thrift/transport/TChainBuffer.h>
+
+namespace apache {
+namespace thrift {
+namespace transport {
+
+TChainBuffer::TChainBuffer(uint32_t segmentSize, std::shared_ptr<TConfiguration> config)
+  : TVirtualTransport(config), segmentSize_(segmentSize) {
+  if (segmentSize == 0) {
+    throw TTransportException(TTransportException::BAD_ARGS,
+                              "TChainBuffer given a zero segment size.");
+  }
+}
+
+void TChainBuffer::append(std::shared_ptr<const void> owner, const uint8_t* data, uint32_t len) {
+  if (len == 0) {
+    return;
+  }
+  endTail();
+  auto* begin = const_cast<uint8_t*>(data);
+  Segment segment = {std::move(owner), begin, begin + len};
+  chain_.push_back(std::move(segment));
+  refreshRead();
+}
+
+void TChainBuffer::append(const TChainBuffer& other) {
+  if (&other == this) {
+    std::shared_ptr<TChainBuffer> copy = clone();
+    append(*copy);
+    return;
+  }
+  for (size_t i = 0; i < other.chain_.size(); ++i) {
+    TIoVec vec = other.unread(i);
+    append(other.chain_[i].owner, vec.base, vec.len);
+  }
+}
+
+std::shared_ptr<TChainBuffer> TChainBuffer::clone() const {
+  std::shared_ptr<TChainBuffer> result = std::make_shared<TChainBuffer>(segmentSize_, configuration_);
+  result->append(*this);
+  return result;
+}
+
+std::shared_ptr<TChainBuffer> TChainBuffer::split(uint32_t len) {
+  if (len > available_read()) {
+    throw TTransportException(TTransportException::BAD_ARGS,
+                              "split beyond the end of the TChainBuffer.");
+  }
+  sync();
+  std::shared_ptr<TChainBuffer> result = std::make_shared<TChainBuffer>(segmentSize_, configuration_);
+  while (len > 0) {
+    Segment& head = chain_.front();
+    uint32_t give = (std::min)(len, static_cast<uint32_t>(head.end - head.begin));
+    result->append(head.owner, head.begin, give);
+    head.begin += give;
+    len -= give;
+    skipEmpty();
+  }
+  refreshRead();
+  return result;
+}
+
+void TChainBuffer::readFrom(TTransport& trans, uint32_t len) {
+  while (len > 0) {
+    uint32_t give = (std::min)(len, segmentSize_);
+    uint8_t* buf = reserve(&give);
+    give = (std::min)(len, give);
+    trans.readAll(buf, give);
+    commit(give);
+    len -= give;
+  }
+}
+
+void TChainBuffer::writeTo(TTransport& trans) {
+  std::vector<TIoVec> vecs;
+  vecs.reserve(chain_.size());
+  for (size_t i = 0; i < chain_.size(); ++i) {
+    TIoVec vec = unread(i);
+    if (vec.len > 0) {
+      vecs.push_back(vec);
+    }
+  }
+  if (vecs.empty()) {
+    return;
+  }
+  trans.writev(vecs.data(), static_cast<uint32_t>(vecs.size()));
+
+  // all of it is read now, only keep the segment being written to
+  sync();
+  if (wBound_ != nullptr) {
+    Segment tail = chain_.back();
+    tail.begin = tail.end;
+    chain_.clear();
+    chain_.push_back(std::move(tail));
+  } else {
+    chain_.clear();
+  }
+  refreshRead();
+}
+
+std::string TChainBuffer::getBufferAsString() const {
+  std::string str;
+  str.reserve(available_read());
+  for (size_t i = 0; i < chain_.size(); ++i) {
+    TIoVec vec = unread(i);
+    str.append(reinterpret_cast<const char*>(vec.base), vec.len);
+  }
+  return str;
+}
+
+void TChainBuffer::resetBuffer() {
+  sync();
+  // Start over in the segment being written to, unless it has been shared.
+  if (wBound_ != nullptr && chain_.back().owner.use_count() == 1) {
+    Segment tail = chain_.back();
+    tail.begin = static_cast<uint8_t*>(const_cast<void*>(tail.owner.get()));
+    tail.end = tail.begin;
+    chain_.clear();
+    chain_.push_back(tail);
+    setWriteBuffer(tail.begin, static_cast<uint32_t>(wBound_ - tail.begin));
+  } else {
+    chain_.clear();
+    setWriteBuffer(nullptr, 0);
+  }
+  refreshRead();
+}
+
+uint32_t TChainBuffer::available_read() const {
+  uint32_t total = 0;
+  for (size_t i = 0; i < chain_.size(); ++i) {
+    total += unread(i).len;
+  }
+  return total;
+}
+
+uint32_t TChainBuffer::readEnd() {
+  resetConsumedMessageSize();
+  if (available_read() == 0) {
+    resetBuffer();
+  }
+  return 0;
+}
+
+std::shared_ptr<const void> TChainBuffer::shareReadBuffer() {
+  // Nothing is moved: borrow() has put the bytes it returned in this segment
+  if (chain_.empty()) {
+    return nullptr;
+  }
+  return chain_.front().owner;
+}
+
+uint32_t TChainBuffer::readSlow(uint8_t* buf, uint32_t len) {
+  sync();
+  uint32_t got = 0;
+  while (got < len && !chain_.empty()) {
+    Segment& head = chain_.front();
+    uint32_t give = (std::min)(len - got, static_cast<uint32_t>(head.end - head.begin));
+    if (give == 0) {
+      if (chain_.size() == 1) {
+        break;
+      }
+      chain_.pop_front();
+      continue;
+    }
+    std::memcpy(buf + got, head.begin, give);
+    head.begin += give;
+    got += give;
+  }
+  skipEmpty();
+  refreshRead();
+  return got;
+}
+
+void TChainBuffer::writeSlow(const uint8_t* buf, uint32_t len) {
+  // fill up the segment being written to, the rest goes into a new one
+  auto space = static_cast<uint32_t>(wBound_ - wBase_);
+  if (space > 0) {
+    std::memcpy(wBase_, buf, space);
+    wBase_ += space;
+    buf += space;
+    len -= space;
+  }
+  addTail(len);
+  std::memcpy(wBase_, buf, len);
+  wBase_ += len;
+}
+
+const uint8_t* TChainBuffer::borrowSlow(uint8_t* buf, uint32_t* len) {
+  (void)buf;
+  sync();
+  skipEmpty();
+  refreshRead();
+  if (static_cast<uint32_t>(rBound_ - rBase_) < *len) {
+    if (available_read() < *len) {
+      return nullptr;
+    }
+    coalesce(*len);
+  }
+  *len = static_cast<uint32_t>(rBound_ - rBase_);
+  return rBase_;
+}
+
+uint8_t* TChainBuffer::reserveSlow(uint32_t* len) {
+  addTail(*len);
+  *len = static_cast<uint32_t>(wBound_ - wBase_);
+  return wBase_;
+}
+
+void TChainBuffer::sync() {
+  if (chain_.empty()) {
+    return;
+  }
+  chain_.front().begin = rBase_;
+  if (wBound_ != nullptr) {
+    chain_.back().end = wBase_;
+  }
+}
+
+void TChainBuffer::refreshRead() {
+  if (chain_.empty()) {
+    setReadBuffer(nullptr, 0);
+    return;
+  }
+  const Segment& head = chain_.front();
+  setReadBuffer(head.begin, static_cast<uint32_t>(head.end - head.begin));
+}
+
+void TChainBuffer::skipEmpty() {
+  while (!chain_.empty() && chain_.front().begin == chain_.front().end
+         && (chain_.size() > 1 || wBound_ == nullptr)) {
+    chain_.pop_front();
+  }
+}
+
+void TChainBuffer::addTail(uint32_t len) {
+  endTail();
+  uint32_t size = (std::max)(len, segmentSize_);
+  std::shared_ptr<uint8_t> block(new uint8_t[size], std::default_delete<uint8_t[]>());
+  Segment segment = {block, block.get(), block.get()};
+  chain_.push_back(std::move(segment));
+  setWriteBuffer(block.get(), size);
+  refreshRead();
+}
+
+void TChainBuffer::endTail() {
+  sync();
+  if (wBound_ != nullptr) {
+    if (chain_.back().begin == chain_.back().end) {
+      chain_.pop_back();
+    }
+    setWriteBuffer(nullptr, 0);
+  }
+  refreshRead();
+}
+
+void TChainBuffer::coalesce(uint32_t len) {
+  std::shared_ptr<uint8_t> block(new uint8_t[len], std::default_delete<uint8_t[]>());
+  uint32_t got = 0;
+  while (got < len) {
+    Segment& head = chain_.front();
+    uint32_t give = (std::min)(len - got, static_cast<uint32_t>(head.end - head.begin));
+    std::memcpy(block.get() + got, head.begin, give);
+    head.begin += give;
+    got += give;
+    skipEmpty();
+  }
+  Segment segment = {block, block.get(), block.get() + len};
+  chain_.push_front(std::move(segment));
+  refreshRead();
+}
+
+TIoVec TChainBuffer::unread(size_t i) const {
+  const Segment& segment = chain_[i];
+  const uint8_t* begin = i == 0 ? rBase_ : segment.begin;
+  const uint8_t* end = i + 1 == chain_.size() && wBound_ != nullptr ? wBase_ : segment.end;
+  TIoVec vec = {begin, static_cast<uint32_t>(end - begin)};
+  return vec;
+}
+}
+}
+} // apache::thrift::transport
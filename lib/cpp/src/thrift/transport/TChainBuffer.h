@@ -0,0 +1,185 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _THRIFT_TRANSPORT_TCHAINBUFFER_H_
+#define _THRIFT_TRANSPORT_TCHAINBUFFER_H_ 1
+
+#include <deque>
+#include <memory>
+#include <string>
+
+#include <thrift/transport/TBufferTransports.h>
+
+namespace apache {
+namespace thrift {
+namespace transport {
+
+/**
+ * An in-memory buffer made of a chain of reference counted segments.
+ *
+ * Unlike TMemoryBuffer it never reallocates or moves what has been written.
+ * Writes fill the last segment and go on in a new one when it is full.
+ * Memory owned by someone else can be appended without copying it, and a
+ * chain can hand out slices of itself (see clone() and split()) that share
+ * its segments, e.g. to forward a payload somewhere else without copying.
+ * Bytes that have been written are never written over, so slices and
+ * buffers handed out by shareReadBuffer() stay valid while this buffer goes
+ * on being used.
+ *
+ * Reads, writes, borrow() and reserve() within a segment take the inlined
+ * TBufferBase fast paths.  A borrow() that spans segments copies just the
+ * bytes asked for into a segment of their own.
+ */
+class TChainBuffer : public TVirtualTransport<TChainBuffer, TBufferBase> {
+public:
+  static const uint32_t defaultSegmentSize = 4096;
+
+  /**
+   * Construct an empty buffer.
+   *
+   * @param segmentSize  The size of the segments that writes allocate.
+   */
+  TChainBuffer(uint32_t segmentSize = defaultSegmentSize,
+               std::shared_ptr<TConfiguration> config = nullptr);
+
+  bool isOpen() const override { return true; }
+
+  bool peek() override { return available_read() > 0; }
+
+  void open() override {}
+
+  void close() override {}
+
+  /**
+   * Appends len bytes at data without copying them.  They must stay valid
+   * and unchanged as long as owner is alive.
+   */
+  void append(std::shared_ptr<const void> owner, const uint8_t* data, uint32_t len);
+
+  /**
+   * Appends the unread bytes of other by sharing its segments.  other is
+   * left as it was.
+   */
+  void append(const TChainBuffer& other);
+
+  /**
+   * Returns a new buffer holding the unread bytes of this one, sharing its
+   * segments.  This buffer is left as it was.
+   */
+  std::shared_ptr<TChainBuffer> clone() const;
+
+  /**
+   * Moves the next len unread bytes into a new buffer, sharing the segments
+   * they are in.
+   *
+   * @throws TTransportException if fewer than len bytes are unread
+   */
+  std::shared_ptr<TChainBuffer> split(uint32_t len);
+
+  /**
+   * Reads exactly len bytes from trans into the end of this buffer.
+   */
+  void readFrom(TTransport& trans, uint32_t len);
+
+  /**
+   * Writes all unread bytes to trans with a single writev() and consumes
+   * them.
+   */
+  void writeTo(TTransport& trans);
+
+  /**
+   * Copies the unread bytes into a string, leaving them unread.
+   */
+  std::string getBufferAsString() const;
+
+  /**
+   * Drops all bytes, read or not.
+   */
+  void resetBuffer();
+
+  uint32_t available_read() const;
+
+  /// The number of segments in the chain, including ones already read.
+  size_t getSegmentCount() const { return chain_.size(); }
+
+  uint32_t getSegmentSize() const { return segmentSize_; }
+
+  /**
+   * Once everything has been read, lets writes start over at the beginning
+   * of the last segment if nobody else refers to it.
+   */
+  uint32_t readEnd() override;
+
+  /*
+   * TVirtualTransport provides a default implementation of readAll().
+   * We want to use the TBufferBase version instead.
+   */
+  uint32_t readAll(uint8_t* buf, uint32_t len) { return TBufferBase::readAll(buf, len); }
+
+  /**
+   * Shares the segment the next bytes are read from, which holds the bytes
+   * the last borrow() returned.  Unread bytes in the segments after it are
+   * not covered.
+   */
+  std::shared_ptr<const void> shareReadBuffer() override;
+
+protected:
+  struct Segment {
+    std::shared_ptr<const void> owner;
+    uint8_t* begin;
+    uint8_t* end;
+  };
+
+  uint32_t readSlow(uint8_t* buf, uint32_t len) override;
+  void writeSlow(const uint8_t* buf, uint32_t len) override;
+  const uint8_t* borrowSlow(uint8_t* buf, uint32_t* len) override;
+  uint8_t* reserveSlow(uint32_t* len) override;
+
+  // Store the read and write positions in the first and last segment.
+  void sync();
+
+  // Point the read buffer at the first segment.
+  void refreshRead();
+
+  // Drop read segments at the front, but not the one being written to.
+  void skipEmpty();
+
+  // Start a new last segment of at least len bytes to write into.
+  void addTail(uint32_t len);
+
+  // Stop writing into the last segment, e.g. because bytes follow it.
+  void endTail();
+
+  // Copy the next len unread bytes into a single new first segment.
+  void coalesce(uint32_t len);
+
+  // The unread part of segment i.
+  TIoVec unread(size_t i) const;
+
+  // The segments, the first one read from.  The last one is written to as
+  // long as wBound_ is set.  Only the first and last one may be empty.
+  std::deque<Segment> chain_;
+
+  uint32_t segmentSize_;
+};
+}
+}
+} // apache::thrift::transport
+
+#endif // #ifndef _THRIFT_TRANSPORT_TCHAINBUFFER_H_
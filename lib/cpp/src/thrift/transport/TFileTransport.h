@@ -193,6 +193,11 @@ public:
   uint32_t getNumChunks() override;
   uint32_t getCurChunk() override;
 
+  // bytes of the event being read that read() has not returned yet
+  uint32_t getCurrentEventRemaining() const {
+    return currentEvent_ ? currentEvent_->eventSize_ - currentEvent_->eventBuffPos_ : 0;
+  }
+
   // for changing the output file
   void resetOutputFile(int fd, std::string filename, off_t offset);
 
@@ -23,11 +23,20 @@
 #include <thrift/protocol/TBinaryProtocol.h>
 #include <thrift/protocol/TCompactProtocol.h>
 
+#include <cstdlib>
 #include <limits>
+#include <new>
 #include <utility>
 #include <string>
 #include <string.h>
 #include <zlib.h>
+#ifdef HAVE_ZSTD_H
+#include <zstd.h>
+#include <thrift/transport/TZstdTransport.h>
+#endif
+#ifdef HAVE_LZ4FRAME_H
+#include <lz4frame.h>
+#endif
 
 using std::map;
 using std::string;
@@ -43,6 +52,27 @@ namespace transport {
 using namespace apache::thrift::protocol;
 using apache::thrift::protocol::TBinaryProtocol;
 
+const char* const THeaderTransport::ZSTD_DICT_HEADER = "zstd_dict";
+
+THeaderTransport::~THeaderTransport() {
+#ifdef HAVE_ZSTD_H
+  ZSTD_freeCCtx(zstdCCtx_);
+  ZSTD_freeDCtx(zstdDCtx_);
+#endif
+}
+
+void THeaderTransport::setZstdDictionary(const shared_ptr<TZstdDictionary>& dict) {
+  zstdWriteDict_ = dict;
+}
+
+void THeaderTransport::addZstdDictionary(const shared_ptr<TZstdDictionary>& dict) {
+#ifdef HAVE_ZSTD_H
+  zstdReadDicts_[dict->getId()] = dict;
+#else
+  (void)dict;
+#endif
+}
+
 uint32_t THeaderTransport::readSlow(uint8_t* buf, uint32_t len) {
   if (clientType == THRIFT_UNFRAMED_BINARY || clientType == THRIFT_UNFRAMED_COMPACT) {
     return transport_->read(buf, len);
@@ -298,15 +328,123 @@ void THeaderTransport::untransform(uint8_t* ptr, uint32_t sz) {
                                     "Error while zlib deflateEnd");
       }
 
+      // As below, the result may not fit where the compressed data was.
+      ensureReadBuffer(sz);
+      ptr = rBuf_.get();
+      memcpy(ptr, tBuf_.get(), sz);
+#ifdef HAVE_ZSTD_H
+    } else if (transId == ZSTD_TRANSFORM) {
+      // Frames are compressed in one go, so they say how big they are.
+      unsigned long long size = ZSTD_getFrameContentSize(ptr, sz);
+      if (size == ZSTD_CONTENTSIZE_UNKNOWN || size == ZSTD_CONTENTSIZE_ERROR) {
+        throw TApplicationException(TApplicationException::MISSING_RESULT,
+                                    "Error while zstd decompress");
+      }
+      checkUntransformedSize(size);
+      if (zstdDCtx_ == nullptr) {
+        zstdDCtx_ = ZSTD_createDCtx();
+        if (zstdDCtx_ == nullptr) {
+          throw std::bad_alloc();
+        }
+      }
+      ensureTransformBuffer(static_cast<uint32_t>(size));
+      size_t got;
+      auto dictHeader = readHeaders_.find(ZSTD_DICT_HEADER);
+      if (dictHeader != readHeaders_.end()) {
+        TZstdDictionary* dict = findZstdDictionary(dictHeader->second);
+        if (dict == nullptr) {
+          throw TApplicationException(TApplicationException::MISSING_RESULT,
+                                      "Unknown zstd dictionary " + dictHeader->second);
+        }
+        got = ZSTD_decompress_usingDDict(zstdDCtx_, tBuf_.get(), tBufSize_, ptr, sz,
+                                         dict->getDDict());
+      } else {
+        got = ZSTD_decompressDCtx(zstdDCtx_, tBuf_.get(), tBufSize_, ptr, sz);
+      }
+      if (ZSTD_isError(got) || got != size) {
+        throw TApplicationException(TApplicationException::MISSING_RESULT,
+                                    "Error while zstd decompress");
+      }
+      sz = static_cast<uint32_t>(got);
+
+      // The result may not fit where the compressed data was, but the rest
+      // of the frame has been read already.
+      ensureReadBuffer(sz);
+      ptr = rBuf_.get();
+      memcpy(ptr, tBuf_.get(), sz);
+#endif
+#ifdef HAVE_LZ4FRAME_H
+    } else if (transId == LZ4_TRANSFORM) {
+      LZ4F_dctx* dctx;
+      if (LZ4F_isError(LZ4F_createDecompressionContext(&dctx, LZ4F_VERSION))) {
+        throw TApplicationException(TApplicationException::MISSING_RESULT,
+                                    "Error while lz4 decompress");
+      }
+      std::unique_ptr<LZ4F_dctx, LZ4F_errorCode_t (*)(LZ4F_dctx*)>
+          guard(dctx, LZ4F_freeDecompressionContext);
+
+      // Frames are compressed in one go, so they say how big they are.
+      LZ4F_frameInfo_t info;
+      size_t in = sz;
+      size_t rv = LZ4F_getFrameInfo(dctx, &info, ptr, &in);
+      if (LZ4F_isError(rv)) {
+        throw TApplicationException(TApplicationException::MISSING_RESULT,
+                                    "Error while lz4 decompress");
+      }
+      checkUntransformedSize(info.contentSize);
+      ensureTransformBuffer(static_cast<uint32_t>(info.contentSize));
+      size_t out = static_cast<size_t>(info.contentSize);
+      size_t rest = sz - in;
+      rv = LZ4F_decompress(dctx, tBuf_.get(), &out, ptr + in, &rest, nullptr);
+      if (rv != 0 || out != info.contentSize || in + rest != sz) {
+        throw TApplicationException(TApplicationException::MISSING_RESULT,
+                                    "Error while lz4 decompress");
+      }
+      sz = static_cast<uint32_t>(out);
+
+      ensureReadBuffer(sz);
+      ptr = rBuf_.get();
       memcpy(ptr, tBuf_.get(), sz);
+#endif
     } else {
       throw TApplicationException(TApplicationException::MISSING_RESULT, "Unknown transform");
     }
   }
 
+  // The data is in rBuf_ now.  Let go of a transform buffer that a large
+  // frame has grown, as TFramedTransport::readEnd() does with rBuf_.
+  if (tBufSize_ > bufReclaimThresh_) {
+    tBuf_.reset();
+    tBufSize_ = 0;
+  }
+
   setReadBuffer(ptr, sz);
 }
 
+void THeaderTransport::checkUntransformedSize(uint64_t size) {
+  if (size > getMaxFrameSize() || size > MAX_FRAME_SIZE) {
+    throw TTransportException(TTransportException::CORRUPTED_DATA,
+                              "Header transport frame is too large");
+  }
+}
+
+TZstdDictionary* THeaderTransport::findZstdDictionary(const string& id) const {
+  char* end;
+  unsigned long value = strtoul(id.c_str(), &end, 10);
+  if (id.empty() || *end != '\0' || value > (std::numeric_limits<uint32_t>::max)()) {
+    return nullptr;
+  }
+  auto it = zstdReadDicts_.find(static_cast<uint32_t>(value));
+  return it == zstdReadDicts_.end() ? nullptr : it->second.get();
+}
+
+void THeaderTransport::ensureTransformBuffer(uint32_t sz) {
+  if (sz > tBufSize_) {
+    tBuf_.reset(new uint8_t[sz]);
+    tBufSize_ = sz;
+  }
+}
+
 /**
  * We may have updated the wBuf size, update the tBuf size to match.
  * Should be called in transform.
@@ -363,14 +501,67 @@ void THeaderTransport::transform(uint8_t* ptr, uint32_t sz) {
       }
 
       memcpy(ptr, tBuf_.get(), sz);
+#ifdef HAVE_ZSTD_H
+    } else if (transId == ZSTD_TRANSFORM) {
+      if (zstdCCtx_ == nullptr) {
+        zstdCCtx_ = ZSTD_createCCtx();
+        if (zstdCCtx_ == nullptr) {
+          throw std::bad_alloc();
+        }
+      }
+      ensureTransformBuffer(static_cast<uint32_t>(ZSTD_compressBound(sz)));
+      size_t got;
+      if (zstdWriteDict_) {
+        got = ZSTD_compress_usingCDict(zstdCCtx_, tBuf_.get(), tBufSize_, ptr, sz,
+                                       zstdWriteDict_->getCDict());
+        writeHeaders_[ZSTD_DICT_HEADER] = std::to_string(zstdWriteDict_->getId());
+      } else {
+        got = ZSTD_compressCCtx(zstdCCtx_, tBuf_.get(), tBufSize_, ptr, sz, ZSTD_CLEVEL_DEFAULT);
+      }
+      if (ZSTD_isError(got)) {
+        throw TTransportException(TTransportException::CORRUPTED_DATA,
+                                  "Error while zstd compress");
+      }
+      sz = static_cast<uint32_t>(got);
+      ptr = storeTransformed(sz);
+#endif
+#ifdef HAVE_LZ4FRAME_H
+    } else if (transId == LZ4_TRANSFORM) {
+      LZ4F_preferences_t prefs;
+      memset(&prefs, 0, sizeof(prefs));
+      prefs.frameInfo.contentSize = sz;
+      ensureTransformBuffer(static_cast<uint32_t>(LZ4F_compressFrameBound(sz, &prefs)));
+      size_t got = LZ4F_compressFrame(tBuf_.get(), tBufSize_, ptr, sz, &prefs);
+      if (LZ4F_isError(got)) {
+        throw TTransportException(TTransportException::CORRUPTED_DATA,
+                                  "Error while lz4 compress");
+      }
+      sz = static_cast<uint32_t>(got);
+      ptr = storeTransformed(sz);
+#endif
     } else {
       throw TTransportException(TTransportException::CORRUPTED_DATA, "Unknown transform");
     }
   }
 
+  // The write buffer may have grown, flush() builds the frame in tBuf_.
+  resizeTransformBuffer();
   wBase_ = wBuf_.get() + sz;
 }
 
+uint8_t* THeaderTransport::storeTransformed(uint32_t sz) {
+  // Incompressible data grows a little, which may not fit the write buffer.
+  // Only wBuf_ may grow here: tBuf_ still holds the bytes to copy, and the
+  // next transform sizes it again before use.
+  if (sz > wBufSize_) {
+    wBase_ = wBuf_.get();
+    uint32_t want = sz;
+    reserveContiguous(&want);
+  }
+  memcpy(wBuf_.get(), tBuf_.get(), sz);
+  return wBuf_.get();
+}
+
 void THeaderTransport::resetProtocol() {
   // Set to anything except HTTP type so we don't flush again
   clientType = THRIFT_HEADER_CLIENT_TYPE;
@@ -38,6 +38,9 @@
 #include <thrift/transport/TTransport.h>
 #include <thrift/transport/TVirtualTransport.h>
 
+struct ZSTD_CCtx_s;
+struct ZSTD_DCtx_s;
+
 enum CLIENT_TYPE {
   THRIFT_HEADER_CLIENT_TYPE = 0,
   THRIFT_FRAMED_BINARY = 1,
@@ -53,6 +56,8 @@ namespace transport {
 
 using apache::thrift::protocol::T_COMPACT_PROTOCOL;
 
+class TZstdDictionary;
+
 /**
  * Header transport. All writes go into an in-memory buffer until flush is
  * called, at which point the transport writes the length of the entire
@@ -81,7 +86,9 @@ public:
       seqId(0),
       flags(0),
       tBufSize_(0),
-      tBuf_(nullptr) {
+      tBuf_(nullptr),
+      zstdCCtx_(nullptr),
+      zstdDCtx_(nullptr) {
     if (!transport_) throw std::invalid_argument("transport is empty");
     initBuffers();
   }
@@ -96,13 +103,36 @@ public:
       seqId(0),
       flags(0),
       tBufSize_(0),
-      tBuf_(nullptr) {
+      tBuf_(nullptr),
+      zstdCCtx_(nullptr),
+      zstdDCtx_(nullptr) {
     if (!transport_) throw std::invalid_argument("inTransport is empty");
     if (!outTransport_) throw std::invalid_argument("outTransport is empty");
     initBuffers();
   }
 
+  ~THeaderTransport() override;
+
   uint32_t readSlow(uint8_t* buf, uint32_t len) override;
+
+  /**
+   * The read buffer is reused while untransforming frames, so it is never
+   * shared.
+   */
+  std::shared_ptr<const void> shareReadBuffer() override { return nullptr; }
+
+  /**
+   * Transforms and headers work on the whole frame, so unlike in
+   * TFramedTransport it is kept in a single buffer.
+   */
+  void writeSlow(const uint8_t* buf, uint32_t len) override {
+    uint32_t space = len;
+    reserveContiguous(&space);
+    memcpy(wBase_, buf, len);
+    wBase_ += len;
+  }
+  uint8_t* reserveSlow(uint32_t* len) override { return reserveContiguous(len); }
+
   void flush() override;
 
   void resizeTransformBuffer(uint32_t additionalSize = 0);
@@ -146,6 +176,20 @@ public:
 
   void setTransform(uint16_t transId) { writeTrans_.push_back(transId); }
 
+  /**
+   * Compress with a dictionary the peer has too, when applying the
+   * ZSTD_TRANSFORM.  Its id goes in the ZSTD_DICT_HEADER info header of each
+   * frame, so nullptr, the default, goes back to frames without one.
+   */
+  void setZstdDictionary(const std::shared_ptr<TZstdDictionary>& dict);
+
+  /**
+   * Make a dictionary available for reading ZSTD_TRANSFORM frames.  Several
+   * versions may be added, so that peers can move to a new one at their own
+   * pace.
+   */
+  void addZstdDictionary(const std::shared_ptr<TZstdDictionary>& dict);
+
   // Info headers
 
   typedef std::map<std::string, std::string> StringToStringMap;
@@ -164,10 +208,22 @@ public:
   int32_t getSequenceNumber() const { return seqId; }
   void setSequenceNumber(int32_t seqId) { this->seqId = seqId; }
 
+  /**
+   * Transforms a peer may apply to the payload.  The ids are the ones other
+   * header transport implementations use, 0x02 to 0x04 are taken there.
+   * ZSTD_TRANSFORM and LZ4_TRANSFORM are only available when thriftz was
+   * built with zstd and lz4 respectively, otherwise they are rejected as
+   * unknown.
+   */
   enum TRANSFORMS {
     ZLIB_TRANSFORM = 0x01,
+    ZSTD_TRANSFORM = 0x05,
+    LZ4_TRANSFORM = 0x06,
   };
 
+  /// Info header naming the dictionary a ZSTD_TRANSFORM frame was made with
+  static const char* const ZSTD_DICT_HEADER;
+
 protected:
   /**
    * Reads a frame of input from the underlying stream.
@@ -178,6 +234,19 @@ protected:
   bool readFrame() override;
 
   void ensureReadBuffer(uint32_t sz);
+  void ensureTransformBuffer(uint32_t sz);
+  /**
+   * Throws unless a frame a peer says is size bytes once decompressed is
+   * within the frame size limit, before anything is allocated for it.
+   */
+  void checkUntransformedSize(uint64_t size);
+  TZstdDictionary* findZstdDictionary(const std::string& id) const;
+
+  /**
+   * Moves sz transformed bytes from the transform buffer to the start of the
+   * write buffer, growing it if needed, and returns where they are now.
+   */
+  uint8_t* storeTransformed(uint32_t sz);
   uint32_t getWriteBytes();
 
   void initBuffers() {
@@ -223,6 +292,12 @@ protected:
   uint32_t tBufSize_;
   std::unique_ptr<uint8_t[]> tBuf_;
 
+  // zstd contexts are kept across frames, they are costly to set up
+  struct ZSTD_CCtx_s* zstdCCtx_;
+  struct ZSTD_DCtx_s* zstdDCtx_;
+  std::shared_ptr<TZstdDictionary> zstdWriteDict_;
+  std::map<uint32_t, std::shared_ptr<TZstdDictionary> > zstdReadDicts_;
+
   void readString(uint8_t*& ptr, /* out */ std::string& str, uint8_t const* headerBoundary);
 
   void writeString(uint8_t*& ptr, const std::string& str);
@@ -265,8 +340,22 @@ public:
    * Wraps the transport into a header one.
    */
   std::shared_ptr<TTransport> getTransport(std::shared_ptr<TTransport> trans) override {
-    return std::shared_ptr<TTransport>(new THeaderTransport(trans));
+    std::shared_ptr<THeaderTransport> header(new THeaderTransport(trans));
+    for (const auto& dict : zstdDicts_) {
+      header->addZstdDictionary(dict);
+    }
+    return header;
+  }
+
+  /**
+   * Transports made from now on can read frames compressed with dict.
+   */
+  void addZstdDictionary(const std::shared_ptr<TZstdDictionary>& dict) {
+    zstdDicts_.push_back(dict);
   }
+
+protected:
+  std::vector<std::shared_ptr<TZstdDictionary> > zstdDicts_;
 };
 }
 }
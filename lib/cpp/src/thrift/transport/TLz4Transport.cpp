@@ -0,0 +1,418 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <cassert>
+#include <cstring>
+#include <algorithm>
+// The dictionary functions are only declared for static linking before lz4 1.10.
+#define LZ4F_STATIC_LINKING_ONLY
+#include <lz4frame.h>
+#include <thrift/TToString.h>
+#include <thrift/transport/TLz4Transport.h>
+
+namespace apache {
+namespace thrift {
+namespace transport {
+
+namespace {
+
+// Use 64KB blocks that refer to the blocks before them, as that compresses
+// best, and checksum the whole frame like zlib and zstd do.
+LZ4F_preferences_t lz4Preferences(int comp_level) {
+  LZ4F_preferences_t prefs;
+  memset(&prefs, 0, sizeof(prefs));
+  prefs.frameInfo.blockSizeID = LZ4F_max64KB;
+  prefs.frameInfo.blockMode = LZ4F_blockLinked;
+  prefs.frameInfo.contentChecksumFlag = LZ4F_contentChecksumEnabled;
+  prefs.compressionLevel = comp_level;
+  return prefs;
+}
+}
+
+TLz4Transport::TLz4Transport(std::shared_ptr<TTransport> transport,
+                             int urbuf_size,
+                             int crbuf_size,
+                             int uwbuf_size,
+                             int cwbuf_size,
+                             int comp_level,
+                             const std::string& dictionary,
+                             std::shared_ptr<TConfiguration> config)
+  : TVirtualTransport(config),
+    transport_(transport),
+    urpos_(0),
+    urlen_(0),
+    crpos_(0),
+    crlen_(0),
+    uwpos_(0),
+    cwpos_(0),
+    input_ended_(false),
+    output_finished_(false),
+    rflushing_(false),
+    output_started_(false),
+    urbuf_size_(urbuf_size),
+    crbuf_size_(crbuf_size),
+    uwbuf_size_(uwbuf_size),
+    cwbuf_size_(0),
+    urbuf_(nullptr),
+    crbuf_(nullptr),
+    uwbuf_(nullptr),
+    cwbuf_(nullptr),
+    cwbound_(0),
+    comp_level_(comp_level),
+    dictionary_(dictionary),
+    rctx_(nullptr),
+    wctx_(nullptr),
+    cdict_(nullptr) {
+  if (uwbuf_size_ < MIN_DIRECT_COMPRESS_SIZE) {
+    // Have to copy this into a local because of a linking issue.
+    uint32_t minimum = MIN_DIRECT_COMPRESS_SIZE;
+    throw TTransportException(TTransportException::BAD_ARGS,
+                              "TLz4Transport: uncompressed write buffer must be at least "
+                              + to_string(minimum) + ".");
+  }
+
+  LZ4F_preferences_t prefs = lz4Preferences(comp_level_);
+  cwbound_ = LZ4F_compressBound(MAX_COMPRESS_CHUNK, &prefs);
+  cwbuf_size_ = static_cast<uint32_t>(cwbuf_size + cwbound_);
+
+  try {
+    urbuf_ = new uint8_t[urbuf_size];
+    crbuf_ = new uint8_t[crbuf_size];
+    uwbuf_ = new uint8_t[uwbuf_size];
+    cwbuf_ = new uint8_t[cwbuf_size_];
+
+    checkLz4Rv(LZ4F_createDecompressionContext(&rctx_, LZ4F_VERSION));
+    checkLz4Rv(LZ4F_createCompressionContext(&wctx_, LZ4F_VERSION));
+    if (!dictionary_.empty()) {
+      cdict_ = LZ4F_createCDict(dictionary_.data(), dictionary_.size());
+      if (cdict_ == nullptr) {
+        throw std::bad_alloc();
+      }
+    }
+  } catch (...) {
+    LZ4F_freeCDict(cdict_);
+    LZ4F_freeDecompressionContext(rctx_);
+    LZ4F_freeCompressionContext(wctx_);
+    delete[] urbuf_;
+    delete[] crbuf_;
+    delete[] uwbuf_;
+    delete[] cwbuf_;
+    throw;
+  }
+}
+
+void TLz4Transport::checkLz4Rv(size_t rv) {
+  if (LZ4F_isError(rv)) {
+    throw TLz4TransportException(rv, LZ4F_getErrorName(rv));
+  }
+}
+
+TLz4Transport::~TLz4Transport() {
+  // Like TZlibTransport, data written but not flushed is silently discarded.
+  LZ4F_freeCDict(cdict_);
+  LZ4F_freeDecompressionContext(rctx_);
+  LZ4F_freeCompressionContext(wctx_);
+
+  delete[] urbuf_;
+  delete[] crbuf_;
+  delete[] uwbuf_;
+  delete[] cwbuf_;
+}
+
+bool TLz4Transport::isOpen() const {
+  return (readAvail() > 0) || readPending() || transport_->isOpen();
+}
+
+bool TLz4Transport::peek() {
+  return (readAvail() > 0) || readPending() || transport_->peek();
+}
+
+// READING STRATEGY
+//
+// The same as in TZstdTransport.  lz4 also decompresses whole blocks and may
+// hold on to what it had no room for.
+
+uint32_t TLz4Transport::read(uint8_t* buf, uint32_t len) {
+  checkReadBytesAvailable(len);
+  uint32_t need = len;
+
+  while (true) {
+    // Copy out whatever we have available.
+    uint32_t give = (std::min)(readAvail(), need);
+    memcpy(buf, urbuf_ + urpos_, give);
+    need -= give;
+    buf += give;
+    urpos_ += give;
+
+    // If they were satisfied, we are done.
+    if (need == 0) {
+      return len;
+    }
+
+    // read() is only allowed to block when no data is available, so return
+    // what we have if getting more means reading the underlying transport.
+    if (need < len && !readPending()) {
+      return len - need;
+    }
+
+    // If lz4 has reported the end of the frame, we can't do any more.
+    if (input_ended_) {
+      return len - need;
+    }
+
+    uint32_t got;
+    if (need >= urbuf_size_) {
+      if (!readFromLz4(buf, need, &got)) {
+        return len - need;
+      }
+      need -= got;
+      buf += got;
+    } else {
+      urpos_ = 0;
+      if (!readFromLz4(urbuf_, urbuf_size_, &urlen_)) {
+        urlen_ = 0;
+        return len - need;
+      }
+    }
+  }
+}
+
+bool TLz4Transport::readFromLz4(uint8_t* buf, uint32_t len, uint32_t* got) {
+  assert(!input_ended_);
+
+  // If we don't have any more compressed data available and lz4 has
+  // nothing left to give, read some from the underlying transport.
+  if (!readPending()) {
+    uint32_t n = transport_->read(crbuf_, crbuf_size_);
+    if (n == 0) {
+      return false;
+    }
+    crpos_ = 0;
+    crlen_ = n;
+  }
+
+  size_t in = crlen_ - crpos_;
+  size_t out = len;
+  size_t rv;
+  if (dictionary_.empty()) {
+    rv = LZ4F_decompress(rctx_, buf, &out, crbuf_ + crpos_, &in, nullptr);
+  } else {
+    rv = LZ4F_decompress_usingDict(rctx_, buf, &out, crbuf_ + crpos_, &in,
+                                   dictionary_.data(), dictionary_.size(), nullptr);
+  }
+  checkLz4Rv(rv);
+  crpos_ += static_cast<uint32_t>(in);
+  *got = static_cast<uint32_t>(out);
+  rflushing_ = out == len;
+
+  // lz4 returns how much input it would like next, which is none at the end
+  // of the frame, once the checksum has been verified.
+  if (rv == 0) {
+    input_ended_ = true;
+  }
+  return true;
+}
+
+// WRITING STRATEGY
+//
+// The same as in TZstdTransport, except that lz4 has to be given enough room
+// for its output up front.  reserveLz4Output() makes sure it has.
+
+void TLz4Transport::write(const uint8_t* buf, uint32_t len) {
+  if (output_finished_) {
+    throw TTransportException(TTransportException::BAD_ARGS, "write() called after finish()");
+  }
+
+  if (len > MIN_DIRECT_COMPRESS_SIZE) {
+    flushToLz4(uwbuf_, uwpos_, FLUSH_NONE);
+    uwpos_ = 0;
+    flushToLz4(buf, len, FLUSH_NONE);
+  } else if (len > 0) {
+    if (uwbuf_size_ - uwpos_ < len) {
+      flushToLz4(uwbuf_, uwpos_, FLUSH_NONE);
+      uwpos_ = 0;
+    }
+    memcpy(uwbuf_ + uwpos_, buf, len);
+    uwpos_ += len;
+  }
+}
+
+void TLz4Transport::flush() {
+  if (output_finished_) {
+    throw TTransportException(TTransportException::BAD_ARGS, "flush() called after finish()");
+  }
+
+  flushToTransport(FLUSH_BLOCK);
+  resetConsumedMessageSize();
+}
+
+void TLz4Transport::finish() {
+  if (output_finished_) {
+    throw TTransportException(TTransportException::BAD_ARGS, "finish() called more than once");
+  }
+
+  flushToTransport(FLUSH_FRAME);
+  output_finished_ = true;
+}
+
+void TLz4Transport::flushToTransport(int mode) {
+  // write pending data in uwbuf_ to lz4
+  flushToLz4(uwbuf_, uwpos_, mode);
+  uwpos_ = 0;
+
+  // write all available data from lz4 to the transport
+  transport_->write(cwbuf_, cwpos_);
+  cwpos_ = 0;
+
+  // flush the transport
+  transport_->flush();
+}
+
+void TLz4Transport::reserveLz4Output(size_t len) {
+  if (cwbuf_size_ - cwpos_ < len) {
+    transport_->write(cwbuf_, cwpos_);
+    cwpos_ = 0;
+  }
+}
+
+void TLz4Transport::flushToLz4(const uint8_t* buf, uint32_t len, int mode) {
+  if (len == 0 && mode == FLUSH_NONE) {
+    return;
+  }
+
+  size_t rv;
+  if (!output_started_) {
+    LZ4F_preferences_t prefs = lz4Preferences(comp_level_);
+    reserveLz4Output(LZ4F_HEADER_SIZE_MAX);
+    if (cdict_ != nullptr) {
+      rv = LZ4F_compressBegin_usingCDict(wctx_, cwbuf_ + cwpos_, cwbuf_size_ - cwpos_, cdict_,
+                                         &prefs);
+    } else {
+      rv = LZ4F_compressBegin(wctx_, cwbuf_ + cwpos_, cwbuf_size_ - cwpos_, &prefs);
+    }
+    checkLz4Rv(rv);
+    cwpos_ += static_cast<uint32_t>(rv);
+    output_started_ = true;
+  }
+
+  uint32_t max_chunk = MAX_COMPRESS_CHUNK;
+  while (len > 0) {
+    uint32_t chunk = (std::min)(len, max_chunk);
+    reserveLz4Output(cwbound_);
+    rv = LZ4F_compressUpdate(wctx_, cwbuf_ + cwpos_, cwbuf_size_ - cwpos_, buf, chunk, nullptr);
+    checkLz4Rv(rv);
+    cwpos_ += static_cast<uint32_t>(rv);
+    buf += chunk;
+    len -= chunk;
+  }
+
+  if (mode == FLUSH_BLOCK) {
+    reserveLz4Output(cwbound_);
+    rv = LZ4F_flush(wctx_, cwbuf_ + cwpos_, cwbuf_size_ - cwpos_, nullptr);
+    checkLz4Rv(rv);
+    cwpos_ += static_cast<uint32_t>(rv);
+  } else if (mode == FLUSH_FRAME) {
+    reserveLz4Output(cwbound_);
+    rv = LZ4F_compressEnd(wctx_, cwbuf_ + cwpos_, cwbuf_size_ - cwpos_, nullptr);
+    checkLz4Rv(rv);
+    cwpos_ += static_cast<uint32_t>(rv);
+  }
+}
+
+const uint8_t* TLz4Transport::borrow(uint8_t* buf, uint32_t* len) {
+  (void)buf;
+  // Only lend what is already decompressed, otherwise let the protocol use
+  // its slow path.
+  if (readAvail() >= *len) {
+    *len = readAvail();
+    return urbuf_ + urpos_;
+  }
+  return nullptr;
+}
+
+void TLz4Transport::consume(uint32_t len) {
+  countConsumedMessageBytes(len);
+  if (readAvail() >= len) {
+    urpos_ += len;
+  } else {
+    throw TTransportException(TTransportException::BAD_ARGS, "consume did not follow a borrow.");
+  }
+}
+
+void TLz4Transport::verifyChecksum() {
+  // If lz4 has already reported the end of the frame,
+  // it has verified the checksum.
+  if (input_ended_) {
+    return;
+  }
+
+  // This should only be called when reading is complete.
+  if (readAvail() > 0) {
+    throw TTransportException(TTransportException::CORRUPTED_DATA,
+                              "verifyChecksum() called before end of lz4 frame");
+  }
+
+  // Decompress whatever is left.  This throws if the checksum is bad.
+  // The first call may only find out that the last read left nothing
+  // behind, so keep going until there is data or the end of the frame.
+  urpos_ = 0;
+  urlen_ = 0;
+  while (!input_ended_ && urlen_ == 0) {
+    if (!readFromLz4(urbuf_, urbuf_size_, &urlen_)) {
+      // See TZlibTransport::verifyChecksum() for why this depends on the
+      // underlying transport.
+      urlen_ = 0;
+      throw TTransportException(TTransportException::CORRUPTED_DATA,
+                                "checksum not available yet in "
+                                "verifyChecksum()");
+    }
+  }
+
+  // If input_ended_ is true now, the checksum has been verified
+  if (input_ended_ && urlen_ == 0) {
+    return;
+  }
+
+  // The caller invoked us before the actual end of the frame
+  throw TTransportException(TTransportException::CORRUPTED_DATA,
+                            "verifyChecksum() called before end of "
+                            "lz4 frame");
+}
+
+TLz4TransportFactory::TLz4TransportFactory(std::shared_ptr<TTransportFactory> transportFactory,
+                                           int comp_level,
+                                           const std::string& dictionary)
+  : transportFactory_(transportFactory), comp_level_(comp_level), dictionary_(dictionary) {
+}
+
+std::shared_ptr<TTransport> TLz4TransportFactory::getTransport(std::shared_ptr<TTransport> trans) {
+  if (transportFactory_) {
+    trans = transportFactory_->getTransport(trans);
+  }
+  return std::shared_ptr<TTransport>(new TLz4Transport(trans,
+                                                       TLz4Transport::DEFAULT_URBUF_SIZE,
+                                                       TLz4Transport::DEFAULT_CRBUF_SIZE,
+                                                       TLz4Transport::DEFAULT_UWBUF_SIZE,
+                                                       TLz4Transport::DEFAULT_CWBUF_SIZE,
+                                                       comp_level_,
+                                                       dictionary_));
+}
+}
+}
+} // apache::thrift::transport
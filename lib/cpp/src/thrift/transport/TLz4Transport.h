@@ -0,0 +1,233 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _THRIFT_TRANSPORT_TLZ4TRANSPORT_H_
+#define _THRIFT_TRANSPORT_TLZ4TRANSPORT_H_ 1
+
+#include <string>
+
+#include <thrift/transport/TTransport.h>
+#include <thrift/transport/TVirtualTransport.h>
+
+struct LZ4F_cctx_s;
+struct LZ4F_dctx_s;
+struct LZ4F_CDict_s;
+
+namespace apache {
+namespace thrift {
+namespace transport {
+
+class TLz4TransportException : public TTransportException {
+public:
+  TLz4TransportException(size_t code, const char* name)
+    : TTransportException(TTransportException::INTERNAL_ERROR, errorMessage(name)),
+      lz4_code_(code),
+      lz4_name_(name == nullptr ? "(null)" : name) {}
+
+  ~TLz4TransportException() noexcept override = default;
+
+  size_t getLz4Code() const { return lz4_code_; }
+  std::string getLz4ErrorName() const { return lz4_name_; }
+
+  static std::string errorMessage(const char* name) {
+    std::string rv = "lz4 error: ";
+    rv += name ? name : "(no message)";
+    return rv;
+  }
+
+  size_t lz4_code_;
+  std::string lz4_name_;
+};
+
+/**
+ * This transport uses the lz4 frame format to compress on write and
+ * decompress on read.
+ *
+ * It works like TZlibTransport: flush() ends a block, so that everything
+ * written so far can be decompressed by the peer, and finish() ends the lz4
+ * frame along with its checksum, which verifyChecksum() checks on the other
+ * side.  lz4 compresses less than zlib or zstd, but costs far less CPU on
+ * both ends.
+ *
+ * Both ends may use a dictionary, i.e. up to 64KB of typical message
+ * content, which helps a lot with small messages.  The same dictionary must
+ * be given to both ends.
+ */
+class TLz4Transport : public TVirtualTransport<TLz4Transport> {
+public:
+  /**
+   * @param transport    The transport to read compressed data from
+   *                     and write compressed data to.
+   * @param urbuf_size   Uncompressed buffer size for reading.
+   * @param crbuf_size   Compressed buffer size for reading.
+   * @param uwbuf_size   Uncompressed buffer size for writing.
+   * @param cwbuf_size   Compressed buffer size for writing, on top of the
+   *                     room lz4 needs for one block.
+   * @param comp_level   Compression level (negative=fastest, 0=default, 3-12=high[slow]).
+   * @param dictionary   Dictionary to compress and decompress with, if not empty.
+   */
+  TLz4Transport(std::shared_ptr<TTransport> transport,
+                 int urbuf_size = DEFAULT_URBUF_SIZE,
+                 int crbuf_size = DEFAULT_CRBUF_SIZE,
+                 int uwbuf_size = DEFAULT_UWBUF_SIZE,
+                 int cwbuf_size = DEFAULT_CWBUF_SIZE,
+                 int comp_level = DEFAULT_COMP_LEVEL,
+                 const std::string& dictionary = std::string(),
+                 std::shared_ptr<TConfiguration> config = nullptr);
+
+  /**
+   * TLz4Transport destructor.
+   *
+   * Warning: Destroying a TLz4Transport object may discard any written but
+   * unflushed data.  You must explicitly call flush() or finish() to ensure
+   * that data is actually written and flushed to the underlying transport.
+   */
+  ~TLz4Transport() override;
+
+  bool isOpen() const override;
+  bool peek() override;
+
+  void open() override { transport_->open(); }
+
+  void close() override { transport_->close(); }
+
+  uint32_t read(uint8_t* buf, uint32_t len);
+
+  void write(const uint8_t* buf, uint32_t len);
+
+  void flush() override;
+
+  /**
+   * End the lz4 frame.
+   *
+   * This writes out any pending data followed by the end of the frame,
+   * including the checksum.  Once finish() has been called, no new data can
+   * be written to the stream.
+   */
+  void finish();
+
+  const uint8_t* borrow(uint8_t* buf, uint32_t* len);
+
+  void consume(uint32_t len);
+
+  /**
+   * Verify the checksum at the end of the lz4 frame.
+   *
+   * This may only be called after all data has been read.
+   * It verifies the checksum that was written by the finish() call.
+   */
+  void verifyChecksum();
+
+  static const int DEFAULT_URBUF_SIZE = 4096;
+  static const int DEFAULT_CRBUF_SIZE = 4096;
+  static const int DEFAULT_UWBUF_SIZE = 512;
+  static const int DEFAULT_CWBUF_SIZE = 4096;
+  static const int DEFAULT_COMP_LEVEL = 0;
+
+  std::shared_ptr<TTransport> getUnderlyingTransport() const { return transport_; }
+
+protected:
+  // How far flushToLz4() flushes what lz4 holds.
+  enum FlushMode { FLUSH_NONE, FLUSH_BLOCK, FLUSH_FRAME };
+
+  void checkLz4Rv(size_t rv);
+  void reserveLz4Output(size_t len);
+  uint32_t readAvail() const { return urlen_ - urpos_; }
+  bool readPending() const { return crpos_ < crlen_ || rflushing_; }
+  void flushToTransport(int mode);
+  void flushToLz4(const uint8_t* buf, uint32_t len, int mode);
+  bool readFromLz4(uint8_t* buf, uint32_t len, uint32_t* got);
+
+protected:
+  // Writes smaller than this are buffered up.
+  // Larger (or equal) writes are sent straight to lz4.
+  static const uint32_t MIN_DIRECT_COMPRESS_SIZE = 32;
+
+  // lz4 is given at most this much at a time, so that the room it needs in
+  // cwbuf_ is bounded.
+  static const uint32_t MAX_COMPRESS_CHUNK = 64 * 1024;
+
+  std::shared_ptr<TTransport> transport_;
+
+  uint32_t urpos_;
+  uint32_t urlen_;
+  uint32_t crpos_;
+  uint32_t crlen_;
+  uint32_t uwpos_;
+  uint32_t cwpos_;
+
+  /// True iff lz4 has reached the end of the input frame.
+  bool input_ended_;
+  /// True iff we have finished the output frame.
+  bool output_finished_;
+  /// True iff lz4 may still hold decompressed data it had no room for.
+  bool rflushing_;
+  /// True iff the header of the output frame has been written.
+  bool output_started_;
+
+  uint32_t urbuf_size_;
+  uint32_t crbuf_size_;
+  uint32_t uwbuf_size_;
+  uint32_t cwbuf_size_;
+
+  uint8_t* urbuf_;
+  uint8_t* crbuf_;
+  uint8_t* uwbuf_;
+  uint8_t* cwbuf_;
+
+  // The most lz4 may write for one chunk, or for a flush.
+  size_t cwbound_;
+
+  const int comp_level_;
+  const std::string dictionary_;
+
+  struct LZ4F_dctx_s* rctx_;
+  struct LZ4F_cctx_s* wctx_;
+  struct LZ4F_CDict_s* cdict_;
+};
+
+/**
+ * Wraps a transport into a lz4 compressed one.
+ */
+class TLz4TransportFactory : public TTransportFactory {
+public:
+  TLz4TransportFactory() = default;
+
+  /**
+   * Wraps a transport factory into a lz4 compressed one.
+   */
+  TLz4TransportFactory(std::shared_ptr<TTransportFactory> transportFactory,
+                        int comp_level = TLz4Transport::DEFAULT_COMP_LEVEL,
+                        const std::string& dictionary = std::string());
+
+  ~TLz4TransportFactory() override = default;
+
+  std::shared_ptr<TTransport> getTransport(std::shared_ptr<TTransport> trans) override;
+
+protected:
+  std::shared_ptr<TTransportFactory> transportFactory_;
+  int comp_level_ = TLz4Transport::DEFAULT_COMP_LEVEL;
+  std::string dictionary_;
+};
+
+}
+}
+} // apache::thrift::transport
+
+#endif // #ifndef _THRIFT_TRANSPORT_TLZ4TRANSPORT_H_
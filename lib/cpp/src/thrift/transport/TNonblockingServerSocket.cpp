@@ -22,6 +22,7 @@
 #include <cstring>
 #include <memory>
 #include <stdexcept>
+#include <typeinfo>
 #include <sys/types.h>
 #ifdef HAVE_SYS_SOCKET_H
 #include <sys/socket.h>
@@ -546,6 +547,19 @@ bool TNonblockingServerSocket::isUnixDomainSocket() const {
 }
 
 shared_ptr<TSocket> TNonblockingServerSocket::acceptImpl() {
+  return acceptSocket(nullptr);
+}
+
+shared_ptr<TSocket> TNonblockingServerSocket::acceptIntoImpl(shared_ptr<TSocket> reuse) {
+  // Subclasses accept or make their sockets their own way
+  if (typeid(*this) != typeid(TNonblockingServerSocket)
+      || (reuse && typeid(*reuse) != typeid(TSocket))) {
+    reuse.reset();
+  }
+  return acceptSocket(reuse);
+}
+
+shared_ptr<TSocket> TNonblockingServerSocket::acceptSocket(shared_ptr<TSocket> reuse) {
   if (serverSocket_ == THRIFT_INVALID_SOCKET) {
     throw TTransportException(TTransportException::NOT_OPEN,
                               "TNonblockingServerSocket not listening");
@@ -584,7 +598,12 @@ shared_ptr<TSocket> TNonblockingServerSocket::acceptImpl() {
                               errno_copy);
   }
 
-  shared_ptr<TSocket> client = createSocket(clientSocket);
+  shared_ptr<TSocket> client = reuse;
+  if (client) {
+    client->setSocketFD(clientSocket);
+  } else {
+    client = createSocket(clientSocket);
+  }
   client->setPath(path_);
   if (sendTimeout_ > 0) {
     client->setSendTimeout(sendTimeout_);
@@ -114,9 +114,12 @@ public:
 
 protected:
   std::shared_ptr<TSocket> acceptImpl() override;
+  std::shared_ptr<TSocket> acceptIntoImpl(std::shared_ptr<TSocket> reuse) override;
   virtual std::shared_ptr<TSocket> createSocket(THRIFT_SOCKET client);
 
 private:
+  std::shared_ptr<TSocket> acceptSocket(std::shared_ptr<TSocket> reuse);
+
   void _setup_sockopts();
   void _setup_unixdomain_sockopts();
   void _setup_tcp_sockopts();
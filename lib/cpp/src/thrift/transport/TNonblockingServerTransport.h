@@ -63,6 +63,23 @@ public:
     return result;
   }
 
+  /**
+   * Accepts like accept(), into reuse instead of a new socket if the
+   * transport supports that.
+   *
+   * @param reuse a closed socket returned by this transport before that
+   *              nobody else holds, or nullptr.
+   * @return reuse or a new socket
+   * @throws TTransportException if there is an error
+   */
+  std::shared_ptr<TSocket> acceptInto(std::shared_ptr<TSocket> reuse) {
+    std::shared_ptr<TSocket> result = acceptIntoImpl(reuse);
+    if (!result) {
+      throw TTransportException("accept() may not return nullptr");
+    }
+    return result;
+  }
+
   /**
   * Utility method
   * 
@@ -92,6 +109,15 @@ protected:
    */
   virtual std::shared_ptr<TSocket> acceptImpl() = 0;
 
+  /**
+   * Subclasses that can accept into a socket they made earlier implement
+   * this, by default a new one is made.
+   */
+  virtual std::shared_ptr<TSocket> acceptIntoImpl(std::shared_ptr<TSocket> reuse) {
+    (void)reuse;
+    return acceptImpl();
+  }
+
 };
 }
 }
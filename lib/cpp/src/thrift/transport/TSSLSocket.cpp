@@ -577,6 +577,17 @@ uint32_t TSSLSocket::write_partial(const uint8_t* buf, uint32_t len) {
   return written;
 }
 
+void TSSLSocket::writev(const TIoVec* vecs, uint32_t count) {
+  for (uint32_t i = 0; i < count; ++i) {
+    write(vecs[i].base, vecs[i].len);
+  }
+}
+
+uint32_t TSSLSocket::writev_partial(const TIoVec* vecs, uint32_t count) {
+  // each buffer is encrypted on its own anyway
+  return writeFirst_partial(vecs, count);
+}
+
 void TSSLSocket::flush() {
   resetConsumedMessageSize();
   // Don't throw exception if not open. Thrift servers close socket twice.
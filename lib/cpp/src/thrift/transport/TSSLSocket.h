@@ -81,6 +81,8 @@ public:
   uint32_t read(uint8_t* buf, uint32_t len) override;
   void write(const uint8_t* buf, uint32_t len) override;
   uint32_t write_partial(const uint8_t* buf, uint32_t len) override;
+  void writev(const TIoVec* vecs, uint32_t count) override;
+  uint32_t writev_partial(const TIoVec* vecs, uint32_t count) override;
   void flush() override;
   /**
   * Set whether to use client or server side SSL handshake protocol.
@@ -597,6 +597,52 @@ shared_ptr<TTransport> TServerSocket::acceptImpl() {
     throw TTransportException(TTransportException::NOT_OPEN, "TServerSocket not listening");
   }
 
+  struct sockaddr_storage clientAddress;
+  int size = sizeof(clientAddress);
+  THRIFT_SOCKET clientSocket = acceptSocket((struct sockaddr*)&clientAddress, (socklen_t*)&size);
+
+  // Make sure client socket is blocking
+  int flags = THRIFT_FCNTL(clientSocket, THRIFT_F_GETFL, 0);
+  if (flags == -1) {
+    int errno_copy = THRIFT_GET_SOCKET_ERROR;
+    ::THRIFT_CLOSESOCKET(clientSocket);
+    GlobalOutput.perror("TServerSocket::acceptImpl() THRIFT_FCNTL() THRIFT_F_GETFL ", errno_copy);
+    throw TTransportException(TTransportException::UNKNOWN,
+                              "THRIFT_FCNTL(THRIFT_F_GETFL)",
+                              errno_copy);
+  }
+
+  if (-1 == THRIFT_FCNTL(clientSocket, THRIFT_F_SETFL, flags & ~THRIFT_O_NONBLOCK)) {
+    int errno_copy = THRIFT_GET_SOCKET_ERROR;
+    ::THRIFT_CLOSESOCKET(clientSocket);
+    GlobalOutput
+        .perror("TServerSocket::acceptImpl() THRIFT_FCNTL() THRIFT_F_SETFL ~THRIFT_O_NONBLOCK ",
+                errno_copy);
+    throw TTransportException(TTransportException::UNKNOWN,
+                              "THRIFT_FCNTL(THRIFT_F_SETFL)",
+                              errno_copy);
+  }
+
+  shared_ptr<TSocket> client = createSocket(clientSocket);
+  client->setPath(path_);
+  if (sendTimeout_ > 0) {
+    client->setSendTimeout(sendTimeout_);
+  }
+  if (recvTimeout_ > 0) {
+    client->setRecvTimeout(recvTimeout_);
+  }
+  if (keepAlive_) {
+    client->setKeepAlive(keepAlive_);
+  }
+  client->setCachedAddress((sockaddr*)&clientAddress, size);
+
+  if (acceptCallback_)
+    acceptCallback_(clientSocket);
+
+  return client;
+}
+
+THRIFT_SOCKET TServerSocket::acceptSocket(struct sockaddr* clientAddress, socklen_t* size) {
   struct THRIFT_POLLFD fds[2];
 
   int maxEintrs = 5;
@@ -647,10 +693,7 @@ shared_ptr<TTransport> TServerSocket::acceptImpl() {
     }
   }
 
-  struct sockaddr_storage clientAddress;
-  int size = sizeof(clientAddress);
-  THRIFT_SOCKET clientSocket
-      = ::accept(serverSocket_, (struct sockaddr*)&clientAddress, (socklen_t*)&size);
+  THRIFT_SOCKET clientSocket = ::accept(serverSocket_, clientAddress, size);
 
   if (clientSocket == THRIFT_INVALID_SOCKET) {
     int errno_copy = THRIFT_GET_SOCKET_ERROR;
@@ -658,45 +701,7 @@ shared_ptr<TTransport> TServerSocket::acceptImpl() {
     throw TTransportException(TTransportException::UNKNOWN, "accept()", errno_copy);
   }
 
-  // Make sure client socket is blocking
-  int flags = THRIFT_FCNTL(clientSocket, THRIFT_F_GETFL, 0);
-  if (flags == -1) {
-    int errno_copy = THRIFT_GET_SOCKET_ERROR;
-    ::THRIFT_CLOSESOCKET(clientSocket);
-    GlobalOutput.perror("TServerSocket::acceptImpl() THRIFT_FCNTL() THRIFT_F_GETFL ", errno_copy);
-    throw TTransportException(TTransportException::UNKNOWN,
-                              "THRIFT_FCNTL(THRIFT_F_GETFL)",
-                              errno_copy);
-  }
-
-  if (-1 == THRIFT_FCNTL(clientSocket, THRIFT_F_SETFL, flags & ~THRIFT_O_NONBLOCK)) {
-    int errno_copy = THRIFT_GET_SOCKET_ERROR;
-    ::THRIFT_CLOSESOCKET(clientSocket);
-    GlobalOutput
-        .perror("TServerSocket::acceptImpl() THRIFT_FCNTL() THRIFT_F_SETFL ~THRIFT_O_NONBLOCK ",
-                errno_copy);
-    throw TTransportException(TTransportException::UNKNOWN,
-                              "THRIFT_FCNTL(THRIFT_F_SETFL)",
-                              errno_copy);
-  }
-
-  shared_ptr<TSocket> client = createSocket(clientSocket);
-  client->setPath(path_);
-  if (sendTimeout_ > 0) {
-    client->setSendTimeout(sendTimeout_);
-  }
-  if (recvTimeout_ > 0) {
-    client->setRecvTimeout(recvTimeout_);
-  }
-  if (keepAlive_) {
-    client->setKeepAlive(keepAlive_);
-  }
-  client->setCachedAddress((sockaddr*)&clientAddress, size);
-
-  if (acceptCallback_)
-    acceptCallback_(clientSocket);
-
-  return client;
+  return clientSocket;
 }
 
 shared_ptr<TSocket> TServerSocket::createSocket(THRIFT_SOCKET clientSocket) {
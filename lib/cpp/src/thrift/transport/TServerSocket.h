@@ -141,6 +141,22 @@ public:
 protected:
   std::shared_ptr<TTransport> acceptImpl() override;
   virtual std::shared_ptr<TSocket> createSocket(THRIFT_SOCKET client);
+
+  /**
+   * Waits for a pending connection (or an interrupt) and accepts it.  The
+   * returned descriptor is configured and wrapped by acceptImpl() through
+   * createSocket().  Subclasses may override this to accept connections
+   * through a different mechanism.
+   *
+   * @param clientAddress filled in with the address of the peer
+   * @param size          in: size of clientAddress, out: size of the address
+   * @throws TTransportException INTERRUPTED if interrupt() was called
+   */
+  virtual THRIFT_SOCKET acceptSocket(struct sockaddr* clientAddress, socklen_t* size);
+
+  THRIFT_SOCKET getInterruptSockReader() const { return interruptSockReader_; }
+  int getAcceptTimeout() const { return accTimeout_; }
+
   bool interruptableChildren_;
   std::shared_ptr<THRIFT_SOCKET> pChildInterruptSockReader_; // if interruptableChildren_ this is shared with child TSockets
 
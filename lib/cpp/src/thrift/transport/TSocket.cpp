@@ -19,6 +19,9 @@
 
 #include <thrift/thrift-config.h>
 
+#include <algorithm>
+#include <chrono>
+#include <climits>
 #include <cstring>
 #include <sstream>
 #ifdef HAVE_SYS_IOCTL_H
@@ -30,6 +33,15 @@
 #ifdef HAVE_SYS_SOCKET_H
 #include <sys/socket.h>
 #endif
+#ifndef _WIN32
+#include <sys/uio.h>
+#endif
+#if defined(__linux__) && defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY)
+#include <linux/errqueue.h>
+#define THRIFT_ZEROCOPY 1
+// How long close() waits for MSG_ZEROCOPY completions without a send timeout
+#define ZEROCOPY_CLOSE_TIMEOUT_MS 1000
+#endif
 #ifdef HAVE_SYS_UN_H
 #include <sys/un.h>
 #endif
@@ -97,7 +109,10 @@ TSocket::TSocket(const string& host, int port, std::shared_ptr<TConfiguration> c
     lingerOn_(1),
     lingerVal_(0),
     noDelay_(1),
-    maxRecvRetries_(5) {
+    maxRecvRetries_(5),
+    zeroCopyThreshold_(0),
+    zeroCopy_(false),
+    zeroCopyFirst_(0) {
 }
 
 TSocket::TSocket(const string& path, std::shared_ptr<TConfiguration> config)
@@ -113,7 +128,10 @@ TSocket::TSocket(const string& path, std::shared_ptr<TConfiguration> config)
     lingerOn_(1),
     lingerVal_(0),
     noDelay_(1),
-    maxRecvRetries_(5) {
+    maxRecvRetries_(5),
+    zeroCopyThreshold_(0),
+    zeroCopy_(false),
+    zeroCopyFirst_(0) {
   cachedPeerAddr_.ipv4.sin_family = AF_UNSPEC;
 }
 
@@ -129,7 +147,10 @@ TSocket::TSocket(std::shared_ptr<TConfiguration> config)
     lingerOn_(1),
     lingerVal_(0),
     noDelay_(1),
-    maxRecvRetries_(5) {
+    maxRecvRetries_(5),
+    zeroCopyThreshold_(0),
+    zeroCopy_(false),
+    zeroCopyFirst_(0) {
   cachedPeerAddr_.ipv4.sin_family = AF_UNSPEC;
 }
 
@@ -145,7 +166,10 @@ TSocket::TSocket(THRIFT_SOCKET socket, std::shared_ptr<TConfiguration> config)
     lingerOn_(1),
     lingerVal_(0),
     noDelay_(1),
-    maxRecvRetries_(5) {
+    maxRecvRetries_(5),
+    zeroCopyThreshold_(0),
+    zeroCopy_(false),
+    zeroCopyFirst_(0) {
   cachedPeerAddr_.ipv4.sin_family = AF_UNSPEC;
 #ifdef SO_NOSIGPIPE
   {
@@ -169,7 +193,10 @@ TSocket::TSocket(THRIFT_SOCKET socket, std::shared_ptr<THRIFT_SOCKET> interruptL
     lingerOn_(1),
     lingerVal_(0),
     noDelay_(1),
-    maxRecvRetries_(5) {
+    maxRecvRetries_(5),
+    zeroCopyThreshold_(0),
+    zeroCopy_(false),
+    zeroCopyFirst_(0) {
   cachedPeerAddr_.ipv4.sin_family = AF_UNSPEC;
 #ifdef SO_NOSIGPIPE
   {
@@ -294,6 +321,8 @@ void TSocket::openConnection(struct addrinfo* res) {
     setKeepAlive(keepAlive_);
   }
 
+  enableZeroCopy();
+
   // Linger
   setLinger(lingerOn_, lingerVal_);
 
@@ -500,10 +529,16 @@ void TSocket::local_open() {
 
 void TSocket::close() {
   if (socket_ != THRIFT_INVALID_SOCKET) {
+    awaitZeroCopy();
     shutdown(socket_, THRIFT_SHUT_RDWR);
     ::THRIFT_CLOSESOCKET(socket_);
   }
   socket_ = THRIFT_INVALID_SOCKET;
+  zeroCopy_ = false;
+  // awaitZeroCopy() made sure the kernel no longer reads from these
+  zeroCopyFirst_ = 0;
+  zeroCopyDone_.clear();
+  zeroCopyOwners_.clear();
 }
 
 void TSocket::setSocketFD(THRIFT_SOCKET socket) {
@@ -511,6 +546,13 @@ void TSocket::setSocketFD(THRIFT_SOCKET socket) {
     close();
   }
   socket_ = socket;
+#ifdef SO_NOSIGPIPE
+  {
+    int one = 1;
+    setsockopt(socket_, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
+  }
+#endif
+  enableZeroCopy();
 }
 
 uint32_t TSocket::read(uint8_t* buf, uint32_t len) {
@@ -666,21 +708,75 @@ uint32_t TSocket::write_partial(const uint8_t* buf, uint32_t len) {
 #endif // ifdef MSG_NOSIGNAL
 
   int b = static_cast<int>(send(socket_, const_cast_sockopt(buf + sent), len - sent, flags));
+  return sendResult(b, "send()");
+}
 
+void TSocket::writev(const TIoVec* vecs, uint32_t count) {
+  while (count > 0) {
+    if (vecs->len == 0) {
+      ++vecs;
+      --count;
+      continue;
+    }
+    uint32_t b = writev_partial(vecs, count);
+    if (b == 0) {
+      // This should only happen if the timeout set with SO_SNDTIMEO expired.
+      // Raise an exception.
+      throw TTransportException(TTransportException::TIMED_OUT, "send timeout expired");
+    }
+    // Step over the buffers sent in full, then finish the one sent in part
+    while (count > 0 && b >= vecs->len) {
+      b -= vecs->len;
+      ++vecs;
+      --count;
+    }
+    if (b > 0) {
+      write(vecs->base + b, vecs->len - b);
+      ++vecs;
+      --count;
+    }
+  }
+}
+
+uint32_t TSocket::writev_partial(const TIoVec* vecs, uint32_t count) {
+#ifdef _WIN32
+  // Without sendmsg() send the first buffer alone
+  return writeFirst_partial(vecs, count);
+#else
+  if (socket_ == THRIFT_INVALID_SOCKET) {
+    throw TTransportException(TTransportException::NOT_OPEN, "Called write on non-open socket");
+  }
+  int b = sendBuffers(vecs, count, 0, 0);
+  return b == 0 ? 0 : sendResult(b, "sendmsg()");
+#endif // _WIN32
+}
+
+uint32_t TSocket::writeFirst_partial(const TIoVec* vecs, uint32_t count) {
+  while (count > 0 && vecs->len == 0) {
+    ++vecs;
+    --count;
+  }
+  return count > 0 ? write_partial(vecs->base, vecs->len) : 0;
+}
+
+uint32_t TSocket::sendResult(int b, const char* call) {
   if (b < 0) {
     if (THRIFT_GET_SOCKET_ERROR == THRIFT_EWOULDBLOCK || THRIFT_GET_SOCKET_ERROR == THRIFT_EAGAIN) {
       return 0;
     }
     // Fail on a send error
     int errno_copy = THRIFT_GET_SOCKET_ERROR;
-    GlobalOutput.perror("TSocket::write_partial() send() " + getSocketInfo(), errno_copy);
+    GlobalOutput.perror(std::string("TSocket::write_partial() ") + call + " " + getSocketInfo(),
+                        errno_copy);
 
     if (errno_copy == THRIFT_EPIPE || errno_copy == THRIFT_ECONNRESET
         || errno_copy == THRIFT_ENOTCONN) {
-      throw TTransportException(TTransportException::NOT_OPEN, "write() send()", errno_copy);
+      throw TTransportException(TTransportException::NOT_OPEN, std::string("write() ") + call,
+                                errno_copy);
     }
 
-    throw TTransportException(TTransportException::UNKNOWN, "write() send()", errno_copy);
+    throw TTransportException(TTransportException::UNKNOWN, std::string("write() ") + call,
+                              errno_copy);
   }
 
   // Fail on blocked send
@@ -690,6 +786,250 @@ uint32_t TSocket::write_partial(const uint8_t* buf, uint32_t len) {
   return b;
 }
 
+int TSocket::sendBuffers(const TIoVec* vecs, uint32_t count, uint32_t skip, int flags) {
+#ifdef _WIN32
+  (void)vecs;
+  (void)count;
+  (void)skip;
+  (void)flags;
+  return 0;
+#else
+  // Any buffers beyond these, and bytes beyond what the result can report,
+  // are left for the next call
+  struct iovec iov[64];
+  const size_t limit = INT_MAX;
+  size_t n = 0;
+  size_t total = 0;
+  for (; n < count && n < sizeof(iov) / sizeof(iov[0]) && total < limit; ++n) {
+    uint32_t from = n == 0 ? skip : 0;
+    iov[n].iov_base = const_cast<uint8_t*>(vecs[n].base + from);
+    iov[n].iov_len = (std::min)(static_cast<size_t>(vecs[n].len - from), limit - total);
+    total += iov[n].iov_len;
+  }
+  if (total == 0) {
+    return 0;
+  }
+
+  struct msghdr msg;
+  std::memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = iov;
+  msg.msg_iovlen = n;
+
+#ifdef MSG_NOSIGNAL
+  flags |= MSG_NOSIGNAL;
+#endif // ifdef MSG_NOSIGNAL
+
+  return static_cast<int>(sendmsg(socket_, &msg, flags));
+#endif // _WIN32
+}
+
+void TSocket::enableZeroCopy() {
+  zeroCopy_ = false;
+#ifdef THRIFT_ZEROCOPY
+  if (zeroCopyThreshold_ == 0 || socket_ == THRIFT_INVALID_SOCKET || isUnixDomainSocket()) {
+    return;
+  }
+  int one = 1;
+  if (setsockopt(socket_, SOL_SOCKET, SO_ZEROCOPY, const_cast_sockopt(&one), sizeof(one)) == -1) {
+    int errno_copy = THRIFT_GET_SOCKET_ERROR;
+    GlobalOutput.perror("TSocket::setZeroCopyThreshold() setsockopt() " + getSocketInfo(),
+                        errno_copy);
+    return;
+  }
+  zeroCopy_ = true;
+#endif
+}
+
+uint32_t TSocket::writevZeroCopy_partial(const TIoVec* vecs,
+                                         uint32_t count,
+                                         const std::shared_ptr<const void>* owners) {
+  if (!zeroCopy_) {
+    return writev_partial(vecs, count);
+  }
+  return sendZeroCopy(vecs, count, 0, owners);
+}
+
+void TSocket::writevZeroCopy(const TIoVec* vecs,
+                             uint32_t count,
+                             const std::shared_ptr<const void>* owners) {
+  if (!zeroCopy_) {
+    writev(vecs, count);
+    return;
+  }
+
+  uint32_t skip = 0;
+  while (count > 0) {
+    if (vecs->len == skip) {
+      ++vecs;
+      ++owners;
+      --count;
+      skip = 0;
+      continue;
+    }
+    uint32_t sent = sendZeroCopy(vecs, count, skip, owners);
+    if (sent == 0) {
+      // This should only happen if the timeout set with SO_SNDTIMEO expired.
+      throw TTransportException(TTransportException::TIMED_OUT, "send timeout expired");
+    }
+    skip += sent;
+    while (count > 0 && skip >= vecs->len) {
+      skip -= vecs->len;
+      ++vecs;
+      ++owners;
+      --count;
+    }
+  }
+}
+
+uint32_t TSocket::sendZeroCopy(const TIoVec* vecs,
+                               uint32_t count,
+                               uint32_t skip,
+                               const std::shared_ptr<const void>* owners) {
+  if (socket_ == THRIFT_INVALID_SOCKET) {
+    throw TTransportException(TTransportException::NOT_OPEN, "Called write on non-open socket");
+  }
+  // Keep the owners of sends the kernel is done with from piling up
+  reclaimZeroCopy();
+
+  uint64_t total = 0;
+  for (uint32_t i = 0; i < count; ++i) {
+    total += vecs[i].len;
+  }
+  int flags = 0;
+#ifdef THRIFT_ZEROCOPY
+  if (zeroCopy_ && total - skip >= zeroCopyThreshold_) {
+    flags = MSG_ZEROCOPY;
+  }
+#endif
+  int b = sendBuffers(vecs, count, skip, flags);
+  if (b < 0 && flags != 0 && THRIFT_GET_SOCKET_ERROR == ENOBUFS) {
+    // Out of memory to pin the pages with, so copy this part
+    flags = 0;
+    b = sendBuffers(vecs, count, skip, flags);
+  }
+  uint32_t sent = b == 0 ? 0 : sendResult(b, "sendmsg()");
+  if (sent == 0 || flags == 0) {
+    return sent;
+  }
+
+  // The kernel numbers the sends, and reads from every buffer this one took
+  // bytes from until the completion for that number
+  uint32_t id = zeroCopyFirst_ + static_cast<uint32_t>(zeroCopyDone_.size());
+  zeroCopyDone_.push_back(false);
+  uint32_t left = sent;
+  for (uint32_t i = 0; i < count && left > 0; ++i) {
+    uint32_t len = vecs[i].len - (i == 0 ? skip : 0);
+    if (len > 0 && owners[i]) {
+      zeroCopyOwners_.emplace_back(id, owners[i]);
+    }
+    left -= (std::min)(left, len);
+  }
+  return sent;
+}
+
+bool TSocket::reclaimZeroCopy() {
+#ifdef THRIFT_ZEROCOPY
+  while (!zeroCopyDone_.empty()) {
+    char control[128];
+    struct msghdr msg;
+    std::memset(&msg, 0, sizeof(msg));
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    if (recvmsg(socket_, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0) {
+      int errno_copy = THRIFT_GET_SOCKET_ERROR;
+      if (errno_copy == THRIFT_EAGAIN || errno_copy == THRIFT_EWOULDBLOCK) {
+        break;
+      }
+      if (errno_copy == THRIFT_EINTR) {
+        continue;
+      }
+      GlobalOutput.perror("TSocket::reclaimZeroCopy() recvmsg() " + getSocketInfo(), errno_copy);
+      throw TTransportException(TTransportException::UNKNOWN, "recvmsg()", errno_copy);
+    }
+    for (struct cmsghdr* cm = CMSG_FIRSTHDR(&msg); cm != nullptr; cm = CMSG_NXTHDR(&msg, cm)) {
+      if (!(cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR)
+          && !(cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR)) {
+        continue;
+      }
+      auto* err = reinterpret_cast<struct sock_extended_err*>(CMSG_DATA(cm));
+      if (err->ee_origin != SO_EE_ORIGIN_ZEROCOPY || err->ee_errno != 0) {
+        continue;
+      }
+      // Sends ee_info to ee_data are done with, not always in order
+      for (uint32_t id = err->ee_info;; ++id) {
+        uint32_t i = id - zeroCopyFirst_;
+        if (i < zeroCopyDone_.size()) {
+          zeroCopyDone_[i] = true;
+        }
+        if (id == err->ee_data) {
+          break;
+        }
+      }
+      if (err->ee_code & SO_EE_CODE_ZEROCOPY_COPIED) {
+        // The kernel copied after all, so stop paying for the completions
+        zeroCopy_ = false;
+      }
+    }
+  }
+
+  while (!zeroCopyDone_.empty() && zeroCopyDone_.front()) {
+    zeroCopyDone_.pop_front();
+    ++zeroCopyFirst_;
+  }
+  while (!zeroCopyOwners_.empty()
+         && static_cast<int32_t>(zeroCopyOwners_.front().first - zeroCopyFirst_) < 0) {
+    zeroCopyOwners_.pop_front();
+  }
+#endif
+  return !zeroCopyDone_.empty();
+}
+
+void TSocket::awaitZeroCopy() {
+#ifdef THRIFT_ZEROCOPY
+  if (zeroCopyDone_.empty()) {
+    return;
+  }
+  // An event loop must not stall on one connection, so a non-blocking socket
+  // only collects the completions that are already there
+  int flags = THRIFT_FCNTL(socket_, THRIFT_F_GETFL, 0);
+  bool wait = flags == -1 || !(flags & THRIFT_O_NONBLOCK);
+  auto deadline = std::chrono::steady_clock::now()
+                  + std::chrono::milliseconds(sendTimeout_ > 0 ? sendTimeout_
+                                                               : ZEROCOPY_CLOSE_TIMEOUT_MS);
+  try {
+    while (reclaimZeroCopy() && wait) {
+      auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+                      deadline - std::chrono::steady_clock::now()).count();
+      if (left <= 0) {
+        break;
+      }
+      // Completions make the socket report an error, whatever it waits for
+      struct THRIFT_POLLFD fds[1];
+      std::memset(fds, 0, sizeof(fds));
+      fds[0].fd = socket_;
+      int ret = THRIFT_POLL(fds, 1, static_cast<int>(left));
+      if (ret < 0 && THRIFT_GET_SOCKET_ERROR != THRIFT_EINTR) {
+        break;
+      }
+      if (ret > 0 && (fds[0].revents & (POLLHUP | POLLNVAL))) {
+        // The connection is gone, and with it what was left to send
+        reclaimZeroCopy();
+        break;
+      }
+    }
+  } catch (TTransportException&) {
+  }
+  if (!zeroCopyDone_.empty()) {
+    // Have the kernel drop what it has not sent yet, and with it the pages
+    GlobalOutput.printf("TSocket::close() resetting %s, the kernel still sends from %u buffers",
+                        getSocketInfo().c_str(),
+                        static_cast<unsigned>(zeroCopyDone_.size()));
+    struct linger l = {1, 0};
+    setsockopt(socket_, SOL_SOCKET, SO_LINGER, const_cast_sockopt(&l), sizeof(l));
+  }
+#endif
+}
+
 std::string TSocket::getHost() const {
   return host_;
 }
@@ -820,6 +1160,11 @@ void TSocket::setKeepAlive(bool keepAlive) {
   }
 }
 
+void TSocket::setZeroCopyThreshold(uint32_t threshold) {
+  zeroCopyThreshold_ = threshold;
+  enableZeroCopy();
+}
+
 void TSocket::setMaxRecvRetries(int maxRecvRetries) {
   maxRecvRetries_ = maxRecvRetries;
 }
@@ -20,7 +20,10 @@
 #ifndef _THRIFT_TRANSPORT_TSOCKET_H_
 #define _THRIFT_TRANSPORT_TSOCKET_H_ 1
 
+#include <deque>
+#include <memory>
 #include <string>
+#include <utility>
 
 #include <thrift/transport/TTransport.h>
 #include <thrift/transport/TVirtualTransport.h>
@@ -136,6 +139,46 @@ public:
    */
   virtual uint32_t write_partial(const uint8_t* buf, uint32_t len);
 
+  /**
+   * Writes the buffers to the underlying socket.  Loops until done or fail.
+   */
+  virtual void writev(const TIoVec* vecs, uint32_t count);
+
+  /**
+   * Writes the buffers to the underlying socket.  Does single sendmsg() and
+   * returns result.  Subclasses that override write_partial() must override
+   * this too.
+   */
+  virtual uint32_t writev_partial(const TIoVec* vecs, uint32_t count);
+
+  /**
+   * Writes the buffers like writev_partial(), but without copying them if
+   * zero copy is on and they add up to at least the threshold.  The kernel
+   * then reads them while they are sent, so they must not change until it
+   * is done with them.  The socket keeps owners[i], which holds on to
+   * vecs[i], until then.
+   */
+  uint32_t writevZeroCopy_partial(const TIoVec* vecs,
+                                  uint32_t count,
+                                  const std::shared_ptr<const void>* owners);
+
+  /**
+   * Writes all of the buffers like writevZeroCopy_partial().  Returns once
+   * they are sent, not once the kernel is done with them.
+   */
+  void writevZeroCopy(const TIoVec* vecs,
+                      uint32_t count,
+                      const std::shared_ptr<const void>* owners);
+
+  /**
+   * Lets go of the owners of the buffers the kernel is done with.  It says
+   * so on the socket's error queue, which also makes the socket report an
+   * error to poll().  Later writes do this too.
+   *
+   * @return whether the kernel still reads from any buffers.
+   */
+  bool reclaimZeroCopy();
+
   /**
    * Get the host that the socket is connected to
    *
@@ -228,6 +271,38 @@ public:
    */
   void setKeepAlive(bool keepAlive);
 
+  /**
+   * Lets writevZeroCopy() and writevZeroCopy_partial() send writes of at
+   * least threshold bytes with MSG_ZEROCOPY, so that the kernel sends
+   * straight from the caller's memory instead of copying it.  The kernel is
+   * done with the memory once the peer has acknowledged it.  Other writes
+   * copy as before, since their callers may reuse the memory right away.  If
+   * the kernel reports that it had to copy anyway, as it does over loopback,
+   * the connection goes back to copying.
+   *
+   * write(), writev() and their partial forms never send without copying,
+   * whatever the threshold, so blocking servers and clients that write
+   * through them get no zero copy.  Only TNonblockingServer, which owns its
+   * output buffers, sends through writevZeroCopy().
+   *
+   * close() waits for the kernel to be done with the memory before it lets
+   * go of the owners, for up to the send timeout or a second if there is
+   * none.  The connection is reset if the kernel still sends from it then.
+   * A non-blocking socket does not wait: it is reset right away unless the
+   * peer has acknowledged everything already.
+   *
+   * Only available on Linux 4.14 and later.  Elsewhere writes always copy.
+   *
+   * @param threshold The smallest write to send without copying, 0 for none,
+   *                  which is the default.
+   */
+  void setZeroCopyThreshold(uint32_t threshold);
+
+  uint32_t getZeroCopyThreshold() const { return zeroCopyThreshold_; }
+
+  /** Whether a write of len bytes would be sent without copying. */
+  bool isZeroCopy(uint32_t len) const { return zeroCopy_ && len >= zeroCopyThreshold_; }
+
   /**
    * Get socket information formatted as a string <Host: x Port: x>
    */
@@ -303,6 +378,12 @@ public:
   void setCachedAddress(const sockaddr* addr, socklen_t len);
 
 protected:
+  /**
+   * Writes the first buffer that is not empty with write_partial(), for
+   * writev_partial() where several buffers cannot be sent at once.
+   */
+  uint32_t writeFirst_partial(const TIoVec* vecs, uint32_t count);
+
   /** connect, called by open */
   void openConnection(struct addrinfo* res);
 
@@ -357,6 +438,21 @@ protected:
   /** Recv EGAIN retries */
   int maxRecvRetries_;
 
+  /** Smallest write sent with MSG_ZEROCOPY, 0 for none */
+  uint32_t zeroCopyThreshold_;
+
+  /** Whether SO_ZEROCOPY is on for the socket */
+  bool zeroCopy_;
+
+  /** Number of the oldest MSG_ZEROCOPY send the kernel may still read from */
+  uint32_t zeroCopyFirst_;
+
+  /** For each MSG_ZEROCOPY send from zeroCopyFirst_ on, whether it is done */
+  std::deque<bool> zeroCopyDone_;
+
+  /** Owners of the buffers of those sends, with the number of their send */
+  std::deque<std::pair<uint32_t, std::shared_ptr<const void> > > zeroCopyOwners_;
+
   /** Cached peer address */
   union {
     sockaddr_in ipv4;
@@ -369,6 +465,38 @@ protected:
 private:
   void unix_open();
   void local_open();
+
+  /**
+   * Turns the result of call, a send() or sendmsg(), into the number of
+   * bytes sent, or 0 if the socket would block.  Throws on errors.
+   */
+  uint32_t sendResult(int b, const char* call);
+
+  /**
+   * Sends the buffers, the first one from skip on, with a single sendmsg().
+   * Returns its result, or 0 if there is nothing to send.
+   */
+  int sendBuffers(const TIoVec* vecs, uint32_t count, uint32_t skip, int flags);
+
+  /** Turns SO_ZEROCOPY on for the socket if a threshold is set. */
+  void enableZeroCopy();
+
+  /**
+   * Waits, for a bounded time, until the kernel is done with the buffers of
+   * the MSG_ZEROCOPY sends, and resets the connection if it is not.  Does
+   * not wait if the socket is non-blocking.
+   */
+  void awaitZeroCopy();
+
+  /**
+   * Sends the buffers, the first one from skip on, with a single sendmsg()
+   * and MSG_ZEROCOPY if they add up to the threshold.  Keeps the owners of
+   * the buffers it took bytes from.  Returns the number of bytes sent.
+   */
+  uint32_t sendZeroCopy(const TIoVec* vecs,
+                        uint32_t count,
+                        uint32_t skip,
+                        const std::shared_ptr<const void>* owners);
 };
 }
 }
@@ -30,6 +30,14 @@ namespace apache {
 namespace thrift {
 namespace transport {
 
+/**
+ * One of the buffers given to TTransport::writev().
+ */
+struct TIoVec {
+  const uint8_t* base;
+  uint32_t len;
+};
+
 /**
  * Helper template to hoist readAll implementation out of TTransport
  */
@@ -49,6 +57,48 @@ uint32_t readAll(Transport_& trans, uint8_t* buf, uint32_t len) {
   return have;
 }
 
+/**
+ * Helper templates for encoding straight into a transport's write buffer.
+ * reserveOr() returns space for len bytes, either reserved in the transport
+ * or scratch when it cannot provide that much.  commitOrWrite() then adds
+ * the len bytes actually encoded there to the transport's output.
+ */
+template <class Transport_>
+uint8_t* reserveOr(Transport_& trans, uint8_t* scratch, uint32_t len) {
+  uint8_t* out = trans.reserve(&len);
+  return out != nullptr ? out : scratch;
+}
+
+template <class Transport_>
+void commitOrWrite(Transport_& trans, const uint8_t* scratch, const uint8_t* out, uint32_t len) {
+  if (out == scratch) {
+    trans.write(scratch, len);
+  } else {
+    trans.commit(len);
+  }
+}
+
+/**
+ * Helper template to discard len bytes.  They are consumed straight out of
+ * the transport's buffer where it can be borrowed from, and read into a
+ * scratch buffer otherwise.
+ */
+template <class Transport_>
+void skipAll(Transport_& trans, uint64_t len) {
+  uint8_t scratch[512];
+  while (len > 0) {
+    uint32_t got = 1;
+    if (trans.borrow(nullptr, &got) != nullptr) {
+      got = got < len ? got : static_cast<uint32_t>(len);
+      trans.consume(got);
+    } else {
+      got = len < sizeof(scratch) ? static_cast<uint32_t>(len) : sizeof(scratch);
+      trans.readAll(scratch, got);
+    }
+    len -= got;
+  }
+}
+
 /**
  * Generic interface for a method of transporting data. A TTransport may be
  * capable of either reading or writing, but not necessarily both.
@@ -166,6 +216,25 @@ public:
     throw TTransportException(TTransportException::NOT_OPEN, "Base TTransport cannot write.");
   }
 
+  /**
+   * Writes count buffers one after the other, as if by a write() of each.
+   * Transports that can pass several buffers to the operating system at once,
+   * like TSocket, send them with a single call instead of one per buffer.
+   *
+   * @param vecs  The buffers to write out
+   * @param count The number of buffers
+   * @throws TTransportException if an error occurs
+   */
+  void writev(const TIoVec* vecs, uint32_t count) {
+    T_VIRTUAL_CALL();
+    writev_virt(vecs, count);
+  }
+  virtual void writev_virt(const TIoVec* vecs, uint32_t count) {
+    for (uint32_t i = 0; i < count; ++i) {
+      write_virt(vecs[i].base, vecs[i].len);
+    }
+  }
+
   /**
    * Called when write is completed.
    * This can be over-ridden to perform a transport-specific action
@@ -238,6 +307,58 @@ public:
     throw TTransportException(TTransportException::NOT_OPEN, "Base TTransport cannot consume.");
   }
 
+  /**
+   * Returns a reference that keeps the transport's current read buffer alive,
+   * so that pointers returned by borrow() stay valid after consume() and
+   * after the transport has moved on to its next buffer.  The transport will
+   * not write into a buffer once it has been shared.  Call it after borrow():
+   * the reference covers the buffer the last borrow() pointed into, which
+   * need not hold more than the bytes asked for.
+   *
+   * @return The owner of the read buffer, or nullptr if the transport cannot
+   *         share it, in which case borrowed data must be copied.
+   */
+  virtual std::shared_ptr<const void> shareReadBuffer() { return nullptr; }
+
+  /**
+   * Attempts to return a pointer to writable space in the transport's
+   * buffer, the write side counterpart of borrow().  The caller encodes
+   * directly into it and then calls commit() with the number of bytes it
+   * actually wrote.  No other write may come in between.  A reserve that is
+   * never committed leaves the output as it was, so it can also be used to
+   * make room ahead of writing a message of known size.
+   *
+   * @param len  *len should initially contain the number of bytes needed.
+   *             If reserve succeeds, *len will contain the number of bytes
+   *             available at the returned pointer, at least what was asked.
+   *             If reserve fails, the contents of *len are undefined.
+   * @return A pointer into the transport's write buffer, or nullptr if it
+   *         cannot provide that much space, in which case the caller should
+   *         fall back to write().
+   * @throws TTransportException if an error occurs
+   */
+  uint8_t* reserve(uint32_t* len) {
+    T_VIRTUAL_CALL();
+    return reserve_virt(len);
+  }
+  virtual uint8_t* reserve_virt(uint32_t* /* len */) { return nullptr; }
+
+  /**
+   * Adds len bytes written into the space returned by reserve() to the
+   * transport's output.  This should always follow a successful reserve of
+   * at least len bytes.
+   *
+   * @param len  How many bytes were written
+   * @throws TTransportException If an error occurs
+   */
+  void commit(uint32_t len) {
+    T_VIRTUAL_CALL();
+    commit_virt(len);
+  }
+  virtual void commit_virt(uint32_t /* len */) {
+    throw TTransportException(TTransportException::NOT_OPEN, "Base TTransport cannot commit.");
+  }
+
   /**
    * Returns the origin of the transports call. The value depends on the
    * transport used. An IP based transport for example will return the
@@ -0,0 +1,1028 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <thrift/thrift-config.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <utility>
+
+#ifdef HAVE_SYS_SOCKET_H
+#include <sys/socket.h>
+#endif
+#ifdef HAVE_POLL_H
+#include <poll.h>
+#endif
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#ifdef HAVE_LINUX_IO_URING_H
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+// IORING_FEAT_FAST_POLL implies a header that knows about all the socket
+// opcodes used below (send, recv, accept, link timeouts and cancellation).
+#if defined(__NR_io_uring_setup) && defined(IORING_FEAT_FAST_POLL)
+#define THRIFT_HAVE_IO_URING 1
+#endif
+#endif
+
+#include <thrift/transport/PlatformSocket.h>
+#include <thrift/transport/TTransportException.h>
+#include <thrift/transport/TUringSocket.h>
+
+namespace apache {
+namespace thrift {
+namespace transport {
+
+using std::shared_ptr;
+using std::string;
+
+namespace {
+
+/// Submission queue depth of the rings used by sockets
+const unsigned RING_ENTRIES = 8;
+
+/// user_data tags identifying the completions
+enum UringOp {
+  URING_OP_READ = 1,
+  URING_OP_WRITE,
+  URING_OP_SEND,
+  URING_OP_TIMEOUT,
+  URING_OP_INTERRUPT,
+  URING_OP_CANCEL,
+  URING_OP_LISTEN_POLL,
+  URING_OP_ACCEPT
+};
+
+/// Slots of the link timeouts a ring can have in flight
+enum UringTimeoutSlot { URING_TIMEOUT_READ = 0, URING_TIMEOUT_WRITE, URING_TIMEOUT_SEND, URING_TIMEOUT_SLOTS };
+}
+
+#ifdef THRIFT_HAVE_IO_URING
+
+/**
+ * Minimal io_uring instance, driven through the raw system calls so that no
+ * additional library is required.  Not thread safe; it has one user at a
+ * time.
+ */
+class TUringRing {
+public:
+  /**
+   * Creates a ring with the given number of submission entries, or returns
+   * nullptr if the kernel does not provide a usable io_uring.
+   */
+  static TUringRing* create(unsigned entries) {
+    struct io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+    int fd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+    if (fd < 0) {
+      return nullptr;
+    }
+    std::unique_ptr<TUringRing> ring(new TUringRing(fd));
+    if (!(params.features & IORING_FEAT_FAST_POLL) || !ring->map(params)) {
+      return nullptr;
+    }
+    return ring.release();
+  }
+
+  ~TUringRing() {
+    std::free(buffers_);
+    if (sqes_ != MAP_FAILED) {
+      munmap(sqes_, sqesSize_);
+    }
+    if (cqRing_ != MAP_FAILED && cqRing_ != sqRing_) {
+      munmap(cqRing_, cqRingSize_);
+    }
+    if (sqRing_ != MAP_FAILED) {
+      munmap(sqRing_, sqRingSize_);
+    }
+    ::close(fd_);
+  }
+
+  /**
+   * Returns a zeroed submission entry tagged with the given operation.
+   * Entries become visible to the kernel on the next enter().
+   */
+  struct io_uring_sqe* getSqe(uint8_t opcode, int fd, uint64_t tag) {
+    unsigned head = __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE);
+    if (sqeTail_ - head >= sqEntries_) {
+      // cannot happen with the number of operations the sockets keep in flight
+      throw TTransportException(TTransportException::UNKNOWN, "io_uring submission queue full");
+    }
+    unsigned index = sqeTail_ & sqMask_;
+    struct io_uring_sqe* sqe = &sqes_[index];
+    std::memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = opcode;
+    sqe->fd = fd;
+    sqe->user_data = tag;
+    sqArray_[index] = index;
+    ++sqeTail_;
+    return sqe;
+  }
+
+  /**
+   * Links a timeout of the given number of milliseconds to the entry
+   * obtained last, which must have been flagged with IOSQE_IO_LINK.
+   */
+  void linkTimeout(UringTimeoutSlot slot, int ms) {
+    struct __kernel_timespec* ts = &timeouts_[slot];
+    ts->tv_sec = ms / 1000;
+    ts->tv_nsec = (ms % 1000) * 1000000LL;
+    struct io_uring_sqe* sqe = getSqe(IORING_OP_LINK_TIMEOUT, -1, URING_OP_TIMEOUT);
+    sqe->addr = reinterpret_cast<uintptr_t>(ts);
+    sqe->len = 1;
+  }
+
+  /**
+   * Submits all prepared entries and, if requested, waits until at least
+   * one completion is available.
+   *
+   * @return the number of entries submitted, or a negated errno value
+   */
+  int enter(bool wait) {
+    __atomic_store_n(sqTail_, sqeTail_, __ATOMIC_RELEASE);
+    unsigned toSubmit = sqeTail_ - __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE);
+    if (toSubmit == 0 && !wait) {
+      return 0;
+    }
+    unsigned flags = wait ? IORING_ENTER_GETEVENTS : 0;
+    int ret = static_cast<int>(
+        syscall(__NR_io_uring_enter, fd_, toSubmit, wait ? 1 : 0, flags, nullptr, 0));
+    return ret < 0 ? -errno : ret;
+  }
+
+  /**
+   * Pops the next completion, if any.
+   */
+  bool popCqe(uint64_t& tag, int& res) {
+    unsigned head = __atomic_load_n(cqHead_, __ATOMIC_RELAXED);
+    if (head == __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE)) {
+      return false;
+    }
+    const struct io_uring_cqe& cqe = cqes_[head & cqMask_];
+    tag = cqe.user_data;
+    res = cqe.res;
+    __atomic_store_n(cqHead_, head + 1, __ATOMIC_RELEASE);
+    return true;
+  }
+
+  /**
+   * Allocates the receive and send buffers of a socket, size bytes each, and
+   * registers the receive buffer for use by IORING_OP_READ_FIXED.  They
+   * belong to the ring, so that they move with it to the next socket.
+   */
+  uint8_t* allocateBuffers(uint32_t size) {
+    buffers_ = static_cast<uint8_t*>(std::malloc(2 * static_cast<size_t>(size)));
+    if (buffers_ == nullptr) {
+      throw std::bad_alloc();
+    }
+    bufferSize_ = size;
+    // without a registered buffer reads fall back to IORING_OP_RECV
+    struct iovec iov;
+    iov.iov_base = buffers_;
+    iov.iov_len = size;
+    fixedBuffer_ = syscall(__NR_io_uring_register, fd_, IORING_REGISTER_BUFFERS, &iov, 1) == 0;
+    return buffers_;
+  }
+
+  uint8_t* getBuffers() const { return buffers_; }
+  uint32_t getBufferSize() const { return bufferSize_; }
+  bool hasFixedBuffer() const { return fixedBuffer_; }
+
+private:
+  explicit TUringRing(int fd)
+    : fd_(fd),
+      sqRing_(MAP_FAILED),
+      cqRing_(MAP_FAILED),
+      sqes_(static_cast<struct io_uring_sqe*>(MAP_FAILED)),
+      sqRingSize_(0),
+      cqRingSize_(0),
+      sqesSize_(0),
+      sqHead_(nullptr),
+      sqTail_(nullptr),
+      sqArray_(nullptr),
+      sqMask_(0),
+      sqEntries_(0),
+      sqeTail_(0),
+      cqHead_(nullptr),
+      cqTail_(nullptr),
+      cqes_(nullptr),
+      cqMask_(0),
+      buffers_(nullptr),
+      bufferSize_(0),
+      fixedBuffer_(false) {
+    std::memset(timeouts_, 0, sizeof(timeouts_));
+  }
+
+  bool map(const struct io_uring_params& params) {
+    sqRingSize_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cqRingSize_ = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    bool single = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single) {
+      sqRingSize_ = cqRingSize_ = (std::max)(sqRingSize_, cqRingSize_);
+    }
+
+    sqRing_ = mmap(nullptr, sqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_,
+                   IORING_OFF_SQ_RING);
+    if (sqRing_ == MAP_FAILED) {
+      return false;
+    }
+    if (single) {
+      cqRing_ = sqRing_;
+    } else {
+      cqRing_ = mmap(nullptr, cqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_,
+                     IORING_OFF_CQ_RING);
+      if (cqRing_ == MAP_FAILED) {
+        return false;
+      }
+    }
+    sqesSize_ = params.sq_entries * sizeof(struct io_uring_sqe);
+    sqes_ = static_cast<struct io_uring_sqe*>(mmap(nullptr, sqesSize_, PROT_READ | PROT_WRITE,
+                                                   MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQES));
+    if (sqes_ == MAP_FAILED) {
+      return false;
+    }
+
+    auto* sq = static_cast<uint8_t*>(sqRing_);
+    sqHead_ = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+    sqTail_ = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    sqArray_ = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    sqMask_ = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    sqEntries_ = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_entries);
+    sqeTail_ = *sqTail_;
+
+    auto* cq = static_cast<uint8_t*>(cqRing_);
+    cqHead_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    cqTail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    cqes_ = reinterpret_cast<struct io_uring_cqe*>(cq + params.cq_off.cqes);
+    cqMask_ = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    return true;
+  }
+
+  int fd_;
+  void* sqRing_;
+  void* cqRing_;
+  struct io_uring_sqe* sqes_;
+  size_t sqRingSize_;
+  size_t cqRingSize_;
+  size_t sqesSize_;
+
+  unsigned* sqHead_;
+  unsigned* sqTail_;
+  unsigned* sqArray_;
+  unsigned sqMask_;
+  unsigned sqEntries_;
+  unsigned sqeTail_; // local tail, published by enter()
+
+  unsigned* cqHead_;
+  unsigned* cqTail_;
+  struct io_uring_cqe* cqes_;
+  unsigned cqMask_;
+
+  uint8_t* buffers_;
+  uint32_t bufferSize_;
+  bool fixedBuffer_;
+  struct __kernel_timespec timeouts_[URING_TIMEOUT_SLOTS];
+};
+
+namespace {
+/**
+ * Ring of the last socket this thread closed, kept for the next one.  Pool
+ * threads of a server then set up a ring once rather than per connection,
+ * and so do clients that reconnect.
+ */
+thread_local std::unique_ptr<TUringRing> spareRing;
+}
+
+#else // THRIFT_HAVE_IO_URING
+
+// Placeholder so that std::unique_ptr<TUringRing> can be destroyed; it is
+// never instantiated.
+class TUringRing {};
+
+#endif // THRIFT_HAVE_IO_URING
+
+/**
+ * TUringSocket
+ */
+
+TUringSocket::TUringSocket(shared_ptr<TConfiguration> config) : TSocket(config) {
+  init();
+}
+
+TUringSocket::TUringSocket(const string& host, int port, shared_ptr<TConfiguration> config)
+  : TSocket(host, port, config) {
+  init();
+}
+
+TUringSocket::TUringSocket(const string& path, shared_ptr<TConfiguration> config)
+  : TSocket(path, config) {
+  init();
+}
+
+TUringSocket::TUringSocket(THRIFT_SOCKET socket, shared_ptr<TConfiguration> config)
+  : TSocket(socket, config) {
+  init();
+}
+
+TUringSocket::TUringSocket(THRIFT_SOCKET socket,
+                           shared_ptr<THRIFT_SOCKET> interruptListener,
+                           shared_ptr<TConfiguration> config)
+  : TSocket(socket, interruptListener, config) {
+  init();
+}
+
+TUringSocket::~TUringSocket() {
+  try {
+    close();
+  } catch (...) {
+    // close() does not throw, but a destructor must not either
+  }
+  releaseRing(false);
+}
+
+void TUringSocket::init() {
+  ringChecked_ = false;
+  bufferSize_ = DEFAULT_BUFFER_SIZE;
+  rBuf_ = nullptr;
+  rPos_ = rLen_ = 0;
+  readTarget_ = nullptr;
+  readPosted_ = readDone_ = false;
+  readResult_ = 0;
+  wBuf_ = nullptr;
+  wDone_ = wLen_ = 0;
+  writePosted_ = false;
+  writeError_ = 0;
+  sendPosted_ = false;
+  sendResult_ = 0;
+  interruptArmed_ = interrupted_ = false;
+}
+
+bool TUringSocket::isAvailable() {
+#ifdef THRIFT_HAVE_IO_URING
+  static const bool available = std::unique_ptr<TUringRing>(TUringRing::create(2)) != nullptr;
+  return available;
+#else
+  return false;
+#endif
+}
+
+bool TUringSocket::ensureRing() {
+  if (ring_) {
+    return true;
+  }
+  if (ringChecked_) {
+    return false;
+  }
+  ringChecked_ = true;
+#ifdef THRIFT_HAVE_IO_URING
+  if (!isAvailable()) {
+    return false;
+  }
+  if (spareRing && spareRing->getBufferSize() == bufferSize_) {
+    ring_ = std::move(spareRing);
+  } else {
+    std::unique_ptr<TUringRing> ring(TUringRing::create(RING_ENTRIES));
+    if (!ring) {
+      return false;
+    }
+    ring->allocateBuffers(bufferSize_);
+    ring_ = std::move(ring);
+  }
+  rBuf_ = ring_->getBuffers();
+  wBuf_ = rBuf_ + bufferSize_;
+  return true;
+#else
+  return false;
+#endif
+}
+
+void TUringSocket::releaseRing(bool idle) {
+#ifdef THRIFT_HAVE_IO_URING
+  if (idle && ring_) {
+    spareRing = std::move(ring_);
+  }
+#endif
+  ring_.reset();
+  rBuf_ = wBuf_ = nullptr;
+}
+
+#ifdef THRIFT_HAVE_IO_URING
+
+void TUringSocket::prepareRead(uint8_t* buf, uint32_t len) {
+  uint8_t opcode = (buf == rBuf_ && ring_->hasFixedBuffer()) ? IORING_OP_READ_FIXED
+                                                             : IORING_OP_RECV;
+  struct io_uring_sqe* sqe = ring_->getSqe(opcode, socket_, URING_OP_READ);
+  sqe->addr = reinterpret_cast<uintptr_t>(buf);
+  sqe->len = len;
+  if (recvTimeout_ > 0) {
+    sqe->flags |= IOSQE_IO_LINK;
+    ring_->linkTimeout(URING_TIMEOUT_READ, recvTimeout_);
+  }
+  if (buf == rBuf_) {
+    rPos_ = rLen_ = 0;
+  }
+  readTarget_ = buf;
+  readPosted_ = true;
+  readDone_ = false;
+}
+
+void TUringSocket::prepareWrite() {
+  if (writePosted_ || writeError_ || wDone_ == wLen_) {
+    return;
+  }
+  struct io_uring_sqe* sqe = ring_->getSqe(IORING_OP_SEND, socket_, URING_OP_WRITE);
+  sqe->addr = reinterpret_cast<uintptr_t>(wBuf_ + wDone_);
+  sqe->len = wLen_ - wDone_;
+  sqe->msg_flags = MSG_NOSIGNAL;
+  if (sendTimeout_ > 0) {
+    sqe->flags |= IOSQE_IO_LINK;
+    ring_->linkTimeout(URING_TIMEOUT_WRITE, sendTimeout_);
+  }
+  writePosted_ = true;
+}
+
+void TUringSocket::armInterrupt() {
+  if (!interruptListener_ || interruptArmed_ || interrupted_) {
+    return;
+  }
+  struct io_uring_sqe* sqe
+      = ring_->getSqe(IORING_OP_POLL_ADD, *(interruptListener_.get()), URING_OP_INTERRUPT);
+  sqe->poll_events = POLLIN;
+  interruptArmed_ = true;
+}
+
+void TUringSocket::reap() {
+  uint64_t tag;
+  int res;
+  while (ring_->popCqe(tag, res)) {
+    switch (tag) {
+    case URING_OP_READ:
+      readPosted_ = false;
+      readDone_ = true;
+      readResult_ = res;
+      if (readTarget_ == rBuf_ && res > 0) {
+        rPos_ = 0;
+        rLen_ = static_cast<uint32_t>(res);
+      }
+      break;
+    case URING_OP_WRITE:
+      writePosted_ = false;
+      if (res == -ECANCELED && sendTimeout_ <= 0) {
+        // the submitting thread has exited, the range is posted again
+      } else if (res < 0) {
+        writeError_ = (res == -ECANCELED) ? THRIFT_ETIMEDOUT : -res;
+        wDone_ = wLen_ = 0;
+      } else {
+        wDone_ += static_cast<uint32_t>(res);
+        if (wDone_ == wLen_) {
+          wDone_ = wLen_ = 0;
+        }
+      }
+      break;
+    case URING_OP_SEND:
+      sendPosted_ = false;
+      sendResult_ = res;
+      break;
+    case URING_OP_INTERRUPT:
+      interruptArmed_ = false;
+      if (res >= 0) {
+        interrupted_ = true;
+      }
+      break;
+    default:
+      // link timeouts and cancellations carry no state of their own
+      break;
+    }
+  }
+}
+
+void TUringSocket::submit(bool wait) {
+  prepareWrite();
+  int ret = ring_->enter(wait);
+  if (ret < 0 && ret != -EINTR && ret != -EAGAIN && ret != -EBUSY) {
+    GlobalOutput.perror("TUringSocket::submit() io_uring_enter() " + getSocketInfo(), -ret);
+    throw TTransportException(TTransportException::UNKNOWN, "io_uring_enter()", -ret);
+  }
+}
+
+bool TUringSocket::waitForRead() {
+  while (true) {
+    armInterrupt();
+    reap();
+    if (readDone_) {
+      break;
+    }
+    if (interrupted_) {
+      cancelRead();
+      break;
+    }
+    submit(true);
+  }
+  // a read cancelled because of the interrupt has no data to return
+  if (interrupted_ && readDone_ && readResult_ == -ECANCELED) {
+    readDone_ = false;
+    throw TTransportException(TTransportException::INTERRUPTED, "Interrupted");
+  }
+  // Requests are cancelled when the thread that submitted them exits, which
+  // happens to read-aheads posted by flush().  Without a timeout linked to it
+  // a cancelled read cannot mean anything else.
+  if (readResult_ == -ECANCELED && recvTimeout_ <= 0) {
+    readDone_ = false;
+    return false;
+  }
+  return true;
+}
+
+void TUringSocket::cancelRead() {
+  if (!readPosted_) {
+    return;
+  }
+  struct io_uring_sqe* sqe = ring_->getSqe(IORING_OP_ASYNC_CANCEL, -1, URING_OP_CANCEL);
+  sqe->addr = URING_OP_READ;
+  while (readPosted_) {
+    submit(true);
+    reap();
+  }
+}
+
+void TUringSocket::drainWrites() {
+  while (wLen_ != 0 && !writeError_) {
+    submit(true);
+    reap();
+  }
+  checkWriteError();
+}
+
+void TUringSocket::checkWriteError() {
+  if (!writeError_) {
+    return;
+  }
+  int errno_copy = writeError_;
+  writeError_ = 0;
+  if (errno_copy == THRIFT_ETIMEDOUT || errno_copy == THRIFT_EAGAIN) {
+    throw TTransportException(TTransportException::TIMED_OUT, "send timeout expired");
+  }
+  GlobalOutput.perror("TUringSocket::write() send() " + getSocketInfo(), errno_copy);
+  if (errno_copy == THRIFT_EPIPE || errno_copy == THRIFT_ECONNRESET
+      || errno_copy == THRIFT_ENOTCONN) {
+    throw TTransportException(TTransportException::NOT_OPEN, "write() send()", errno_copy);
+  }
+  throw TTransportException(TTransportException::UNKNOWN, "write() send()", errno_copy);
+}
+
+uint32_t TUringSocket::completeRead(uint8_t* buf, uint32_t len) {
+  readDone_ = false;
+  int res = readResult_;
+  if (res > 0) {
+    if (readTarget_ != rBuf_) {
+      return static_cast<uint32_t>(res);
+    }
+    uint32_t avail = rLen_ - rPos_;
+    if (buf == nullptr) {
+      return avail;
+    }
+    uint32_t give = (std::min)(len, avail);
+    std::memcpy(buf, rBuf_ + rPos_, give);
+    rPos_ += give;
+    return give;
+  }
+  if (res == 0 || res == -THRIFT_ECONNRESET) {
+    return 0;
+  }
+  int errno_copy = -res;
+  if (errno_copy == ECANCELED || errno_copy == ETIME) {
+    GlobalOutput.printf("TUringSocket::read() THRIFT_EAGAIN (timed out) after %d ms", recvTimeout_);
+    throw TTransportException(TTransportException::TIMED_OUT, "THRIFT_EAGAIN (timed out)");
+  }
+  if (errno_copy == THRIFT_EAGAIN) {
+    throw TTransportException(TTransportException::TIMED_OUT, "THRIFT_EAGAIN (unavailable resources)");
+  }
+  if (errno_copy == THRIFT_ENOTCONN) {
+    throw TTransportException(TTransportException::NOT_OPEN, "THRIFT_ENOTCONN");
+  }
+  if (errno_copy == THRIFT_ETIMEDOUT) {
+    throw TTransportException(TTransportException::TIMED_OUT, "THRIFT_ETIMEDOUT");
+  }
+  GlobalOutput.perror("TUringSocket::read() recv() " + getSocketInfo(), errno_copy);
+  throw TTransportException(TTransportException::UNKNOWN, "Unknown", errno_copy);
+}
+
+int TUringSocket::sendDirect(const uint8_t* buf, uint32_t len) {
+  struct io_uring_sqe* sqe = ring_->getSqe(IORING_OP_SEND, socket_, URING_OP_SEND);
+  sqe->addr = reinterpret_cast<uintptr_t>(buf);
+  sqe->len = len;
+  sqe->msg_flags = MSG_NOSIGNAL;
+  if (sendTimeout_ > 0) {
+    sqe->flags |= IOSQE_IO_LINK;
+    ring_->linkTimeout(URING_TIMEOUT_SEND, sendTimeout_);
+  }
+  sendPosted_ = true;
+  while (sendPosted_) {
+    submit(true);
+    reap();
+  }
+  return sendResult_;
+}
+
+#else // THRIFT_HAVE_IO_URING
+
+// ensureRing() never succeeds, so none of these is reached
+void TUringSocket::prepareRead(uint8_t*, uint32_t) {}
+void TUringSocket::prepareWrite() {}
+void TUringSocket::armInterrupt() {}
+void TUringSocket::reap() {}
+void TUringSocket::submit(bool) {}
+bool TUringSocket::waitForRead() {
+  return false;
+}
+void TUringSocket::cancelRead() {}
+void TUringSocket::drainWrites() {}
+void TUringSocket::checkWriteError() {}
+uint32_t TUringSocket::completeRead(uint8_t*, uint32_t) {
+  return 0;
+}
+int TUringSocket::sendDirect(const uint8_t*, uint32_t) {
+  return 0;
+}
+
+#endif // THRIFT_HAVE_IO_URING
+
+bool TUringSocket::peek() {
+  if (!ensureRing()) {
+    return TSocket::peek();
+  }
+  if (rPos_ < rLen_) {
+    return true;
+  }
+  if (!isOpen()) {
+    return false;
+  }
+  try {
+    do {
+      if (!readPosted_ && !readDone_) {
+        if (interrupted_) {
+          return false;
+        }
+        prepareRead(rBuf_, bufferSize_);
+      }
+    } while (!waitForRead());
+    return completeRead(nullptr, 0) > 0;
+  } catch (TTransportException& ex) {
+    if (ex.getType() == TTransportException::INTERRUPTED) {
+      return false;
+    }
+    if (ex.getType() == TTransportException::TIMED_OUT && interruptListener_) {
+      return false;
+    }
+    throw;
+  }
+}
+
+uint32_t TUringSocket::read(uint8_t* buf, uint32_t len) {
+  if (!ensureRing()) {
+    return TSocket::read(buf, len);
+  }
+  checkReadBytesAvailable(len);
+  if (socket_ == THRIFT_INVALID_SOCKET) {
+    throw TTransportException(TTransportException::NOT_OPEN, "Called read on non-open socket");
+  }
+
+  int32_t retries = 0;
+  while (true) {
+    if (rPos_ < rLen_) {
+      uint32_t give = (std::min)(len, rLen_ - rPos_);
+      std::memcpy(buf, rBuf_ + rPos_, give);
+      rPos_ += give;
+      return give;
+    }
+    if (!readPosted_ && !readDone_) {
+      if (interrupted_) {
+        throw TTransportException(TTransportException::INTERRUPTED, "Interrupted");
+      }
+      // large reads go straight into the caller's buffer
+      if (len >= bufferSize_) {
+        prepareRead(buf, len);
+      } else {
+        prepareRead(rBuf_, bufferSize_);
+      }
+    }
+    // send whatever was written so far together with the read
+    if (!waitForRead()) {
+      continue;
+    }
+    if (readResult_ == -THRIFT_EINTR && retries++ < maxRecvRetries_) {
+      readDone_ = false;
+      continue;
+    }
+    if (readTarget_ == buf) {
+      return completeRead(buf, len);
+    }
+    if (readResult_ > 0) {
+      readDone_ = false;
+      continue;
+    }
+    return completeRead(buf, len);
+  }
+}
+
+void TUringSocket::write(const uint8_t* buf, uint32_t len) {
+  if (!ensureRing()) {
+    TSocket::write(buf, len);
+    return;
+  }
+  if (socket_ == THRIFT_INVALID_SOCKET) {
+    throw TTransportException(TTransportException::NOT_OPEN, "Called write on non-open socket");
+  }
+  checkWriteError();
+
+  if (len > bufferSize_ - wLen_) {
+    drainWrites();
+  }
+  if (len < bufferSize_) {
+    std::memcpy(wBuf_ + wLen_, buf, len);
+    wLen_ += len;
+    return;
+  }
+
+  uint32_t sent = 0;
+  while (sent < len) {
+    int res = sendDirect(buf + sent, len - sent);
+    if (res < 0) {
+      writeError_ = (res == -ECANCELED) ? THRIFT_ETIMEDOUT : -res;
+      checkWriteError();
+    }
+    if (res == 0) {
+      throw TTransportException(TTransportException::NOT_OPEN, "Socket send returned 0.");
+    }
+    sent += static_cast<uint32_t>(res);
+  }
+}
+
+uint32_t TUringSocket::write_partial(const uint8_t* buf, uint32_t len) {
+  if (!ensureRing()) {
+    return TSocket::write_partial(buf, len);
+  }
+  if (socket_ == THRIFT_INVALID_SOCKET) {
+    throw TTransportException(TTransportException::NOT_OPEN, "Called write on non-open socket");
+  }
+  drainWrites();
+
+  int res = sendDirect(buf, len);
+  if (res == -THRIFT_EAGAIN || res == -ECANCELED) {
+    return 0;
+  }
+  if (res < 0) {
+    writeError_ = -res;
+    checkWriteError();
+  }
+  return static_cast<uint32_t>(res);
+}
+
+void TUringSocket::writev(const TIoVec* vecs, uint32_t count) {
+  if (!ensureRing()) {
+    TSocket::writev(vecs, count);
+    return;
+  }
+  // the send buffer gathers them anyway
+  for (uint32_t i = 0; i < count; ++i) {
+    write(vecs[i].base, vecs[i].len);
+  }
+}
+
+uint32_t TUringSocket::writev_partial(const TIoVec* vecs, uint32_t count) {
+  if (!ensureRing()) {
+    return TSocket::writev_partial(vecs, count);
+  }
+  return writeFirst_partial(vecs, count);
+}
+
+void TUringSocket::flush() {
+  if (!ring_) {
+    TSocket::flush();
+    return;
+  }
+  checkWriteError();
+  // only one send is in flight at a time, anything appended since follows it
+  while (writePosted_) {
+    submit(true);
+    reap();
+  }
+  checkWriteError();
+  if (wLen_ == wDone_) {
+    return;
+  }
+  // Hand the request to the kernel together with a read for the reply, so
+  // that the following read() only has to wait for the completion.  With a
+  // receive timeout the read is posted by read() to start the timer there.
+  if (recvTimeout_ == 0 && !readPosted_ && !readDone_ && rPos_ == rLen_ && !interrupted_) {
+    prepareRead(rBuf_, bufferSize_);
+    armInterrupt();
+  }
+  submit(false);
+  reap();
+  if (sendTimeout_ > 0) {
+    // the timeout only applies while the submitting thread is alive
+    drainWrites();
+  }
+  checkWriteError();
+}
+
+bool TUringSocket::hasPendingDataToRead() {
+  if (!ring_) {
+    return TSocket::hasPendingDataToRead();
+  }
+  if (rPos_ < rLen_) {
+    return true;
+  }
+  reap();
+  if (rPos_ < rLen_) {
+    return true;
+  }
+  if (readPosted_ || readDone_) {
+    return false;
+  }
+  return TSocket::hasPendingDataToRead();
+}
+
+void TUringSocket::close() {
+#ifdef THRIFT_HAVE_IO_URING
+  if (ring_) {
+    try {
+      if (socket_ != THRIFT_INVALID_SOCKET) {
+        if (wLen_ != wDone_ && !writeError_) {
+          drainWrites();
+        }
+        ::shutdown(socket_, THRIFT_SHUT_RDWR);
+      }
+      // the kernel may still write into rBuf_; wait for everything in flight
+      if (readPosted_) {
+        struct io_uring_sqe* sqe = ring_->getSqe(IORING_OP_ASYNC_CANCEL, -1, URING_OP_CANCEL);
+        sqe->addr = URING_OP_READ;
+      }
+      if (interruptArmed_) {
+        struct io_uring_sqe* sqe = ring_->getSqe(IORING_OP_ASYNC_CANCEL, -1, URING_OP_CANCEL);
+        sqe->addr = URING_OP_INTERRUPT;
+      }
+      while (readPosted_ || interruptArmed_ || writePosted_) {
+        submit(true);
+        reap();
+      }
+      // nothing is in flight any more, so the next socket may have the ring
+      releaseRing(true);
+    } catch (const TTransportException&) {
+      // the ring is unusable; tearing it down cancels what is left
+      releaseRing(false);
+    }
+    ringChecked_ = false;
+    rPos_ = rLen_ = 0;
+    readPosted_ = readDone_ = false;
+    wDone_ = wLen_ = 0;
+    writePosted_ = false;
+    writeError_ = 0;
+    interrupted_ = false;
+  }
+#endif
+  TSocket::close();
+}
+
+/**
+ * TUringServerSocket
+ */
+
+TUringServerSocket::TUringServerSocket(int port)
+  : TServerSocket(port), ringChecked_(false), interruptArmed_(false) {
+}
+
+TUringServerSocket::TUringServerSocket(int port, int sendTimeout, int recvTimeout)
+  : TServerSocket(port, sendTimeout, recvTimeout), ringChecked_(false), interruptArmed_(false) {
+}
+
+TUringServerSocket::TUringServerSocket(const string& address, int port)
+  : TServerSocket(address, port), ringChecked_(false), interruptArmed_(false) {
+}
+
+TUringServerSocket::TUringServerSocket(const string& path)
+  : TServerSocket(path), ringChecked_(false), interruptArmed_(false) {
+}
+
+TUringServerSocket::~TUringServerSocket() = default;
+
+shared_ptr<TSocket> TUringServerSocket::createSocket(THRIFT_SOCKET clientSocket) {
+  if (interruptableChildren_) {
+    return std::make_shared<TUringSocket>(clientSocket, pChildInterruptSockReader_);
+  } else {
+    return std::make_shared<TUringSocket>(clientSocket);
+  }
+}
+
+THRIFT_SOCKET TUringServerSocket::acceptSocket(struct sockaddr* clientAddress, socklen_t* size) {
+#ifdef THRIFT_HAVE_IO_URING
+  if (!ring_ && !ringChecked_) {
+    ringChecked_ = true;
+    if (TUringSocket::isAvailable()) {
+      ring_.reset(TUringRing::create(RING_ENTRIES));
+    }
+  }
+  if (!ring_ || getAcceptTimeout() >= 0) {
+    return TServerSocket::acceptSocket(clientAddress, size);
+  }
+
+  THRIFT_SOCKET interruptSock = getInterruptSockReader();
+  socklen_t addressSize = *size;
+  while (true) {
+    if (interruptSock != THRIFT_INVALID_SOCKET && !interruptArmed_) {
+      struct io_uring_sqe* sqe
+          = ring_->getSqe(IORING_OP_POLL_ADD, interruptSock, URING_OP_INTERRUPT);
+      sqe->poll_events = POLLIN;
+      interruptArmed_ = true;
+    }
+
+    // the listening socket is non-blocking: wait for it to become readable,
+    // then accept, in a single submission
+    struct io_uring_sqe* sqe = ring_->getSqe(IORING_OP_POLL_ADD, getSocketFD(), URING_OP_LISTEN_POLL);
+    sqe->poll_events = POLLIN;
+    sqe->flags |= IOSQE_IO_LINK;
+    *size = addressSize;
+    sqe = ring_->getSqe(IORING_OP_ACCEPT, getSocketFD(), URING_OP_ACCEPT);
+    sqe->addr = reinterpret_cast<uintptr_t>(clientAddress);
+    sqe->addr2 = reinterpret_cast<uintptr_t>(size);
+
+    bool accepted = false;
+    bool interrupted = false;
+    bool cancelled = false;
+    int acceptResult = 0;
+    while (!accepted) {
+      int ret = ring_->enter(true);
+      if (ret < 0 && ret != -EINTR && ret != -EAGAIN && ret != -EBUSY) {
+        GlobalOutput.perror("TUringServerSocket::acceptSocket() io_uring_enter() ", -ret);
+        throw TTransportException(TTransportException::UNKNOWN, "io_uring_enter()", -ret);
+      }
+      uint64_t tag;
+      int res;
+      while (ring_->popCqe(tag, res)) {
+        if (tag == URING_OP_ACCEPT) {
+          accepted = true;
+          acceptResult = res;
+        } else if (tag == URING_OP_INTERRUPT) {
+          interruptArmed_ = false;
+          interrupted = interrupted || res >= 0;
+        }
+      }
+      if (interrupted && !accepted && !cancelled) {
+        // cancelling the head of the link cancels the accept as well
+        sqe = ring_->getSqe(IORING_OP_ASYNC_CANCEL, -1, URING_OP_CANCEL);
+        sqe->addr = URING_OP_LISTEN_POLL;
+        cancelled = true;
+      }
+    }
+
+    if (acceptResult >= 0) {
+      // a pending interrupt is picked up by the next call
+      return acceptResult;
+    }
+    if (interrupted) {
+      int8_t buf;
+      if (-1 == recv(interruptSock, &buf, sizeof(int8_t), 0)) {
+        GlobalOutput.perror("TUringServerSocket::acceptSocket() recv() interrupt ",
+                            THRIFT_GET_SOCKET_ERROR);
+      }
+      throw TTransportException(TTransportException::INTERRUPTED);
+    }
+    if (acceptResult == -THRIFT_EAGAIN || acceptResult == -THRIFT_EINTR
+        || acceptResult == -ECANCELED) {
+      // another thread took the connection, or the poll was interrupted
+      continue;
+    }
+    int errno_copy = -acceptResult;
+    GlobalOutput.perror("TUringServerSocket::acceptSocket() accept() ", errno_copy);
+    throw TTransportException(TTransportException::UNKNOWN, "accept()", errno_copy);
+  }
+#else
+  return TServerSocket::acceptSocket(clientAddress, size);
+#endif
+}
+}
+}
+} // apache::thrift::transport
@@ -0,0 +1,190 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _THRIFT_TRANSPORT_TURINGSOCKET_H_
+#define _THRIFT_TRANSPORT_TURINGSOCKET_H_ 1
+
+#include <memory>
+#include <string>
+
+#include <thrift/transport/TServerSocket.h>
+#include <thrift/transport/TSocket.h>
+
+namespace apache {
+namespace thrift {
+namespace transport {
+
+class TUringRing;
+
+/**
+ * TCP socket that performs its I/O through a Linux io_uring instance.
+ *
+ * Reads are issued into a receive buffer registered with the ring, so a
+ * single completion typically satisfies several read() calls of the
+ * protocol layer.  Writes are gathered in a send buffer and handed to the
+ * kernel on flush(), together with a read-ahead for the reply, in a single
+ * io_uring_enter() call.  Compared to TSocket this replaces the
+ * poll() + recv() + send() sequence per request with one submission and one
+ * wait.
+ *
+ * Because writes are deferred, data is only guaranteed to be handed to the
+ * kernel once flush(), read() or close() has been called.  All buffered
+ * transports and generated clients and processors flush after each message.
+ *
+ * Unlike TSocket, an instance must not be read from and written to by
+ * different threads at the same time, so it cannot be shared by the
+ * reading and writing side of a TConcurrentClient.
+ *
+ * Each open socket drives its own small ring, which costs a file descriptor
+ * and three shared mappings on top of the socket.  The servers this is used
+ * with already give every connection a thread, which blocks on that ring
+ * alone, so a ring shared between connections would only add locking and
+ * the hand-over of completions between threads.  A closed socket passes its
+ * ring and buffers on to the next socket the same thread opens, so pool
+ * threads and reconnecting clients do not set them up again.
+ *
+ * When io_uring is not available (old kernels, seccomp filters, non-Linux
+ * platforms) every operation falls back to the TSocket implementation.
+ */
+class TUringSocket : public TSocket {
+public:
+  /// Default size of both the receive and the send buffer
+  static const uint32_t DEFAULT_BUFFER_SIZE = 64 * 1024;
+
+  TUringSocket(std::shared_ptr<TConfiguration> config = nullptr);
+  TUringSocket(const std::string& host, int port, std::shared_ptr<TConfiguration> config = nullptr);
+  TUringSocket(const std::string& path, std::shared_ptr<TConfiguration> config = nullptr);
+  TUringSocket(THRIFT_SOCKET socket, std::shared_ptr<TConfiguration> config = nullptr);
+  TUringSocket(THRIFT_SOCKET socket,
+               std::shared_ptr<THRIFT_SOCKET> interruptListener,
+               std::shared_ptr<TConfiguration> config = nullptr);
+
+  ~TUringSocket() override;
+
+  /**
+   * TTransport interface.
+   */
+  bool peek() override;
+  void close() override;
+  bool hasPendingDataToRead() override;
+  uint32_t read(uint8_t* buf, uint32_t len) override;
+  void write(const uint8_t* buf, uint32_t len) override;
+  uint32_t write_partial(const uint8_t* buf, uint32_t len) override;
+  void writev(const TIoVec* vecs, uint32_t count) override;
+  uint32_t writev_partial(const TIoVec* vecs, uint32_t count) override;
+  void flush() override;
+
+  /**
+   * Set the size of the receive and send buffers.  Only has an effect before
+   * the first I/O operation on this socket.
+   */
+  void setBufferSize(uint32_t size) { bufferSize_ = size; }
+
+  /**
+   * Whether I/O on this socket is currently performed through io_uring.
+   * This is decided on the first I/O operation, so it returns false before,
+   * and again after close().
+   */
+  bool isUringActive() const { return ring_ != nullptr; }
+
+  /**
+   * Whether the running kernel allows this process to create an io_uring
+   * instance.  The result is probed once and cached.
+   */
+  static bool isAvailable();
+
+private:
+  void init();
+  bool ensureRing();
+  void releaseRing(bool idle);
+
+  void prepareRead(uint8_t* buf, uint32_t len);
+  void prepareWrite();
+  void armInterrupt();
+  void reap();
+  void submit(bool wait);
+  bool waitForRead();
+  void cancelRead();
+  void drainWrites();
+  void checkWriteError();
+  uint32_t completeRead(uint8_t* buf, uint32_t len);
+  int sendDirect(const uint8_t* buf, uint32_t len);
+
+  std::unique_ptr<TUringRing> ring_;
+  bool ringChecked_;
+  uint32_t bufferSize_;
+
+  /// Receive buffer, registered with the ring when possible
+  uint8_t* rBuf_;
+  uint32_t rPos_;
+  uint32_t rLen_;
+
+  /// Destination of the read in flight and its outcome
+  uint8_t* readTarget_;
+  bool readPosted_;
+  bool readDone_;
+  int readResult_;
+
+  /// Send buffer: [wDone_, wLen_) has not been acknowledged by the kernel yet
+  uint8_t* wBuf_;
+  uint32_t wDone_;
+  uint32_t wLen_;
+  bool writePosted_;
+  int writeError_;
+
+  /// Outcome of an unbuffered send
+  bool sendPosted_;
+  int sendResult_;
+
+  /// State of the poll on the interrupt listener, if any
+  bool interruptArmed_;
+  bool interrupted_;
+};
+
+/**
+ * Server socket that accepts connections through io_uring and hands out
+ * TUringSocket children.  It can be used with any TServerFramework based
+ * server, e.g. TThreadPoolServer or TThreadedServer.
+ *
+ * Accepts with an accept timeout fall back to the TServerSocket path, as
+ * does everything else when io_uring is not available.
+ */
+class TUringServerSocket : public TServerSocket {
+public:
+  TUringServerSocket(int port);
+  TUringServerSocket(int port, int sendTimeout, int recvTimeout);
+  TUringServerSocket(const std::string& address, int port);
+  TUringServerSocket(const std::string& path);
+
+  ~TUringServerSocket() override;
+
+protected:
+  std::shared_ptr<TSocket> createSocket(THRIFT_SOCKET client) override;
+  THRIFT_SOCKET acceptSocket(struct sockaddr* clientAddress, socklen_t* size) override;
+
+private:
+  std::unique_ptr<TUringRing> ring_;
+  bool ringChecked_;
+  bool interruptArmed_;
+};
+}
+}
+} // apache::thrift::transport
+
+#endif // #ifndef _THRIFT_TRANSPORT_TURINGSOCKET_H_
@@ -30,7 +30,7 @@ namespace transport {
  * Helper class that provides default implementations of TTransport methods.
  *
  * This class provides default implementations of read(), readAll(), write(),
- * borrow() and consume().
+ * writev(), borrow() and consume().
  *
  * In the TTransport base class, each of these methods simply invokes its
  * virtual counterpart.  This class overrides them to always perform the
@@ -51,10 +51,13 @@ public:
   uint32_t read(uint8_t* buf, uint32_t len) { return this->TTransport::read_virt(buf, len); }
   uint32_t readAll(uint8_t* buf, uint32_t len) { return this->TTransport::readAll_virt(buf, len); }
   void write(const uint8_t* buf, uint32_t len) { this->TTransport::write_virt(buf, len); }
+  void writev(const TIoVec* vecs, uint32_t count) { this->TTransport::writev_virt(vecs, count); }
   const uint8_t* borrow(uint8_t* buf, uint32_t* len) {
     return this->TTransport::borrow_virt(buf, len);
   }
   void consume(uint32_t len) { this->TTransport::consume_virt(len); }
+  uint8_t* reserve(uint32_t* len) { return this->TTransport::reserve_virt(len); }
+  void commit(uint32_t len) { this->TTransport::commit_virt(len); }
 
 protected:
   TTransportDefaults(std::shared_ptr<TConfiguration> config = nullptr) : TTransport(config) {}
@@ -96,12 +99,22 @@ public:
     static_cast<Transport_*>(this)->write(buf, len);
   }
 
+  void writev_virt(const TIoVec* vecs, uint32_t count) override {
+    static_cast<Transport_*>(this)->writev(vecs, count);
+  }
+
   const uint8_t* borrow_virt(uint8_t* buf, uint32_t* len) override {
     return static_cast<Transport_*>(this)->borrow(buf, len);
   }
 
   void consume_virt(uint32_t len) override { static_cast<Transport_*>(this)->consume(len); }
 
+  uint8_t* reserve_virt(uint32_t* len) override {
+    return static_cast<Transport_*>(this)->reserve(len);
+  }
+
+  void commit_virt(uint32_t len) override { static_cast<Transport_*>(this)->commit(len); }
+
   /*
    * Provide a default readAll() implementation that invokes
    * read() non-virtually.
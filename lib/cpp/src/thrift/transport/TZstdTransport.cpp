@@ -0,0 +1,413 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <cassert>
+#include <cstring>
+#include <algorithm>
+#include <zstd.h>
+#include <zdict.h>
+#include <thrift/TToString.h>
+#include <thrift/transport/TZstdTransport.h>
+
+namespace apache {
+namespace thrift {
+namespace transport {
+
+TZstdTransport::TZstdTransport(std::shared_ptr<TTransport> transport,
+                               int urbuf_size,
+                               int crbuf_size,
+                               int uwbuf_size,
+                               int cwbuf_size,
+                               int comp_level,
+                               const std::string& dictionary,
+                               std::shared_ptr<TConfiguration> config)
+  : TVirtualTransport(config),
+    transport_(transport),
+    urpos_(0),
+    urlen_(0),
+    crpos_(0),
+    crlen_(0),
+    uwpos_(0),
+    cwpos_(0),
+    input_ended_(false),
+    output_finished_(false),
+    rflushing_(false),
+    urbuf_size_(urbuf_size),
+    crbuf_size_(crbuf_size),
+    uwbuf_size_(uwbuf_size),
+    cwbuf_size_(cwbuf_size),
+    urbuf_(nullptr),
+    crbuf_(nullptr),
+    uwbuf_(nullptr),
+    cwbuf_(nullptr),
+    rctx_(nullptr),
+    wctx_(nullptr) {
+  if (uwbuf_size_ < MIN_DIRECT_COMPRESS_SIZE) {
+    // Have to copy this into a local because of a linking issue.
+    uint32_t minimum = MIN_DIRECT_COMPRESS_SIZE;
+    throw TTransportException(TTransportException::BAD_ARGS,
+                              "TZstdTransport: uncompressed write buffer must be at least "
+                              + to_string(minimum) + ".");
+  }
+
+  try {
+    urbuf_ = new uint8_t[urbuf_size];
+    crbuf_ = new uint8_t[crbuf_size];
+    uwbuf_ = new uint8_t[uwbuf_size];
+    cwbuf_ = new uint8_t[cwbuf_size];
+
+    rctx_ = ZSTD_createDCtx();
+    wctx_ = ZSTD_createCCtx();
+    if (rctx_ == nullptr || wctx_ == nullptr) {
+      throw std::bad_alloc();
+    }
+    checkZstdRv(ZSTD_CCtx_setParameter(wctx_, ZSTD_c_compressionLevel, comp_level));
+    checkZstdRv(ZSTD_CCtx_setParameter(wctx_, ZSTD_c_checksumFlag, 1));
+    if (!dictionary.empty()) {
+      checkZstdRv(ZSTD_CCtx_loadDictionary(wctx_, dictionary.data(), dictionary.size()));
+      checkZstdRv(ZSTD_DCtx_loadDictionary(rctx_, dictionary.data(), dictionary.size()));
+    }
+  } catch (...) {
+    ZSTD_freeDCtx(rctx_);
+    ZSTD_freeCCtx(wctx_);
+    delete[] urbuf_;
+    delete[] crbuf_;
+    delete[] uwbuf_;
+    delete[] cwbuf_;
+    throw;
+  }
+}
+
+void TZstdTransport::checkZstdRv(size_t rv) {
+  if (ZSTD_isError(rv)) {
+    throw TZstdTransportException(rv, ZSTD_getErrorName(rv));
+  }
+}
+
+TZstdTransport::~TZstdTransport() {
+  // Like TZlibTransport, data written but not flushed is silently discarded.
+  ZSTD_freeDCtx(rctx_);
+  ZSTD_freeCCtx(wctx_);
+
+  delete[] urbuf_;
+  delete[] crbuf_;
+  delete[] uwbuf_;
+  delete[] cwbuf_;
+}
+
+bool TZstdTransport::isOpen() const {
+  return (readAvail() > 0) || readPending() || transport_->isOpen();
+}
+
+bool TZstdTransport::peek() {
+  return (readAvail() > 0) || readPending() || transport_->peek();
+}
+
+// READING STRATEGY
+//
+// As in TZlibTransport, compressed data is read into crbuf_ and decompressed
+// into urbuf_, from where it is copied out.  Reads of at least urbuf_size_
+// bytes are decompressed straight into the caller's buffer instead.
+//
+// zstd decompresses whole blocks, so it may hold on to data it had no room
+// for in the output buffer.  rflushing_ keeps track of that, so that we do
+// not block on the underlying transport while data is still available.
+
+uint32_t TZstdTransport::read(uint8_t* buf, uint32_t len) {
+  checkReadBytesAvailable(len);
+  uint32_t need = len;
+
+  while (true) {
+    // Copy out whatever we have available.
+    uint32_t give = (std::min)(readAvail(), need);
+    memcpy(buf, urbuf_ + urpos_, give);
+    need -= give;
+    buf += give;
+    urpos_ += give;
+
+    // If they were satisfied, we are done.
+    if (need == 0) {
+      return len;
+    }
+
+    // read() is only allowed to block when no data is available, so return
+    // what we have if getting more means reading the underlying transport.
+    if (need < len && !readPending()) {
+      return len - need;
+    }
+
+    // If zstd has reported the end of the frame, we can't do any more.
+    if (input_ended_) {
+      return len - need;
+    }
+
+    uint32_t got;
+    if (need >= urbuf_size_) {
+      if (!readFromZstd(buf, need, &got)) {
+        return len - need;
+      }
+      need -= got;
+      buf += got;
+    } else {
+      urpos_ = 0;
+      if (!readFromZstd(urbuf_, urbuf_size_, &urlen_)) {
+        urlen_ = 0;
+        return len - need;
+      }
+    }
+  }
+}
+
+bool TZstdTransport::readFromZstd(uint8_t* buf, uint32_t len, uint32_t* got) {
+  assert(!input_ended_);
+
+  // If we don't have any more compressed data available and zstd has
+  // nothing left to give, read some from the underlying transport.
+  if (!readPending()) {
+    uint32_t n = transport_->read(crbuf_, crbuf_size_);
+    if (n == 0) {
+      return false;
+    }
+    crpos_ = 0;
+    crlen_ = n;
+  }
+
+  ZSTD_inBuffer in = {crbuf_, crlen_, crpos_};
+  ZSTD_outBuffer out = {buf, len, 0};
+  size_t rv = ZSTD_decompressStream(rctx_, &out, &in);
+  checkZstdRv(rv);
+  crpos_ = static_cast<uint32_t>(in.pos);
+  *got = static_cast<uint32_t>(out.pos);
+  rflushing_ = out.pos == out.size;
+
+  if (rv == 0) {
+    input_ended_ = true;
+  }
+  return true;
+}
+
+// WRITING STRATEGY
+//
+// Small writes are buffered up in uwbuf_ before they are given to zstd, as
+// in TZlibTransport.  zstd compresses into cwbuf_, which is written to the
+// underlying transport whenever it is full.
+
+void TZstdTransport::write(const uint8_t* buf, uint32_t len) {
+  if (output_finished_) {
+    throw TTransportException(TTransportException::BAD_ARGS, "write() called after finish()");
+  }
+
+  if (len > MIN_DIRECT_COMPRESS_SIZE) {
+    flushToZstd(uwbuf_, uwpos_, ZSTD_e_continue);
+    uwpos_ = 0;
+    flushToZstd(buf, len, ZSTD_e_continue);
+  } else if (len > 0) {
+    if (uwbuf_size_ - uwpos_ < len) {
+      flushToZstd(uwbuf_, uwpos_, ZSTD_e_continue);
+      uwpos_ = 0;
+    }
+    memcpy(uwbuf_ + uwpos_, buf, len);
+    uwpos_ += len;
+  }
+}
+
+void TZstdTransport::flush() {
+  if (output_finished_) {
+    throw TTransportException(TTransportException::BAD_ARGS, "flush() called after finish()");
+  }
+
+  flushToTransport(ZSTD_e_flush);
+  resetConsumedMessageSize();
+}
+
+void TZstdTransport::finish() {
+  if (output_finished_) {
+    throw TTransportException(TTransportException::BAD_ARGS, "finish() called more than once");
+  }
+
+  flushToTransport(ZSTD_e_end);
+  output_finished_ = true;
+}
+
+void TZstdTransport::flushToTransport(int mode) {
+  // write pending data in uwbuf_ to zstd
+  flushToZstd(uwbuf_, uwpos_, mode);
+  uwpos_ = 0;
+
+  // write all available data from zstd to the transport
+  transport_->write(cwbuf_, cwpos_);
+  cwpos_ = 0;
+
+  // flush the transport
+  transport_->flush();
+}
+
+void TZstdTransport::flushToZstd(const uint8_t* buf, uint32_t len, int mode) {
+  if (len == 0 && mode == ZSTD_e_continue) {
+    return;
+  }
+  ZSTD_inBuffer in = {buf, len, 0};
+
+  while (true) {
+    // If our output buffer is full, flush to the underlying transport.
+    if (cwpos_ == cwbuf_size_) {
+      transport_->write(cwbuf_, cwbuf_size_);
+      cwpos_ = 0;
+    }
+
+    ZSTD_outBuffer out = {cwbuf_, cwbuf_size_, cwpos_};
+    size_t rv = ZSTD_compressStream2(wctx_, &out, &in, static_cast<ZSTD_EndDirective>(mode));
+    checkZstdRv(rv);
+    cwpos_ = static_cast<uint32_t>(out.pos);
+
+    // When flushing, zstd returns how much it still has to write out.
+    if (mode == ZSTD_e_continue ? in.pos == in.size : rv == 0) {
+      break;
+    }
+  }
+}
+
+const uint8_t* TZstdTransport::borrow(uint8_t* buf, uint32_t* len) {
+  (void)buf;
+  // Only lend what is already decompressed, otherwise let the protocol use
+  // its slow path.
+  if (readAvail() >= *len) {
+    *len = readAvail();
+    return urbuf_ + urpos_;
+  }
+  return nullptr;
+}
+
+void TZstdTransport::consume(uint32_t len) {
+  countConsumedMessageBytes(len);
+  if (readAvail() >= len) {
+    urpos_ += len;
+  } else {
+    throw TTransportException(TTransportException::BAD_ARGS, "consume did not follow a borrow.");
+  }
+}
+
+void TZstdTransport::verifyChecksum() {
+  // If zstd has already reported the end of the frame,
+  // it has verified the checksum.
+  if (input_ended_) {
+    return;
+  }
+
+  // This should only be called when reading is complete.
+  if (readAvail() > 0) {
+    throw TTransportException(TTransportException::CORRUPTED_DATA,
+                              "verifyChecksum() called before end of zstd frame");
+  }
+
+  // Decompress whatever is left.  This throws if the checksum is bad.
+  // The first call may only find out that the last read left nothing
+  // behind, so keep going until there is data or the end of the frame.
+  urpos_ = 0;
+  urlen_ = 0;
+  while (!input_ended_ && urlen_ == 0) {
+    if (!readFromZstd(urbuf_, urbuf_size_, &urlen_)) {
+      // See TZlibTransport::verifyChecksum() for why this depends on the
+      // underlying transport.
+      urlen_ = 0;
+      throw TTransportException(TTransportException::CORRUPTED_DATA,
+                                "checksum not available yet in "
+                                "verifyChecksum()");
+    }
+  }
+
+  // If input_ended_ is true now, the checksum has been verified
+  if (input_ended_ && urlen_ == 0) {
+    return;
+  }
+
+  // The caller invoked us before the actual end of the frame
+  throw TTransportException(TTransportException::CORRUPTED_DATA,
+                            "verifyChecksum() called before end of "
+                            "zstd frame");
+}
+
+TZstdDictionary::TZstdDictionary(const std::string& content, uint32_t id, int comp_level)
+  : id_(id), content_(content), cdict_(nullptr), ddict_(nullptr) {
+  if (id_ == 0) {
+    id_ = ZSTD_getDictID_fromDict(content_.data(), content_.size());
+    if (id_ == 0) {
+      throw TTransportException(TTransportException::BAD_ARGS,
+                                "TZstdDictionary: a dictionary without an id needs one.");
+    }
+  }
+
+  // The digested forms are read-only, which is what makes them shareable.
+  cdict_ = ZSTD_createCDict(content_.data(), content_.size(), comp_level);
+  ddict_ = ZSTD_createDDict(content_.data(), content_.size());
+  if (cdict_ == nullptr || ddict_ == nullptr) {
+    ZSTD_freeCDict(cdict_);
+    ZSTD_freeDDict(ddict_);
+    throw std::bad_alloc();
+  }
+}
+
+TZstdDictionary::~TZstdDictionary() {
+  ZSTD_freeCDict(cdict_);
+  ZSTD_freeDDict(ddict_);
+}
+
+std::string TZstdDictionary::train(const std::vector<std::string>& samples, size_t capacity) {
+  std::string buffer;
+  std::vector<size_t> sizes;
+  sizes.reserve(samples.size());
+  for (const std::string& sample : samples) {
+    buffer += sample;
+    sizes.push_back(sample.size());
+  }
+
+  std::string dictionary(capacity, '\0');
+  size_t rv = ZDICT_trainFromBuffer(&dictionary[0],
+                                    capacity,
+                                    buffer.data(),
+                                    sizes.data(),
+                                    static_cast<unsigned>(sizes.size()));
+  if (ZDICT_isError(rv)) {
+    throw TZstdTransportException(rv, ZDICT_getErrorName(rv));
+  }
+  dictionary.resize(rv);
+  return dictionary;
+}
+
+TZstdTransportFactory::TZstdTransportFactory(std::shared_ptr<TTransportFactory> transportFactory,
+                                             int comp_level,
+                                             const std::string& dictionary)
+  : transportFactory_(transportFactory), comp_level_(comp_level), dictionary_(dictionary) {
+}
+
+std::shared_ptr<TTransport> TZstdTransportFactory::getTransport(std::shared_ptr<TTransport> trans) {
+  if (transportFactory_) {
+    trans = transportFactory_->getTransport(trans);
+  }
+  return std::shared_ptr<TTransport>(new TZstdTransport(trans,
+                                                        TZstdTransport::DEFAULT_URBUF_SIZE,
+                                                        TZstdTransport::DEFAULT_CRBUF_SIZE,
+                                                        TZstdTransport::DEFAULT_UWBUF_SIZE,
+                                                        TZstdTransport::DEFAULT_CWBUF_SIZE,
+                                                        comp_level_,
+                                                        dictionary_));
+}
+}
+}
+} // apache::thrift::transport
@@ -0,0 +1,261 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _THRIFT_TRANSPORT_TZSTDTRANSPORT_H_
+#define _THRIFT_TRANSPORT_TZSTDTRANSPORT_H_ 1
+
+#include <string>
+#include <vector>
+
+#include <thrift/TNonCopyable.h>
+#include <thrift/transport/TTransport.h>
+#include <thrift/transport/TVirtualTransport.h>
+
+struct ZSTD_CCtx_s;
+struct ZSTD_DCtx_s;
+struct ZSTD_CDict_s;
+struct ZSTD_DDict_s;
+
+namespace apache {
+namespace thrift {
+namespace transport {
+
+class TZstdTransportException : public TTransportException {
+public:
+  TZstdTransportException(size_t code, const char* name)
+    : TTransportException(TTransportException::INTERNAL_ERROR, errorMessage(name)),
+      zstd_code_(code),
+      zstd_name_(name == nullptr ? "(null)" : name) {}
+
+  ~TZstdTransportException() noexcept override = default;
+
+  size_t getZstdCode() const { return zstd_code_; }
+  std::string getZstdErrorName() const { return zstd_name_; }
+
+  static std::string errorMessage(const char* name) {
+    std::string rv = "zstd error: ";
+    rv += name ? name : "(no message)";
+    return rv;
+  }
+
+  size_t zstd_code_;
+  std::string zstd_name_;
+};
+
+/**
+ * This transport uses zstd to compress on write and decompress on read.
+ *
+ * It works like TZlibTransport: flush() ends a block, so that everything
+ * written so far can be decompressed by the peer, and finish() ends the zstd
+ * frame along with its checksum, which verifyChecksum() checks on the other
+ * side.  zstd is much cheaper than zlib for a similar ratio.
+ *
+ * Both ends may use a dictionary, e.g. one trained with "zstd --train" on
+ * typical messages, which helps a lot with small messages.  The same
+ * dictionary must be given to both ends.
+ */
+class TZstdTransport : public TVirtualTransport<TZstdTransport> {
+public:
+  /**
+   * @param transport    The transport to read compressed data from
+   *                     and write compressed data to.
+   * @param urbuf_size   Uncompressed buffer size for reading.
+   * @param crbuf_size   Compressed buffer size for reading.
+   * @param uwbuf_size   Uncompressed buffer size for writing.
+   * @param cwbuf_size   Compressed buffer size for writing.
+   * @param comp_level   Compression level (negative=fastest, 3=default, 19=max[slow]).
+   * @param dictionary   Dictionary to compress and decompress with, if not empty.
+   */
+  TZstdTransport(std::shared_ptr<TTransport> transport,
+                 int urbuf_size = DEFAULT_URBUF_SIZE,
+                 int crbuf_size = DEFAULT_CRBUF_SIZE,
+                 int uwbuf_size = DEFAULT_UWBUF_SIZE,
+                 int cwbuf_size = DEFAULT_CWBUF_SIZE,
+                 int comp_level = DEFAULT_COMP_LEVEL,
+                 const std::string& dictionary = std::string(),
+                 std::shared_ptr<TConfiguration> config = nullptr);
+
+  /**
+   * TZstdTransport destructor.
+   *
+   * Warning: Destroying a TZstdTransport object may discard any written but
+   * unflushed data.  You must explicitly call flush() or finish() to ensure
+   * that data is actually written and flushed to the underlying transport.
+   */
+  ~TZstdTransport() override;
+
+  bool isOpen() const override;
+  bool peek() override;
+
+  void open() override { transport_->open(); }
+
+  void close() override { transport_->close(); }
+
+  uint32_t read(uint8_t* buf, uint32_t len);
+
+  void write(const uint8_t* buf, uint32_t len);
+
+  void flush() override;
+
+  /**
+   * End the zstd frame.
+   *
+   * This writes out any pending data followed by the end of the frame,
+   * including the checksum.  Once finish() has been called, no new data can
+   * be written to the stream.
+   */
+  void finish();
+
+  const uint8_t* borrow(uint8_t* buf, uint32_t* len);
+
+  void consume(uint32_t len);
+
+  /**
+   * Verify the checksum at the end of the zstd frame.
+   *
+   * This may only be called after all data has been read.
+   * It verifies the checksum that was written by the finish() call.
+   */
+  void verifyChecksum();
+
+  static const int DEFAULT_URBUF_SIZE = 4096;
+  static const int DEFAULT_CRBUF_SIZE = 4096;
+  static const int DEFAULT_UWBUF_SIZE = 512;
+  static const int DEFAULT_CWBUF_SIZE = 4096;
+  static const int DEFAULT_COMP_LEVEL = 3;
+
+  std::shared_ptr<TTransport> getUnderlyingTransport() const { return transport_; }
+
+protected:
+  void checkZstdRv(size_t rv);
+  uint32_t readAvail() const { return urlen_ - urpos_; }
+  bool readPending() const { return crpos_ < crlen_ || rflushing_; }
+  void flushToTransport(int mode);
+  void flushToZstd(const uint8_t* buf, uint32_t len, int mode);
+  bool readFromZstd(uint8_t* buf, uint32_t len, uint32_t* got);
+
+protected:
+  // Writes smaller than this are buffered up.
+  // Larger (or equal) writes are sent straight to zstd.
+  static const uint32_t MIN_DIRECT_COMPRESS_SIZE = 32;
+
+  std::shared_ptr<TTransport> transport_;
+
+  uint32_t urpos_;
+  uint32_t urlen_;
+  uint32_t crpos_;
+  uint32_t crlen_;
+  uint32_t uwpos_;
+  uint32_t cwpos_;
+
+  /// True iff zstd has reached the end of the input frame.
+  bool input_ended_;
+  /// True iff we have finished the output frame.
+  bool output_finished_;
+  /// True iff zstd may still hold decompressed data it had no room for.
+  bool rflushing_;
+
+  uint32_t urbuf_size_;
+  uint32_t crbuf_size_;
+  uint32_t uwbuf_size_;
+  uint32_t cwbuf_size_;
+
+  uint8_t* urbuf_;
+  uint8_t* crbuf_;
+  uint8_t* uwbuf_;
+  uint8_t* cwbuf_;
+
+  struct ZSTD_DCtx_s* rctx_;
+  struct ZSTD_CCtx_s* wctx_;
+};
+
+/**
+ * A zstd dictionary, digested once for compressing and decompressing so that
+ * it can be shared by any number of transports and threads.
+ *
+ * THeaderTransport uses these for the ZSTD_TRANSFORM, where they make small
+ * messages much smaller.  Dictionaries are told apart by their id, so a new
+ * version of a dictionary must get a new id.
+ */
+class TZstdDictionary : apache::thrift::TNonCopyable {
+public:
+  /**
+   * @param content     The dictionary, typically made by train().
+   * @param id          Identifies the dictionary to peers.  0 means the id
+   *                    stored in a trained dictionary, which raw content
+   *                    does not have.
+   * @param comp_level  Compression level to compress with.
+   */
+  explicit TZstdDictionary(const std::string& content,
+                           uint32_t id = 0,
+                           int comp_level = TZstdTransport::DEFAULT_COMP_LEVEL);
+
+  ~TZstdDictionary() override;
+
+  uint32_t getId() const { return id_; }
+  const std::string& getContent() const { return content_; }
+
+  struct ZSTD_CDict_s* getCDict() const { return cdict_; }
+  struct ZSTD_DDict_s* getDDict() const { return ddict_; }
+
+  /**
+   * Trains a dictionary on sample messages, the more the better, as they
+   * will be sent.  The result is at most capacity bytes and has a random id.
+   */
+  static std::string train(const std::vector<std::string>& samples,
+                           size_t capacity = DEFAULT_CAPACITY);
+
+  static const size_t DEFAULT_CAPACITY = 16 * 1024;
+
+private:
+  uint32_t id_;
+  std::string content_;
+  struct ZSTD_CDict_s* cdict_;
+  struct ZSTD_DDict_s* ddict_;
+};
+
+/**
+ * Wraps a transport into a zstd compressed one.
+ */
+class TZstdTransportFactory : public TTransportFactory {
+public:
+  TZstdTransportFactory() = default;
+
+  /**
+   * Wraps a transport factory into a zstd compressed one.
+   */
+  TZstdTransportFactory(std::shared_ptr<TTransportFactory> transportFactory,
+                        int comp_level = TZstdTransport::DEFAULT_COMP_LEVEL,
+                        const std::string& dictionary = std::string());
+
+  ~TZstdTransportFactory() override = default;
+
+  std::shared_ptr<TTransport> getTransport(std::shared_ptr<TTransport> trans) override;
+
+protected:
+  std::shared_ptr<TTransportFactory> transportFactory_;
+  int comp_level_ = TZstdTransport::DEFAULT_COMP_LEVEL;
+  std::string dictionary_;
+};
+
+}
+}
+} // apache::thrift::transport
+
+#endif // #ifndef _THRIFT_TRANSPORT_TZSTDTRANSPORT_H_
@@ -45,3 +45,24 @@ BOOST_AUTO_TEST_CASE(test_little_binary_protocol) {
 BOOST_AUTO_TEST_CASE(test_compact_protocol) {
   testProtocol<TCompactProtocol>("TCompactProtocol");
 }
+
+BOOST_AUTO_TEST_CASE(test_binary_protocol_array_limits) {
+  shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer());
+  buffer->write(reinterpret_cast<const uint8_t*>("0123456789abcdef"), 16);
+  int64_t values[2] = {0, 0};
+
+  // a count from the wire that overflows when scaled to bytes
+  TBinaryProtocol protocol(buffer);
+  BOOST_CHECK_EXCEPTION(protocol.readI32s(reinterpret_cast<int32_t*>(values), 0x40000001),
+                        TProtocolException,
+                        [](const TProtocolException& e) {
+                          return e.getType() == TProtocolException::SIZE_LIMIT;
+                        });
+  BOOST_CHECK_THROW(protocol.writeI64s(values, 0x20000001), TProtocolException);
+  BOOST_CHECK_EQUAL(buffer->available_read(), 16u);
+
+  TBinaryProtocol limited(buffer);
+  limited.setContainerSizeLimit(1);
+  BOOST_CHECK_THROW(limited.readI64s(values, 2), TProtocolException);
+  BOOST_CHECK_EQUAL(limited.readI64s(values, 1), 8u);
+}
@@ -125,6 +125,178 @@ void testMessage() {
   }
 }
 
+template <typename Val>
+uint32_t readEach(shared_ptr<TProtocol> protocol, Val* values, uint32_t count) {
+  uint32_t xfer = 0;
+  for (uint32_t i = 0; i < count; ++i) {
+    xfer += GenericIO::read(protocol, values[i]);
+  }
+  return xfer;
+}
+
+inline uint32_t readBulk(shared_ptr<TProtocol> protocol, int16_t* values, uint32_t count) {
+  return protocol->readI16s(values, count);
+}
+inline uint32_t readBulk(shared_ptr<TProtocol> protocol, int32_t* values, uint32_t count) {
+  return protocol->readI32s(values, count);
+}
+inline uint32_t readBulk(shared_ptr<TProtocol> protocol, int64_t* values, uint32_t count) {
+  return protocol->readI64s(values, count);
+}
+inline uint32_t readBulk(shared_ptr<TProtocol> protocol, double* values, uint32_t count) {
+  return protocol->readDoubles(values, count);
+}
+
+inline uint32_t writeBulk(shared_ptr<TProtocol> protocol, const int16_t* values, uint32_t count) {
+  return protocol->writeI16s(values, count);
+}
+inline uint32_t writeBulk(shared_ptr<TProtocol> protocol, const int32_t* values, uint32_t count) {
+  return protocol->writeI32s(values, count);
+}
+inline uint32_t writeBulk(shared_ptr<TProtocol> protocol, const int64_t* values, uint32_t count) {
+  return protocol->writeI64s(values, count);
+}
+inline uint32_t writeBulk(shared_ptr<TProtocol> protocol, const double* values, uint32_t count) {
+  return protocol->writeDoubles(values, count);
+}
+
+/**
+ * Writes a list with the bulk call and reads it back both with the bulk call
+ * and element by element, once from a buffer the protocol can borrow from
+ * and once through a transport whose buffer is too small for that.
+ */
+template <typename TProto, TType type, typename Val>
+void testList(uint32_t count) {
+  std::vector<Val> val(count);
+  for (uint32_t i = 0; i < count; ++i) {
+    // spread the values over every magnitude and both signs
+    val[i] = static_cast<Val>(static_cast<int64_t>(i * 0x9E3779B97F4A7C15ULL) >> (i % 64));
+  }
+
+  for (int pass = 0; pass < 4; ++pass) {
+    shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer());
+    shared_ptr<TTransport> transport = buffer;
+    if (pass >= 2) {
+      transport.reset(new TBufferedTransport(buffer, 64));
+    }
+    shared_ptr<TProtocol> protocol(new TProto(transport));
+
+    uint32_t written = protocol->writeListBegin(type, count);
+    written += writeBulk(protocol, val.data(), count);
+    written += protocol->writeListEnd();
+    transport->flush();
+
+    TType elemType;
+    uint32_t size;
+    uint32_t read = protocol->readListBegin(elemType, size);
+    std::vector<Val> out(size);
+    if (pass % 2) {
+      read += readEach(protocol, out.data(), size);
+    } else {
+      read += readBulk(protocol, out.data(), size);
+    }
+    read += protocol->readListEnd();
+
+    if (elemType != type || out != val || read != written) {
+      THRIFT_SNPRINTF(errorMessage,
+                      ERR_LEN,
+                      "Invalid list test (type: %s, pass: %d)",
+                      ClassNames::getName<Val>(),
+                      pass);
+      throw TException(errorMessage);
+    }
+  }
+}
+
+/**
+ * Writes a struct with a field of every kind, followed by a marker, and
+ * checks that skip() passes over exactly the bytes of the struct, once from a
+ * buffer the protocol can borrow from and once through a transport whose
+ * buffer is too small for that.
+ */
+template <typename TProto>
+void testSkip() {
+  for (int pass = 0; pass < 2; ++pass) {
+    shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer());
+    shared_ptr<TTransport> transport = buffer;
+    if (pass == 1) {
+      transport.reset(new TBufferedTransport(buffer, 64));
+    }
+    shared_ptr<TProtocol> protocol(new TProto(transport));
+
+    uint32_t written = protocol->writeStructBegin("skipped");
+    written += protocol->writeFieldBegin("flag", T_BOOL, 1);
+    written += protocol->writeBool(true);
+    written += protocol->writeFieldBegin("byte", T_BYTE, 2);
+    written += protocol->writeByte(-7);
+    written += protocol->writeFieldBegin("i16", T_I16, 3);
+    written += protocol->writeI16(-300);
+    written += protocol->writeFieldBegin("i32", T_I32, 20);
+    written += protocol->writeI32(70000);
+    written += protocol->writeFieldBegin("i64", T_I64, 21);
+    written += protocol->writeI64((std::numeric_limits<int64_t>::min)());
+    written += protocol->writeFieldBegin("double", T_DOUBLE, 300);
+    written += protocol->writeDouble(1.5);
+    written += protocol->writeFieldBegin("string", T_STRING, 301);
+    written += protocol->writeString(std::string(1000, 's'));
+    written += protocol->writeFieldBegin("nested", T_STRUCT, 302);
+    written += protocol->writeStructBegin("nested");
+    written += protocol->writeFieldBegin("flag", T_BOOL, 1);
+    written += protocol->writeBool(false);
+    written += protocol->writeFieldStop();
+    written += protocol->writeStructEnd();
+    written += protocol->writeFieldBegin("i64s", T_LIST, 303);
+    written += protocol->writeListBegin(T_I64, 200);
+    for (int64_t i = 0; i < 200; ++i) {
+      written += protocol->writeI64(static_cast<int64_t>(static_cast<uint64_t>(i) << (i % 60)));
+    }
+    written += protocol->writeFieldBegin("strings", T_SET, 304);
+    written += protocol->writeSetBegin(T_STRING, 3);
+    written += protocol->writeString("");
+    written += protocol->writeString("one");
+    written += protocol->writeString(std::string(100, 't'));
+    written += protocol->writeFieldBegin("bools", T_LIST, 305);
+    written += protocol->writeListBegin(T_BOOL, 2);
+    written += protocol->writeBool(true);
+    written += protocol->writeBool(false);
+    written += protocol->writeFieldBegin("doubles", T_MAP, 306);
+    written += protocol->writeMapBegin(T_I32, T_DOUBLE, 20);
+    for (int32_t i = 0; i < 20; ++i) {
+      written += protocol->writeI32(i * 1000);
+      written += protocol->writeDouble(i);
+    }
+    written += protocol->writeFieldBegin("varints", T_MAP, 307);
+    written += protocol->writeMapBegin(T_I16, T_I64, 20);
+    for (int16_t i = 0; i < 20; ++i) {
+      written += protocol->writeI16(-i);
+      written += protocol->writeI64(i * 1000000007LL);
+    }
+    written += protocol->writeFieldBegin("empty", T_MAP, 308);
+    written += protocol->writeMapBegin(T_STRING, T_STRUCT, 0);
+    written += protocol->writeFieldBegin("structs", T_LIST, 309);
+    written += protocol->writeListBegin(T_STRUCT, 2);
+    for (int32_t i = 0; i < 2; ++i) {
+      written += protocol->writeStructBegin("element");
+      written += protocol->writeFieldBegin("i32", T_I32, 1);
+      written += protocol->writeI32(i);
+      written += protocol->writeFieldStop();
+      written += protocol->writeStructEnd();
+    }
+    written += protocol->writeFieldStop();
+    written += protocol->writeStructEnd();
+    protocol->writeI32(12345);
+    transport->flush();
+
+    uint32_t skipped = protocol->skip(T_STRUCT);
+    int32_t marker;
+    protocol->readI32(marker);
+    if (skipped != written || marker != 12345) {
+      THRIFT_SNPRINTF(errorMessage, ERR_LEN, "Invalid skip test (pass: %d)", pass);
+      throw TException(errorMessage);
+    }
+  }
+}
+
 template <typename TProto>
 void testProtocol(const char* protoname) {
   try {
@@ -213,6 +385,14 @@ void testProtocol(const char* protoname) {
     testField<TProto, T_STRING, std::string>("borderlinetiny");
     testField<TProto, T_STRING, std::string>("a bit longer than the smallest possible");
 
+    testList<TProto, T_I16, int16_t>(0);
+    testList<TProto, T_I16, int16_t>(1000);
+    testList<TProto, T_I32, int32_t>(1000);
+    testList<TProto, T_I64, int64_t>(1000);
+    testList<TProto, T_DOUBLE, double>(1000);
+
+    testSkip<TProto>();
+
     testMessage<TProto>();
 
     printf("%s => OK\n", protoname);
@@ -24,9 +24,15 @@
 #define _USE_MATH_DEFINES
 #include <math.h>
 #include <memory>
+#include <string>
 #include "thrift/protocol/TBinaryProtocol.h"
+#include "thrift/protocol/TCompactProtocol.h"
+#include "thrift/protocol/TFieldMask.h"
+#include "thrift/protocol/TMultiplexedProtocol.h"
+#include "thrift/processor/TMultiplexedProcessor.h"
 #include "thrift/transport/TBufferTransports.h"
 #include "gen-cpp/DebugProtoTest_types.h"
+#include "gen-cpp/PartialTest_types.h"
 
 #ifdef HAVE_SYS_TIME_H
 #include <sys/time.h>
@@ -48,6 +54,60 @@ public:
   }
 };
 
+// Reads a call and does nothing with it
+class NullProcessor : public apache::thrift::TProcessor {
+public:
+  bool process(std::shared_ptr<apache::thrift::protocol::TProtocol> in,
+               std::shared_ptr<apache::thrift::protocol::TProtocol>,
+               void*) override {
+    std::string name;
+    apache::thrift::protocol::TMessageType type;
+    int32_t seqid;
+    in->readMessageBegin(name, type, seqid);
+    in->skip(apache::thrift::protocol::T_STRUCT);
+    in->readMessageEnd();
+    return true;
+  }
+};
+
+// Writes value num times the way a client sends a call, into a new buffer
+// or into one reused from the last call, with or without sizing it first as
+// generated code does.  Returns the rate in kHz.
+template <class Protocol_, class T>
+double writeRate(const T& value, int num, bool reuse, bool sized) {
+  using apache::thrift::transport::TMemoryBuffer;
+  std::shared_ptr<TMemoryBuffer> buf(new TMemoryBuffer());
+  Protocol_ prot(buf);
+  double elapsed = 0.0;
+  Timer timer;
+
+  for (int i = 0; i < num; ++i) {
+    if (reuse) {
+      buf->resetBuffer();
+      if (sized)
+        apache::thrift::protocol::reserveSerializedSize(&prot, value);
+      value.write(&prot);
+    } else {
+      std::shared_ptr<TMemoryBuffer> buf2(new TMemoryBuffer());
+      Protocol_ prot2(buf2);
+      if (sized)
+        apache::thrift::protocol::reserveSerializedSize(&prot2, value);
+      value.write(&prot2);
+    }
+  }
+  elapsed = timer.frame();
+  return num / (1000 * elapsed);
+}
+
+template <class Protocol_, class T>
+void printSizing(const char* name, const T& value, int num) {
+  using std::cout;
+  cout << "  " << name << " new buffer: " << writeRate<Protocol_>(value, num, false, false)
+       << " kHz, sized " << writeRate<Protocol_>(value, num, false, true) << " kHz" << '\n';
+  cout << "  " << name << " reused buffer: " << writeRate<Protocol_>(value, num, true, false)
+       << " kHz, sized " << writeRate<Protocol_>(value, num, true, true) << " kHz" << '\n';
+}
+
 int main() {
   using namespace thrift::test::debug;
   using namespace apache::thrift::transport;
@@ -240,5 +300,177 @@ int main() {
   }
 
 
+  // Zigzag varint lists, element by element and through the bulk calls.
+  // The values cover one to five byte varints.
+  std::vector<int64_t> varints(num);
+  for (int x = 0; x < num; ++x)
+    varints[x] = (x % 2 ? 1 : -1) * (int64_t(x) << (x % 29));
+  std::vector<int64_t> varints2(num);
+
+  {
+    buf->resetBuffer();
+    TCompactProtocolT<TMemoryBuffer> prot(buf);
+    double elapsed = 0.0;
+    Timer timer;
+
+    for (int x = 0; x < num; ++x)
+      prot.writeI64(varints[x]);
+    elapsed = timer.frame();
+    cout << "Varint write one by one: " << num / (1000 * elapsed) << " kHz" << '\n';
+  }
+
+  {
+    buf->getBuffer(&data, &datasize);
+    std::shared_ptr<TMemoryBuffer> buf2(new TMemoryBuffer(data, datasize));
+    TCompactProtocolT<TMemoryBuffer> prot(buf2);
+    double elapsed = 0.0;
+    Timer timer;
+
+    for (int x = 0; x < num; ++x)
+      prot.readI64(varints2[x]);
+    elapsed = timer.frame();
+    cout << " Varint read one by one: " << num / (1000 * elapsed) << " kHz" << '\n';
+  }
+
+  {
+    buf->resetBuffer();
+    TCompactProtocolT<TMemoryBuffer> prot(buf);
+    double elapsed = 0.0;
+    Timer timer;
+
+    prot.writeI64s(varints.data(), num);
+    elapsed = timer.frame();
+    cout << "Varint write bulk: " << num / (1000 * elapsed) << " kHz" << '\n';
+  }
+
+  {
+    buf->getBuffer(&data, &datasize);
+    std::shared_ptr<TMemoryBuffer> buf2(new TMemoryBuffer(data, datasize));
+    TCompactProtocolT<TMemoryBuffer> prot(buf2);
+    double elapsed = 0.0;
+    Timer timer;
+
+    prot.readI64s(varints2.data(), num);
+    elapsed = timer.frame();
+    cout << " Varint read bulk: " << num / (1000 * elapsed) << " kHz" << '\n';
+  }
+
+  if (varints2 != varints) {
+    cout << "Varint round trip failed" << '\n';
+    return 1;
+  }
+
+  // A 50 field struct read whole and with readPartial() asking for two fields
+  partialtest::Wide wide;
+  wide.id = 1;
+  wide.name = "wide";
+  wide.field3 = M_PI;
+  wide.field7 = std::string(32, 'x');
+  wide.field9.assign(16, 9);
+  wide.field10 = 10;
+  wide.field11 = 11;
+  wide.field12 = std::string(32, 'y');
+  wide.field24.assign(16, 24);
+  wide.field32 = std::string(32, 'z');
+  wide.field45 = 45;
+  wide.inner.b = std::string(32, 'i');
+  wide.inner.c.assign(16, 50);
+  int numWide = num / 100;
+
+  {
+    buf->resetBuffer();
+    TBinaryProtocolT<TMemoryBuffer> prot(buf);
+    for (int i = 0; i < numWide; ++i)
+      wide.write(&prot);
+  }
+
+  {
+    buf->getBuffer(&data, &datasize);
+    std::shared_ptr<TMemoryBuffer> buf2(new TMemoryBuffer(data, datasize));
+    TBinaryProtocolT<TMemoryBuffer> prot(buf2);
+    partialtest::Wide wide2;
+    double elapsed = 0.0;
+    Timer timer;
+
+    for (int i = 0; i < numWide; ++i)
+      wide2.read(&prot);
+    elapsed = timer.frame();
+    cout << "  Wide read: " << numWide / (1000 * elapsed) << " kHz" << '\n';
+  }
+
+  {
+    buf->getBuffer(&data, &datasize);
+    std::shared_ptr<TMemoryBuffer> buf2(new TMemoryBuffer(data, datasize));
+    TBinaryProtocolT<TMemoryBuffer> prot(buf2);
+    partialtest::Wide wide2;
+    TFieldMask mask{1, 2};
+    double elapsed = 0.0;
+    Timer timer;
+
+    for (int i = 0; i < numWide; ++i)
+      wide2.readPartial(&prot, mask);
+    elapsed = timer.frame();
+    cout << "  Wide read partial: " << numWide / (1000 * elapsed) << " kHz" << '\n';
+  }
+
+  {
+    buf->getBuffer(&data, &datasize);
+    std::shared_ptr<TMemoryBuffer> buf2(new TMemoryBuffer(data, datasize));
+    TBinaryProtocolT<TMemoryBuffer> prot(buf2);
+    double elapsed = 0.0;
+    Timer timer;
+
+    for (int i = 0; i < numWide; ++i)
+      prot.skip(T_STRUCT);
+    elapsed = timer.frame();
+    cout << "  Wide skip: " << numWide / (1000 * elapsed) << " kHz" << '\n';
+  }
+
+  // The sizing pass that generated code runs before writing a message, for a
+  // small message, a large one of many elements and a large string.  The
+  // compact protocol cannot write uuids, so these leave OneOfEach out.
+  cout << "Sizing pass:" << '\n';
+  {
+    Bonk small;
+    small.message = "small";
+    small.type = 1;
+    HolyMoley large;
+    for (int i = 0; i < 100; ++i)
+      large.bonks[std::to_string(i)].assign(100, small);
+    Bonk blob;
+    blob.message = std::string(1 << 20, 'b');
+    printSizing<TBinaryProtocolT<TMemoryBuffer> >("Binary small", small, 1000000);
+    printSizing<TBinaryProtocolT<TMemoryBuffer> >("Binary large", large, 1000);
+    printSizing<TBinaryProtocolT<TMemoryBuffer> >("Binary string", blob, 1000);
+    printSizing<TCompactProtocolT<TMemoryBuffer> >("Compact small", small, 1000000);
+    printSizing<TCompactProtocolT<TMemoryBuffer> >("Compact large", large, 1000);
+    printSizing<TCompactProtocolT<TMemoryBuffer> >("Compact string", blob, 1000);
+  }
+
+  cout << "Multiplexed:" << '\n';
+  {
+    apache::thrift::TMultiplexedProcessor processor;
+    processor.registerProcessor("Calculator", std::make_shared<NullProcessor>());
+    processor.registerProcessor("WeatherReport", std::make_shared<NullProcessor>());
+    std::shared_ptr<TMemoryBuffer> buf2(new TMemoryBuffer());
+    std::shared_ptr<TProtocol> prot(new TBinaryProtocol(buf2));
+    TMultiplexedProtocol mprot(prot, "WeatherReport");
+    int numCalls = 1000000;
+    double elapsed = 0.0;
+    Timer timer;
+
+    for (int i = 0; i < numCalls; ++i) {
+      mprot.writeMessageBegin("getTemperature", T_CALL, i);
+      mprot.writeStructBegin("args");
+      mprot.writeFieldStop();
+      mprot.writeStructEnd();
+      mprot.writeMessageEnd();
+      processor.process(prot, prot, nullptr);
+      buf2->resetBuffer();
+    }
+    elapsed = timer.frame();
+    cout << "  Call: " << numCalls / (1000 * elapsed) << " kHz" << '\n';
+  }
+
   return 0;
 }
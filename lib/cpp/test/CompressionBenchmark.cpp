@@ -0,0 +1,212 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include "thrift/protocol/TBinaryProtocol.h"
+#include "thrift/transport/TBufferTransports.h"
+#include "thrift/transport/TZlibTransport.h"
+#ifdef HAVE_ZSTD_H
+#include "thrift/transport/TZstdTransport.h"
+#endif
+#ifdef HAVE_LZ4FRAME_H
+#include "thrift/transport/TLz4Transport.h"
+#endif
+#include "gen-cpp/DebugProtoTest_types.h"
+
+#ifdef HAVE_SYS_TIME_H
+#include <sys/time.h>
+#endif
+
+using namespace apache::thrift::transport;
+using apache::thrift::protocol::TBinaryProtocolT;
+using std::shared_ptr;
+using std::string;
+
+class Timer {
+public:
+  timeval vStart;
+
+  Timer() { THRIFT_GETTIMEOFDAY(&vStart, nullptr); }
+
+  double frame() {
+    timeval vEnd;
+    THRIFT_GETTIMEOFDAY(&vEnd, nullptr);
+    double dstart = vStart.tv_sec + ((double)vStart.tv_usec / 1000000.0);
+    double dend = vEnd.tv_sec + ((double)vEnd.tv_usec / 1000000.0);
+    return dend - dstart;
+  }
+};
+
+// The same kinds of data as in ZlibTest.cpp, and serialized structs.
+
+static string compressibleData(uint32_t len) {
+  // Small runs of alternately increasing and decreasing bytes
+  std::mt19937 rng(len);
+  string str;
+  int step = 1;
+  while (str.size() < len) {
+    uint32_t run = rng() % 64 + 1;
+    auto byte = static_cast<char>(rng());
+    for (uint32_t n = 0; n < run && str.size() < len; ++n) {
+      str.push_back(byte);
+      byte = static_cast<char>(byte + step);
+    }
+    step = -step;
+  }
+  return str;
+}
+
+static string randomData(uint32_t len) {
+  std::mt19937 rng(len);
+  string str(len, '\0');
+  for (uint32_t n = 0; n < len; ++n) {
+    str[n] = static_cast<char>(rng());
+  }
+  return str;
+}
+
+static string structData(uint32_t len) {
+  std::mt19937 rng(len);
+  shared_ptr<TMemoryBuffer> buf(new TMemoryBuffer(len + 1024));
+  TBinaryProtocolT<TMemoryBuffer> prot(buf);
+  thrift::test::debug::OneOfEach ooe;
+  while (buf->available_read() < len) {
+    ooe.im_true = true;
+    ooe.a_bite = static_cast<int8_t>(rng());
+    ooe.integer16 = static_cast<int16_t>(rng() % 1000);
+    ooe.integer32 = static_cast<int32_t>(rng() % 100000);
+    ooe.integer64 = rng();
+    ooe.double_precision = rng() / 7.0;
+    ooe.some_characters = "user" + std::to_string(rng() % 5000) + "@example.com";
+    ooe.zomg_unicode = "status: active, region: " + std::to_string(rng() % 16);
+    ooe.write(&prot);
+  }
+  return buf->getBufferAsString().substr(0, len);
+}
+
+typedef std::function<shared_ptr<TTransport>(shared_ptr<TTransport>)> Factory;
+
+// Sends data in messages of msgSize bytes, flushing after each one as a
+// client or server does, then reads it back the same way.
+static void run(const string& codec,
+                const string& kind,
+                const string& data,
+                uint32_t msgSize,
+                const Factory& factory) {
+  shared_ptr<TMemoryBuffer> membuf(new TMemoryBuffer(static_cast<uint32_t>(data.size() * 2)));
+  const auto* bytes = reinterpret_cast<const uint8_t*>(data.data());
+
+  shared_ptr<TTransport> writer = factory(membuf);
+  Timer wtimer;
+  for (size_t pos = 0; pos < data.size(); pos += msgSize) {
+    writer->write(bytes + pos, msgSize);
+    writer->flush();
+  }
+  double welapsed = wtimer.frame();
+  uint32_t compressed = membuf->available_read();
+
+  shared_ptr<TTransport> reader = factory(membuf);
+  string mirror(msgSize, '\0');
+  auto* mbytes = reinterpret_cast<uint8_t*>(&mirror[0]);
+  Timer rtimer;
+  for (size_t pos = 0; pos < data.size(); pos += msgSize) {
+    reader->readAll(mbytes, msgSize);
+  }
+  double relapsed = rtimer.frame();
+  if (data.compare(data.size() - msgSize, msgSize, mirror) != 0) {
+    std::cerr << codec << " " << kind << ": data read back differs" << '\n';
+  }
+
+  double mb = data.size() / (1024.0 * 1024.0);
+  std::cout << std::left << std::setw(14) << kind << std::setw(10) << codec << std::right
+            << std::fixed << std::setprecision(3) << std::setw(8)
+            << static_cast<double>(compressed) / data.size() << " ratio" << std::setprecision(1)
+            << std::setw(9) << mb / welapsed << " MB/s write" << std::setw(9) << mb / relapsed
+            << " MB/s read" << '\n';
+}
+
+static Factory zlib(int level) {
+  return [level](shared_ptr<TTransport> trans) {
+    // The same buffer sizes as the others, so only the codecs differ
+    return shared_ptr<TTransport>(new TZlibTransport(trans, 4096, 4096, 512, 4096, level));
+  };
+}
+
+#ifdef HAVE_ZSTD_H
+static Factory zstd(int level) {
+  return [level](shared_ptr<TTransport> trans) {
+    return shared_ptr<TTransport>(new TZstdTransport(trans,
+                                                     TZstdTransport::DEFAULT_URBUF_SIZE,
+                                                     TZstdTransport::DEFAULT_CRBUF_SIZE,
+                                                     TZstdTransport::DEFAULT_UWBUF_SIZE,
+                                                     TZstdTransport::DEFAULT_CWBUF_SIZE,
+                                                     level));
+  };
+}
+#endif
+
+#ifdef HAVE_LZ4FRAME_H
+static Factory lz4(int level) {
+  return [level](shared_ptr<TTransport> trans) {
+    return shared_ptr<TTransport>(new TLz4Transport(trans,
+                                                    TLz4Transport::DEFAULT_URBUF_SIZE,
+                                                    TLz4Transport::DEFAULT_CRBUF_SIZE,
+                                                    TLz4Transport::DEFAULT_UWBUF_SIZE,
+                                                    TLz4Transport::DEFAULT_CWBUF_SIZE,
+                                                    level));
+  };
+}
+#endif
+
+int main(int argc, char** argv) {
+  uint32_t len = 16 * 1024 * 1024;
+  uint32_t msgSize = 4096;
+  if (argc > 1) {
+    msgSize = static_cast<uint32_t>(std::stoul(argv[1]));
+    len -= len % msgSize;
+  }
+
+  std::pair<string, string> kinds[] = {
+    {"compressible", compressibleData(len)},
+    {"structs", structData(len)},
+    {"random", randomData(len)},
+  };
+
+  std::cout << msgSize << " byte messages, " << len / (1024 * 1024) << " MB each" << '\n';
+  for (const auto& kind : kinds) {
+    run("zlib-6", kind.first, kind.second, msgSize, zlib(6));
+    run("zlib-1", kind.first, kind.second, msgSize, zlib(1));
+#ifdef HAVE_ZSTD_H
+    run("zstd-1", kind.first, kind.second, msgSize, zstd(1));
+    run("zstd-3", kind.first, kind.second, msgSize, zstd(3));
+#endif
+#ifdef HAVE_LZ4FRAME_H
+    run("lz4", kind.first, kind.second, msgSize, lz4(0));
+#endif
+  }
+  return 0;
+}
@@ -0,0 +1,494 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#define BOOST_TEST_MODULE CompressionTest
+#include <boost/mpl/list.hpp>
+#include <boost/test/unit_test.hpp>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#include <thrift/TApplicationException.h>
+#include <thrift/transport/TBufferTransports.h>
+#include <thrift/transport/THeaderTransport.h>
+#ifdef HAVE_ZSTD_H
+#include <thrift/transport/TZstdTransport.h>
+#endif
+#ifdef HAVE_LZ4FRAME_H
+#include <thrift/transport/TLz4Transport.h>
+#endif
+
+using apache::thrift::TException;
+using apache::thrift::transport::THeaderTransport;
+using apache::thrift::transport::TMemoryBuffer;
+using apache::thrift::transport::TTransportException;
+using std::shared_ptr;
+using std::string;
+
+BOOST_AUTO_TEST_SUITE(CompressionTest)
+
+static const uint8_t* bytes(const string& str) {
+  return reinterpret_cast<const uint8_t*>(str.data());
+}
+
+static uint8_t* bytes(string& str) {
+  return reinterpret_cast<uint8_t*>(&str[0]);
+}
+
+static string throughHeaderTransport(uint16_t transId, const string& data) {
+  shared_ptr<TMemoryBuffer> membuf(new TMemoryBuffer());
+  THeaderTransport writer(membuf);
+  writer.setTransform(transId);
+  writer.write(bytes(data), static_cast<uint32_t>(data.size()));
+  writer.flush();
+
+  THeaderTransport reader(membuf);
+  string mirror(data.size(), '\0');
+  reader.readAll(bytes(mirror), static_cast<uint32_t>(mirror.size()));
+  return mirror;
+}
+
+#if defined(HAVE_ZSTD_H) || defined(HAVE_LZ4FRAME_H)
+
+// The same kinds of data as in ZlibTest.cpp
+static string compressibleData(uint32_t len) {
+  // Small runs of alternately increasing and decreasing bytes
+  std::mt19937 rng(len);
+  string str;
+  int step = 1;
+  while (str.size() < len) {
+    uint32_t run = rng() % 64 + 1;
+    auto byte = static_cast<char>(rng());
+    for (uint32_t n = 0; n < run && str.size() < len; ++n) {
+      str.push_back(byte);
+      byte = static_cast<char>(byte + step);
+    }
+    step = -step;
+  }
+  return str;
+}
+
+static string randomData(uint32_t len) {
+  std::mt19937 rng(len);
+  string str(len, '\0');
+  for (uint32_t n = 0; n < len; ++n) {
+    str[n] = static_cast<char>(rng());
+  }
+  return str;
+}
+
+#if defined(HAVE_ZSTD_H) && defined(HAVE_LZ4FRAME_H)
+typedef boost::mpl::list<apache::thrift::transport::TZstdTransport,
+                         apache::thrift::transport::TLz4Transport> Transports;
+#elif defined(HAVE_ZSTD_H)
+typedef boost::mpl::list<apache::thrift::transport::TZstdTransport> Transports;
+#else
+typedef boost::mpl::list<apache::thrift::transport::TLz4Transport> Transports;
+#endif
+
+template <typename T>
+static shared_ptr<T> makeTransport(shared_ptr<TMemoryBuffer> membuf,
+                                   const string& dictionary = string(),
+                                   int crbuf_size = T::DEFAULT_CRBUF_SIZE) {
+  return shared_ptr<T>(new T(membuf,
+                             T::DEFAULT_URBUF_SIZE,
+                             crbuf_size,
+                             T::DEFAULT_UWBUF_SIZE,
+                             T::DEFAULT_CWBUF_SIZE,
+                             T::DEFAULT_COMP_LEVEL,
+                             dictionary));
+}
+
+template <typename T>
+static string compress(const string& data, const string& dictionary = string()) {
+  shared_ptr<TMemoryBuffer> membuf(new TMemoryBuffer());
+  shared_ptr<T> trans = makeTransport<T>(membuf, dictionary);
+  trans->write(bytes(data), static_cast<uint32_t>(data.size()));
+  trans->finish();
+  return membuf->getBufferAsString();
+}
+
+template <typename T>
+static void checkReadBack(shared_ptr<T> trans, const string& data) {
+  string mirror(data.size(), '\0');
+  uint32_t got = trans->readAll(bytes(mirror), static_cast<uint32_t>(mirror.size()));
+  BOOST_REQUIRE_EQUAL(got, data.size());
+  BOOST_CHECK(mirror == data);
+  trans->verifyChecksum();
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(test_write_then_read, T, Transports) {
+  const uint32_t len = 256 * 1024;
+  for (const string& data : {string(len, 'a'), compressibleData(len), randomData(len)}) {
+    shared_ptr<TMemoryBuffer> membuf(new TMemoryBuffer());
+    shared_ptr<T> trans = makeTransport<T>(membuf);
+    trans->write(bytes(data), len);
+    trans->finish();
+    checkReadBack(trans, data);
+  }
+  BOOST_CHECK_LT(compress<T>(compressibleData(len)).size(), len / 2);
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(test_read_write_mix, T, Transports) {
+  string data = compressibleData(200 * 1024);
+  shared_ptr<TMemoryBuffer> membuf(new TMemoryBuffer());
+  shared_ptr<T> trans = makeTransport<T>(membuf);
+
+  // Sizes from a single byte up to more than the read buffer, so reads take
+  // both the buffered and the direct path.
+  std::mt19937 rng(1);
+  for (size_t pos = 0; pos < data.size();) {
+    auto write_len = static_cast<uint32_t>((std::min)(data.size() - pos, size_t(1) << (rng() % 14)));
+    trans->write(bytes(data) + pos, write_len);
+    pos += write_len;
+    if (rng() % 8 == 0) {
+      trans->flush();
+    }
+  }
+  trans->finish();
+
+  string mirror(data.size(), '\0');
+  for (size_t pos = 0; pos < data.size();) {
+    auto read_len = static_cast<uint32_t>((std::min)(data.size() - pos, size_t(1) << (rng() % 15)));
+    uint32_t got = trans->read(bytes(mirror) + pos, read_len);
+    BOOST_REQUIRE_GT(got, 0u);
+    BOOST_REQUIRE_LE(got, read_len);
+    pos += got;
+  }
+  BOOST_CHECK(mirror == data);
+  trans->verifyChecksum();
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(test_flush_ends_block, T, Transports) {
+  // Whatever has been flushed can be read before the frame ends.
+  shared_ptr<TMemoryBuffer> membuf(new TMemoryBuffer());
+  shared_ptr<T> writer = makeTransport<T>(membuf);
+  shared_ptr<T> reader = makeTransport<T>(membuf);
+  string first = compressibleData(1000);
+  string second = randomData(20000);
+
+  writer->write(bytes(first), static_cast<uint32_t>(first.size()));
+  writer->flush();
+  string mirror(first.size(), '\0');
+  reader->readAll(bytes(mirror), static_cast<uint32_t>(mirror.size()));
+  BOOST_CHECK(mirror == first);
+
+  writer->write(bytes(second), static_cast<uint32_t>(second.size()));
+  writer->flush();
+  mirror.assign(second.size(), '\0');
+  reader->readAll(bytes(mirror), static_cast<uint32_t>(mirror.size()));
+  BOOST_CHECK(mirror == second);
+  BOOST_CHECK_THROW(reader->verifyChecksum(), TTransportException);
+
+  writer->finish();
+  reader->verifyChecksum();
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(test_separate_checksum, T, Transports) {
+  // The last byte of the frame is only read when verifying the checksum.
+  string data = compressibleData(32 * 1024);
+  string frame = compress<T>(data);
+  shared_ptr<TMemoryBuffer> membuf(new TMemoryBuffer());
+  membuf->write(bytes(frame), static_cast<uint32_t>(frame.size()));
+  checkReadBack(makeTransport<T>(membuf, string(), static_cast<int>(frame.size() - 1)), data);
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(test_invalid_checksum, T, Transports) {
+  string data = compressibleData(32 * 1024);
+  string frame = compress<T>(data);
+  frame[frame.size() - 1]++;
+  shared_ptr<TMemoryBuffer> membuf(new TMemoryBuffer());
+  membuf->write(bytes(frame), static_cast<uint32_t>(frame.size()));
+  shared_ptr<T> trans = makeTransport<T>(membuf);
+
+  string mirror(data.size(), '\0');
+  try {
+    trans->readAll(bytes(mirror), static_cast<uint32_t>(mirror.size()));
+    trans->verifyChecksum();
+    BOOST_ERROR("verifyChecksum() did not report an error");
+  } catch (TTransportException& ex) {
+    BOOST_CHECK_EQUAL(ex.getType(), TTransportException::INTERNAL_ERROR);
+  }
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(test_incomplete_checksum, T, Transports) {
+  string data = compressibleData(32 * 1024);
+  string frame = compress<T>(data);
+  frame.erase(frame.size() - 1);
+  shared_ptr<TMemoryBuffer> membuf(new TMemoryBuffer());
+  membuf->write(bytes(frame), static_cast<uint32_t>(frame.size()));
+  shared_ptr<T> trans = makeTransport<T>(membuf);
+
+  string mirror(data.size(), '\0');
+  trans->readAll(bytes(mirror), static_cast<uint32_t>(mirror.size()));
+  BOOST_CHECK(mirror == data);
+  try {
+    trans->verifyChecksum();
+    BOOST_ERROR("verifyChecksum() did not report an error");
+  } catch (TTransportException& ex) {
+    BOOST_CHECK_EQUAL(ex.getType(), TTransportException::CORRUPTED_DATA);
+  }
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(test_write_after_finish, T, Transports) {
+  shared_ptr<TMemoryBuffer> membuf(new TMemoryBuffer());
+  shared_ptr<T> trans = makeTransport<T>(membuf);
+  trans->write(bytes("abc"), 3);
+  trans->finish();
+
+  try {
+    trans->write(bytes("a"), 1);
+    BOOST_ERROR("write() after finish() did not raise an exception");
+  } catch (TTransportException& ex) {
+    BOOST_CHECK_EQUAL(ex.getType(), TTransportException::BAD_ARGS);
+  }
+  BOOST_CHECK_THROW(trans->flush(), TTransportException);
+  BOOST_CHECK_THROW(trans->finish(), TTransportException);
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(test_no_write, T, Transports) {
+  shared_ptr<TMemoryBuffer> membuf(new TMemoryBuffer());
+  {
+    shared_ptr<T> trans = makeTransport<T>(membuf);
+    BOOST_CHECK_EQUAL(membuf.get(), trans->getUnderlyingTransport().get());
+  }
+  BOOST_CHECK_EQUAL(membuf->available_read(), 0u);
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(test_dictionary, T, Transports) {
+  // A dictionary holding what messages have in common makes small ones
+  // much smaller.
+  string dictionary;
+  for (int i = 0; i < 100; ++i) {
+    dictionary += "{\"user\":\"user" + std::to_string(i) + "\",\"status\":\"active\",\"region\":\"eu\"}";
+  }
+  string message = "{\"user\":\"user42\",\"status\":\"active\",\"region\":\"us\"}";
+
+  string frame = compress<T>(message, dictionary);
+  BOOST_CHECK_LT(frame.size(), compress<T>(message).size());
+
+  shared_ptr<TMemoryBuffer> membuf(new TMemoryBuffer());
+  membuf->write(bytes(frame), static_cast<uint32_t>(frame.size()));
+  checkReadBack(makeTransport<T>(membuf, dictionary), message);
+}
+
+static void checkHeaderTransform(uint16_t transId) {
+  // Compressible data grows back to more than the frame it came in, and
+  // random data grows beyond what was written.
+  for (const string& data : {compressibleData(100000), randomData(100000), string("x")}) {
+    BOOST_CHECK(throughHeaderTransport(transId, data) == data);
+  }
+
+  // Frames say how big they are once decompressed, readers only believe
+  // them up to their frame size limit
+  shared_ptr<TMemoryBuffer> membuf(new TMemoryBuffer());
+  THeaderTransport writer(membuf);
+  writer.setTransform(transId);
+  string big(1000000, 'a');
+  for (int i = 0; i < 3; ++i) {
+    writer.write(bytes(big), static_cast<uint32_t>(big.size()));
+    writer.flush();
+  }
+  BOOST_CHECK_LT(membuf->available_read(), 100000u);
+
+  THeaderTransport limited(membuf);
+  limited.setMaxFrameSize(100000);
+  string mirror(big.size(), '\0');
+  BOOST_CHECK_THROW(limited.readAll(bytes(mirror), static_cast<uint32_t>(mirror.size())),
+                    TTransportException);
+
+  // and let go of the buffers a large frame grew above the threshold
+  THeaderTransport reclaiming(membuf);
+  reclaiming.setBufReclaimThresh(4096);
+  for (int i = 0; i < 2; ++i) {
+    reclaiming.readAll(bytes(mirror), static_cast<uint32_t>(mirror.size()));
+    BOOST_CHECK(mirror == big);
+    reclaiming.readEnd();
+  }
+}
+
+static void checkIncompressibleFrame(uint16_t transId) {
+  // Random data that nearly fills the write buffer comes out of the transform
+  // larger than the buffer, which must then grow without losing it.
+  uint32_t len = THeaderTransport::DEFAULT_BUFFER_SIZE - 8;
+  shared_ptr<TMemoryBuffer> membuf(new TMemoryBuffer());
+  THeaderTransport writer(membuf);
+  writer.setTransform(transId);
+  for (uint32_t n = len; n < len + 3; ++n) {
+    string data = randomData(n);
+    writer.write(bytes(data), n);
+    writer.flush();
+  }
+
+  THeaderTransport reader(membuf);
+  for (uint32_t n = len; n < len + 3; ++n) {
+    string mirror(n, '\0');
+    reader.readAll(bytes(mirror), n);
+    BOOST_CHECK(mirror == randomData(n));
+    reader.readEnd();
+  }
+}
+
+BOOST_AUTO_TEST_CASE(test_header_incompressible_frame) {
+#ifdef HAVE_ZSTD_H
+  checkIncompressibleFrame(THeaderTransport::ZSTD_TRANSFORM);
+#endif
+#ifdef HAVE_LZ4FRAME_H
+  checkIncompressibleFrame(THeaderTransport::LZ4_TRANSFORM);
+#endif
+}
+
+#endif // HAVE_ZSTD_H || HAVE_LZ4FRAME_H
+
+BOOST_AUTO_TEST_CASE(test_header_zlib_transform) {
+  // A small frame that compresses well grows back beyond where it was read.
+  string data(900, 'a');
+  BOOST_CHECK(throughHeaderTransport(THeaderTransport::ZLIB_TRANSFORM, data) == data);
+}
+
+BOOST_AUTO_TEST_CASE(test_header_zstd_transform) {
+#ifdef HAVE_ZSTD_H
+  checkHeaderTransform(THeaderTransport::ZSTD_TRANSFORM);
+#else
+  BOOST_CHECK_THROW(throughHeaderTransport(THeaderTransport::ZSTD_TRANSFORM, "x"), TException);
+#endif
+}
+
+BOOST_AUTO_TEST_CASE(test_header_lz4_transform) {
+#ifdef HAVE_LZ4FRAME_H
+  checkHeaderTransform(THeaderTransport::LZ4_TRANSFORM);
+#else
+  BOOST_CHECK_THROW(throughHeaderTransport(THeaderTransport::LZ4_TRANSFORM, "x"), TException);
+#endif
+}
+
+#ifdef HAVE_ZSTD_H
+using apache::thrift::TApplicationException;
+using apache::thrift::transport::TZstdDictionary;
+
+// Small messages that have a lot in common, like requests to one service
+static string similarMessage(std::mt19937& rng) {
+  return "{\"user\":\"user" + std::to_string(rng() % 100000) + "@example.com\",\"status\":\""
+         + (rng() % 2 ? "active" : "suspended") + "\",\"region\":\"region-"
+         + std::to_string(rng() % 16) + "\",\"score\":" + std::to_string(rng() % 1000)
+         + ",\"tags\":[\"alpha\",\"beta\",\"gamma\"]}";
+}
+
+static shared_ptr<TZstdDictionary> trainDictionary(uint32_t seed) {
+  std::mt19937 rng(seed);
+  std::vector<string> samples;
+  for (int i = 0; i < 2000; ++i) {
+    samples.push_back(similarMessage(rng));
+  }
+  return std::make_shared<TZstdDictionary>(TZstdDictionary::train(samples, 4096));
+}
+
+static void writeFrame(THeaderTransport& writer, const string& data) {
+  writer.write(bytes(data), static_cast<uint32_t>(data.size()));
+  writer.flush();
+}
+
+static string readFrame(THeaderTransport& reader, uint32_t len) {
+  string mirror(len, '\0');
+  reader.readAll(bytes(mirror), len);
+  return mirror;
+}
+
+BOOST_AUTO_TEST_CASE(test_header_zstd_dictionary) {
+  shared_ptr<TZstdDictionary> dict = trainDictionary(1);
+  std::mt19937 rng(2);
+  string message = similarMessage(rng);
+
+  shared_ptr<TMemoryBuffer> plain(new TMemoryBuffer());
+  THeaderTransport plainWriter(plain);
+  plainWriter.setTransform(THeaderTransport::ZSTD_TRANSFORM);
+  writeFrame(plainWriter, message);
+
+  shared_ptr<TMemoryBuffer> membuf(new TMemoryBuffer());
+  THeaderTransport writer(membuf);
+  writer.setTransform(THeaderTransport::ZSTD_TRANSFORM);
+  writer.setZstdDictionary(dict);
+  writeFrame(writer, message);
+  BOOST_CHECK_LT(membuf->available_read(), plain->available_read());
+
+  THeaderTransport reader(membuf);
+  reader.addZstdDictionary(dict);
+  BOOST_CHECK(readFrame(reader, static_cast<uint32_t>(message.size())) == message);
+  BOOST_CHECK_EQUAL(reader.getHeaders().at(THeaderTransport::ZSTD_DICT_HEADER),
+                    std::to_string(dict->getId()));
+}
+
+BOOST_AUTO_TEST_CASE(test_header_zstd_dictionary_versions) {
+  // Readers know both versions while writers move from one to the other,
+  // and contexts are reused from frame to frame.
+  shared_ptr<TZstdDictionary> v1 = trainDictionary(1);
+  shared_ptr<TZstdDictionary> v2 = trainDictionary(3);
+  BOOST_REQUIRE_NE(v1->getId(), v2->getId());
+
+  shared_ptr<TMemoryBuffer> membuf(new TMemoryBuffer());
+  THeaderTransport writer(membuf);
+  writer.setTransform(THeaderTransport::ZSTD_TRANSFORM);
+  std::vector<string> messages;
+  std::mt19937 rng(4);
+  for (int i = 0; i < 30; ++i) {
+    writer.setZstdDictionary(i < 10 ? v1 : i < 20 ? v2 : nullptr);
+    messages.push_back(similarMessage(rng));
+    writeFrame(writer, messages.back());
+  }
+
+  THeaderTransport reader(membuf);
+  reader.addZstdDictionary(v1);
+  reader.addZstdDictionary(v2);
+  for (const string& message : messages) {
+    BOOST_CHECK(readFrame(reader, static_cast<uint32_t>(message.size())) == message);
+  }
+  BOOST_CHECK(reader.getHeaders().empty());
+}
+
+BOOST_AUTO_TEST_CASE(test_header_zstd_unknown_dictionary) {
+  shared_ptr<TMemoryBuffer> membuf(new TMemoryBuffer());
+  THeaderTransport writer(membuf);
+  writer.setTransform(THeaderTransport::ZSTD_TRANSFORM);
+  writer.setZstdDictionary(trainDictionary(1));
+  writeFrame(writer, "hello");
+
+  THeaderTransport reader(membuf);
+  reader.addZstdDictionary(trainDictionary(3));
+  BOOST_CHECK_THROW(readFrame(reader, 5), TApplicationException);
+}
+
+BOOST_AUTO_TEST_CASE(test_raw_dictionary_needs_id) {
+  string content = "{\"user\":\"\",\"status\":\"active\",\"region\":\"region-\"}";
+  BOOST_CHECK_THROW(TZstdDictionary dict(content), TTransportException);
+
+  shared_ptr<TZstdDictionary> dict(new TZstdDictionary(content, 42));
+  BOOST_CHECK_EQUAL(dict->getId(), 42u);
+
+  shared_ptr<TMemoryBuffer> membuf(new TMemoryBuffer());
+  THeaderTransport writer(membuf);
+  writer.setTransform(THeaderTransport::ZSTD_TRANSFORM);
+  writer.setZstdDictionary(dict);
+  writeFrame(writer, content);
+  THeaderTransport reader(membuf);
+  reader.addZstdDictionary(dict);
+  BOOST_CHECK(readFrame(reader, static_cast<uint32_t>(content.size())) == content);
+}
+#endif
+
+BOOST_AUTO_TEST_SUITE_END()
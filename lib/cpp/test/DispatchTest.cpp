@@ -0,0 +1,177 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <boost/test/unit_test.hpp>
+#include <functional>
+#include <memory>
+#include <string>
+#include <utility>
+#include <thrift/TApplicationException.h>
+#include <thrift/protocol/TBinaryProtocol.h>
+#include <thrift/transport/TBufferTransports.h>
+#include "gen-cpp/DispatchChild.h"
+#include "gen-cpp/DispatchParent.h"
+
+BOOST_AUTO_TEST_SUITE(DispatchTest)
+
+using apache::thrift::TApplicationException;
+using apache::thrift::TProcessor;
+using apache::thrift::protocol::TBinaryProtocol;
+using apache::thrift::protocol::TMessageType;
+using apache::thrift::protocol::TProtocol;
+using apache::thrift::protocol::TType;
+using apache::thrift::transport::TMemoryBuffer;
+using std::shared_ptr;
+using std::string;
+using namespace dispatchtest;
+
+namespace {
+
+typedef std::pair<const char*, int32_t> Answer;
+
+// What Handler answers for each name
+const Answer parentAnswers[] = {
+  {"a", 1}, {"b", 2}, {"ab", 3}, {"ba", 4}, {"abc", 5}, {"abd", 6}, {"axc", 7},
+  {"xbc", 8}, {"ping", 9}, {"longerThanInlineBuffer", 10},
+};
+const Answer childAnswers[] = {{"c", 11}, {"abe", 12}, {"pong", 13}};
+
+// Names no service has, of every length the switch knows and more.  Some
+// match a known name in the character the switch looks at.
+const char* const unknownNames[] = {
+  "", "z", "aa", "abx", "xbd", "pinx", "abcde", "longerThanInlineBuffeR",
+};
+
+class Handler : public DispatchChildIf {
+public:
+  int32_t a() override {
+    if (duringA) {
+      duringA();
+    }
+    return 1;
+  }
+  int32_t b() override { return 2; }
+  int32_t ab() override { return 3; }
+  int32_t ba() override { return 4; }
+  int32_t abc() override { return 5; }
+  int32_t abd() override { return 6; }
+  int32_t axc() override { return 7; }
+  int32_t xbc() override { return 8; }
+  int32_t ping() override { return 9; }
+  int32_t longerThanInlineBuffer() override { return 10; }
+  int32_t c() override { return 11; }
+  int32_t abe() override { return 12; }
+  int32_t pong() override { return 13; }
+
+  std::function<void()> duringA;
+};
+
+// Returns what processor answers to a call of name, or throws the
+// TApplicationException it answers with.
+int32_t call(TProcessor& processor, const string& name) {
+  shared_ptr<TMemoryBuffer> request(new TMemoryBuffer());
+  shared_ptr<TMemoryBuffer> reply(new TMemoryBuffer());
+  shared_ptr<TProtocol> iprot(new TBinaryProtocol(request));
+  shared_ptr<TProtocol> oprot(new TBinaryProtocol(reply));
+
+  iprot->writeMessageBegin(name, apache::thrift::protocol::T_CALL, 7);
+  iprot->writeStructBegin("args");
+  iprot->writeFieldStop();
+  iprot->writeStructEnd();
+  iprot->writeMessageEnd();
+  BOOST_REQUIRE(processor.process(iprot, oprot, nullptr));
+  BOOST_CHECK_EQUAL(request->available_read(), 0u);
+
+  string fname;
+  TMessageType type;
+  int32_t seqid;
+  oprot->readMessageBegin(fname, type, seqid);
+  BOOST_CHECK_EQUAL(fname, name);
+  BOOST_CHECK_EQUAL(seqid, 7);
+  if (type == apache::thrift::protocol::T_EXCEPTION) {
+    TApplicationException x;
+    x.read(oprot.get());
+    throw x;
+  }
+  BOOST_REQUIRE(type == apache::thrift::protocol::T_REPLY);
+
+  string sname;
+  TType ftype;
+  int16_t fid;
+  int32_t success;
+  oprot->readStructBegin(sname);
+  oprot->readFieldBegin(sname, ftype, fid);
+  BOOST_REQUIRE_EQUAL(fid, 0);
+  BOOST_REQUIRE(ftype == apache::thrift::protocol::T_I32);
+  oprot->readI32(success);
+  return success;
+}
+
+bool unknownMethod(const TApplicationException& x) {
+  return x.getType() == TApplicationException::UNKNOWN_METHOD;
+}
+
+}
+
+BOOST_AUTO_TEST_CASE(dispatch_parent) {
+  DispatchParentProcessor processor(std::make_shared<Handler>());
+  for (const Answer& answer : parentAnswers) {
+    BOOST_CHECK_MESSAGE(call(processor, answer.first) == answer.second, answer.first);
+  }
+  for (const char* name : unknownNames) {
+    BOOST_TEST_CHECKPOINT(name);
+    BOOST_CHECK_EXCEPTION(call(processor, name), TApplicationException, unknownMethod);
+  }
+  // The child's names are not the parent's
+  for (const Answer& answer : childAnswers) {
+    BOOST_TEST_CHECKPOINT(answer.first);
+    BOOST_CHECK_EXCEPTION(call(processor, answer.first), TApplicationException, unknownMethod);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(dispatch_child) {
+  // Names the child's switch does not know go on to the parent's
+  DispatchChildProcessor processor(std::make_shared<Handler>());
+  for (const Answer& answer : childAnswers) {
+    BOOST_CHECK_MESSAGE(call(processor, answer.first) == answer.second, answer.first);
+  }
+  for (const Answer& answer : parentAnswers) {
+    BOOST_CHECK_MESSAGE(call(processor, answer.first) == answer.second, answer.first);
+  }
+  for (const char* name : unknownNames) {
+    BOOST_TEST_CHECKPOINT(name);
+    BOOST_CHECK_EXCEPTION(call(processor, name), TApplicationException, unknownMethod);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(dispatch_nested) {
+  // A call made while another is dispatched on the same thread has a name
+  // of its own
+  shared_ptr<Handler> handler(new Handler());
+  DispatchParentProcessor processor(handler);
+  int32_t nested = 0;
+  handler->duringA = [&]() { nested = call(processor, "longerThanInlineBuffer"); };
+
+  BOOST_CHECK_EQUAL(call(processor, "longerThanInlineBuffer"), 10);
+  BOOST_CHECK_EQUAL(call(processor, "a"), 1);
+  BOOST_CHECK_EQUAL(nested, 10);
+  BOOST_CHECK_EQUAL(call(processor, "longerThanInlineBuffer"), 10);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,43 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+namespace cpp dispatchtest
+
+// Names for the switch in generated dispatchCall(), used by DispatchTest.cpp.
+// Several have the same length, and abc, abd and axc also share the
+// character the switch looks at for names of three characters.
+service DispatchParent {
+  i32 a(),
+  i32 b(),
+  i32 ab(),
+  i32 ba(),
+  i32 abc(),
+  i32 abd(),
+  i32 axc(),
+  i32 xbc(),
+  i32 ping(),
+  i32 longerThanInlineBuffer()
+}
+
+// Has names of the same lengths as the parent's, for the parent to find.
+service DispatchChild extends DispatchParent {
+  i32 c(),
+  i32 abe(),
+  i32 pong()
+}
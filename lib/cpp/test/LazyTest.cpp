@@ -0,0 +1,206 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <boost/test/unit_test.hpp>
+#include <memory>
+#include <string>
+#include <thrift/protocol/TBinaryProtocol.h>
+#include <thrift/protocol/TCompactProtocol.h>
+#include <thrift/transport/TBufferTransports.h>
+#include <thrift/transport/TChainBuffer.h>
+#include "gen-cpp/LazyTest_types.h"
+
+BOOST_AUTO_TEST_SUITE(LazyTest)
+
+using apache::thrift::protocol::TBinaryProtocol;
+using apache::thrift::protocol::TBinaryProtocolT;
+using apache::thrift::protocol::TCompactProtocol;
+using apache::thrift::protocol::TCompactProtocolT;
+using apache::thrift::protocol::TProtocol;
+using apache::thrift::transport::TChainBuffer;
+using apache::thrift::transport::TFramedTransport;
+using apache::thrift::transport::TMemoryBuffer;
+using std::shared_ptr;
+using std::string;
+using namespace lazytest;
+
+namespace {
+
+Request makeRequest(int32_t id) {
+  Payload payload;
+  payload.id = id;
+  payload.name = string(100, 'p');
+  for (int64_t i = 0; i < 50; ++i) {
+    payload.values.push_back(i * id);
+  }
+
+  Request request;
+  request.route = id + 1;
+  request.payload = payload;
+  payload.name = "extra";
+  request.__set_extra(payload);
+  request.trailer = "trailer";
+  return request;
+}
+
+string serialize(const Request& request, shared_ptr<TProtocol> (*makeProtocol)(shared_ptr<TMemoryBuffer>)) {
+  shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer());
+  request.write(makeProtocol(buffer).get());
+  return buffer->getBufferAsString();
+}
+
+shared_ptr<TProtocol> binary(shared_ptr<TMemoryBuffer> buffer) {
+  return shared_ptr<TProtocol>(new TBinaryProtocol(buffer));
+}
+
+shared_ptr<TProtocol> compact(shared_ptr<TMemoryBuffer> buffer) {
+  return shared_ptr<TProtocol>(new TCompactProtocol(buffer));
+}
+
+void testProtocol(shared_ptr<TProtocol> (*makeProtocol)(shared_ptr<TMemoryBuffer>)) {
+  const Request expected = makeRequest(7);
+  const string bytes = serialize(expected, makeProtocol);
+
+  shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer());
+  buffer->write(reinterpret_cast<const uint8_t*>(bytes.data()), static_cast<uint32_t>(bytes.size()));
+  Request request;
+  request.read(makeProtocol(buffer).get());
+
+  // Only the plain fields have been decoded
+  BOOST_CHECK(request.payload.isLazy());
+  BOOST_CHECK(request.extra.isLazy());
+  BOOST_CHECK_EQUAL(expected.route, request.route);
+  BOOST_CHECK_EQUAL(expected.trailer, request.trailer);
+  BOOST_CHECK(request.__isset.extra);
+
+  // Untouched fields are written out as they were read
+  BOOST_CHECK_EQUAL(bytes, serialize(request, makeProtocol));
+  BOOST_CHECK(request.payload.isLazy());
+
+  // The buffer they came from may be reused
+  buffer->resetBuffer();
+  buffer->write(reinterpret_cast<const uint8_t*>(string(bytes.size(), 'x').data()),
+                static_cast<uint32_t>(bytes.size()));
+
+  // Reading decodes, and still writes the original bytes
+  const Request& constRequest = request;
+  BOOST_CHECK_EQUAL(7, constRequest.payload->id);
+  BOOST_CHECK(!request.payload.isLazy());
+  BOOST_CHECK(expected.payload.get() == constRequest.payload.get());
+  BOOST_CHECK_EQUAL(bytes, serialize(request, makeProtocol));
+
+  // Modifying re-encodes
+  request.payload->id = 8;
+  Request reread;
+  const string modified = serialize(request, makeProtocol);
+  shared_ptr<TMemoryBuffer> modifiedBuffer(new TMemoryBuffer());
+  modifiedBuffer->write(reinterpret_cast<const uint8_t*>(modified.data()),
+                        static_cast<uint32_t>(modified.size()));
+  reread.read(makeProtocol(modifiedBuffer).get());
+  BOOST_CHECK_EQUAL(8, reread.payload->id);
+  BOOST_CHECK(expected.extra == reread.extra);
+}
+
+template <typename Protocol_>
+void testChain(uint32_t segmentSize) {
+  shared_ptr<TChainBuffer> buffer(new TChainBuffer(segmentSize));
+  Protocol_ prot(buffer);
+  for (int32_t i = 0; i < 3; ++i) {
+    makeRequest(i).write(&prot);
+  }
+
+  Request requests[3];
+  for (auto& request : requests) {
+    request.read(&prot);
+  }
+
+  // Fields that fit in a segment stay lazy, others are read straight away
+  BOOST_CHECK_EQUAL(segmentSize > 1000, requests[0].payload.isLazy());
+
+  // Either way they stay valid while the chain is reused
+  prot.getTransport()->readEnd();
+  makeRequest(9).write(&prot);
+  for (int32_t i = 0; i < 3; ++i) {
+    BOOST_CHECK(makeRequest(i) == requests[i]);
+  }
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_CASE(test_binary) {
+  testProtocol(binary);
+}
+
+BOOST_AUTO_TEST_CASE(test_compact) {
+  testProtocol(compact);
+}
+
+BOOST_AUTO_TEST_CASE(test_other_protocol) {
+  // Lazy fields read from one protocol are re-encoded for another
+  const Request expected = makeRequest(3);
+  const string bytes = serialize(expected, binary);
+  shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer());
+  buffer->write(reinterpret_cast<const uint8_t*>(bytes.data()), static_cast<uint32_t>(bytes.size()));
+  Request request;
+  request.read(binary(buffer).get());
+  BOOST_CHECK(request.payload.isLazy());
+  BOOST_CHECK_EQUAL(serialize(expected, compact), serialize(request, compact));
+}
+
+BOOST_AUTO_TEST_CASE(test_unshared_buffer) {
+  // Without a buffer to share, lazy fields are read straight away
+  const Request expected = makeRequest(5);
+  string bytes = serialize(expected, compact);
+  shared_ptr<TMemoryBuffer> buffer(
+      new TMemoryBuffer(reinterpret_cast<uint8_t*>(&bytes[0]), static_cast<uint32_t>(bytes.size())));
+  Request request;
+  request.read(compact(buffer).get());
+  BOOST_CHECK(!request.payload.isLazy());
+  BOOST_CHECK(expected == request);
+}
+
+BOOST_AUTO_TEST_CASE(test_chain) {
+  testChain<TBinaryProtocolT<TChainBuffer> >(16);
+  testChain<TBinaryProtocolT<TChainBuffer> >(4096);
+  testChain<TCompactProtocolT<TChainBuffer> >(16);
+  testChain<TCompactProtocolT<TChainBuffer> >(4096);
+}
+
+BOOST_AUTO_TEST_CASE(test_framed) {
+  // Lazy fields keep their frame while the next one is read
+  shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer());
+  shared_ptr<TFramedTransport> framed(new TFramedTransport(buffer));
+  TBinaryProtocol prot(framed);
+  for (int32_t i = 0; i < 3; ++i) {
+    makeRequest(i).write(&prot);
+    framed->flush();
+  }
+
+  Request requests[3];
+  for (auto& request : requests) {
+    request.read(&prot);
+    prot.getTransport()->readEnd();
+  }
+  for (int32_t i = 0; i < 3; ++i) {
+    BOOST_CHECK(requests[i].payload.isLazy());
+    BOOST_CHECK(makeRequest(i) == requests[i]);
+  }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,37 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+namespace cpp lazytest
+
+struct Payload
+{
+  1: i32 id,
+  2: string name,
+  3: list<i64> values,
+}
+
+// A request that is mostly routed on its header, so its payload is only
+// decoded when a handler asks for it.
+struct Request
+{
+  1: i32 route,
+  2: Payload payload (cpp.lazy),
+  3: optional Payload extra (cpp.lazy),
+  4: string trailer,
+}
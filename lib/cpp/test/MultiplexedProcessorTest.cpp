@@ -0,0 +1,173 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <boost/test/unit_test.hpp>
+#include <memory>
+#include <string>
+#include <thrift/processor/TMultiplexedProcessor.h>
+#include <thrift/protocol/TBinaryProtocol.h>
+#include <thrift/protocol/TMultiplexedProtocol.h>
+#include <thrift/transport/TBufferTransports.h>
+
+BOOST_AUTO_TEST_SUITE(MultiplexedProcessorTest)
+
+using apache::thrift::TException;
+using apache::thrift::TMultiplexedProcessor;
+using apache::thrift::TProcessor;
+using apache::thrift::protocol::TBinaryProtocol;
+using apache::thrift::protocol::TMessageType;
+using apache::thrift::protocol::TMultiplexedProtocol;
+using apache::thrift::protocol::TProtocol;
+using apache::thrift::transport::TMemoryBuffer;
+using std::shared_ptr;
+using std::string;
+
+namespace {
+
+class RecordingProcessor : public TProcessor {
+public:
+  RecordingProcessor() : type(apache::thrift::protocol::T_EXCEPTION), seqid(0), protocol(nullptr) {}
+
+  bool process(shared_ptr<TProtocol> in, shared_ptr<TProtocol>, void*) override {
+    in->readMessageBegin(name, type, seqid);
+    in->skip(apache::thrift::protocol::T_STRUCT);
+    in->readMessageEnd();
+    protocol = in.get();
+    return true;
+  }
+
+  string name;
+  TMessageType type;
+  int32_t seqid;
+  TProtocol* protocol;
+};
+
+void writeCall(TProtocol& prot, const string& name, int32_t seqid) {
+  prot.writeMessageBegin(name, apache::thrift::protocol::T_CALL, seqid);
+  prot.writeStructBegin("args");
+  prot.writeFieldStop();
+  prot.writeStructEnd();
+  prot.writeMessageEnd();
+}
+
+struct Fixture {
+  Fixture()
+    : buffer(new TMemoryBuffer()),
+      prot(new TBinaryProtocol(buffer)),
+      replies(new TBinaryProtocol(std::make_shared<TMemoryBuffer>())),
+      calculator(new RecordingProcessor()),
+      weather(new RecordingProcessor()),
+      plain(new RecordingProcessor()) {
+    processor.registerProcessor("Calculator", calculator);
+    processor.registerProcessor("WeatherReport", weather);
+  }
+
+  bool process() { return processor.process(prot, replies, nullptr); }
+
+  shared_ptr<TMemoryBuffer> buffer;
+  shared_ptr<TProtocol> prot;
+  shared_ptr<TProtocol> replies;
+  shared_ptr<RecordingProcessor> calculator;
+  shared_ptr<RecordingProcessor> weather;
+  shared_ptr<RecordingProcessor> plain;
+  TMultiplexedProcessor processor;
+};
+
+}
+
+BOOST_FIXTURE_TEST_CASE(test_dispatch, Fixture) {
+  TMultiplexedProtocol calculatorProt(prot, "Calculator");
+  TMultiplexedProtocol weatherProt(prot, "WeatherReport");
+
+  writeCall(calculatorProt, "add", 1);
+  writeCall(weatherProt, "getTemperature", 2);
+  writeCall(calculatorProt, "subtract", 3);
+
+  BOOST_CHECK(process());
+  BOOST_CHECK_EQUAL(calculator->name, "add");
+  BOOST_CHECK_EQUAL(calculator->seqid, 1);
+  BOOST_CHECK(calculator->type == apache::thrift::protocol::T_CALL);
+  TProtocol* stored = calculator->protocol;
+
+  BOOST_CHECK(process());
+  BOOST_CHECK_EQUAL(weather->name, "getTemperature");
+  BOOST_CHECK_EQUAL(weather->seqid, 2);
+
+  BOOST_CHECK(process());
+  BOOST_CHECK_EQUAL(calculator->name, "subtract");
+  BOOST_CHECK_EQUAL(calculator->seqid, 3);
+
+  // The decorator is used again for every call on this thread
+  BOOST_CHECK(weather->protocol == stored);
+  BOOST_CHECK(calculator->protocol == stored);
+  BOOST_CHECK_EQUAL(buffer->available_read(), 0u);
+}
+
+BOOST_FIXTURE_TEST_CASE(test_tokens, Fixture) {
+  // Empty tokens are left out
+  writeCall(*prot, "::Calculator::multiply:", 1);
+  BOOST_CHECK(process());
+  BOOST_CHECK_EQUAL(calculator->name, "multiply");
+
+  writeCall(*prot, "Calculator:divide:now", 2);
+  BOOST_CHECK_THROW(process(), TException);
+
+  writeCall(*prot, "Abacus:add", 3);
+  BOOST_CHECK_THROW(process(), TException);
+  BOOST_CHECK_EQUAL(calculator->seqid, 1);
+}
+
+BOOST_FIXTURE_TEST_CASE(test_default, Fixture) {
+  writeCall(*prot, "ping", 1);
+  BOOST_CHECK_THROW(process(), TException);
+
+  processor.registerDefault(plain);
+  writeCall(*prot, "ping", 2);
+  BOOST_CHECK(process());
+  BOOST_CHECK_EQUAL(plain->name, "ping");
+  BOOST_CHECK_EQUAL(plain->seqid, 2);
+}
+
+BOOST_FIXTURE_TEST_CASE(test_reregister, Fixture) {
+  processor.registerProcessor("Calculator", plain);
+  writeCall(*prot, "Calculator:add", 1);
+  BOOST_CHECK(process());
+  BOOST_CHECK_EQUAL(plain->name, "add");
+  BOOST_CHECK(calculator->name.empty());
+}
+
+BOOST_FIXTURE_TEST_CASE(test_copy, Fixture) {
+  shared_ptr<TMultiplexedProcessor> copy(new TMultiplexedProcessor(processor));
+  TMultiplexedProcessor assigned;
+  assigned = *copy;
+  copy.reset();
+
+  // The copies look services up by names of their own
+  processor.registerProcessor("Calculator", plain);
+  writeCall(*prot, "Calculator:add", 1);
+  BOOST_CHECK(assigned.process(prot, replies, nullptr));
+  BOOST_CHECK_EQUAL(calculator->name, "add");
+  BOOST_CHECK(plain->name.empty());
+
+  writeCall(*prot, "WeatherReport:getTemperature", 2);
+  BOOST_CHECK(assigned.process(prot, replies, nullptr));
+  BOOST_CHECK_EQUAL(weather->name, "getTemperature");
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,156 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <boost/test/unit_test.hpp>
+#include <memory>
+#include <string>
+#include <thrift/protocol/TBinaryProtocol.h>
+#include <thrift/protocol/TCompactProtocol.h>
+#include <thrift/protocol/TFieldMask.h>
+#include <thrift/transport/TBufferTransports.h>
+#include "gen-cpp/PartialTest_types.h"
+
+BOOST_AUTO_TEST_SUITE(PartialTest)
+
+using apache::thrift::protocol::TBinaryProtocol;
+using apache::thrift::protocol::TCompactProtocol;
+using apache::thrift::protocol::TFieldMask;
+using apache::thrift::protocol::TProtocol;
+using apache::thrift::protocol::TProtocolException;
+using apache::thrift::transport::TMemoryBuffer;
+using std::shared_ptr;
+using std::string;
+using namespace partialtest;
+
+namespace {
+
+Wide makeWide() {
+  Wide wide;
+  wide.id = 42;
+  wide.name = "name";
+  wide.field3 = 3.5;
+  wide.field4.push_back(4);
+  wide.field5 = 5;
+  wide.field7 = "seven";
+  wide.field49 = {49, 490};
+  wide.inner.a = 1;
+  wide.inner.b = "inner";
+  wide.inner.c = {1, 2, 3};
+  return wide;
+}
+
+template <class Protocol_>
+Wide readPartial(const Wide& written, const TFieldMask& mask) {
+  shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer());
+  Protocol_ prot(buffer);
+  written.write(&prot);
+  const uint32_t size = buffer->available_read();
+
+  Wide wide;
+  BOOST_CHECK_EQUAL(wide.readPartial(&prot, mask), size);
+  BOOST_CHECK_EQUAL(buffer->available_read(), 0u);
+  return wide;
+}
+
+template <class Protocol_>
+void testProtocol() {
+  const Wide written = makeWide();
+
+  Wide wide = readPartial<Protocol_>(written, TFieldMask{1, 7});
+  BOOST_CHECK_EQUAL(wide.id, 42);
+  BOOST_CHECK_EQUAL(wide.field7, "seven");
+  BOOST_CHECK(wide.__isset.field7);
+  BOOST_CHECK(wide.name.empty());
+  BOOST_CHECK(!wide.__isset.name);
+  BOOST_CHECK_EQUAL(wide.field5, 0);
+  BOOST_CHECK(!wide.__isset.field5);
+  BOOST_CHECK(wide.field49.empty());
+  BOOST_CHECK(!wide.__isset.inner);
+
+  // The whole of a struct field
+  wide = readPartial<Protocol_>(written, TFieldMask{1, 50});
+  BOOST_CHECK(wide.__isset.inner);
+  BOOST_CHECK(wide.inner == written.inner);
+
+  // Only some fields of a struct field
+  TFieldMask mask{1};
+  mask.add(50, TFieldMask{2});
+  wide = readPartial<Protocol_>(written, mask);
+  BOOST_CHECK(wide.__isset.inner);
+  BOOST_CHECK_EQUAL(wide.inner.b, "inner");
+  BOOST_CHECK(wide.inner.__isset.b);
+  BOOST_CHECK_EQUAL(wide.inner.a, 0);
+  BOOST_CHECK(!wide.inner.__isset.a);
+  BOOST_CHECK(wide.inner.c.empty());
+
+  // Every field is the same as read()
+  TFieldMask all;
+  for (int16_t id = 1; id <= 50; ++id) {
+    all.add(id);
+  }
+  wide = readPartial<Protocol_>(written, all);
+  BOOST_CHECK(wide == written);
+}
+
+}
+
+BOOST_AUTO_TEST_CASE(test_binary) {
+  testProtocol<TBinaryProtocol>();
+}
+
+BOOST_AUTO_TEST_CASE(test_compact) {
+  testProtocol<TCompactProtocol>();
+}
+
+BOOST_AUTO_TEST_CASE(test_required) {
+  shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer());
+  TBinaryProtocol prot(buffer);
+  Inner inner;
+  inner.write(&prot);
+  const string bytes = buffer->getBufferAsString();
+
+  // A Wide without its required id, which only matters when it is asked for
+  Wide wide;
+  BOOST_CHECK_NO_THROW(wide.readPartial(&prot, TFieldMask{2}));
+  buffer->resetBuffer(reinterpret_cast<uint8_t*>(const_cast<char*>(bytes.data())),
+                      static_cast<uint32_t>(bytes.size()));
+  BOOST_CHECK_THROW(wide.readPartial(&prot, TFieldMask{1, 2}), TProtocolException);
+}
+
+BOOST_AUTO_TEST_CASE(test_mask) {
+  TFieldMask mask{3, 100, -1};
+  mask.add(64, TFieldMask{1});
+  BOOST_CHECK(mask.contains(3));
+  BOOST_CHECK(mask.contains(64));
+  BOOST_CHECK(mask.contains(100));
+  BOOST_CHECK(mask.contains(-1));
+  BOOST_CHECK(!mask.contains(4));
+  BOOST_CHECK(!mask.contains(65));
+  BOOST_CHECK(!mask.contains(0));
+  BOOST_CHECK(mask.nested(3) == nullptr);
+  BOOST_CHECK(mask.nested(4) == nullptr);
+  BOOST_REQUIRE(mask.nested(64) != nullptr);
+  BOOST_CHECK(mask.nested(64)->contains(1));
+  mask.add(64);
+  BOOST_CHECK(mask.nested(64) == nullptr);
+  BOOST_CHECK(!mask.empty());
+  BOOST_CHECK(TFieldMask().empty());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,82 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+namespace cpp partialtest
+
+struct Inner
+{
+  1: i32 a,
+  2: string b,
+  3: list<i32> c,
+}
+
+// A wide record of which readers usually only want a couple of fields.
+struct Wide
+{
+  1: required i64 id,
+  2: string name,
+  3: double field3,
+  4: list<i32> field4,
+  5: i32 field5,
+  6: i64 field6,
+  7: string field7,
+  8: double field8,
+  9: list<i32> field9,
+  10: i32 field10,
+  11: i64 field11,
+  12: string field12,
+  13: double field13,
+  14: list<i32> field14,
+  15: i32 field15,
+  16: i64 field16,
+  17: string field17,
+  18: double field18,
+  19: list<i32> field19,
+  20: i32 field20,
+  21: i64 field21,
+  22: string field22,
+  23: double field23,
+  24: list<i32> field24,
+  25: i32 field25,
+  26: i64 field26,
+  27: string field27,
+  28: double field28,
+  29: list<i32> field29,
+  30: i32 field30,
+  31: i64 field31,
+  32: string field32,
+  33: double field33,
+  34: list<i32> field34,
+  35: i32 field35,
+  36: i64 field36,
+  37: string field37,
+  38: double field38,
+  39: list<i32> field39,
+  40: i32 field40,
+  41: i64 field41,
+  42: string field42,
+  43: double field43,
+  44: list<i32> field44,
+  45: i32 field45,
+  46: i64 field46,
+  47: string field47,
+  48: double field48,
+  49: list<i32> field49,
+  50: Inner inner,
+}
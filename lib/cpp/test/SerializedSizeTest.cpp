@@ -0,0 +1,153 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <boost/test/unit_test.hpp>
+#include <memory>
+#include <string>
+#include <thrift/protocol/TBinaryProtocol.h>
+#include <thrift/protocol/TCompactProtocol.h>
+#include <thrift/protocol/TJSONProtocol.h>
+#include <thrift/transport/TBufferTransports.h>
+#include "gen-cpp/SerializedSizeTest_types.h"
+
+BOOST_AUTO_TEST_SUITE(SerializedSizeTest)
+
+using apache::thrift::protocol::TBinaryProtocol;
+using apache::thrift::protocol::TCompactProtocol;
+using apache::thrift::protocol::TJSONProtocol;
+using apache::thrift::protocol::TProtocol;
+using apache::thrift::transport::TFramedTransport;
+using apache::thrift::transport::TMemoryBuffer;
+using std::shared_ptr;
+using std::string;
+using namespace sizetest;
+
+namespace {
+
+Everything makeEverything(int32_t scale) {
+  Everything everything;
+  everything.flag = true;
+  everything.small = -5;
+  everything.medium = static_cast<int16_t>(-300 * scale);
+  everything.large = 70000 * scale;
+  everything.huge = (int64_t(1) << 40) * scale;
+  everything.real = 2.5;
+  everything.text = string(20 * scale, 't');
+  everything.blob = string(200 * scale, '\0');
+  everything.color = Color::BLUE;
+  everything.__set_note("note");
+  everything.point.x = -scale;
+  everything.point.y = scale;
+  for (int32_t i = 0; i < 20 * scale; ++i) {
+    everything.names.push_back(string(i % 7, 'n'));
+    everything.keys.insert(int64_t(i) << (i % 50));
+    everything.groups[std::to_string(i)].assign(i % 5, i);
+    everything.bits.push_back(i % 3 == 0);
+    everything.points[i * 100].x = i;
+    everything.weights[static_cast<int16_t>(i)] = i / 3.0;
+  }
+  everything.far = -1;
+  return everything;
+}
+
+uint32_t written(const Everything& everything, TProtocol& prot) {
+  uint32_t size = everything.write(&prot);
+  BOOST_CHECK_EQUAL(size, dynamic_cast<TMemoryBuffer&>(*prot.getTransport()).available_read());
+  return size;
+}
+
+}
+
+BOOST_AUTO_TEST_CASE(test_binary) {
+  for (int32_t scale = 0; scale < 3; ++scale) {
+    const Everything everything = makeEverything(scale);
+    shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer());
+    TBinaryProtocol prot(buffer);
+    BOOST_CHECK_EQUAL(everything.serializedSize(&prot), written(everything, prot));
+  }
+}
+
+BOOST_AUTO_TEST_CASE(test_compact) {
+  for (int32_t scale = 0; scale < 3; ++scale) {
+    const Everything everything = makeEverything(scale);
+    shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer());
+    TCompactProtocol prot(buffer);
+    const uint32_t size = everything.serializedSize(&prot);
+    const uint32_t actual = written(everything, prot);
+    // Only field headers, bool fields among them, may take less than their
+    // bound, by at most two bytes each
+    const uint32_t headers = 18 + 2 + 2 * static_cast<uint32_t>(everything.points.size());
+    BOOST_CHECK_GE(size, actual);
+    BOOST_CHECK_LE(size, actual + 2 * headers);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(test_unknown) {
+  shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer());
+  TJSONProtocol prot(buffer);
+  BOOST_CHECK(!prot.hasSerializedSizes());
+  BOOST_CHECK_EQUAL(makeEverything(1).serializedSize(&prot), 0u);
+
+  // Nothing is sized or reserved for protocols that cannot tell the sizes
+  shared_ptr<TMemoryBuffer> small(new TMemoryBuffer(16));
+  TJSONProtocol smallProt(small);
+  apache::thrift::protocol::reserveSerializedSize(&smallProt, makeEverything(50));
+  BOOST_CHECK_EQUAL(small->available_write(), 16u);
+}
+
+BOOST_AUTO_TEST_CASE(test_reserve) {
+  const Everything everything = makeEverything(50);
+
+  shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer(16));
+  TBinaryProtocol prot(buffer);
+  apache::thrift::protocol::reserveSerializedSize(&prot, everything);
+  BOOST_CHECK_GE(buffer->available_write(), everything.serializedSize(&prot));
+  uint8_t* before = nullptr;
+  uint32_t size = 0;
+  buffer->getBuffer(&before, &size);
+  written(everything, prot);
+  uint8_t* after = nullptr;
+  buffer->getBuffer(&after, &size);
+  BOOST_CHECK(before == after);
+
+  shared_ptr<TMemoryBuffer> sink(new TMemoryBuffer());
+  shared_ptr<TFramedTransport> framed(new TFramedTransport(sink, 16));
+  TBinaryProtocol framedProt(framed);
+  apache::thrift::protocol::reserveSerializedSize(&framedProt, everything);
+  everything.write(&framedProt);
+  framed->flush();
+  BOOST_CHECK_EQUAL(sink->available_read(), size + 4);
+}
+
+BOOST_AUTO_TEST_CASE(test_reserve_room) {
+  const Everything everything = makeEverything(50);
+
+  // A transport with room for the size hint is left to grow as it writes
+  shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer(1024));
+  TBinaryProtocol prot(buffer);
+  const uint32_t size = everything.serializedSize(&prot);
+  BOOST_CHECK_GT(size, 1024u);
+  apache::thrift::protocol::reserveSerializedSize(&prot, everything);
+  BOOST_CHECK_EQUAL(buffer->available_write(), 1024u);
+
+  apache::thrift::protocol::reserveSerializedSize(&prot, everything, size + 1);
+  BOOST_CHECK_GE(buffer->available_write(), size);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
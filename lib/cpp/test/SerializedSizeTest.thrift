@@ -0,0 +1,53 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+namespace cpp sizetest
+
+enum Color {
+  RED = 1,
+  BLUE = 300,
+}
+
+struct Point
+{
+  1: i32 x,
+  2: i32 y,
+}
+
+struct Everything
+{
+  1: bool flag,
+  2: byte small,
+  3: i16 medium,
+  4: i32 large,
+  5: i64 huge,
+  6: double real,
+  7: string text,
+  8: binary blob,
+  10: Color color,
+  11: optional string note,
+  12: Point point,
+  13: list<string> names,
+  14: set<i64> keys,
+  15: map<string, list<i32>> groups,
+  16: list<bool> bits,
+  17: map<i32, Point> points,
+  18: map<i16, double> weights,
+  200: i64 far,
+}
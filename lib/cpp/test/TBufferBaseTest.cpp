@@ -172,6 +172,27 @@ void init_data() {
   data_str.assign((char*)data, sizeof(data));
 }
 
+// Writes all of data in the given piece sizes through reserve()/commit(),
+// falling back to write() when the transport can't reserve enough.
+template <class Transport_>
+void reserve_commit_data(Transport_& trans, unsigned int* sizes) {
+  int offset = 0;
+  int index = 0;
+  while (offset < 1<<15) {
+    uint32_t len = sizes[index];
+    uint8_t* out = trans.reserve(&len);
+    if (out != nullptr) {
+      BOOST_CHECK_GE(len, sizes[index]);
+      memcpy(out, &data[offset], sizes[index]);
+      trans.commit(sizes[index]);
+    } else {
+      trans.write(&data[offset], sizes[index]);
+    }
+    offset += sizes[index];
+    index++;
+  }
+}
+
 
 BOOST_AUTO_TEST_SUITE( TBufferBaseTest )
 
@@ -194,6 +215,26 @@ BOOST_AUTO_TEST_CASE( test_MemoryBuffer_Write_GetBuffer ) {
   }
 }
 
+BOOST_AUTO_TEST_CASE( test_MemoryBuffer_Reserve_Commit ) {
+  init_data();
+
+  for (auto & d1 : dist) {
+    TMemoryBuffer buffer(16);
+    reserve_commit_data(buffer, d1);
+    BOOST_CHECK_EQUAL(data_str, buffer.getBufferAsString());
+  }
+
+  // An observed buffer is never written to, so it can't reserve anything.
+  TMemoryBuffer observed(data, sizeof(data), TMemoryBuffer::OBSERVE);
+  uint32_t len = 1;
+  BOOST_CHECK(observed.reserve(&len) == nullptr);
+
+  TMemoryBuffer buffer(16);
+  len = 4;
+  BOOST_CHECK(buffer.reserve(&len) != nullptr);
+  BOOST_CHECK_THROW(buffer.commit(len + 1), apache::thrift::transport::TTransportException);
+}
+
 BOOST_AUTO_TEST_CASE( test_MemoryBuffer_Write_Read ) {
   init_data();
 
@@ -419,6 +460,27 @@ BOOST_AUTO_TEST_CASE( test_BufferedTransport_Write ) {
   }
 }
 
+BOOST_AUTO_TEST_CASE( test_BufferedTransport_Reserve_Commit ) {
+  init_data();
+
+  int sizes[] = {
+    12, 15, 16, 17, 20,
+    501, 512, 523,
+    2000, 2048, 2096,
+    1<<14, 1<<17,
+  };
+
+  for (int size : sizes) {
+    for (auto & d1 : dist) {
+      shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer(16));
+      TBufferedTransport trans(buffer, size);
+      reserve_commit_data(trans, d1);
+      trans.flush();
+      BOOST_CHECK_EQUAL(data_str, buffer->getBufferAsString());
+    }
+  }
+}
+
 BOOST_AUTO_TEST_CASE( test_BufferedTransport_Read_Full ) {
   init_data();
 
@@ -519,6 +581,72 @@ BOOST_AUTO_TEST_CASE( test_FramedTransport_Write ) {
   }
 }
 
+BOOST_AUTO_TEST_CASE( test_FramedTransport_Reserve_Commit ) {
+  init_data();
+
+  for (auto & d1 : dist) {
+    shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer(16));
+    TFramedTransport trans(buffer, 12);
+    reserve_commit_data(trans, d1);
+    trans.flush();
+
+    int32_t frame_size = -1;
+    buffer->read(reinterpret_cast<uint8_t*>(&frame_size), sizeof(frame_size));
+    BOOST_CHECK_EQUAL((int32_t)ntohl((uint32_t)frame_size), 1<<15);
+    BOOST_CHECK_EQUAL(data_str, buffer->getBufferAsString());
+  }
+}
+
+// Counts how a transport above it writes.
+class WriteRecorder : public apache::thrift::transport::TVirtualTransport<WriteRecorder> {
+public:
+  WriteRecorder() : writes(0), writevs(0) {}
+
+  void write(const uint8_t* buf, uint32_t len) {
+    ++writes;
+    out.append(reinterpret_cast<const char*>(buf), len);
+  }
+
+  void writev(const apache::thrift::transport::TIoVec* vecs, uint32_t count) {
+    ++writevs;
+    for (uint32_t i = 0; i < count; ++i) {
+      out.append(reinterpret_cast<const char*>(vecs[i].base), vecs[i].len);
+    }
+  }
+
+  string out;
+  int writes;
+  int writevs;
+};
+
+BOOST_AUTO_TEST_CASE( test_FramedTransport_Write_Segments ) {
+  init_data();
+
+  shared_ptr<WriteRecorder> recorder(new WriteRecorder());
+  TFramedTransport trans(recorder, 64);
+
+  string frame("\x00\x00\x80\x00", 4);
+  frame += data_str;
+
+  // A frame outgrowing the buffer goes out in one writev()
+  for (int offset = 0; offset < 1<<15; offset += 100) {
+    trans.write(&data[offset], (std::min)(100, (1<<15) - offset));
+  }
+  BOOST_CHECK_EQUAL(trans.writeEnd(), 4u + (1<<15));
+  trans.flush();
+  BOOST_CHECK_EQUAL(recorder->writevs, 1);
+  BOOST_CHECK_EQUAL(recorder->writes, 0);
+  BOOST_CHECK(recorder->out == frame);
+
+  // and leaves a buffer big enough for the next one
+  recorder->out.clear();
+  trans.write(data, 1<<15);
+  trans.flush();
+  BOOST_CHECK_EQUAL(recorder->writevs, 1);
+  BOOST_CHECK_EQUAL(recorder->writes, 1);
+  BOOST_CHECK(recorder->out == frame);
+}
+
 BOOST_AUTO_TEST_CASE( test_FramedTransport_Read ) {
   init_data();
 
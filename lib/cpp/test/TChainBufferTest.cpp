@@ -0,0 +1,243 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <boost/test/unit_test.hpp>
+#include <memory>
+#include <string>
+#include <thrift/protocol/TBinaryProtocol.h>
+#include <thrift/protocol/TCompactProtocol.h>
+#include <thrift/transport/TBufferTransports.h>
+#include <thrift/transport/TChainBuffer.h>
+#include <vector>
+
+BOOST_AUTO_TEST_SUITE(TChainBufferTest)
+
+using apache::thrift::TBinaryView;
+using apache::thrift::protocol::TBinaryProtocolT;
+using apache::thrift::protocol::TCompactProtocolT;
+using apache::thrift::transport::TChainBuffer;
+using apache::thrift::transport::TMemoryBuffer;
+using apache::thrift::transport::TTransportException;
+using std::shared_ptr;
+using std::string;
+
+static string pattern(uint32_t len, uint32_t seed = 0) {
+  string str(len, '\0');
+  for (uint32_t i = 0; i < len; ++i) {
+    str[i] = static_cast<char>((i + seed) * 31);
+  }
+  return str;
+}
+
+static const uint8_t* bytes(const string& str) {
+  return reinterpret_cast<const uint8_t*>(str.data());
+}
+
+BOOST_AUTO_TEST_CASE(test_read_write_segments) {
+  TChainBuffer uut(16);
+  string data = pattern(1000);
+  for (uint32_t i = 0, len = 1; i < data.size(); i += len, ++len) {
+    len = (std::min)(len, static_cast<uint32_t>(data.size()) - i);
+    uut.write(bytes(data) + i, len);
+  }
+  BOOST_CHECK_EQUAL(uut.available_read(), 1000u);
+  BOOST_CHECK_GT(uut.getSegmentCount(), 1u);
+  BOOST_CHECK(uut.getBufferAsString() == data);
+
+  string got;
+  for (uint32_t len = 1; got.size() < data.size(); ++len) {
+    uint8_t buf[64];
+    uint32_t n = uut.read(buf, (std::min)(len, 64u));
+    got.append(reinterpret_cast<const char*>(buf), n);
+  }
+  BOOST_CHECK(got == data);
+  BOOST_CHECK_EQUAL(uut.available_read(), 0u);
+
+  // the last segment is written again from its start once all is read
+  uut.readEnd();
+  BOOST_CHECK_EQUAL(uut.getSegmentCount(), 1u);
+  uut.write(bytes(data), 10);
+  BOOST_CHECK(uut.getBufferAsString() == data.substr(0, 10));
+}
+
+BOOST_AUTO_TEST_CASE(test_append_without_copy) {
+  shared_ptr<string> payload = std::make_shared<string>(pattern(5000));
+  TChainBuffer uut(64);
+  uut.write(bytes("head"), 4);
+  uut.append(payload, bytes(*payload), static_cast<uint32_t>(payload->size()));
+  uut.write(bytes("tail"), 4);
+  BOOST_CHECK_EQUAL(payload.use_count(), 2);
+  BOOST_CHECK(uut.getBufferAsString() == "head" + *payload + "tail");
+
+  uint8_t head[4];
+  uut.readAll(head, 4);
+  uint32_t len = 1;
+  const uint8_t* borrowed = uut.borrow(nullptr, &len);
+  BOOST_CHECK(borrowed == bytes(*payload));
+  BOOST_CHECK_EQUAL(len, payload->size());
+  uut.consume(len);
+
+  uint8_t tail[4];
+  uut.readAll(tail, 4);
+  BOOST_CHECK(string(reinterpret_cast<char*>(tail), 4) == "tail");
+  uut.readEnd();
+  BOOST_CHECK_EQUAL(payload.use_count(), 1);
+}
+
+BOOST_AUTO_TEST_CASE(test_borrow_across_segments) {
+  TChainBuffer uut(8);
+  string data = pattern(40);
+  uut.write(bytes(data), 5);
+  uut.write(bytes(data) + 5, 35);
+  uint8_t buf[6];
+  uut.read(buf, 6);
+
+  uint32_t len = 20;
+  const uint8_t* borrowed = uut.borrow(nullptr, &len);
+  BOOST_REQUIRE(borrowed != nullptr);
+  BOOST_CHECK_EQUAL(len, 20u);
+  BOOST_CHECK(string(reinterpret_cast<const char*>(borrowed), len) == data.substr(6, 20));
+  uut.consume(20);
+  BOOST_CHECK(uut.getBufferAsString() == data.substr(26));
+
+  len = 15;
+  BOOST_CHECK(uut.borrow(nullptr, &len) == nullptr);
+}
+
+BOOST_AUTO_TEST_CASE(test_clone_split) {
+  TChainBuffer uut(16);
+  string data = pattern(100);
+  uut.write(bytes(data), 50);
+
+  shared_ptr<TChainBuffer> clone = uut.clone();
+  shared_ptr<TChainBuffer> front = uut.split(20);
+  uut.write(bytes(data) + 50, 50);
+
+  BOOST_CHECK(front->getBufferAsString() == data.substr(0, 20));
+  BOOST_CHECK(clone->getBufferAsString() == data.substr(0, 50));
+  BOOST_CHECK(uut.getBufferAsString() == data.substr(20));
+
+  // slices go on by themselves
+  front->write(bytes("more"), 4);
+  BOOST_CHECK(front->getBufferAsString() == data.substr(0, 20) + "more");
+  BOOST_CHECK(uut.getBufferAsString() == data.substr(20));
+
+  uut.append(*front);
+  BOOST_CHECK(uut.getBufferAsString() == data.substr(20) + data.substr(0, 20) + "more");
+
+  BOOST_CHECK_THROW(uut.split(1000), TTransportException);
+}
+
+BOOST_AUTO_TEST_CASE(test_share_read_buffer) {
+  TChainBuffer uut(16);
+  string data = pattern(100);
+  for (uint32_t i = 0; i < 100; i += 10) {
+    uut.write(bytes(data) + i, 10);
+  }
+
+  // borrowing brings the bytes into one segment, sharing keeps it
+  BOOST_CHECK_GT(uut.getSegmentCount(), 1u);
+  uint32_t len = 100;
+  const uint8_t* start = uut.borrow(nullptr, &len);
+  BOOST_REQUIRE(start);
+  BOOST_CHECK_EQUAL(len, 100u);
+  size_t segments = uut.getSegmentCount();
+  shared_ptr<const void> owner = uut.shareReadBuffer();
+  BOOST_REQUIRE(owner);
+  BOOST_CHECK_EQUAL(uut.getSegmentCount(), segments);
+  uut.consume(len);
+
+  // neither more writes nor a reset touch what was shared
+  uut.readEnd();
+  uut.write(bytes(pattern(100, 1)), 100);
+  BOOST_CHECK(string(reinterpret_cast<const char*>(start), 100) == data);
+}
+
+BOOST_AUTO_TEST_CASE(test_transports) {
+  string data = pattern(10000);
+  TMemoryBuffer source;
+  source.write(bytes(data), static_cast<uint32_t>(data.size()));
+
+  TChainBuffer uut(1024);
+  uut.readFrom(source, 10000);
+  BOOST_CHECK_EQUAL(uut.getSegmentCount(), 10u);
+
+  TMemoryBuffer sink;
+  uut.writeTo(sink);
+  BOOST_CHECK(sink.getBufferAsString() == data);
+  BOOST_CHECK_EQUAL(uut.available_read(), 0u);
+}
+
+template <typename Protocol_>
+static void roundTrip() {
+  shared_ptr<TChainBuffer> buffer = std::make_shared<TChainBuffer>(16);
+  Protocol_ prot(buffer);
+  string big = pattern(300);
+  for (int i = 0; i < 20; ++i) {
+    prot.writeI64(i * 1000003);
+    prot.writeString(big.substr(0, i * 15));
+    prot.writeDouble(i / 3.0);
+  }
+  for (int i = 0; i < 20; ++i) {
+    int64_t n;
+    string str;
+    double d;
+    prot.readI64(n);
+    prot.readString(str);
+    prot.readDouble(d);
+    BOOST_CHECK_EQUAL(n, i * 1000003);
+    BOOST_CHECK(str == big.substr(0, i * 15));
+    BOOST_CHECK_EQUAL(d, i / 3.0);
+  }
+  BOOST_CHECK_EQUAL(buffer->available_read(), 0u);
+}
+
+BOOST_AUTO_TEST_CASE(test_protocols) {
+  roundTrip<TBinaryProtocolT<TChainBuffer> >();
+  roundTrip<TCompactProtocolT<TChainBuffer> >();
+}
+
+template <typename Protocol_>
+static void binaryViews() {
+  shared_ptr<TChainBuffer> buffer = std::make_shared<TChainBuffer>(16);
+  Protocol_ prot(buffer);
+  string data = pattern(100);
+  for (uint32_t len : {12u, 44u, 3u, 90u}) {
+    prot.writeBinary(data.substr(0, len));
+  }
+
+  // views that span segments must not move the ones read before them
+  TBinaryView views[4];
+  for (auto& view : views) {
+    prot.readBinaryView(view);
+  }
+  prot.getTransport()->readEnd();
+  prot.writeBinary(pattern(100, 1));
+  uint32_t i = 0;
+  for (uint32_t len : {12u, 44u, 3u, 90u}) {
+    BOOST_CHECK(views[i++].str() == data.substr(0, len));
+  }
+}
+
+BOOST_AUTO_TEST_CASE(test_binary_views) {
+  binaryViews<TBinaryProtocolT<TChainBuffer> >();
+  binaryViews<TCompactProtocolT<TChainBuffer> >();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -336,6 +336,35 @@ BOOST_AUTO_TEST_CASE(test_noop_flush) {
   }
 }
 
+/**
+ * Make sure getCurrentEventRemaining() tells where an event ends when it
+ * fills the read buffer exactly.
+ */
+BOOST_AUTO_TEST_CASE(test_event_remaining) {
+  TempFile f(tmp_dir, "thrift.TFileTransportTest.");
+  {
+    TFileTransport writer(f.getPath());
+    uint8_t buf[64];
+    memset(buf, 'a', sizeof(buf));
+    writer.write(buf, 64);
+    buf[0] = 'b';
+    writer.write(buf, 8);
+    writer.flush();
+  }
+
+  TFileTransport reader(f.getPath(), true);
+  reader.setReadTimeout(TFileTransport::NO_TAIL_READ_TIMEOUT);
+  uint8_t buf[32];
+  BOOST_CHECK_EQUAL(reader.getCurrentEventRemaining(), 0u);
+  BOOST_CHECK_EQUAL(reader.read(buf, sizeof(buf)), 32u);
+  BOOST_CHECK_EQUAL(reader.getCurrentEventRemaining(), 32u);
+  BOOST_CHECK_EQUAL(reader.read(buf, sizeof(buf)), 32u);
+  BOOST_CHECK_EQUAL(reader.getCurrentEventRemaining(), 0u);
+  BOOST_CHECK_EQUAL(reader.read(buf, sizeof(buf)), 8u);
+  BOOST_CHECK_EQUAL(buf[0], 'b');
+  BOOST_CHECK_EQUAL(reader.getCurrentEventRemaining(), 0u);
+}
+
 /**************************************************************************
  * General Initialization
  **************************************************************************/
@@ -25,6 +25,7 @@
 #include <memory>
 #include <numeric>
 #include <thrift/protocol/TBinaryProtocol.h>
+#include <thrift/protocol/TCompactProtocol.h>
 #include <thrift/transport/TBufferTransports.h>
 #include <vector>
 
@@ -32,7 +33,10 @@
 
 BOOST_AUTO_TEST_SUITE(TMemoryBufferTest)
 
+using apache::thrift::TBinaryView;
 using apache::thrift::protocol::TBinaryProtocol;
+using apache::thrift::protocol::TCompactProtocol;
+using apache::thrift::transport::TFramedTransport;
 using apache::thrift::transport::TMemoryBuffer;
 using apache::thrift::transport::TTransportException;
 using std::shared_ptr;
@@ -409,4 +413,76 @@ BOOST_AUTO_TEST_CASE(test_memory_buffer_to_get_sizeof_objects)
   BOOST_CHECK_EQUAL(47, size);
 }
 
+BOOST_AUTO_TEST_CASE(test_binary_view)
+{
+  shared_ptr<TMemoryBuffer> buf(new TMemoryBuffer());
+  TBinaryProtocol prot(buf);
+  const string first(1000, 'a');
+  const string second(2000, 'b');
+  prot.writeBinary(first);
+  prot.writeBinaryView(TBinaryView(second));
+
+  // Both views point into the buffer itself
+  uint8_t* data;
+  uint32_t len;
+  buf->getBuffer(&data, &len);
+  TBinaryView view1, view2;
+  prot.readBinaryView(view1);
+  prot.readBinaryView(view2);
+  BOOST_CHECK_EQUAL(first, view1.str());
+  BOOST_CHECK_EQUAL(second, view2.str());
+  BOOST_CHECK(view1.data() == data + 4);
+
+  // Reusing and growing the buffer must leave them alone
+  buf->resetBuffer();
+  for (int i = 0; i < 8; ++i) {
+    prot.writeBinary(string(4096, 'c'));
+  }
+  BOOST_CHECK_EQUAL(first, view1.str());
+  BOOST_CHECK_EQUAL(second, view2.str());
+  string str;
+  prot.readBinary(str);
+  BOOST_CHECK_EQUAL(string(4096, 'c'), str);
+
+  // They outlive the buffer too
+  buf.reset();
+  BOOST_CHECK_EQUAL(first, view1.str());
+  BOOST_CHECK_EQUAL(second, view2.str());
+
+  // Observed memory is not ours to share, so it gets copied
+  TMemoryBuffer source;
+  TBinaryProtocol(std::shared_ptr<TMemoryBuffer>(&source, [](TMemoryBuffer*) {}))
+      .writeBinary(first);
+  source.getBuffer(&data, &len);
+  shared_ptr<TMemoryBuffer> observed(new TMemoryBuffer(data, len));
+  TBinaryProtocol(observed).readBinaryView(view1);
+  BOOST_CHECK_EQUAL(first, view1.str());
+  BOOST_CHECK(view1.data() != data + 4);
+}
+
+BOOST_AUTO_TEST_CASE(test_binary_view_framed)
+{
+  shared_ptr<TMemoryBuffer> buf(new TMemoryBuffer());
+  shared_ptr<TFramedTransport> framed(new TFramedTransport(buf));
+  TCompactProtocol prot(framed);
+  for (int i = 0; i < 3; ++i) {
+    prot.writeBinary(string(100, static_cast<char>('a' + i)));
+    prot.writeBinary(string(200, static_cast<char>('A' + i)));
+    framed->flush();
+  }
+
+  // Every frame stays with the views into it while the next one is read
+  std::vector<TBinaryView> views;
+  for (int i = 0; i < 6; ++i) {
+    TBinaryView view;
+    prot.readBinaryView(view);
+    views.push_back(view);
+  }
+  for (int i = 0; i < 3; ++i) {
+    BOOST_CHECK_EQUAL(string(100, static_cast<char>('a' + i)), views[2 * i].str());
+    BOOST_CHECK_EQUAL(string(200, static_cast<char>('A' + i)), views[2 * i + 1].str());
+    BOOST_CHECK(views[2 * i].end() <= views[2 * i + 1].data());
+  }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
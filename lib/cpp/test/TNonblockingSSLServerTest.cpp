@@ -152,9 +152,10 @@ private:
     std::shared_ptr<ListenEventHandler> listenHandler;
     std::shared_ptr<TSSLSocketFactory> pServerSocketFactory;
     std::shared_ptr<transport::TNonblockingSSLServerSocket> socket;
+    server::TEventLoopType eventLoopType;
     Mutex mutex_;
 
-    Runner():port(0) {
+    Runner():port(0), eventLoopType(server::T_EVENT_LOOP_LIBEVENT) {
       listenHandler.reset(new ListenEventHandler(&mutex_));
     }
 
@@ -179,6 +180,7 @@ private:
         server.reset(new server::TNonblockingServer(processor, socket));
 	      server->setServerEventHandler(listenHandler);
         server->setNumIOThreads(1);
+        server->setEventLoopType(eventLoopType);
         if (userEventBase) {
           server->registerEvents(userEventBase.get());
         }
@@ -199,7 +201,9 @@ private:
   };
 
 protected:
-  Fixture() : processor(new test::ParentServiceProcessor(std::make_shared<Handler>())) {}
+  Fixture()
+    : eventLoopType_(server::T_EVENT_LOOP_LIBEVENT),
+      processor(new test::ParentServiceProcessor(std::make_shared<Handler>())) {}
 
   ~Fixture() {
     if (server) {
@@ -214,9 +218,12 @@ protected:
     userEventBase_.reset(user_event_base, EventDeleter());
   }
 
+  void setEventLoopType(server::TEventLoopType type) { eventLoopType_ = type; }
+
   int startServer(int port) {
     std::shared_ptr<Runner> runner(new Runner);
     runner->port = port;
+    runner->eventLoopType = eventLoopType_;
     runner->processor = processor;
     runner->userEventBase = userEventBase_;
 
@@ -242,7 +249,29 @@ protected:
     return strings.size() == 1 && !(strings[0].compare("foo"));
   }
 
+  // sends requests larger than a TLS record, several of them back to back,
+  // checks that every response arrives
+  bool canCommunicateLarge(int serverPort) {
+    std::shared_ptr<TSSLSocketFactory> pClientSocketFactory = createClientSocketFactory();
+    std::shared_ptr<TSSLSocket> socket = pClientSocketFactory->createSocket("localhost", serverPort);
+    socket->open();
+    test::ParentServiceClient client(std::make_shared<protocol::TBinaryProtocol>(
+        std::make_shared<transport::TFramedTransport>(socket)));
+    std::vector<std::string> expected;
+    for (int i = 0; i < 3; ++i) {
+      expected.push_back(std::string(40000, static_cast<char>('a' + i)));
+      client.send_addString(expected.back());
+    }
+    for (int i = 0; i < 3; ++i) {
+      client.recv_addString();
+    }
+    std::vector<std::string> strings;
+    client.getStrings(strings);
+    return strings == expected;
+  }
+
 private:
+  server::TEventLoopType eventLoopType_;
   std::shared_ptr<event_base> userEventBase_;
   std::shared_ptr<test::ParentServiceProcessor> processor;
 protected:
@@ -286,4 +315,12 @@ BOOST_FIXTURE_TEST_CASE(provide_event_base, Fixture) {
 #endif
 }
 
+#ifdef HAVE_SYS_EPOLL_H
+BOOST_FIXTURE_TEST_CASE(epoll_event_loop, Fixture) {
+  setEventLoopType(server::T_EVENT_LOOP_EPOLL);
+  startServer(0);
+  BOOST_CHECK(canCommunicateLarge(server->getListenPort()));
+}
+#endif
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -21,8 +21,19 @@
 #include <boost/test/unit_test.hpp>
 #include <memory>
 
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <set>
+#include <thread>
+
+#include "thrift/TApplicationException.h"
+#include "thrift/TBinaryView.h"
+#include "thrift/concurrency/FunctionRunner.h"
 #include "thrift/concurrency/Monitor.h"
 #include "thrift/concurrency/Thread.h"
+#include "thrift/concurrency/ThreadManager.h"
 #include "thrift/server/TNonblockingServer.h"
 #include "thrift/transport/TNonblockingServerSocket.h"
 
@@ -30,13 +41,17 @@
 
 #include <event.h>
 
+using apache::thrift::concurrency::FunctionRunner;
 using apache::thrift::concurrency::Guard;
 using apache::thrift::concurrency::Monitor;
 using apache::thrift::concurrency::Mutex;
 using apache::thrift::concurrency::ThreadFactory;
 using apache::thrift::concurrency::Runnable;
 using apache::thrift::concurrency::Thread;
+using apache::thrift::concurrency::ThreadManager;
 using apache::thrift::concurrency::ThreadFactory;
+using apache::thrift::server::TDispatchMode;
+using apache::thrift::server::TEventLoopType;
 using apache::thrift::server::TServerEventHandler;
 using std::make_shared;
 using std::shared_ptr;
@@ -48,15 +63,93 @@ struct Handler : public test::ParentServiceIf {
   void getStrings(std::vector<std::string>& _return) override { _return = strings_; }
   std::vector<std::string> strings_;
 
+  // sleeps for length milliseconds
+  void getDataWait(std::string& _return, const int32_t length) override {
+    std::this_thread::sleep_for(std::chrono::milliseconds(length));
+    _return = "data";
+  }
+
+  // remembers the thread it ran on
+  int32_t getGeneration() override {
+    generationThread_ = std::this_thread::get_id();
+    return 0;
+  }
+  std::thread::id generationThread_;
+
   // dummy overrides not used in this test
   int32_t incrementGeneration() override { return 0; }
-  int32_t getGeneration() override { return 0; }
-  void getDataWait(std::string&, const int32_t) override {}
   void onewayWait() override {}
   void exceptionWait(const std::string&) override {}
   void unexpectedExceptionWait(const std::string&) override {}
 };
 
+// Replies to a call of any name, remembers the thread it ran on
+class NameProcessor : public TProcessor {
+public:
+  bool process(shared_ptr<protocol::TProtocol> in,
+               shared_ptr<protocol::TProtocol> out,
+               void*) override {
+    std::string name;
+    protocol::TMessageType type;
+    int32_t seqid;
+    in->readMessageBegin(name, type, seqid);
+    in->skip(protocol::T_STRUCT);
+    in->readMessageEnd();
+    in->getTransport()->readEnd();
+    thread_ = std::this_thread::get_id();
+
+    out->writeMessageBegin(name, protocol::T_REPLY, seqid);
+    out->writeStructBegin("result");
+    out->writeFieldStop();
+    out->writeStructEnd();
+    out->writeMessageEnd();
+    out->getTransport()->writeEnd();
+    out->getTransport()->flush();
+    return true;
+  }
+
+  std::thread::id thread_;
+};
+
+// Keeps a view of the payload of every request it reads, the way a handler
+// keeps a zero-copy field (TBinaryView or cpp.lazy) of its arguments, and
+// echoes the payload back.
+class ViewProcessor : public TProcessor {
+public:
+  bool process(shared_ptr<protocol::TProtocol> in,
+               shared_ptr<protocol::TProtocol> out,
+               void*) override {
+    std::string name;
+    protocol::TMessageType type;
+    int32_t seqid;
+    TBinaryView view;
+    in->readMessageBegin(name, type, seqid);
+    in->readBinaryView(view);
+    // without readEnd(), the request still shares its buffer when it is done
+    in->readMessageEnd();
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      views_.push_back(view);
+    }
+
+    out->writeMessageBegin(name, protocol::T_REPLY, seqid);
+    out->writeBinary(view.str());
+    out->writeMessageEnd();
+    out->getTransport()->writeEnd();
+    out->getTransport()->flush();
+    return true;
+  }
+
+  std::vector<TBinaryView> views() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return views_;
+  }
+
+private:
+  std::mutex mutex_;
+  std::vector<TBinaryView> views_;
+};
+
 class Fixture {
 private:
   struct ListenEventHandler : public TServerEventHandler {
@@ -69,14 +162,41 @@ private:
         listenMonitor_.notify();
       }
 
+      // remembers the protocols and sockets connections were served with
+      void* createContext(shared_ptr<protocol::TProtocol> input,
+                          shared_ptr<protocol::TProtocol> output) override {
+        (void)output;
+        std::lock_guard<std::mutex> g(seenMutex_);
+        protocols_.insert(input.get());
+        return nullptr;
+      }
+      void processContext(void* serverContext,
+                          shared_ptr<transport::TTransport> transport) override {
+        (void)serverContext;
+        std::lock_guard<std::mutex> g(seenMutex_);
+        sockets_.insert(transport.get());
+      }
+
       Monitor listenMonitor_;
       bool ready_;
+      std::mutex seenMutex_;
+      std::set<void*> protocols_;
+      std::set<void*> sockets_;
   };
 
   struct Runner : public Runnable {
     int port;
+    TEventLoopType eventLoopType;
+    size_t maxPipelinedRequests;
+    int64_t inlineDispatchThreshold;
+    int64_t taskExpireTime;
+    std::map<std::string, TDispatchMode> dispatchModes;
+    size_t bufferPoolSize;
+    uint32_t zeroCopyThreshold;
+    size_t numIOThreads;
     shared_ptr<event_base> userEventBase;
     shared_ptr<TProcessor> processor;
+    shared_ptr<ThreadManager> threadManager;
     shared_ptr<server::TNonblockingServer> server;
     shared_ptr<ListenEventHandler> listenHandler;
     shared_ptr<transport::TNonblockingServerSocket> socket;
@@ -84,6 +204,13 @@ private:
 
     Runner() {
       port = 0;
+      eventLoopType = server::T_EVENT_LOOP_LIBEVENT;
+      maxPipelinedRequests = 1;
+      inlineDispatchThreshold = 0;
+      taskExpireTime = 0;
+      bufferPoolSize = 0;
+      zeroCopyThreshold = 0;
+      numIOThreads = 1;
       listenHandler.reset(new ListenEventHandler(&mutex_));
     }
 
@@ -105,7 +232,20 @@ private:
       try {
         socket.reset(new transport::TNonblockingServerSocket(port));
         server.reset(new server::TNonblockingServer(processor, socket));
+        if (threadManager) {
+          server->setThreadManager(threadManager);
+        }
         server->setServerEventHandler(listenHandler);
+        server->setEventLoopType(eventLoopType);
+        server->setMaxPipelinedRequests(maxPipelinedRequests);
+        server->setInlineDispatchThreshold(inlineDispatchThreshold);
+        server->setTaskExpireTime(taskExpireTime);
+        for (auto& mode : dispatchModes) {
+          server->setMethodDispatchMode(mode.first, mode.second);
+        }
+        server->setBufferPoolSize(bufferPoolSize);
+        server->setZeroCopyThreshold(zeroCopyThreshold);
+        server->setNumIOThreads(numIOThreads);
         if (userEventBase) {
           server->registerEvents(userEventBase.get());
         }
@@ -126,24 +266,73 @@ private:
   };
 
 protected:
-  Fixture() : processor(new test::ParentServiceProcessor(make_shared<Handler>())) {}
-
-  ~Fixture() {
+  Fixture()
+    : eventLoopType_(server::T_EVENT_LOOP_LIBEVENT),
+      maxPipelinedRequests_(1),
+      inlineDispatchThreshold_(0),
+      taskExpireTime_(0),
+      bufferPoolSize_(0),
+      zeroCopyThreshold_(0),
+      numIOThreads_(1),
+      handler(make_shared<Handler>()),
+      processor(new test::ParentServiceProcessor(handler)) {}
+
+  ~Fixture() { stopServer(); }
+
+  void stopServer() {
     if (server) {
       server->stop();
     }
     if (thread) {
       thread->join();
     }
+    server.reset();
+    thread.reset();
   }
 
   void setEventBase(event_base* user_event_base) {
     userEventBase_.reset(user_event_base, EventDeleter());
   }
 
+  void setEventLoopType(TEventLoopType type) { eventLoopType_ = type; }
+
+  void setMaxPipelinedRequests(size_t max) { maxPipelinedRequests_ = max; }
+
+  void setInlineDispatchThreshold(int64_t micros) { inlineDispatchThreshold_ = micros; }
+
+  void setTaskExpireTime(int64_t millis) { taskExpireTime_ = millis; }
+
+  void setMethodDispatchMode(const std::string& method, TDispatchMode mode) {
+    dispatchModes_[method] = mode;
+  }
+
+  void setBufferPoolSize(size_t size) { bufferPoolSize_ = size; }
+
+  void setZeroCopyThreshold(uint32_t threshold) { zeroCopyThreshold_ = threshold; }
+
+  void setNumIOThreads(size_t threads) { numIOThreads_ = threads; }
+
+  void setProcessor(shared_ptr<TProcessor> value) { processor = value; }
+
+  void setThreadManager(size_t workers,
+                        ThreadManager::SCHEDULING scheduling = ThreadManager::FIFO) {
+    threadManager_ = ThreadManager::newSimpleThreadManager(workers, 0, scheduling);
+    threadManager_->threadFactory(make_shared<ThreadFactory>());
+    threadManager_->start();
+  }
+
   int startServer(int port) {
     shared_ptr<Runner> runner(new Runner);
     runner->port = port;
+    runner->eventLoopType = eventLoopType_;
+    runner->threadManager = threadManager_;
+    runner->maxPipelinedRequests = maxPipelinedRequests_;
+    runner->inlineDispatchThreshold = inlineDispatchThreshold_;
+    runner->taskExpireTime = taskExpireTime_;
+    runner->dispatchModes = dispatchModes_;
+    runner->bufferPoolSize = bufferPoolSize_;
+    runner->zeroCopyThreshold = zeroCopyThreshold_;
+    runner->numIOThreads = numIOThreads_;
     runner->processor = processor;
     runner->userEventBase = userEventBase_;
 
@@ -154,6 +343,7 @@ protected:
     runner->readyBarrier();
 
     server = runner->server;
+    listenHandler_ = runner->listenHandler;
     return runner->port;
   }
 
@@ -168,11 +358,192 @@ protected:
     return strings.size() == 1 && !(strings[0].compare("foo"));
   }
 
+  // calls getDataWait from that many clients at once, returns how many got
+  // a response
+  int dataWaitClients(int serverPort, int clients, int32_t waitMs) {
+    std::atomic<int> responses(0);
+    std::vector<shared_ptr<Thread> > threads;
+    shared_ptr<ThreadFactory> threadFactory(new ThreadFactory(false));
+    for (int i = 0; i < clients; ++i) {
+      threads.push_back(threadFactory->newThread(FunctionRunner::create([&]() {
+        shared_ptr<transport::TSocket> socket(new transport::TSocket("localhost", serverPort));
+        socket->open();
+        test::ParentServiceClient client(make_shared<protocol::TBinaryProtocol>(
+            make_shared<transport::TFramedTransport>(socket)));
+        try {
+          std::string data;
+          client.getDataWait(data, waitMs);
+          ++responses;
+        } catch (const TException&) {
+          // the server closed the connection instead of running the call
+        }
+      })));
+      threads.back()->start();
+    }
+    for (auto& thread : threads) {
+      thread->join();
+    }
+    return responses;
+  }
+
+  // sends all requests before reading the first response, returns the
+  // time it took in milliseconds
+  int64_t pipelineDataWait(int serverPort, int requests, int32_t waitMs) {
+    shared_ptr<transport::TSocket> socket(new transport::TSocket("localhost", serverPort));
+    socket->open();
+    test::ParentServiceClient client(make_shared<protocol::TBinaryProtocol>(
+        make_shared<transport::TFramedTransport>(socket)));
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int i = 0; i < requests; ++i) {
+      client.send_getDataWait(waitMs);
+    }
+    for (int i = 0; i < requests; ++i) {
+      std::string data;
+      client.recv_getDataWait(data);
+      BOOST_CHECK_EQUAL(data, "data");
+    }
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+               std::chrono::steady_clock::now() - start).count();
+  }
+
+  // returns whether each of the calls ran on the thread that serves the IO
+  std::vector<bool> generationInline(int serverPort, int calls) {
+    shared_ptr<transport::TSocket> socket(new transport::TSocket("localhost", serverPort));
+    socket->open();
+    test::ParentServiceClient client(make_shared<protocol::TBinaryProtocol>(
+        make_shared<transport::TFramedTransport>(socket)));
+    std::vector<bool> result;
+    for (int i = 0; i < calls; ++i) {
+      client.getGeneration();
+      result.push_back(handler->generationThread_ == thread->getId());
+    }
+    return result;
+  }
+
+  // calls the methods of a NameProcessor by name, returns whether each of the
+  // calls ran on the thread that serves the IO
+  std::vector<bool> namedCallsInline(NameProcessor& names, const std::vector<std::string>& calls) {
+    shared_ptr<transport::TSocket> socket(new transport::TSocket("localhost",
+                                                                server->getListenPort()));
+    socket->open();
+    protocol::TBinaryProtocol prot(make_shared<transport::TFramedTransport>(socket));
+    std::vector<bool> result;
+    int32_t seqid = 0;
+    for (const auto& call : calls) {
+      prot.writeMessageBegin(call, protocol::T_CALL, seqid++);
+      prot.writeStructBegin("args");
+      prot.writeFieldStop();
+      prot.writeStructEnd();
+      prot.writeMessageEnd();
+      prot.getTransport()->writeEnd();
+      prot.getTransport()->flush();
+
+      std::string name;
+      protocol::TMessageType type;
+      prot.readMessageBegin(name, type, seqid);
+      prot.skip(protocol::T_STRUCT);
+      prot.readMessageEnd();
+      prot.getTransport()->readEnd();
+      result.push_back(names.thread_ == thread->getId());
+    }
+    return result;
+  }
+
+  // calls methods the service does not have, returns how many were refused
+  int unknownMethods(int serverPort, int calls) {
+    shared_ptr<transport::TSocket> socket(new transport::TSocket("localhost", serverPort));
+    socket->open();
+    protocol::TBinaryProtocol prot(make_shared<transport::TFramedTransport>(socket));
+    int refused = 0;
+    for (int i = 0; i < calls; ++i) {
+      prot.writeMessageBegin("unknown" + std::to_string(i), protocol::T_CALL, i);
+      prot.writeStructBegin("args");
+      prot.writeFieldStop();
+      prot.writeStructEnd();
+      prot.writeMessageEnd();
+      prot.getTransport()->writeEnd();
+      prot.getTransport()->flush();
+
+      std::string name;
+      protocol::TMessageType type;
+      int32_t seqid;
+      prot.readMessageBegin(name, type, seqid);
+      TApplicationException x;
+      x.read(&prot);
+      prot.readMessageEnd();
+      prot.getTransport()->readEnd();
+      if (type == protocol::T_EXCEPTION && x.getType() == TApplicationException::UNKNOWN_METHOD) {
+        ++refused;
+      }
+    }
+    return refused;
+  }
+
+  // waits until the connections have given back all pooled buffers
+  bool buffersReturned() {
+    for (int i = 0; i < 100 && server->getNumBorrowedBuffers() > 0; ++i) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return server->getNumBorrowedBuffers() == 0;
+  }
+
+  // waits until the server has closed all connections
+  bool connectionsClosed() {
+    for (int i = 0; i < 100 && server->getNumActiveConnections() > 0; ++i) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return server->getNumActiveConnections() == 0;
+  }
+
+  // makes responses of growing size, checks that they all arrive intact
+  bool largeResponses(int serverPort, int calls) {
+    shared_ptr<transport::TSocket> socket(new transport::TSocket("localhost", serverPort));
+    socket->open();
+    test::ParentServiceClient client(make_shared<protocol::TBinaryProtocol>(
+        make_shared<transport::TFramedTransport>(socket)));
+    std::vector<std::string> expected;
+    for (int i = 0; i < calls; ++i) {
+      expected.push_back(std::string(64 * 1024, static_cast<char>('a' + i)));
+      client.addString(expected.back());
+      std::vector<std::string> strings;
+      client.getStrings(strings);
+      if (strings != expected) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // returns the number of round trips per second over one connection
+  double measureThroughput(int serverPort, int calls) {
+    shared_ptr<transport::TSocket> socket(new transport::TSocket("localhost", serverPort));
+    socket->open();
+    test::ParentServiceClient client(make_shared<protocol::TBinaryProtocol>(
+        make_shared<transport::TFramedTransport>(socket)));
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int i = 0; i < calls; ++i) {
+      client.getGeneration();
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return calls / elapsed.count();
+  }
+
 private:
+  TEventLoopType eventLoopType_;
+  size_t maxPipelinedRequests_;
+  int64_t inlineDispatchThreshold_;
+  int64_t taskExpireTime_;
+  std::map<std::string, TDispatchMode> dispatchModes_;
+  size_t bufferPoolSize_;
+  uint32_t zeroCopyThreshold_;
+  size_t numIOThreads_;
+  shared_ptr<ThreadManager> threadManager_;
   shared_ptr<event_base> userEventBase_;
-  shared_ptr<test::ParentServiceProcessor> processor;
+  shared_ptr<Handler> handler;
+  shared_ptr<TProcessor> processor;
 protected:
   shared_ptr<server::TNonblockingServer> server;
+  shared_ptr<ListenEventHandler> listenHandler_;
 private:
   shared_ptr<apache::thrift::concurrency::Thread> thread;
 
@@ -212,4 +583,408 @@ BOOST_FIXTURE_TEST_CASE(provide_event_base, Fixture) {
 #endif
 }
 
+BOOST_FIXTURE_TEST_CASE(task_completion_batching, Fixture) {
+  const int clients = 8;
+  const int calls = 500;
+  setThreadManager(4);
+  startServer(0);
+
+  std::vector<shared_ptr<Thread> > threads;
+  shared_ptr<ThreadFactory> threadFactory(new ThreadFactory(false));
+  for (int i = 0; i < clients; ++i) {
+    threads.push_back(threadFactory->newThread(FunctionRunner::create(
+        [this, calls]() { measureThroughput(server->getListenPort(), calls); })));
+    threads.back()->start();
+  }
+  for (auto& thread : threads) {
+    thread->join();
+  }
+
+  uint64_t completions = server->getNumTaskCompletions();
+  uint64_t wakeups = server->getNumCompletionWakeups();
+  BOOST_TEST_MESSAGE(completions << " task completions in " << wakeups << " wakeups");
+  BOOST_CHECK_EQUAL(completions, static_cast<uint64_t>(clients * calls));
+  BOOST_CHECK_GT(wakeups, 0U);
+  BOOST_CHECK_LE(wakeups, completions);
+}
+
+BOOST_FIXTURE_TEST_CASE(pipelined_requests, Fixture) {
+  setThreadManager(4);
+  setMaxPipelinedRequests(4);
+  startServer(0);
+
+  // the requests run side by side instead of one after the other
+  int64_t elapsed = pipelineDataWait(server->getListenPort(), 4, 200);
+  BOOST_CHECK_LT(elapsed, 600);
+  BOOST_CHECK(canCommunicate(server->getListenPort()));
+}
+
+BOOST_FIXTURE_TEST_CASE(pipelined_requests_limit, Fixture) {
+  setThreadManager(4);
+  setMaxPipelinedRequests(2);
+  startServer(0);
+
+  // only two requests run at a time
+  int64_t elapsed = pipelineDataWait(server->getListenPort(), 4, 200);
+  BOOST_CHECK_GE(elapsed, 400);
+  BOOST_CHECK_LT(elapsed, 800);
+}
+
+BOOST_FIXTURE_TEST_CASE(unpipelined_requests, Fixture) {
+  setThreadManager(4);
+  startServer(0);
+
+  // by default requests of a connection are processed one at a time
+  int64_t elapsed = pipelineDataWait(server->getListenPort(), 4, 100);
+  BOOST_CHECK_GE(elapsed, 400);
+}
+
+BOOST_FIXTURE_TEST_CASE(expired_tasks_dropped, Fixture) {
+  setThreadManager(1, ThreadManager::EARLIEST_DEADLINE_FIRST);
+  setTaskExpireTime(50);
+  startServer(0);
+
+  // one worker, each call takes longer than the others may wait
+  const int clients = 8;
+  int responses = dataWaitClients(server->getListenPort(), clients, 100);
+  uint64_t expired = server->getNumExpiredTasks(ThreadManager::EXPIRED_AT_DISPATCH);
+  BOOST_TEST_MESSAGE(responses << " responses, " << expired << " expired");
+  BOOST_CHECK_GE(responses, 1);
+  BOOST_CHECK_LT(responses, clients);
+  BOOST_CHECK_EQUAL(static_cast<uint64_t>(responses) + expired, static_cast<uint64_t>(clients));
+  BOOST_CHECK(connectionsClosed());
+  BOOST_CHECK(canCommunicate(server->getListenPort()));
+}
+
+BOOST_FIXTURE_TEST_CASE(expire_time_keeps_scheduling, Fixture) {
+  setThreadManager(1);
+  setTaskExpireTime(50);
+  startServer(0);
+  BOOST_CHECK_EQUAL(server->getThreadManager()->scheduling(), ThreadManager::FIFO);
+
+  // expired tasks are dropped from a FIFO queue too
+  const int clients = 8;
+  int responses = dataWaitClients(server->getListenPort(), clients, 100);
+  uint64_t expired = server->getNumExpiredTasks(ThreadManager::EXPIRED_AT_DISPATCH);
+  BOOST_CHECK_LT(responses, clients);
+  BOOST_CHECK_EQUAL(static_cast<uint64_t>(responses) + expired, static_cast<uint64_t>(clients));
+  BOOST_CHECK(connectionsClosed());
+}
+
+BOOST_FIXTURE_TEST_CASE(inline_dispatch_forced, Fixture) {
+  setThreadManager(2);
+  setMethodDispatchMode("getGeneration", server::T_DISPATCH_INLINE);
+  startServer(0);
+
+  std::vector<bool> calls = generationInline(server->getListenPort(), 3);
+  BOOST_CHECK(calls == std::vector<bool>(3, true));
+  BOOST_CHECK(canCommunicate(server->getListenPort()));
+}
+
+BOOST_FIXTURE_TEST_CASE(inline_dispatch_threshold, Fixture) {
+  setThreadManager(2);
+  setInlineDispatchThreshold(1000000);
+  startServer(0);
+
+  // the first call is measured on a worker, the fast ones after it run inline
+  std::vector<bool> calls = generationInline(server->getListenPort(), 3);
+  BOOST_CHECK(!calls[0]);
+  BOOST_CHECK(calls[1]);
+  BOOST_CHECK(calls[2]);
+}
+
+BOOST_FIXTURE_TEST_CASE(inline_dispatch_thread_pool, Fixture) {
+  setThreadManager(2);
+  setInlineDispatchThreshold(1000000);
+  setMethodDispatchMode("getGeneration", server::T_DISPATCH_THREAD_POOL);
+  startServer(0);
+
+  std::vector<bool> calls = generationInline(server->getListenPort(), 3);
+  BOOST_CHECK(calls == std::vector<bool>(3, false));
+}
+
+BOOST_FIXTURE_TEST_CASE(inline_dispatch_pipelined, Fixture) {
+  setThreadManager(4);
+  setMaxPipelinedRequests(4);
+  setMethodDispatchMode("getGeneration", server::T_DISPATCH_INLINE);
+  startServer(0);
+
+  // slow requests still run side by side next to the inline ones
+  std::vector<bool> calls = generationInline(server->getListenPort(), 2);
+  BOOST_CHECK(calls == std::vector<bool>(2, true));
+  int64_t elapsed = pipelineDataWait(server->getListenPort(), 4, 200);
+  BOOST_CHECK_LT(elapsed, 600);
+}
+
+BOOST_FIXTURE_TEST_CASE(inline_dispatch_unknown_methods, Fixture) {
+  setThreadManager(2);
+  setInlineDispatchThreshold(1000000);
+  startServer(0);
+
+  // names the service does not have are not measured
+  size_t limit = server::TNonblockingIOThread::MAX_MEASURED_METHODS;
+  int calls = 2 * static_cast<int>(limit);
+  BOOST_CHECK_EQUAL(unknownMethods(server->getListenPort(), calls), calls);
+  BOOST_CHECK_EQUAL(server->getNumMeasuredMethods(), 0U);
+
+  // and do not keep the methods the service does have from running inline
+  std::vector<bool> generation = generationInline(server->getListenPort(), 2);
+  BOOST_CHECK(!generation[0]);
+  BOOST_CHECK(generation[1]);
+}
+
+BOOST_FIXTURE_TEST_CASE(inline_dispatch_method_churn, Fixture) {
+  setThreadManager(2);
+  setInlineDispatchThreshold(1000000);
+  shared_ptr<NameProcessor> nameProcessor(new NameProcessor);
+  setProcessor(nameProcessor);
+  startServer(0);
+
+  // once the latency table is full, the method measured longest ago makes
+  // room for a new one
+  size_t limit = server::TNonblockingIOThread::MAX_MEASURED_METHODS;
+  std::vector<std::string> names;
+  for (size_t i = 0; i < limit; ++i) {
+    names.push_back("method" + std::to_string(i));
+  }
+  names.push_back("late");
+  names.push_back("late");
+  names.push_back("method0");
+  std::vector<bool> calls = namedCallsInline(*nameProcessor, names);
+  BOOST_CHECK_EQUAL(server->getNumMeasuredMethods(), limit);
+  BOOST_CHECK(!calls[limit]);
+  BOOST_CHECK(calls[limit + 1]);
+  BOOST_CHECK(!calls[limit + 2]);
+}
+
+BOOST_FIXTURE_TEST_CASE(buffer_pool, Fixture) {
+  setBufferPoolSize(64 * 1024);
+  startServer(0);
+
+  shared_ptr<transport::TSocket> socket(new transport::TSocket("localhost",
+                                                              server->getListenPort()));
+  socket->open();
+  test::ParentServiceClient client(make_shared<protocol::TBinaryProtocol>(
+      make_shared<transport::TFramedTransport>(socket)));
+  client.addString(std::string(5000, 'x'));
+  std::vector<std::string> strings;
+  client.getStrings(strings);
+  BOOST_CHECK_EQUAL(strings.size(), 1U);
+
+  // the open but idle connection holds no buffers, they wait in the pool
+  BOOST_CHECK(buffersReturned());
+  BOOST_CHECK_GT(server->getNumPooledBuffers(), 0U);
+  BOOST_CHECK_GE(server->getPooledBufferBytes(), 8192U);
+  BOOST_CHECK_LE(server->getPooledBufferBytes(), 64U * 1024);
+
+  // and reuses them for the next requests
+  size_t pooled = server->getNumPooledBuffers();
+  client.getStrings(strings);
+  BOOST_CHECK(buffersReturned());
+  BOOST_CHECK_EQUAL(server->getNumPooledBuffers(), pooled);
+}
+
+BOOST_FIXTURE_TEST_CASE(buffer_pool_pipelined, Fixture) {
+  setThreadManager(4);
+  setMaxPipelinedRequests(4);
+  setBufferPoolSize(64 * 1024);
+  startServer(0);
+
+  int64_t elapsed = pipelineDataWait(server->getListenPort(), 4, 100);
+  BOOST_CHECK_LT(elapsed, 300);
+  BOOST_CHECK(canCommunicate(server->getListenPort()));
+  BOOST_CHECK(buffersReturned());
+  BOOST_CHECK_GT(server->getNumPooledBuffers(), 0U);
+}
+
+BOOST_FIXTURE_TEST_CASE(buffer_pool_pipelined_views, Fixture) {
+  setThreadManager(4);
+  setMaxPipelinedRequests(4);
+  setBufferPoolSize(64 * 1024);
+  shared_ptr<ViewProcessor> viewProcessor(new ViewProcessor);
+  setProcessor(viewProcessor);
+  startServer(0);
+
+  shared_ptr<transport::TSocket> socket(new transport::TSocket("localhost",
+                                                              server->getListenPort()));
+  socket->open();
+  protocol::TBinaryProtocol prot(make_shared<transport::TFramedTransport>(socket));
+  const int rounds = 4;
+  const int requests = 8;
+  std::set<std::string> sent;
+  for (int round = 0; round < rounds; ++round) {
+    for (int i = 0; i < requests; ++i) {
+      std::string payload(1000, static_cast<char>('a' + round * requests + i));
+      sent.insert(payload);
+      prot.writeMessageBegin("echo", protocol::T_CALL, i);
+      prot.writeBinary(payload);
+      prot.writeMessageEnd();
+      prot.getTransport()->writeEnd();
+      prot.getTransport()->flush();
+    }
+    for (int i = 0; i < requests; ++i) {
+      std::string name;
+      protocol::TMessageType type;
+      int32_t seqid;
+      std::string payload;
+      prot.readMessageBegin(name, type, seqid);
+      prot.readBinary(payload);
+      prot.readMessageEnd();
+      prot.getTransport()->readEnd();
+      BOOST_CHECK_EQUAL(payload.size(), 1000U);
+    }
+  }
+  socket->close();
+
+  // the buffers the views point into were not given back to the pool for
+  // later requests to write over, and are still accounted for
+  BOOST_CHECK(connectionsClosed());
+  BOOST_CHECK(buffersReturned());
+  std::vector<TBinaryView> views = viewProcessor->views();
+  BOOST_REQUIRE_EQUAL(views.size(), static_cast<size_t>(rounds * requests));
+  std::set<std::string> kept;
+  for (const auto& view : views) {
+    kept.insert(view.str());
+  }
+  BOOST_CHECK(kept == sent);
+
+  // and outlive the server and its pool
+  stopServer();
+  kept.clear();
+  for (const auto& view : views) {
+    kept.insert(view.str());
+  }
+  BOOST_CHECK(kept == sent);
+}
+
+BOOST_FIXTURE_TEST_CASE(zero_copy_responses, Fixture) {
+  setZeroCopyThreshold(16 * 1024);
+  startServer(0);
+  BOOST_CHECK(largeResponses(server->getListenPort(), 8));
+  // the next connection gets the same connection object, small responses
+  // are copied
+  BOOST_CHECK(connectionsClosed());
+  BOOST_CHECK_GT(measureThroughput(server->getListenPort(), 10), 0);
+}
+
+BOOST_FIXTURE_TEST_CASE(zero_copy_responses_pipelined, Fixture) {
+  setThreadManager(4);
+  setMaxPipelinedRequests(4);
+  setBufferPoolSize(64 * 1024);
+  setZeroCopyThreshold(16 * 1024);
+  startServer(0);
+  BOOST_CHECK(largeResponses(server->getListenPort(), 8));
+  BOOST_CHECK(connectionsClosed());
+  BOOST_CHECK(buffersReturned());
+}
+
+#ifdef __linux__
+BOOST_FIXTURE_TEST_CASE(zero_copy_close_does_not_stall, Fixture) {
+  setThreadManager(4);
+  setMaxPipelinedRequests(4);
+  setZeroCopyThreshold(16 * 1024);
+  startServer(0);
+
+  // a client that asks for a response larger than the socket buffers, does
+  // not read it and hangs up, so the server closes the connection while the
+  // kernel still sends from the response
+  shared_ptr<transport::TSocket> stalled(new transport::TSocket("localhost", server->getListenPort()));
+  stalled->open();
+  test::ParentServiceClient client(make_shared<protocol::TBinaryProtocol>(
+      make_shared<transport::TFramedTransport>(stalled)));
+  client.addString(std::string(32 * 1024 * 1024, 'a'));
+  client.send_getStrings();
+  std::this_thread::sleep_for(std::chrono::milliseconds(200));
+  ::shutdown(stalled->getSocketFD(), SHUT_WR);
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+  // the IO thread does not wait for the stalled client before it serves
+  // the next one
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  BOOST_CHECK_GT(measureThroughput(server->getListenPort(), 1), 0);
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  BOOST_CHECK_LT(elapsed.count(), 0.5);
+
+  stalled->close();
+  BOOST_CHECK(connectionsClosed());
+}
+#endif
+
+BOOST_FIXTURE_TEST_CASE(connection_reuse, Fixture) {
+  setNumIOThreads(2);
+  startServer(0);
+
+  // each IO thread keeps the connection objects it closed for reuse
+  for (int i = 0; i < 10; ++i) {
+    BOOST_CHECK(measureThroughput(server->getListenPort(), 1) > 0);
+    BOOST_REQUIRE(connectionsClosed());
+  }
+  BOOST_CHECK_EQUAL(server->getNumConnections(), 2U);
+  BOOST_CHECK_EQUAL(server->getNumIdleConnections(), 2U);
+
+  // and accepts into their sockets, served by the same protocols
+  std::lock_guard<std::mutex> g(listenHandler_->seenMutex_);
+  BOOST_CHECK_EQUAL(listenHandler_->sockets_.size(), 2U);
+  BOOST_CHECK_EQUAL(listenHandler_->protocols_.size(), 2U);
+}
+
+BOOST_FIXTURE_TEST_CASE(connection_reconnect_storm, Fixture) {
+  const int clients = 4;
+  const int connects = 100;
+  setNumIOThreads(2);
+  startServer(0);
+
+  std::vector<shared_ptr<Thread> > threads;
+  shared_ptr<ThreadFactory> threadFactory(new ThreadFactory(false));
+  for (int i = 0; i < clients; ++i) {
+    threads.push_back(threadFactory->newThread(FunctionRunner::create([this, connects]() {
+      for (int j = 0; j < connects; ++j) {
+        measureThroughput(server->getListenPort(), 1);
+      }
+    })));
+    threads.back()->start();
+  }
+  for (auto& thread : threads) {
+    thread->join();
+  }
+
+  BOOST_REQUIRE(connectionsClosed());
+  BOOST_CHECK_EQUAL(server->getNumIdleConnections(), server->getNumConnections());
+  BOOST_CHECK_LE(server->getNumConnections(), static_cast<size_t>(clients * connects));
+  BOOST_CHECK(canCommunicate(server->getListenPort()));
+}
+
+#ifdef HAVE_SYS_EPOLL_H
+BOOST_FIXTURE_TEST_CASE(epoll_event_loop, Fixture) {
+  setEventLoopType(server::T_EVENT_LOOP_EPOLL);
+  startServer(0);
+  BOOST_CHECK_EQUAL(server->getEventLoopType(), server::T_EVENT_LOOP_EPOLL);
+  BOOST_CHECK(canCommunicate(server->getListenPort()));
+}
+
+BOOST_FIXTURE_TEST_CASE(epoll_zero_copy_responses, Fixture) {
+  setEventLoopType(server::T_EVENT_LOOP_EPOLL);
+  setZeroCopyThreshold(16 * 1024);
+  startServer(0);
+  BOOST_CHECK(largeResponses(server->getListenPort(), 8));
+  BOOST_CHECK(connectionsClosed());
+  BOOST_CHECK_GT(measureThroughput(server->getListenPort(), 10), 0);
+}
+
+BOOST_FIXTURE_TEST_CASE(event_loop_throughput, Fixture) {
+  const int calls = 20000;
+  startServer(0);
+  double libeventRate = measureThroughput(server->getListenPort(), calls);
+  stopServer();
+
+  setEventLoopType(server::T_EVENT_LOOP_EPOLL);
+  startServer(0);
+  double epollRate = measureThroughput(server->getListenPort(), calls);
+
+  BOOST_TEST_MESSAGE("libevent: " << static_cast<int>(libeventRate) << " calls/s, epoll: "
+                                  << static_cast<int>(epollRate) << " calls/s");
+  BOOST_CHECK_GT(epollRate, 0);
+}
+#endif
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -17,13 +17,18 @@
  * under the License.
  */
 
+#include <algorithm>
+#include <chrono>
 #include <boost/test/unit_test.hpp>
 #include <thrift/transport/TSocket.h>
 #include <thrift/transport/TServerSocket.h>
 #include <memory>
 #include "TTransportCheckThrow.h"
 #include <iostream>
+#include <thread>
+#include <vector>
 
+using apache::thrift::transport::TIoVec;
 using apache::thrift::transport::TServerSocket;
 using apache::thrift::transport::TSocket;
 using apache::thrift::transport::TTransport;
@@ -70,4 +75,103 @@ BOOST_AUTO_TEST_CASE(test_get_port) {
   BOOST_CHECK_EQUAL(888, sock1.getPort());
 }
 
+BOOST_AUTO_TEST_CASE(test_zero_copy_write) {
+  TServerSocket sock1("localhost", 0);
+  sock1.listen();
+  int port = sock1.getPort();
+
+  // over loopback the kernel copies anyway, after which the socket copies too
+  std::vector<uint8_t> data(1 << 20);
+  for (size_t i = 0; i < data.size(); ++i) {
+    data[i] = static_cast<uint8_t>(i * 7);
+  }
+  std::vector<uint8_t> received;
+  std::thread reader([&] {
+    TSocket clientSock("localhost", port);
+    clientSock.open();
+    uint8_t buf[65536];
+    uint32_t got;
+    while ((got = clientSock.read(buf, sizeof(buf))) > 0) {
+      received.insert(received.end(), buf, buf + got);
+    }
+  });
+
+  shared_ptr<TSocket> accepted = std::dynamic_pointer_cast<TSocket>(sock1.accept());
+  BOOST_REQUIRE(accepted);
+  accepted->setZeroCopyThreshold(4096);
+  BOOST_CHECK_EQUAL(accepted->getZeroCopyThreshold(), 4096u);
+  BOOST_CHECK(accepted->isZeroCopy(4096));
+  BOOST_CHECK(!accepted->isZeroCopy(4095));
+
+  // the socket holds on to the data until the kernel is done with it
+  shared_ptr<const void> owner = std::make_shared<std::vector<uint8_t> >(data);
+  std::weak_ptr<const void> held = owner;
+  const auto* base = &static_cast<const std::vector<uint8_t>*>(owner.get())->front();
+  for (int i = 0; i < 4; ++i) {
+    TIoVec vec = {base, static_cast<uint32_t>(data.size())};
+    accepted->writevZeroCopy(&vec, 1, &owner);
+  }
+  TIoVec vecs[] = {{base, 100}, {base + 100, 5000}, {base + 5100, 0},
+                   {base + 5100, static_cast<uint32_t>(data.size() - 5100)}};
+  shared_ptr<const void> owners[] = {owner, owner, owner, owner};
+  accepted->writevZeroCopy(vecs, 4, owners);
+  accepted->write(&data[0], 10);
+  owner.reset();
+  for (auto& o : owners) {
+    o.reset();
+  }
+  for (int i = 0; i < 500 && accepted->reclaimZeroCopy(); ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  BOOST_CHECK(held.expired());
+
+  accepted->close();
+  reader.join();
+  sock1.close();
+
+  BOOST_REQUIRE_EQUAL(received.size(), 5 * data.size() + 10);
+  for (size_t i = 0; i < 5; ++i) {
+    BOOST_CHECK(std::equal(data.begin(), data.end(), received.begin() + i * data.size()));
+  }
+  BOOST_CHECK(std::equal(data.begin(), data.begin() + 10, received.end() - 10));
+}
+
+BOOST_AUTO_TEST_CASE(test_zero_copy_close) {
+  TServerSocket sock1("localhost", 0);
+  sock1.listen();
+  int port = sock1.getPort();
+
+  std::vector<uint8_t> data(1 << 20, 'z');
+  size_t received = 0;
+  std::thread reader([&] {
+    TSocket clientSock("localhost", port);
+    clientSock.open();
+    uint8_t buf[65536];
+    uint32_t got;
+    while ((got = clientSock.read(buf, sizeof(buf))) > 0) {
+      received += got;
+    }
+  });
+
+  shared_ptr<TSocket> accepted = std::dynamic_pointer_cast<TSocket>(sock1.accept());
+  BOOST_REQUIRE(accepted);
+  accepted->setZeroCopyThreshold(4096);
+
+  // close() right after the sends waits for the kernel to let go of the data
+  shared_ptr<const void> owner = std::make_shared<std::vector<uint8_t> >(data);
+  std::weak_ptr<const void> held = owner;
+  TIoVec vec = {&static_cast<const std::vector<uint8_t>*>(owner.get())->front(),
+                static_cast<uint32_t>(data.size())};
+  for (int i = 0; i < 4; ++i) {
+    accepted->writevZeroCopy(&vec, 1, &owner);
+  }
+  owner.reset();
+  accepted->close();
+  BOOST_CHECK(held.expired());
+
+  reader.join();
+  sock1.close();
+  BOOST_CHECK_EQUAL(received, 4 * data.size());
+}
+
 BOOST_AUTO_TEST_SUITE_END()
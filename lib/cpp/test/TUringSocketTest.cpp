@@ -0,0 +1,185 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <boost/test/unit_test.hpp>
+
+#include <boost/chrono/duration.hpp>
+#include <boost/date_time/posix_time/posix_time_duration.hpp>
+#include <boost/thread/thread.hpp>
+#include <thrift/transport/TUringSocket.h>
+#include <memory>
+#include <vector>
+
+using apache::thrift::transport::TSocket;
+using apache::thrift::transport::TTransport;
+using apache::thrift::transport::TTransportException;
+using apache::thrift::transport::TUringServerSocket;
+using apache::thrift::transport::TUringSocket;
+
+// Everything below also passes when io_uring is unavailable, in which case
+// TUringSocket behaves exactly like TSocket.
+
+BOOST_AUTO_TEST_SUITE(TUringSocketTest)
+
+void uringEchoWorker(std::shared_ptr<TTransport> tt, uint32_t total) {
+  std::vector<uint8_t> buf(total);
+  tt->readAll(&buf[0], total);
+  tt->write(&buf[0], total);
+  tt->flush();
+}
+
+BOOST_AUTO_TEST_CASE(test_uring_echo) {
+  TUringServerSocket sock1("localhost", 0);
+  sock1.listen();
+  int port = sock1.getPort();
+  TUringSocket clientSock("localhost", port);
+  clientSock.open();
+  std::shared_ptr<TTransport> accepted = sock1.accept();
+  BOOST_CHECK(std::dynamic_pointer_cast<TUringSocket>(accepted) != nullptr);
+
+  // small messages go through the buffers, the large one bypasses them
+  const uint32_t sizes[] = {1, 13, 4096, 3 * TUringSocket::DEFAULT_BUFFER_SIZE + 7};
+  for (uint32_t size : sizes) {
+    std::vector<uint8_t> out(size);
+    for (uint32_t i = 0; i < size; ++i) {
+      out[i] = static_cast<uint8_t>(i * 31 + size);
+    }
+    boost::thread echoThread(std::bind(uringEchoWorker, accepted, size));
+    clientSock.write(&out[0], size);
+    clientSock.flush();
+    std::vector<uint8_t> in(size);
+    clientSock.readAll(&in[0], size);
+    echoThread.join();
+    BOOST_CHECK(in == out);
+  }
+  BOOST_CHECK_EQUAL(TUringSocket::isAvailable(), clientSock.isUringActive());
+
+  clientSock.close();
+  uint8_t buf[4];
+  BOOST_CHECK_EQUAL(0U, accepted->read(buf, 4));
+  accepted->close();
+  sock1.close();
+}
+
+BOOST_AUTO_TEST_CASE(test_uring_reconnect) {
+  TUringServerSocket sock1("localhost", 0);
+  sock1.listen();
+  int port = sock1.getPort();
+
+  // closed sockets pass their ring on to the next ones of the thread, which
+  // must not see anything left over from the connections before
+  TUringSocket reopened("localhost", port);
+  for (uint32_t round = 0; round < 4; ++round) {
+    TUringSocket fresh("localhost", port);
+    TUringSocket& clientSock = round % 2 ? reopened : fresh;
+    clientSock.open();
+    std::shared_ptr<TTransport> accepted = sock1.accept();
+    const uint32_t size = 100 + round;
+    std::vector<uint8_t> out(size, static_cast<uint8_t>(round));
+    boost::thread echoThread(std::bind(uringEchoWorker, accepted, size));
+    clientSock.write(&out[0], size);
+    clientSock.flush();
+    std::vector<uint8_t> in(size);
+    clientSock.readAll(&in[0], size);
+    echoThread.join();
+    BOOST_CHECK(in == out);
+    BOOST_CHECK_EQUAL(TUringSocket::isAvailable(), clientSock.isUringActive());
+    clientSock.close();
+    BOOST_CHECK(!clientSock.isUringActive());
+    accepted->close();
+  }
+  sock1.close();
+}
+
+BOOST_AUTO_TEST_CASE(test_uring_read_timeout) {
+  TUringServerSocket sock1("localhost", 0);
+  sock1.listen();
+  TUringSocket clientSock("localhost", sock1.getPort());
+  clientSock.setRecvTimeout(50);
+  clientSock.open();
+  std::shared_ptr<TTransport> accepted = sock1.accept();
+  uint8_t buf[4];
+  try {
+    clientSock.read(buf, 4);
+    BOOST_ERROR("should not have gotten here");
+  } catch (const TTransportException& tx) {
+    BOOST_CHECK_EQUAL(TTransportException::TIMED_OUT, tx.getType());
+  }
+  clientSock.close();
+  accepted->close();
+  sock1.close();
+}
+
+void uringReaderWorkerMustThrow(std::shared_ptr<TTransport> tt) {
+  try {
+    uint8_t buf[4];
+    tt->read(buf, 4);
+    BOOST_ERROR("should not have gotten here");
+  } catch (const TTransportException& tx) {
+    BOOST_CHECK_EQUAL(TTransportException::INTERRUPTED, tx.getType());
+  }
+}
+
+BOOST_AUTO_TEST_CASE(test_uring_interruptable_child_read) {
+  TUringServerSocket sock1("localhost", 0);
+  sock1.listen();
+  int port = sock1.getPort();
+  TSocket clientSock("localhost", port);
+  clientSock.open();
+  std::shared_ptr<TTransport> accepted = sock1.accept();
+  boost::thread readThread(std::bind(uringReaderWorkerMustThrow, accepted));
+  boost::this_thread::sleep(boost::posix_time::milliseconds(50));
+  // readThread is practically guaranteed to be blocking now
+  sock1.interruptChildren();
+  BOOST_CHECK_MESSAGE(readThread.try_join_for(boost::chrono::milliseconds(200)),
+                      "server socket interruptChildren did not interrupt child read");
+  clientSock.close();
+  accepted->close();
+  sock1.close();
+}
+
+void uringAcceptWorkerMustThrow(TUringServerSocket* sock) {
+  try {
+    sock->accept();
+    BOOST_ERROR("should not have gotten here");
+  } catch (const TTransportException& tx) {
+    BOOST_CHECK_EQUAL(TTransportException::INTERRUPTED, tx.getType());
+  }
+}
+
+BOOST_AUTO_TEST_CASE(test_uring_interrupt_accept) {
+  TUringServerSocket sock1("localhost", 0);
+  sock1.listen();
+  boost::thread acceptThread(std::bind(uringAcceptWorkerMustThrow, &sock1));
+  boost::this_thread::sleep(boost::posix_time::milliseconds(50));
+  sock1.interrupt();
+  BOOST_CHECK_MESSAGE(acceptThread.try_join_for(boost::chrono::milliseconds(200)),
+                      "server socket interrupt did not interrupt accept");
+
+  // the interrupt was consumed: the next accept succeeds
+  TSocket clientSock("localhost", sock1.getPort());
+  clientSock.open();
+  std::shared_ptr<TTransport> accepted = sock1.accept();
+  BOOST_CHECK(accepted->isOpen());
+  clientSock.close();
+  accepted->close();
+  sock1.close();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
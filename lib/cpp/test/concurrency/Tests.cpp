@@ -30,6 +30,90 @@
 // and the baseline is optimized for running in valgrind
 static int WEIGHT = 10;
 
+template <class Manager>
+static bool timerManagerTests() {
+  std::cout << "\t\tTimerManager test00" << '\n';
+
+  TimerManagerTests timerManagerTests;
+
+  if (!timerManagerTests.template test00<Manager>()) {
+    std::cerr << "\t\tTimerManager tests FAILED" << '\n';
+    return false;
+  }
+
+  std::cout << "\t\tTimerManager test01" << '\n';
+
+  if (!timerManagerTests.template test01<Manager>()) {
+    std::cerr << "\t\tTimerManager tests FAILED" << '\n';
+    return false;
+  }
+
+  std::cout << "\t\tTimerManager test02" << '\n';
+
+  if (!timerManagerTests.template test02<Manager>()) {
+    std::cerr << "\t\tTimerManager tests FAILED" << '\n';
+    return false;
+  }
+
+  std::cout << "\t\tTimerManager test03" << '\n';
+
+  if (!timerManagerTests.template test03<Manager>()) {
+    std::cerr << "\t\tTimerManager tests FAILED" << '\n';
+    return false;
+  }
+
+  std::cout << "\t\tTimerManager test04" << '\n';
+
+  if (!timerManagerTests.template test04<Manager>()) {
+    std::cerr << "\t\tTimerManager tests FAILED" << '\n';
+    return false;
+  }
+
+  return true;
+}
+
+static bool threadManagerTests(ThreadManagerTests::Factory factory) {
+  size_t workerCount = 10 * WEIGHT;
+  size_t taskCount = 500 * WEIGHT;
+  int64_t delay = 10LL;
+
+  ThreadManagerTests threadManagerTests(factory);
+
+  std::cout << "\t\tThreadManager api test:" << '\n';
+
+  if (!threadManagerTests.apiTest()) {
+    std::cerr << "\t\tThreadManager apiTest FAILED" << '\n';
+    return false;
+  }
+
+  std::cout << "\t\tThreadManager load test: worker count: " << workerCount
+            << " task count: " << taskCount << " delay: " << delay << '\n';
+
+  if (!threadManagerTests.loadTest(taskCount, delay, workerCount)) {
+    std::cerr << "\t\tThreadManager loadTest FAILED" << '\n';
+    return false;
+  }
+
+  std::cout << "\t\tThreadManager block test: worker count: " << workerCount
+            << " delay: " << delay << '\n';
+
+  if (!threadManagerTests.blockTest(delay, workerCount)) {
+    std::cerr << "\t\tThreadManager blockTest FAILED" << '\n';
+    return false;
+  }
+
+  size_t wakeupCount = 2000 * WEIGHT;
+
+  std::cout << "\t\tThreadManager wakeup test: task count: " << wakeupCount << '\n';
+
+  if (!threadManagerTests.wakeupTest(wakeupCount)) {
+    std::cerr << "\t\tThreadManager wakeupTest FAILED" << '\n';
+    return false;
+  }
+
+  return true;
+}
+
 int main(int argc, char** argv) {
 
   std::vector<std::string> args((argc - 1) > 1 ? (argc - 1) : 1);
@@ -114,77 +198,57 @@ int main(int argc, char** argv) {
 
     std::cout << "TimerManager tests..." << '\n';
 
-    std::cout << "\t\tTimerManager test00" << '\n';
-
-    TimerManagerTests timerManagerTests;
-
-    if (!timerManagerTests.test00()) {
-      std::cerr << "\t\tTimerManager tests FAILED" << '\n';
+    if (!timerManagerTests<TimerManager>()) {
       return 1;
     }
 
-    std::cout << "\t\tTimerManager test01" << '\n';
+    std::cout << "TimingWheelTimerManager tests..." << '\n';
 
-    if (!timerManagerTests.test01()) {
-      std::cerr << "\t\tTimerManager tests FAILED" << '\n';
+    if (!timerManagerTests<TimingWheelTimerManager>()) {
       return 1;
     }
 
-    std::cout << "\t\tTimerManager test02" << '\n';
+    std::cout << "\t\tTimingWheelTimerManager test05" << '\n';
 
-    if (!timerManagerTests.test02()) {
+    if (!TimerManagerTests().test05()) {
       std::cerr << "\t\tTimerManager tests FAILED" << '\n';
       return 1;
     }
 
-    std::cout << "\t\tTimerManager test03" << '\n';
+    size_t timerCount = 10000 * WEIGHT;
 
-    if (!timerManagerTests.test03()) {
-      std::cerr << "\t\tTimerManager tests FAILED" << '\n';
-      return 1;
-    }
+    std::cout << "\t\tTimerManager scale test: timer count: " << timerCount << '\n';
 
-    std::cout << "\t\tTimerManager test04" << '\n';
+    TimerManager timerManager;
+    TimingWheelTimerManager timingWheelTimerManager;
 
-    if (!timerManagerTests.test04()) {
-      std::cerr << "\t\tTimerManager tests FAILED" << '\n';
-      return 1;
-    }
+    std::cout << "\t\t\tmultimap: "
+              << static_cast<int64_t>(TimerManagerTests().scaleTest(timerManager, timerCount))
+              << " timers/s, timing wheel: "
+              << static_cast<int64_t>(
+                     TimerManagerTests().scaleTest(timingWheelTimerManager, timerCount))
+              << " timers/s" << '\n';
   }
 
   if (runAll || args[0].compare("thread-manager") == 0) {
 
     std::cout << "ThreadManager tests..." << '\n';
 
-    {
-      size_t workerCount = 10 * WEIGHT;
-      size_t taskCount = 500 * WEIGHT;
-      int64_t delay = 10LL;
-
-      ThreadManagerTests threadManagerTests;
-
-      std::cout << "\t\tThreadManager api test:" << '\n';
-
-      if (!threadManagerTests.apiTest()) {
-        std::cerr << "\t\tThreadManager apiTest FAILED" << '\n';
-        return 1;
-      }
+    if (!threadManagerTests(ThreadManager::newSimpleThreadManager)) {
+      return 1;
+    }
 
-      std::cout << "\t\tThreadManager load test: worker count: " << workerCount
-                << " task count: " << taskCount << " delay: " << delay << '\n';
+    std::cout << "\t\tThreadManager deadline test:" << '\n';
 
-      if (!threadManagerTests.loadTest(taskCount, delay, workerCount)) {
-        std::cerr << "\t\tThreadManager loadTest FAILED" << '\n';
-        return 1;
-      }
+    if (!ThreadManagerTests().deadlineTest()) {
+      std::cerr << "\t\tThreadManager deadlineTest FAILED" << '\n';
+      return 1;
+    }
 
-      std::cout << "\t\tThreadManager block test: worker count: " << workerCount
-                << " delay: " << delay << '\n';
+    std::cout << "WorkStealingThreadManager tests..." << '\n';
 
-      if (!threadManagerTests.blockTest(delay, workerCount)) {
-        std::cerr << "\t\tThreadManager blockTest FAILED" << '\n';
-        return 1;
-      }
+    if (!threadManagerTests(ThreadManager::newWorkStealingThreadManager)) {
+      return 1;
     }
   }
 
@@ -218,6 +282,31 @@ int main(int argc, char** argv) {
         }
       }
     }
+
+    {
+      size_t taskCount = 10000 * WEIGHT;
+
+      size_t adderCount = 4;
+
+      std::cout << "\t\tThreadManager throughput test: task count: " << taskCount
+                << " adder count: " << adderCount << '\n';
+
+      std::cout << "\t\t\tworkers\tsimple tasks/s\twork stealing tasks/s" << '\n';
+
+      for (size_t workerCount = 1; workerCount <= 16; workerCount *= 2) {
+
+        ThreadManagerTests simpleTests(ThreadManager::newSimpleThreadManager);
+
+        ThreadManagerTests workStealingTests(ThreadManager::newWorkStealingThreadManager);
+
+        double simple = simpleTests.throughputTest(taskCount, workerCount, adderCount);
+
+        double workStealing = workStealingTests.throughputTest(taskCount, workerCount, adderCount);
+
+        std::cout << "\t\t\t" << workerCount << "\t" << static_cast<int64_t>(simple) << "\t\t"
+                  << static_cast<int64_t>(workStealing) << '\n';
+      }
+    }
   }
 
   std::cout << "ALL TESTS PASSED" << '\n';
@@ -23,10 +23,13 @@
 #include <thrift/concurrency/Monitor.h>
 
 #include <assert.h>
+#include <atomic>
 #include <deque>
 #include <set>
 #include <iostream>
 #include <stdint.h>
+#include <thread>
+#include <vector>
 
 namespace apache {
 namespace thrift {
@@ -57,6 +60,11 @@ static void sleep_(int64_t millisec) {
 class ThreadManagerTests {
 
 public:
+  typedef std::shared_ptr<ThreadManager> (*Factory)(size_t count, size_t pendingTaskCountMax);
+
+  ThreadManagerTests(Factory factory = ThreadManager::newSimpleThreadManager)
+    : _factory(factory) {}
+
   class Task : public Runnable {
 
   public:
@@ -105,7 +113,7 @@ public:
 
     size_t activeCount = count;
 
-    shared_ptr<ThreadManager> threadManager = ThreadManager::newSimpleThreadManager(workerCount);
+    shared_ptr<ThreadManager> threadManager = _factory(workerCount, 0);
 
     shared_ptr<ThreadFactory> threadFactory
         = shared_ptr<ThreadFactory>(new ThreadFactory(false));
@@ -251,7 +259,7 @@ public:
       size_t activeCounts[] = {workerCount, pendingTaskMaxCount, 1};
 
       shared_ptr<ThreadManager> threadManager
-          = ThreadManager::newSimpleThreadManager(workerCount, pendingTaskMaxCount);
+          = _factory(workerCount, pendingTaskMaxCount);
 
       shared_ptr<ThreadFactory> threadFactory
           = shared_ptr<ThreadFactory>(new ThreadFactory());
@@ -400,7 +408,7 @@ public:
 
   bool apiTestWithThreadFactory(shared_ptr<ThreadFactory> threadFactory)
   {
-    shared_ptr<ThreadManager> threadManager = ThreadManager::newSimpleThreadManager(1);
+    shared_ptr<ThreadManager> threadManager = _factory(1, 0);
     threadManager->threadFactory(threadFactory);
 
     std::cout << "\t\t\t\tstarting.. " << '\n';
@@ -629,6 +637,237 @@ public:
     threadManager.reset();
     return true;
   }
+
+  /**
+   * Deadline test.  Verify that EARLIEST_DEADLINE_FIRST orders the pending tasks
+   * by expiration and that expired tasks are reported with the right reason.
+   */
+  bool deadlineTest() {
+
+    shared_ptr<ThreadManager> threadManager = _factory(0, 2);
+    threadManager->threadFactory(shared_ptr<ThreadFactory>(new ThreadFactory()));
+    threadManager->start();
+
+    std::deque<ThreadManager::EXPIRE_REASON> reasons;
+    threadManager->setExpireInfoCallback(
+        [&reasons](shared_ptr<Runnable>, const ThreadManager::ExpireInfo& info) {
+          reasons.push_back(info.reason);
+        });
+
+    Monitor monitor;
+    size_t count = 4;
+    std::vector<shared_ptr<Runnable> > tasks;
+    for (size_t ix = 0; ix < 4; ix++) {
+      tasks.push_back(shared_ptr<Runnable>(new ThreadManagerTests::Task(monitor, count, 1)));
+    }
+
+    std::cout << "\t\t\t\tpending tasks run earliest deadline first.." << '\n';
+
+    threadManager->add(tasks[0], 0, 500);
+    threadManager->add(tasks[1]);
+    threadManager->scheduling(ThreadManager::EARLIEST_DEADLINE_FIRST);
+    EXPECT(threadManager->pendingTaskCount(), 2);
+
+    if (threadManager->removeNextPending() != tasks[0]
+        || threadManager->removeNextPending() != tasks[1]) {
+      std::cerr << "\t\t\t\t\texpected the task with a deadline first" << '\n';
+      return false;
+    }
+
+    std::cout << "\t\t\t\ttasks without a deadline are not starved.." << '\n';
+
+    threadManager->fallbackDeadline(20);
+    threadManager->add(tasks[1]);
+    sleep_(50);
+    threadManager->add(tasks[0], 0, 60000);
+    if (threadManager->removeNextPending() != tasks[1]
+        || threadManager->removeNextPending() != tasks[0]) {
+      std::cerr << "\t\t\t\t\texpected the overdue task without a deadline first" << '\n';
+      return false;
+    }
+
+    // an expired task behind an overdue one without a deadline is still found
+    threadManager->add(tasks[1]);
+    sleep_(50);
+    threadManager->add(tasks[2], 0, 1);
+    sleep_(50);
+    threadManager->removeExpiredTasks();
+    EXPECT(threadManager->pendingTaskCount(), 1);
+    EXPECT(threadManager->expiredTaskCount(), 1);
+    if (threadManager->removeNextPending() != tasks[1]) {
+      std::cerr << "\t\t\t\t\texpected the task without a deadline to stay" << '\n';
+      return false;
+    }
+    reasons.clear();
+    threadManager->fallbackDeadline(ThreadManager::DEFAULT_FALLBACK_DEADLINE);
+
+    threadManager->add(tasks[0], 0, 60000);
+    threadManager->add(tasks[1], 0, 30000);
+    if (threadManager->removeNextPending() != tasks[1]
+        || threadManager->removeNextPending() != tasks[0]) {
+      std::cerr << "\t\t\t\t\texpected the earlier deadline first" << '\n';
+      return false;
+    }
+
+    std::cout << "\t\t\t\tadd drops an expired task at the limit.." << '\n';
+
+    threadManager->add(tasks[2]);
+    threadManager->add(tasks[3], 0, 1);
+    sleep_(50);
+    threadManager->add(tasks[1], -1);
+    EXPECT(threadManager->pendingTaskCount(), 2);
+    EXPECT(threadManager->expiredTaskCount(), 2);
+    if (reasons.size() != 1 || reasons.front() != ThreadManager::EXPIRED_AT_LIMIT) {
+      std::cerr << "\t\t\t\t\texpected an EXPIRED_AT_LIMIT expiration" << '\n';
+      return false;
+    }
+    reasons.clear();
+
+    std::cout << "\t\t\t\tremove expired tasks.." << '\n';
+
+    threadManager->remove(tasks[1]);
+    threadManager->add(tasks[3], 0, 1);
+    sleep_(50);
+    threadManager->removeExpiredTasks();
+    EXPECT(threadManager->pendingTaskCount(), 1);
+    EXPECT(threadManager->expiredTaskCount(), 3);
+    if (reasons.size() != 1 || reasons.front() != ThreadManager::EXPIRED_BY_SWEEP) {
+      std::cerr << "\t\t\t\t\texpected an EXPIRED_BY_SWEEP expiration" << '\n';
+      return false;
+    }
+    reasons.clear();
+
+    std::cout << "\t\t\t\tworker drops an expired task.." << '\n';
+
+    threadManager->add(tasks[3], 0, 1);
+    sleep_(50);
+    threadManager->addWorker();
+    while (threadManager->totalTaskCount() != 0) {
+      sleep_(10);
+    }
+    threadManager->removeWorker();
+
+    EXPECT(threadManager->pendingTaskCount(), 0);
+    EXPECT(threadManager->expiredTaskCount(), 4);
+    if (reasons.size() != 1 || reasons.front() != ThreadManager::EXPIRED_AT_DISPATCH) {
+      std::cerr << "\t\t\t\t\texpected an EXPIRED_AT_DISPATCH expiration" << '\n';
+      return false;
+    }
+
+    return true;
+  }
+
+  class CountTask : public Runnable {
+
+  public:
+    CountTask(Monitor& monitor, std::atomic<size_t>& count) : _monitor(monitor), _count(count) {}
+
+    void run() override {
+      if (--_count == 0) {
+        Synchronized s(_monitor);
+        _monitor.notify();
+      }
+    }
+
+    Monitor& _monitor;
+    std::atomic<size_t>& _count;
+  };
+
+  /**
+   * Wakeup test.  Adds count tasks one at a time, each once the one before
+   * has run, so the workers are idle when it arrives.  A task whose wakeup
+   * is lost would wait for the next add(), which does not come.
+   */
+  bool wakeupTest(size_t count = 10000, size_t workerCount = 2) {
+
+    Monitor monitor;
+
+    std::atomic<size_t> activeCount(0);
+
+    shared_ptr<ThreadManager> threadManager = _factory(workerCount, 0);
+
+    threadManager->threadFactory(shared_ptr<ThreadFactory>(new ThreadFactory(false)));
+
+    threadManager->start();
+
+    shared_ptr<Runnable> task(new CountTask(monitor, activeCount));
+
+    bool success = true;
+
+    for (size_t ix = 0; ix < count && success; ix++) {
+      Synchronized s(monitor);
+
+      activeCount = 1;
+      threadManager->add(task);
+
+      while (activeCount > 0) {
+        if (monitor.waitForTimeRelative(1000) != 0 && activeCount > 0) {
+          std::cerr << "\t\t\ttask " << ix << " did not run" << '\n';
+          success = false;
+          break;
+        }
+      }
+    }
+
+    threadManager->stop();
+
+    return success;
+  }
+
+  /**
+   * Throughput test.  adderCount threads add count tasks that do next to
+   * nothing, so the cost of handing tasks to the workers dominates.
+   *
+   * @return the number of tasks run per second
+   */
+  double throughputTest(size_t count = 100000, size_t workerCount = 4, size_t adderCount = 4) {
+
+    Monitor monitor;
+
+    std::atomic<size_t> activeCount(count);
+
+    shared_ptr<ThreadManager> threadManager = _factory(workerCount, 0);
+
+    threadManager->threadFactory(shared_ptr<ThreadFactory>(new ThreadFactory(false)));
+
+    threadManager->start();
+
+    // the same task can be queued any number of times
+    shared_ptr<Runnable> task(new CountTask(monitor, activeCount));
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> adders;
+    for (size_t ix = 0; ix < adderCount; ix++) {
+      size_t share = count / adderCount + (ix < count % adderCount ? 1 : 0);
+      adders.push_back(std::thread([threadManager, task, share]() {
+        for (size_t jx = 0; jx < share; jx++) {
+          threadManager->add(task);
+        }
+      }));
+    }
+
+    for (auto& adder : adders) {
+      adder.join();
+    }
+
+    {
+      Synchronized s(monitor);
+
+      while (activeCount > 0) {
+        monitor.wait();
+      }
+    }
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    threadManager->stop();
+
+    return count / elapsed.count();
+  }
+
+private:
+  Factory _factory;
 };
 
 }
@@ -22,9 +22,11 @@
 #include <thrift/concurrency/Monitor.h>
 
 #include <assert.h>
+#include <atomic>
 #include <chrono>
 #include <thread>
 #include <iostream>
+#include <vector>
 
 namespace apache {
 namespace thrift {
@@ -74,13 +76,14 @@ public:
    * properly clean up itself and the remaining orphaned timeout task when the
    * manager goes out of scope and its destructor is called.
    */
+  template <class Manager = TimerManager>
   bool test00(uint64_t timeout = 1000LL) {
 
     shared_ptr<TimerManagerTests::Task> orphanTask
         = shared_ptr<TimerManagerTests::Task>(new TimerManagerTests::Task(_monitor, 10 * timeout));
 
     {
-      TimerManager timerManager;
+      Manager timerManager;
       timerManager.threadFactory(shared_ptr<ThreadFactory>(new ThreadFactory()));
       timerManager.start();
       if (timerManager.state() != TimerManager::STARTED) {
@@ -124,8 +127,9 @@ public:
    * verifies that the timer manager properly clean up itself and the remaining orphaned timeout
    * task when the manager goes out of scope and its destructor is called.
    */
+  template <class Manager = TimerManager>
   bool test01(uint64_t timeout = 1000LL) {
-    TimerManager timerManager;
+    Manager timerManager;
     timerManager.threadFactory(shared_ptr<ThreadFactory>(new ThreadFactory()));
     timerManager.start();
     assert(timerManager.state() == TimerManager::STARTED);
@@ -157,8 +161,9 @@ public:
    * clean up itself and the remaining orphaned timeout task when the manager goes out of scope
    * and its destructor is called.
    */
+  template <class Manager = TimerManager>
   bool test02(uint64_t timeout = 1000LL) {
-    TimerManager timerManager;
+    Manager timerManager;
     timerManager.threadFactory(shared_ptr<ThreadFactory>(new ThreadFactory()));
     timerManager.start();
     assert(timerManager.state() == TimerManager::STARTED);
@@ -190,8 +195,9 @@ public:
    * verifies that the timer manager properly clean up itself and the remaining orphaned timeout
    * task when the manager goes out of scope and its destructor is called.
    */
+  template <class Manager = TimerManager>
   bool test03(uint64_t timeout = 1000LL) {
-    TimerManager timerManager;
+    Manager timerManager;
     timerManager.threadFactory(shared_ptr<ThreadFactory>(new ThreadFactory()));
     timerManager.start();
     assert(timerManager.state() == TimerManager::STARTED);
@@ -227,8 +233,9 @@ public:
   /**
    * This test creates one task, and tries to remove it after it has expired.
    */
+  template <class Manager = TimerManager>
   bool test04(uint64_t timeout = 1000LL) {
-    TimerManager timerManager;
+    Manager timerManager;
     timerManager.threadFactory(shared_ptr<ThreadFactory>(new ThreadFactory()));
     timerManager.start();
     assert(timerManager.state() == TimerManager::STARTED);
@@ -262,6 +269,106 @@ public:
     return true;
   }
 
+  class CountTask : public Runnable {
+  public:
+    CountTask(std::atomic<size_t>& count, std::chrono::steady_clock::time_point due)
+      : _count(count), _due(due), _early(false) {}
+
+    void run() override {
+      _early = std::chrono::steady_clock::now() < _due;
+      _count--;
+    }
+
+    std::atomic<size_t>& _count;
+    std::chrono::steady_clock::time_point _due;
+    bool _early;
+  };
+
+  /**
+   * This test adds count timers spread over more than one turn of the innermost
+   * wheel of a TimingWheelTimerManager, removes every fourth one and verifies
+   * that the others run, none of them early, and the removed ones do not.
+   */
+  bool test05(size_t count = 1000, uint64_t timeout = 1000LL) {
+    TimingWheelTimerManager timerManager(std::chrono::milliseconds(1));
+    timerManager.threadFactory(shared_ptr<ThreadFactory>(new ThreadFactory()));
+    timerManager.start();
+    assert(timerManager.state() == TimerManager::STARTED);
+
+    std::atomic<size_t> remaining(count - count / 4);
+    std::vector<shared_ptr<CountTask> > tasks;
+    std::vector<TimerManager::Timer> timers;
+    for (size_t ix = 0; ix < count; ix++) {
+      std::chrono::milliseconds delay(1 + ix * timeout / count);
+      auto due = std::chrono::steady_clock::now() + delay;
+      tasks.push_back(shared_ptr<CountTask>(new CountTask(remaining, due)));
+      timers.push_back(timerManager.add(tasks.back(), delay));
+    }
+
+    for (size_t ix = 3; ix < count; ix += 4) {
+      try {
+        timerManager.remove(timers[ix]);
+      } catch (const UncancellableTaskException&) {
+        // already running, so it counts itself
+        remaining++;
+      } catch (const NoSuchTaskException&) {
+        // already ran, so it has counted itself
+        remaining++;
+      }
+    }
+
+    for (uint64_t waited = 0; remaining > 0 && waited < 2 * timeout; waited += 10) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    if (remaining != 0 || timerManager.taskCount() != 0) {
+      std::cerr << "\t\t\t" << remaining << " timers did not run" << '\n';
+      return false;
+    }
+
+    for (const auto& task : tasks) {
+      if (task->_early) {
+        std::cerr << "\t\t\ta timer ran early" << '\n';
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+  /**
+   * Scale test.  Adds count timers with timeouts between one second and
+   * one minute, as for request timeouts, then removes them all again.
+   *
+   * @return the number of added and removed timers per second
+   */
+  template <class Manager>
+  double scaleTest(Manager& timerManager, size_t count = 1000000) {
+    timerManager.threadFactory(shared_ptr<ThreadFactory>(new ThreadFactory()));
+    timerManager.start();
+
+    std::atomic<size_t> remaining(count);
+    shared_ptr<Runnable> task(new CountTask(remaining, std::chrono::steady_clock::now()));
+    std::vector<TimerManager::Timer> timers;
+    timers.reserve(count);
+
+    auto start = std::chrono::steady_clock::now();
+
+    for (size_t ix = 0; ix < count; ix++) {
+      timers.push_back(timerManager.add(task, std::chrono::milliseconds(1000 + ix * 59000 / count)));
+    }
+
+    for (const auto& timer : timers) {
+      timerManager.remove(timer);
+    }
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    timerManager.stop();
+
+    return count / elapsed.count();
+  }
+
   friend class TestTask;
 
   Monitor _monitor;
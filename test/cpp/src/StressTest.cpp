@@ -27,16 +27,19 @@
 #include <thrift/server/TThreadedServer.h>
 #include <thrift/transport/TServerSocket.h>
 #include <thrift/transport/TSocket.h>
+#include <thrift/transport/TUringSocket.h>
 #include <thrift/transport/TTransportUtils.h>
 #include <thrift/transport/TFileTransport.h>
 #include <thrift/TLogging.h>
 
 #include "Service.h"
+#include <algorithm>
 #include <iostream>
 #include <set>
 #include <stdexcept>
 #include <sstream>
 #include <map>
+#include <vector>
 #if _WIN32
 #include <thrift/windows/TWinsockSingleton.h>
 #endif
@@ -120,7 +123,9 @@ public:
       _workerCount(workerCount),
       _loopCount(loopCount),
       _loopType(loopType),
-      _behavior(behavior) {}
+      _behavior(behavior) {
+    _latencies.reserve(loopCount);
+  }
 
   void run() override {
 
@@ -181,7 +186,9 @@ public:
 
   void loopEchoVoid() {
     for (size_t ix = 0; ix < _loopCount; ix++) {
+      int64_t begin = nowMicros();
       _client->echoVoid();
+      _latencies.push_back(nowMicros() - begin);
     }
   }
 
@@ -189,7 +196,9 @@ public:
     for (size_t ix = 0; ix < _loopCount; ix++) {
       int8_t arg = 1;
       int8_t result;
+      int64_t begin = nowMicros();
       result = _client->echoByte(arg);
+      _latencies.push_back(nowMicros() - begin);
       (void)result;
       assert(result == arg);
     }
@@ -199,7 +208,9 @@ public:
     for (size_t ix = 0; ix < _loopCount; ix++) {
       int32_t arg = 1;
       int32_t result;
+      int64_t begin = nowMicros();
       result = _client->echoI32(arg);
+      _latencies.push_back(nowMicros() - begin);
       (void)result;
       assert(result == arg);
     }
@@ -209,7 +220,9 @@ public:
     for (size_t ix = 0; ix < _loopCount; ix++) {
       int64_t arg = 1;
       int64_t result;
+      int64_t begin = nowMicros();
       result = _client->echoI64(arg);
+      _latencies.push_back(nowMicros() - begin);
       (void)result;
       assert(result == arg);
     }
@@ -219,11 +232,17 @@ public:
     for (size_t ix = 0; ix < _loopCount; ix++) {
       string arg = "hello";
       string result;
+      int64_t begin = nowMicros();
       _client->echoString(result, arg);
+      _latencies.push_back(nowMicros() - begin);
       assert(result == arg);
     }
   }
 
+  static int64_t nowMicros() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+
   std::shared_ptr<TTransport> _transport;
   std::shared_ptr<ServiceIf> _client;
   Monitor& _monitor;
@@ -235,6 +254,7 @@ public:
   bool _done;
   Monitor _sleep;
   TransportOpenCloseBehavior _behavior;
+  vector<int64_t> _latencies; // microseconds per call
 };
 
 class TStartObserver : public apache::thrift::server::TServerEventHandler {
@@ -265,6 +285,7 @@ int main(int argc, char** argv) {
   string clientType = "regular";
   string serverType = "thread-pool";
   string protocolType = "binary";
+  string transportType = "socket";
   size_t workerCount = 8;
   size_t clientCount = 4;
   size_t loopCount = 50000;
@@ -280,7 +301,7 @@ int main(int argc, char** argv) {
   usage << argv[0] << " [--port=<port number>] [--server] [--server-type=<server-type>] "
                       "[--protocol-type=<protocol-type>] [--workers=<worker-count>] "
                       "[--clients=<client-count>] [--loop=<loop-count>] "
-                      "[--client-type=<client-type>]" << '\n'
+                      "[--client-type=<client-type>] [--transport-type=<transport-type>]" << '\n'
         << "\tclients        Number of client threads to create - 0 implies no clients, i.e. "
                             "server only.  Default is " << clientCount << '\n'
         << "\thelp           Prints this help text." << '\n'
@@ -296,6 +317,11 @@ int main(int argc, char** argv) {
         << "\tworkers        Number of thread pools workers.  Only valid "
                             "for thread-pool server type.  Default is " << workerCount << '\n'
         << "\tclient-type    Type of client, \"regular\" or \"concurrent\".  Default is " << clientType << '\n'
+        << "\ttransport-type Type of socket for server and clients, \"socket\" or \"uring\" "
+                            "(io_uring).  Default is " << transportType << '\n'
+        << '\n'
+        << "The system calls made per request can be compared by running the benchmark under" << '\n'
+        << "\tperf stat -e raw_syscalls:sys_enter " << argv[0] << " --transport-type=<transport-type>" << '\n'
         << '\n';
 
   map<string, string> args;
@@ -381,9 +407,25 @@ int main(int argc, char** argv) {
         throw invalid_argument("Unknown client type " + clientType);
       }
     }
+    if (!args["transport-type"].empty()) {
+      transportType = args["transport-type"];
+
+      if (transportType == "socket") {
+
+      } else if (transportType == "uring") {
+
+      } else {
+
+        throw invalid_argument("Unknown transport type " + transportType);
+      }
+    }
     if (!args["workers"].empty()) {
       workerCount = atoi(args["workers"].c_str());
     }
+    if (transportType == "uring" && clientType == "concurrent") {
+      // TUringSocket does not support reading and writing from different threads
+      throw invalid_argument("Transport type uring cannot be used with client type concurrent");
+    }
 
   } catch (std::exception& e) {
     cerr << e.what() << '\n';
@@ -420,7 +462,12 @@ int main(int argc, char** argv) {
     std::shared_ptr<ServiceProcessor> serviceProcessor(new ServiceProcessor(serviceHandler));
 
     // Transport
-    std::shared_ptr<TServerSocket> serverSocket(new TServerSocket(port));
+    std::shared_ptr<TServerSocket> serverSocket;
+    if (transportType == "uring") {
+      serverSocket.reset(new TUringServerSocket(port));
+    } else {
+      serverSocket.reset(new TServerSocket(port));
+    }
 
     // Transport Factory
     std::shared_ptr<TTransportFactory> transportFactory(new TBufferedTransportFactory());
@@ -501,10 +548,17 @@ int main(int argc, char** argv) {
       throw invalid_argument("Unknown service call " + callName);
     }
 
+    auto newSocket = [&]() -> std::shared_ptr<TSocket> {
+      if (transportType == "uring") {
+        return std::make_shared<TUringSocket>("127.0.0.1", port);
+      }
+      return std::make_shared<TSocket>("127.0.0.1", port);
+    };
+
     if(clientType == "regular") {
       for (size_t ix = 0; ix < clientCount; ix++) {
 
-        std::shared_ptr<TSocket> socket(new TSocket("127.0.0.1", port));
+        std::shared_ptr<TSocket> socket = newSocket();
         std::shared_ptr<TBufferedTransport> bufferedSocket(new TBufferedTransport(socket, 2048));
         std::shared_ptr<TProtocol> protocol(new TBinaryProtocol(bufferedSocket));
         std::shared_ptr<ServiceClient> serviceClient(new ServiceClient(protocol));
@@ -513,7 +567,7 @@ int main(int argc, char** argv) {
             new ClientThread(socket, serviceClient, monitor, threadCount, loopCount, loopType, OpenAndCloseTransportInThread))));
       }
     } else if(clientType == "concurrent") {
-      std::shared_ptr<TSocket> socket(new TSocket("127.0.0.1", port));
+      std::shared_ptr<TSocket> socket = newSocket();
       std::shared_ptr<TBufferedTransport> bufferedSocket(new TBufferedTransport(socket, 2048));
       std::shared_ptr<TProtocol> protocol(new TBinaryProtocol(bufferedSocket));
       auto sync = std::make_shared<TConcurrentClientSyncInfo>();
@@ -558,6 +612,9 @@ int main(int argc, char** argv) {
     int64_t minTime = 9223372036854775807LL;
     int64_t maxTime = 0;
 
+    vector<int64_t> latencies;
+    latencies.reserve(clientCount * loopCount);
+
     for (auto ix = clientThreads.begin();
          ix != clientThreads.end();
          ix++) {
@@ -586,6 +643,8 @@ int main(int argc, char** argv) {
       }
 
       averageTime += delta;
+
+      latencies.insert(latencies.end(), client->_latencies.begin(), client->_latencies.end());
     }
 
     averageTime /= clientCount;
@@ -593,6 +652,14 @@ int main(int argc, char** argv) {
     cout << "workers :" << workerCount << ", client : " << clientCount << ", loops : " << loopCount
          << ", rate : " << (clientCount * loopCount * 1000) / ((double)(time01 - time00)) << '\n';
 
+    if (!latencies.empty()) {
+      std::sort(latencies.begin(), latencies.end());
+      cout << "transport : " << transportType
+           << ", latency p50 : " << latencies[latencies.size() / 2] << "us"
+           << ", p99 : " << latencies[(latencies.size() * 99) / 100] << "us"
+           << ", max : " << latencies.back() << "us" << '\n';
+    }
+
     count_map count = serviceHandler->getCount();
     count_map::iterator iter;
     for (iter = count.begin(); iter != count.end(); ++iter) {